@@ -19,19 +19,13 @@ typedef struct allpass
     t_object object;
     
     // state of each inlet value
-    t_float sample;    // first inlet: audio, so not used for control rate
-    t_float Q;         // second inlet: filter Q, or width
-    t_float freq;      // third inlet: filter cutoff frequency (Hz.)
+    t_float     sample; // first inlet: audio, so not used for control rate
     
-    // state of pd audio
-    t_float sr;        // sample rate for filter math (Hz.)
-    
-    // filter coefficients and delay table
-    t_float b_coef[3]; // 'B' coefficients (B0, B1, B2)
-    t_float a_coef[2]; // 'A' coefficients (A1, A2)
-    t_float f_feed[2]; // feedforward delay
-    t_float b_feed[2]; // feedback delay
-    t_int   wptr;      // write pointer (for delay tables)
+    // the filter engine (keeps Q and freq, coefficients and delay tables)
+    hof_biquad* filter;
+    t_outlet*   info;    // outlet for "latency" (and "stats")
+    int         latency; // the latency last sent out of it
+    t_clock*    poll;    // sends it once a posted change is taken
     
 } t_allpass;
 
@@ -51,75 +45,138 @@ static t_int* allpass_perform(t_int* ptr)
     const t_int nSamples = (t_int)     ptr[3];
     t_allpass*  x        = (t_allpass*)ptr[4];
     
-    for (t_int n = 0; n < nSamples; ++n)
-    {
-        // get wrapped read pointers and copy input sample
-        const t_int rptr1    = x->wptr;
-        const t_int rptr0    = 1 - rptr1;
-        const t_float sample = input[n];
-        
-        // make output sample and write to feedback delay table
-        x->b_feed[x->wptr] =
-        output[n] =
-        sample           * x->b_coef[0] +
-        x->f_feed[rptr0] * x->b_coef[1] +
-        x->f_feed[rptr1] * x->b_coef[2] -
-        x->b_feed[rptr0] * x->a_coef[0] -
-        x->b_feed[rptr1] * x->a_coef[1];
-        
-        // write input sample to feedforward delay table
-        x->f_feed[x->wptr] = sample;
-        
-        // toggle write pointer
-        x->wptr = rptr0;
-    }
+    // filter this block (the engine handles any scheduled changes)
+    hof_biquad_process(x->filter, (const float* const*)&input, &output,
+                       nSamples);
     
     return &ptr[5];
 }
 
-// update coefficients ---------------------------------------------------------
+// update a parameter ----------------------------------------------------------
 /*
- * called after filter parameters are changed.
- * here we calculate the B and A coefficients for this filter. the filter
- * equations are the canonical second-order filters from DAFX vol.2 (p.50).
- * the term 'Q' is a scalar for filter resonance.
- * the term 'K' is a function of cutoff frequency and sampling rate.
- * all other terms are derived from Q and K to minimize redundant computation.
+ * called by the parameter messages below, which might not come from the audio
+ * thread (libpd hosts can send them from anywhere). the change is posted to the
+ * filter engine, which applies it at the start of the next block. a 'delay'
+ * (ms.) schedules it for that much later, on the right sample.
  */
-static void allpass_update_BA(t_allpass* x)
+static void allpass_set(t_allpass* x, hof_param param, t_floatarg value,
+                        t_floatarg delay)
 {
-    const t_float Q            = clip_Q(x->Q);
-    const t_float K            = tanf(M_PI * clip_freq_ratio(x->freq, x->sr));
-    const t_float KKQ          = K * K * Q;
-    const t_float rDenominator = 1.f / (KKQ + K + Q);
-    
-    x->b_coef[0] =
-    x->a_coef[1] = ((KKQ - K) + Q) * rDenominator;
-    x->b_coef[1] =
-    x->a_coef[0] = 2.f * (KKQ - Q) * rDenominator;
-    x->b_coef[2] = 1.f;
+    const double samples = (delay > 0.f) ? ms_to_samples(delay, x->filter->sr)
+                                         : 0.;
+    
+    if (hof_biquad_post(x->filter, param, value, samples) == 0)
+    {
+        pd_error(x, "allpass~: too many scheduled parameter changes");
+    }
 }
 
 // update allpass Q ------------------------------------------------------------
 /*
  * called when we get the message "Q".
  * updates Q (arbitrary scalar).
+ * an optional second argument delays the change (ms.).
  */
-static void allpass_Q(t_allpass* x, t_floatarg new_Q)
+static void allpass_Q(t_allpass* x, t_floatarg new_Q, t_floatarg delay)
 {
-    x->Q = new_Q;
-    allpass_update_BA(x);
+    allpass_set(x, hof_Q, new_Q, delay);
 }
 
 // update allpass frequency ----------------------------------------------------
 /*
  * called when we get the message "freq".
  * updates freq (Hz.).
+ * an optional second argument delays the change (ms.).
+ */
+static void allpass_freq(t_allpass* x, t_floatarg new_freq, t_floatarg delay)
+{
+    allpass_set(x, hof_freq, new_freq, delay);
+}
+
+// multirate mode --------------------------------------------------------------
+/*
+ * called when we get the message "multirate".
+ * 1 filters very low cutoffs at a lower sample rate, where they're more
+ * accurate (adding some latency, which is sent out of the info outlet as
+ * "latency" once the filter has taken the change); 0 turns it off.
+ */
+static void allpass_multirate(t_allpass* x, t_floatarg multirate)
+{
+    if (hof_biquad_post_multirate(x->filter, multirate != 0.f) == 0)
+    {
+        pd_error(x, "not enough memory for allpass~ multirate");
+        return;
+    }
+    
+    // the audio thread takes it with the next block
+    clock_delay(x->poll, 0);
+}
+
+// latency ---------------------------------------------------------------------
+/*
+ * called by our clock after a multirate or kernel change, to send the new
+ * latency once the filter has taken it.
  */
-static void allpass_freq(t_allpass* x, t_floatarg new_freq)
+static void allpass_poll(t_allpass* x)
 {
-    x->freq = new_freq;
-    allpass_update_BA(x);
+    latency_poll(x->poll, x->filter, x->info, &x->latency);
+}
+
+// kernel ----------------------------------------------------------------------
+/*
+ * called when we get the message "kernel".
+ * "svf" computes the filter as a state variable filter, which takes fast
+ * parameter changes smoothly and stays accurate at low cutoffs; "df1" (the
+ * default) goes back to direct form 1. the delay tables are cleared when the
+ * filter takes the change, with its next block.
+ */
+static void allpass_kernel(t_allpass* x, t_symbol* kernel)
+{
+    if (kernel == gensym("svf"))
+    {
+        hof_biquad_post_kernel(x->filter, hof_svf);
+    }
+    else if (kernel == gensym("df1"))
+    {
+        hof_biquad_post_kernel(x->filter, hof_df1);
+    }
+    else
+    {
+        pd_error(x, "allpass~: unknown kernel '%s' (svf or df1)",
+                 kernel->s_name);
+        return;
+    }
+    
+    // the audio thread takes it with the next block
+    clock_delay(x->poll, 0);
+}
+
+#ifdef HOF_STATS
+// report stats ----------------------------------------------------------------
+/*
+ * called when we get the message "stats" (only when built with HOF_STATS).
+ * sends this object's dsp counters out of the info outlet, or zeros them if
+ * the argument is "reset".
+ */
+static void allpass_stats(t_allpass* x, t_symbol* arg)
+{
+    stats_message(x->info, &x->filter->stats, arg);
+}
+#endif
+
+// _free -----------------------------------------------------------------------
+/*
+ * called when this object is deleted.
+ * free any memory we've allocated.
+ */
+static void allpass_free(t_allpass* x)
+{
+    if (x->poll != 0)
+    {
+        clock_free(x->poll);
+    }
+    
+    hof_biquad_free(x->filter);
 }
 
 // _new ------------------------------------------------------------------------
@@ -134,21 +191,35 @@ static void* allpass_new(t_symbol* selector, int argc, t_atom* argv)
     // make a pointer to this object
     t_allpass* x = (t_allpass*)pd_new(allpass_class);
     
-    // make a new inlet for cutoff frequency and filter Q
+    // make a filter engine (sample rate gets updated when dsp is turned on)
+    x->sample = 0.f;
+    x->filter = hof_biquad_new(hof_allpass, 1, default_sr);
+    
+    if (x->filter == 0)
+    {
+        pd_error(x, "not enough memory for allpass~");
+        pd_free(&x->object.ob_pd);
+        return 0;
+    }
+    
+    // make a new inlet for each parameter
     inlet_new(&x->object, &x->object.ob_pd, gensym("float"), gensym("Q"));
     inlet_new(&x->object, &x->object.ob_pd, gensym("float"), gensym("freq"));
     
     // make a signal outlet
     outlet_new(&x->object, gensym("signal"));
     
+    // make an outlet for latency (and stats)
+    x->info    = outlet_new(&x->object, 0);
+    x->latency = 0;
+    x->poll    = clock_new(x, (t_method)allpass_poll);
+    
     // get creation arguments from user if they exist
-    x->sample = 0.f;
-    x->sr     = 44100.f; // just a guess (it gets updated when dsp is turned on)
-    x->Q      = (argc > 0) ? atom_getfloat(&argv[0]) : default_Q;
-    x->freq   = (argc > 1) ? atom_getfloat(&argv[1]) : default_freq;
+    x->filter->param[hof_Q]    = (argc > 0) ? atom_getfloat(&argv[0]) : default_Q;
+    x->filter->param[hof_freq] = (argc > 1) ? atom_getfloat(&argv[1]) : default_freq;
     
     // update BA coefficients
-    allpass_update_BA(x);
+    hof_biquad_update(x->filter);
     
     return (void*)x;
 }
@@ -160,11 +231,11 @@ static void* allpass_new(t_symbol* selector, int argc, t_atom* argv)
  * them. if necessary, any initialization that needs info about pd's dsp state
  * should happen here to.
  */
-static void allpass_dsp (t_allpass* x, t_signal** sig)
+static void allpass_dsp(t_allpass* x, t_signal** sig)
 {
-    // init the allpass filter
-    x->sr = sig[0]->s_sr;    // set the allpass filter sampling rate
-    allpass_update_BA(x);    // update BA coefficients
+    // set the allpass filter sampling rate (and update BA coefficients)
+    hof_biquad_set_sr(x->filter, sig[0]->s_sr);
+    latency_message(x->info, hof_biquad_latency(x->filter), &x->latency);
     
     // add this object's dsp function to pd's dsp function list
     dsp_add(allpass_perform, // this class' perform method
@@ -184,19 +255,24 @@ static void allpass_dsp (t_allpass* x, t_signal** sig)
 void allpass_tilde_setup(void)
 {
     // tell pd how to build our class
-    allpass_class = class_new(gensym("allpass~"),    // name
-                           (t_newmethod)allpass_new, // _new
-                           0,                        // _free
-                           sizeof(t_allpass),        // size
-                           CLASS_DEFAULT,            // flags
-                           A_GIMME,                  // arg types list...
-                           0);                       // ...0-terminated
+    allpass_class = class_new(gensym("allpass~"),       // name
+                              (t_newmethod)allpass_new, // _new
+                              (t_method)allpass_free,   // _free
+                              sizeof(t_allpass),        // size
+                              CLASS_DEFAULT,            // flags
+                              A_GIMME,                  // arg types...
+                              0);                       // ...0-terminated
     
     // tell pd that our left inlet expects audio
     CLASS_MAINSIGNALIN(allpass_class, t_allpass, sample);
     
     // tell pd which methods can be called by users (including dsp)
     class_addmethod(allpass_class, (t_method)allpass_dsp, gensym("dsp"), 0);
-    class_addmethod(allpass_class, (t_method)allpass_Q, gensym("Q"), A_FLOAT, 0);
-    class_addmethod(allpass_class, (t_method)allpass_freq, gensym("freq"), A_FLOAT, 0);
+    class_addmethod(allpass_class, (t_method)allpass_Q, gensym("Q"), A_FLOAT, A_DEFFLOAT, 0);
+    class_addmethod(allpass_class, (t_method)allpass_freq, gensym("freq"), A_FLOAT, A_DEFFLOAT, 0);
+    class_addmethod(allpass_class, (t_method)allpass_multirate, gensym("multirate"), A_FLOAT, 0);
+    class_addmethod(allpass_class, (t_method)allpass_kernel, gensym("kernel"), A_SYMBOL, 0);
+#ifdef HOF_STATS
+    class_addmethod(allpass_class, (t_method)allpass_stats, gensym("stats"), A_DEFSYM, 0);
+#endif
 }
@@ -0,0 +1,2274 @@
+//------------------------------------------------------------------------------
+//  Higher Order Filter Project
+//
+//  hof_bench.c: offline benchmark for every object in this project
+//  Copyright (c) 2016 Elliot Patros. All rights reserved.
+//------------------------------------------------------------------------------
+
+/*
+ * runs the real object code (through pd_stub.c, not pd) and reports the time
+ * spent per sample, per instance, for a range of block sizes, instance counts,
+ * fir~ lengths and fir~ latency budgets. the dsp chain is built the way pd
+ * builds it, so per-call overhead at small block sizes shows up too.
+ *
+ * it can also check that nothing changed: -verify renders impulses, sweeps and
+ * noise through every object, compares them against the reference outputs in
+ * 'dir' (recorded earlier with -record), and checks that throughput hasn't
+ * dropped below the stored baseline. some objects are checked again, set up
+ * differently (see variants), and fir~ with latency budgets, against the
+ * direct form. objects without fixed outputs are checked by what they do:
+ * adaptive filters learn an echo, cascade~ fits a curve, firdesign~ meets its
+ * specs, and firmatrix~ sounds like fir~s. with -render, tools/hof_render
+ * must match the objects exactly. it exits with status 1 on any failure.
+ *
+ * fir~'s spectra cache and tuning (see hof_cache_path and hof_tune_path) are
+ * kept in a temporary directory, so no run depends on an earlier one.
+ *
+ * usage: hof_bench [-q] [-record dir | -verify dir [-render path]] [object ...]
+ *   -q           quick run (less work per measurement, noisier numbers)
+ *   -record dir  write reference outputs and a throughput baseline to dir
+ *   -verify dir  compare against the reference outputs and baseline in dir
+ *   -render path check hof_render (at 'path') against the objects too
+ *   object       only use objects with these names (e.g. lowpass~ fir~)
+ */
+
+#include "pd_stub.h"
+#include "hof.h"
+
+#include <dirent.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+// what we measure -------------------------------------------------------------
+static const int block_sizes[]     = {1, 64, 512, 4096};
+static const int instance_counts[] = {1, 16, 128};
+static const int fir_lengths[]     = {16, 256, 4096, 65536};
+static const int fir_budgets[]     = {0, 1024}; // besides direct form
+
+#define countof(a) ((int)(sizeof(a) / sizeof((a)[0])))
+
+typedef struct bench_object
+{
+    const char* name;
+    const char* args;    // creation arguments, separated by spaces
+    const char* message; // sent before dsp is turned on (or 0)
+    const char* tag;     // added to the name of its reference outputs (or 0)
+
+} t_bench_object;
+
+static const t_bench_object biquads[] =
+{
+    {"lowpass~",   "0.707 1000", 0, 0},
+    {"highpass~",  "0.707 1000", 0, 0},
+    {"bandpass~",  "2 1000",     0, 0},
+    {"notch~",     "2 1000",     0, 0},
+    {"allpass~",   "0.707 1000", 0, 0},
+    {"peak~",      "2 6 1000",   0, 0},
+    {"lowshelf~",  "6 1000",     0, 0},
+    {"highshelf~", "-6 1000",    0, 0},
+};
+
+/*
+ * the same objects, set up differently (their outputs are checked, not
+ * timed). the multirate ones are low enough to use stages (see
+ * hof_biquad_set_multirate), and "schedule" fades them out.
+ */
+static const t_bench_object variants[] =
+{
+    {"lowpass~",   "2 1000",     "kernel svf",  "svf"},
+    {"highpass~",  "2 1000",     "kernel svf",  "svf"},
+    {"bandpass~",  "2 1000",     "kernel svf",  "svf"},
+    {"notch~",     "2 1000",     "kernel svf",  "svf"},
+    {"lowpass~",   "0.707 20",   "multirate 1", "multirate"},
+    {"highpass~",  "0.707 10",   "multirate 1", "multirate"},
+};
+
+// multiply-adds per measurement (split across instances and blocks)
+static double work = 1 << 26;
+
+// helpers ---------------------------------------------------------------------
+static double now_ns(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+}
+
+static unsigned int noise_state = 1;
+
+static t_sample noise(void)
+{
+    noise_state = noise_state * 1664525u + 1013904223u;
+    return (t_sample)((int)noise_state) * (1.f / 2147483648.f);
+}
+
+/*
+ * a perform routine that fills a vector with fresh noise every block, like
+ * noise~ would in a patch. without it, inputs would repeat every block (a
+ * constant, for block size 1), which isn't what the filters see in practice.
+ */
+static t_int* noise_perform(t_int* ptr)
+{
+    t_sample*   output   = (t_sample*)ptr[1];
+    const t_int nSamples = (t_int)    ptr[2];
+
+    for (t_int n = 0; n < nSamples; ++n)
+    {
+        output[n] = noise();
+    }
+
+    return &ptr[3];
+}
+
+// split "a b c" into atoms (numbers become floats, everything else symbols)
+static int parse_args(const char* args, t_atom* argv, int maxArgs)
+{
+    char buffer[256];
+    int  argc = 0;
+
+    strncpy(buffer, args, sizeof(buffer) - 1);
+    buffer[sizeof(buffer) - 1] = 0;
+
+    for (char* s = strtok(buffer, " "); s != 0 && argc < maxArgs;
+         s = strtok(0, " "))
+    {
+        char* end;
+        const double f = strtod(s, &end);
+
+        if (*end == 0)
+        {
+            SETFLOAT(&argv[argc], (t_float)f);
+        }
+        else
+        {
+            SETSYMBOL(&argv[argc], gensym(s));
+        }
+
+        ++argc;
+    }
+
+    return argc;
+}
+
+// object names from the command line (all objects if there are none)
+static char** names  = 0;
+static int    nNames = 0;
+
+static int wanted(const char* name)
+{
+    for (int i = 0; i < nNames; ++i)
+    {
+        if (strcmp(names[i], name) == 0)
+        {
+            return 1;
+        }
+    }
+
+    return nNames == 0;
+}
+
+// a directory of our own for files (removed at exit), where fir~'s cache and
+// tuning are kept too, so runs don't depend on each other (or on $HOME)
+static char scratch[] = "/tmp/hof_bench.XXXXXX";
+
+static void remove_scratch(void)
+{
+    char command[64];
+    snprintf(command, sizeof(command), "rm -rf %s", scratch);
+
+    if (system(command) != 0)
+    {
+        fprintf(stderr, "couldn't remove %s\n", scratch);
+    }
+}
+
+// what objects last sent out of their info outlets, by selector
+#define max_heard 16
+
+static t_symbol* heard_selectors[max_heard];
+static t_float   heard_values[max_heard]; // (the first float, or 0)
+static int       nHeard = 0;
+
+static void hear(t_pd* owner, int outlet, t_symbol* selector, int argc,
+                 t_atom* argv)
+{
+    (void)owner;
+    (void)outlet;
+
+    int i = 0;
+
+    while (i < nHeard && heard_selectors[i] != selector)
+    {
+        ++i;
+    }
+
+    if (i < max_heard)
+    {
+        heard_selectors[i] = selector;
+        heard_values[i]    = (argc > 0 && argv[0].a_type == A_FLOAT) ?
+                             argv[0].a_w.w_float : 0.f;
+        nHeard            += (i == nHeard);
+    }
+}
+
+// 1 if 'selector' was heard since nHeard was last zeroed (and its value)
+static int heard(const char* selector, t_float* value)
+{
+    for (int i = 0; i < nHeard; ++i)
+    {
+        if (heard_selectors[i] == gensym(selector))
+        {
+            *value = heard_values[i];
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+// one measurement -------------------------------------------------------------
+/*
+ * makes nInstances of an object, each filtering its own noise buffer, runs
+ * enough blocks to do about 'work' multiply-adds in total, and returns the
+ * time per sample per instance (ns.). an empty name measures the noise
+ * generators alone.
+ */
+static double measure(const char* name, const char* args, int costPerSample,
+                      int blockSize, int nInstances)
+{
+    t_atom    argv[8];
+    const int argc = parse_args(args, argv, 8);
+
+    t_pd**     objects = (t_pd**)calloc(nInstances, sizeof(t_pd*));
+    t_sample** vecs    = (t_sample**)calloc(nInstances * 2, sizeof(t_sample*));
+
+    stub_dsp_clear();
+
+    for (int i = 0; i < nInstances; ++i)
+    {
+        objects[i]      = (*name != 0) ? stub_new(name, argc, argv) : 0;
+        vecs[i * 2]     = (t_sample*)malloc(sizeof(t_sample) * blockSize);
+        vecs[i * 2 + 1] = (t_sample*)malloc(sizeof(t_sample) * blockSize);
+
+        dsp_add(noise_perform, 2, vecs[i * 2], (t_int)blockSize);
+
+        if (objects[i] != 0)
+        {
+            stub_dsp_add(objects[i], 2, &vecs[i * 2], blockSize, 48000.f);
+        }
+    }
+
+    double nBlocks = work / ((double)costPerSample * blockSize * nInstances);
+    nBlocks = (nBlocks < 1.) ? 1. : floor(nBlocks);
+
+    // warm up caches (and the branch predictor), then time it
+    for (int b = 0; b < 2; ++b)
+    {
+        stub_tick();
+    }
+
+    const double start = now_ns();
+
+    for (double b = 0.; b < nBlocks; b += 1.)
+    {
+        stub_tick();
+    }
+
+    const double elapsed = now_ns() - start;
+
+    for (int i = 0; i < nInstances; ++i)
+    {
+        if (objects[i] != 0)
+        {
+            stub_free(objects[i]);
+        }
+
+        free(vecs[i * 2]);
+        free(vecs[i * 2 + 1]);
+    }
+
+    free(objects);
+    free(vecs);
+    stub_dsp_clear();
+
+    return elapsed / (nBlocks * blockSize * nInstances);
+}
+
+static void run(const char* name, const char* args, int costPerSample)
+{
+    for (int c = 0; c < countof(instance_counts); ++c)
+    {
+        printf("%-11s %-20s %9d", name, args, instance_counts[c]);
+
+        for (int b = 0; b < countof(block_sizes); ++b)
+        {
+            // don't bother if a single block is far more work than we want
+            if ((double)costPerSample * block_sizes[b] * instance_counts[c] >
+                4. * work)
+            {
+                printf(" %9s", "-");
+                continue;
+            }
+
+            // subtract the time spent making noise
+            const double ns =
+                measure(name, args, costPerSample,
+                        block_sizes[b], instance_counts[c]) -
+                measure("", "", costPerSample,
+                        block_sizes[b], instance_counts[c]);
+
+            printf(" %9.3f", ns);
+        }
+
+        printf("\n");
+        fflush(stdout);
+    }
+}
+
+// reference outputs ---------------------------------------------------------
+/*
+ * each object renders three signals (an impulse, a sine sweep and noise),
+ * plus noise with scheduled parameter changes for the second-order filters.
+ * references are recorded at one block size, and checked at several, since
+ * output must never depend on pd's block size.
+ */
+#define golden_length 2048
+#define golden_block  64
+#define golden_fir    "golden_fir"
+
+static const int   verify_block_sizes[] = {1, 64, 4096};
+static const char* signal_names[]       = {"impulse", "sweep", "noise",
+                                           "schedule"};
+
+// errors above this (relative to the reference's peak) fail
+static double tolerance = 1e-4;
+
+// throughput more than this much slower than the baseline fails
+static double slack = 0.25;
+
+static void make_signal(int which, t_sample* x, int n)
+{
+    noise_state = 1;
+
+    for (int i = 0; i < n; ++i)
+    {
+        if (which == 0)
+        {   // impulse
+            x[i] = (i == 0) ? 1.f : 0.f;
+        }
+        else if (which == 1)
+        {   // exponential sweep from 20 Hz. to 20 kHz. (at 48 kHz.)
+            const double T = n / 48000.;
+            const double L = log(20000. / 20.);
+            const double t = i / 48000.;
+            x[i] = (t_sample)(0.5 * sin(2. * M_PI * 20. * T / L *
+                                        (exp(t / T * L) - 1.)));
+        }
+        else
+        {   // noise (and noise with scheduled changes)
+            x[i] = 0.5f * noise();
+        }
+    }
+}
+
+/*
+ * fir~ opens files (and makes minimum phase filters) in the background, so
+ * after those messages, wait (up to ten seconds) for it to report the new
+ * plan. returns 0 if it doesn't.
+ */
+static int finished(const char* selector)
+{
+    const double began  = now_ns();
+    const int    errors = stub_errors;
+    t_float      taps;
+
+    if (strcmp(selector, "open") != 0 && strcmp(selector, "minphase") != 0)
+    {
+        return 1;
+    }
+
+    nHeard = 0;
+    stub_dsp_clear();
+
+    while (!heard("taps", &taps) && stub_errors == errors &&
+           now_ns() - began < 10e9)
+    {   // (its clock runs, with nothing in the dsp chain)
+        stub_tick();
+    }
+
+    return heard("taps", &taps);
+}
+
+/*
+ * run one signal through a new instance of an object, blockSize samples at a
+ * time, and return 0 if the object couldn't be created. the output comes
+ * from one of its nOutlets signal outlets.
+ */
+static int render_outlet(const t_bench_object* object, int nOutlets,
+                         int outlet, int which, int blockSize,
+                         t_sample* output, int n)
+{
+    t_atom    argv[8];
+    const int argc = parse_args(object->args, argv, 8);
+    t_pd*     x    = stub_new(object->name, argc, argv);
+
+    if (x == 0)
+    {
+        return 0;
+    }
+
+    if (object->message != 0)
+    {   // (its first word is the selector)
+        const int nAtoms = parse_args(object->message, argv, 8);
+
+        if (nAtoms < 1 || argv[0].a_type != A_SYMBOL ||
+            !stub_message(x, argv[0].a_w.w_symbol->s_name, nAtoms - 1,
+                          argv + 1) ||
+            !finished(argv[0].a_w.w_symbol->s_name))
+        {
+            stub_free(x);
+            return 0;
+        }
+    }
+
+    t_sample* signal = (t_sample*)malloc(sizeof(t_sample) * n);
+    t_sample* vecs[8];
+
+    for (int v = 0; v <= nOutlets; ++v)
+    {   // the inlet's vector, then each outlet's
+        vecs[v] = (t_sample*)calloc(blockSize, sizeof(t_sample));
+    }
+
+    t_sample* in  = vecs[0];
+    t_sample* out = vecs[1 + outlet];
+
+    make_signal(which, signal, n);
+    stub_dsp_clear();
+    stub_dsp_add(x, 1 + nOutlets, vecs, blockSize, 48000.f);
+
+    if (which == 3)
+    {   // sweep freq down at exactly sample 480, then back at sample 1000
+        t_atom msg[2];
+        SETFLOAT(&msg[0], 300.f);
+        SETFLOAT(&msg[1], 10.f);
+        stub_message(x, "freq", 2, msg);
+        SETFLOAT(&msg[0], 3000.f);
+        SETFLOAT(&msg[1], 1000.f / 48.f);
+        stub_message(x, "freq", 2, msg);
+    }
+
+    for (int start = 0; start < n; start += blockSize)
+    {
+        const int count = (n - start < blockSize) ? n - start : blockSize;
+
+        memset(in, 0, sizeof(t_sample) * blockSize);
+        memcpy(in, signal + start, sizeof(t_sample) * count);
+        stub_tick();
+        memcpy(output + start, out, sizeof(t_sample) * count);
+    }
+
+    stub_dsp_clear();
+    stub_free(x);
+    free(signal);
+
+    for (int v = 0; v <= nOutlets; ++v)
+    {
+        free(vecs[v]);
+    }
+
+    return 1;
+}
+
+// the same, for objects with one signal outlet
+static int render(const t_bench_object* object, int which, int blockSize,
+                  t_sample* output, int n)
+{
+    return render_outlet(object, 1, 0, which, blockSize, output, n);
+}
+
+// read a reference output (returns 0 if it isn't there)
+static int load(const char* path, t_sample* golden)
+{
+    FILE* file = fopen(path, "rb");
+
+    if (file == 0)
+    {
+        return 0;
+    }
+
+    const int ok = fread(golden, sizeof(t_sample), golden_length, file) ==
+                   golden_length;
+
+    fclose(file);
+    return ok;
+}
+
+// write one (returns 0 if it couldn't)
+static int save(const char* path, const t_sample* golden)
+{
+    FILE* file = fopen(path, "wb");
+
+    if (file == 0)
+    {
+        return 0;
+    }
+
+    const int ok = fwrite(golden, sizeof(t_sample), golden_length, file) ==
+                   golden_length;
+
+    return (fclose(file) == 0) && ok;
+}
+
+// largest error, relative to the reference's peak
+static double compare(const t_sample* output, const t_sample* reference,
+                      int n)
+{
+    double peak = 1e-6, error = 0.;
+
+    for (int i = 0; i < n; ++i)
+    {
+        const double e = fabs((double)output[i] - reference[i]);
+        peak  = (fabs(reference[i]) > peak) ? fabs(reference[i]) : peak;
+        error = (e > error) ? e : error;
+    }
+
+    return error / peak;
+}
+
+/*
+ * a fixed workload that doesn't depend on this project's code. throughput is
+ * stored relative to it, so a baseline recorded on one machine is still
+ * roughly meaningful on another.
+ */
+static double reference_ns(void)
+{
+    double best = 1e30;
+
+    for (int trial = 0; trial < 5; ++trial)
+    {
+        volatile float sink;
+        float y = 0.f, a = 0.5f;
+        const double start = now_ns();
+
+        for (int i = 0; i < 1 << 22; ++i)
+        {
+            y = y * a + 1.f;
+        }
+
+        sink = y;
+        const double elapsed = (now_ns() - start) / (1 << 22);
+        best = (elapsed < best) ? elapsed : best;
+    }
+
+    return best;
+}
+
+// time per sample at pd's default block size, relative to reference_ns()
+static double throughput(const char* name, const char* args, int cost,
+                         double reference)
+{
+    double best = 1e30;
+
+    for (int trial = 0; trial < 3; ++trial)
+    {
+        const double ns = measure(name, args, cost, golden_block, 1) -
+                          measure("", "", cost, golden_block, 1);
+        best = (ns < best) ? ns : best;
+    }
+
+    return best / reference;
+}
+
+/*
+ * check (or record) an object's reference outputs, then its throughput
+ * against the baseline (if there is one for it: baseline == 0 skips it).
+ */
+static int check(const char* dir, int record, const t_bench_object* object,
+                 int cost, int nSignals, double reference, FILE* baseline)
+{
+    t_sample output[golden_length], golden[golden_length];
+    char     name[64];
+    int      failed = 0;
+
+    snprintf(name, sizeof(name), "%s%s%s", object->name,
+             (object->tag != 0) ? "." : "",
+             (object->tag != 0) ? object->tag : "");
+
+    for (int which = 0; which < nSignals; ++which)
+    {
+        char path[1024];
+        snprintf(path, sizeof(path), "%s/%s.%s.f32",
+                 dir, name, signal_names[which]);
+
+        if (record)
+        {
+            if (!render(object, which, golden_block, golden,
+                        golden_length) || !save(path, golden))
+            {
+                printf("FAIL %-11s %-9s couldn't record %s\n",
+                       name, signal_names[which], path);
+                failed = 1;
+            }
+
+            continue;
+        }
+
+        if (!load(path, golden))
+        {
+            printf("FAIL %-11s %-9s no reference output (%s)\n",
+                   name, signal_names[which], path);
+            failed = 1;
+            continue;
+        }
+
+        for (int b = 0; b < countof(verify_block_sizes); ++b)
+        {
+            const int ok = render(object, which, verify_block_sizes[b],
+                                  output, golden_length);
+            const double error = ok ? compare(output, golden, golden_length)
+                                    : 1e30;
+
+            printf("%s %-11s %-9s block %-5d error %g\n",
+                   (error <= tolerance) ? "ok  " : "FAIL",
+                   name, signal_names[which], verify_block_sizes[b], error);
+            failed |= (error > tolerance);
+        }
+    }
+
+    if (baseline == 0)
+    {
+        return failed;
+    }
+
+    const double t = throughput(object->name, object->args, cost, reference);
+
+    if (record)
+    {
+        fprintf(baseline, "%s %g\n", name, t);
+        printf("ok   %-11s throughput %g\n", name, t);
+        return failed;
+    }
+
+    // look for this object in the baseline
+    char   other[64];
+    double base = -1.;
+
+    rewind(baseline);
+
+    while (fscanf(baseline, "%63s %lf", other, &base) == 2)
+    {
+        if (strcmp(other, name) == 0)
+        {
+            break;
+        }
+
+        base = -1.;
+    }
+
+    if (base <= 0.)
+    {
+        printf("FAIL %-11s no throughput baseline\n", name);
+        return 1;
+    }
+
+    printf("%s %-11s throughput %g (baseline %g)\n",
+           (t <= base * (1. + slack)) ? "ok  " : "FAIL", name, t, base);
+    return failed | (t > base * (1. + slack));
+}
+
+/*
+ * fir~ with a latency budget (see hof_convolver) must sound like the direct
+ * form, only as many samples later as the latency it reports. a longer
+ * filter than golden_fir is used, so even a budget of 0 puts most of it in
+ * partitions; its references are direct form. it runs at block sizes that
+ * don't divide the partitions, too.
+ */
+#define golden_long        "golden_long"
+#define golden_long_length 4096
+
+static const int budget_block_sizes[] = {1, 37, 64};
+
+static int check_budgets(const char* dir, int record)
+{
+    t_sample output[golden_length], golden[golden_length];
+    int failed = 0;
+
+    for (int which = 0; which < 3; ++which)
+    {
+        char path[1024];
+        snprintf(path, sizeof(path), "%s/fir~.long.%s.f32",
+                 dir, signal_names[which]);
+
+        if (record)
+        {
+            const t_bench_object direct = {"fir~", golden_long, 0, 0};
+
+            if (!render(&direct, which, golden_block, golden, golden_length) ||
+                !save(path, golden))
+            {
+                printf("FAIL %-11s %-9s couldn't record %s\n",
+                       "fir~", signal_names[which], path);
+                failed = 1;
+            }
+
+            continue;
+        }
+
+        if (!load(path, golden))
+        {
+            printf("FAIL %-11s %-9s no reference output (%s)\n",
+                   "fir~", signal_names[which], path);
+            failed = 1;
+            continue;
+        }
+
+        for (int b = 0; b < countof(fir_budgets); ++b)
+        {
+            char args[64];
+            snprintf(args, sizeof(args), "%s %d", golden_long, fir_budgets[b]);
+
+            const t_bench_object partitioned = {"fir~", args, 0, 0};
+
+            for (int k = 0; k < countof(budget_block_sizes); ++k)
+            {
+                t_float latency = -1.f;
+
+                nHeard = 0;
+
+                const int ok = render(&partitioned, which,
+                                      budget_block_sizes[k], output,
+                                      golden_length) &&
+                               heard("latency", &latency) &&
+                               latency >= 0.f && latency < golden_length;
+                const int    delay = ok ? (int)latency : 0;
+                const double error = ok ? compare(output + delay, golden,
+                                                  golden_length - delay)
+                                        : 1e30;
+
+                printf("%s %-11s %-9s budget %-4d block %-5d latency %-4d "
+                       "error %g\n", (error <= tolerance) ? "ok  " : "FAIL",
+                       "fir~", signal_names[which], fir_budgets[b],
+                       budget_block_sizes[k], delay, error);
+                failed |= (error > tolerance);
+            }
+        }
+    }
+
+    return failed;
+}
+
+/*
+ * each of multifilter~'s outlets must sound like the object it stands in
+ * for, running the same kernel, so they're checked against those objects'
+ * references (see variants).
+ */
+static const char* multifilter_outlets[] = {"lowpass~.svf", "highpass~.svf",
+                                            "bandpass~.svf", "notch~.svf"};
+
+static int check_multifilter(const char* dir)
+{
+    const t_bench_object object = {"multifilter~", "2 1000", 0, 0};
+    t_sample output[golden_length], golden[golden_length];
+    int failed = 0;
+
+    for (int which = 0; which < 4; ++which)
+    {
+        for (int o = 0; o < countof(multifilter_outlets); ++o)
+        {
+            char path[1024];
+            snprintf(path, sizeof(path), "%s/%s.%s.f32",
+                     dir, multifilter_outlets[o], signal_names[which]);
+
+            if (!load(path, golden))
+            {
+                printf("FAIL %-11s %-9s no reference output (%s)\n",
+                       object.name, signal_names[which], path);
+                failed = 1;
+                continue;
+            }
+
+            for (int b = 0; b < countof(verify_block_sizes); ++b)
+            {
+                const int ok = render_outlet(&object,
+                                             countof(multifilter_outlets), o,
+                                             which, verify_block_sizes[b],
+                                             output, golden_length);
+                const double error = ok ? compare(output, golden,
+                                                  golden_length)
+                                        : 1e30;
+
+                printf("%s %-11s %-9s outlet %d (%s) block %-5d error %g\n",
+                       (error <= tolerance) ? "ok  " : "FAIL", object.name,
+                       signal_names[which], o, multifilter_outlets[o],
+                       verify_block_sizes[b], error);
+                failed |= (error > tolerance);
+            }
+        }
+    }
+
+    return failed;
+}
+
+/*
+ * adaptive filters must learn a known echo: noise is played through the
+ * first 'order' taps of golden_long (the "room"), and the object hears both.
+ * by the end, its error must be erle_min db below the echo (the echo return
+ * loss enhancement), and the taps it writes must be within tap_error_max db
+ * of the room's.
+ */
+#define adaptive_taps   "adaptive_taps"
+#define adaptive_length (1 << 16) // samples heard
+#define adaptive_window 8192      // the last samples, where erle is measured
+
+static double erle_min      = 60.;
+static double tap_error_max = -50.;
+
+static int check_adaptive(const char* name, const char* args, int order,
+                          const t_word* room)
+{
+    t_atom    argv[8];
+    const int argc = parse_args(args, argv, 8);
+    t_pd*     x    = stub_new(name, argc, argv);
+    t_sample* vecs[4]; // reference and desired in, estimate and error out
+    double    echo = 0., residue = 0., taps = 0., miss = 0.;
+    int       nTaps;
+    t_word*   learned;
+
+    if (x == 0)
+    {
+        printf("FAIL %-11s couldn't make one (%s)\n", name, args);
+        return 1;
+    }
+
+    for (int v = 0; v < 4; ++v)
+    {
+        vecs[v] = (t_sample*)calloc(golden_block, sizeof(t_sample));
+    }
+
+    t_sample* history = (t_sample*)calloc(order, sizeof(t_sample));
+
+    stub_dsp_clear();
+    stub_dsp_add(x, 4, vecs, golden_block, 48000.f);
+    noise_state = 1;
+
+    for (int start = 0; start < adaptive_length; start += golden_block)
+    {
+        for (int n = 0; n < golden_block; ++n)
+        {   // the room's echo of fresh noise (history[0] is the newest)
+            double d = 0.;
+
+            memmove(history + 1, history, sizeof(t_sample) * (order - 1));
+            history[0] = vecs[0][n] = 0.5f * noise();
+
+            for (int k = 0; k < order; ++k)
+            {
+                d += room[k].w_float * history[k];
+            }
+
+            vecs[1][n] = (t_sample)d;
+        }
+
+        stub_tick();
+
+        for (int n = 0; n < golden_block &&
+                        start >= adaptive_length - adaptive_window; ++n)
+        {
+            echo    += (double)vecs[1][n] * vecs[1][n];
+            residue += (double)vecs[3][n] * vecs[3][n];
+        }
+    }
+
+    // what it learned, against the room
+    SETSYMBOL(&argv[0], gensym(adaptive_taps));
+    stub_message(x, "write", 1, argv);
+    garray_getfloatwords((t_garray*)pd_findbyclass(gensym(adaptive_taps),
+                                                   garray_class),
+                         &nTaps, &learned);
+
+    for (int k = 0; k < nTaps; ++k)
+    {
+        const double h = (k < order) ? room[k].w_float : 0.;
+        const double e = learned[k].w_float - h;
+
+        taps += h * h;
+        miss += e * e;
+    }
+
+    stub_dsp_clear();
+    stub_free(x);
+    free(history);
+
+    for (int v = 0; v < 4; ++v)
+    {
+        free(vecs[v]);
+    }
+
+    const double erle  = 10. * log10(echo / (residue + 1e-30));
+    const double error = 10. * log10((miss + 1e-30) / taps);
+    const int    ok    = (erle >= erle_min && error <= tap_error_max);
+
+    printf("%s %-11s %-20s erle %.1f db  tap error %.1f db\n",
+           ok ? "ok  " : "FAIL", name, args, erle, error);
+    return !ok;
+}
+
+/*
+ * firmatrix~ must sound like a fir~ for every pair, with each output the sum
+ * of its inputs' filters, only a partition later (see hof_convmatrix). one
+ * pair has no filter. the inputs are the sweep and noise signals.
+ */
+#define matrix_size 64
+
+static const int matrix_orders[] = {100, 0, 300, 700}; // output major
+
+static int check_firmatrix(void)
+{
+    t_atom   argv[4];
+    t_sample signals[2][golden_length];
+    t_sample output[2][golden_length], expected[2][golden_length];
+    int      failed = 0;
+
+    make_signal(1, signals[0], golden_length);
+    make_signal(2, signals[1], golden_length);
+    noise_state = 54321;
+
+    for (int pair = 0; pair < countof(matrix_orders); ++pair)
+    {   // (a 0 leaves a pair without a filter)
+        const int order = matrix_orders[pair];
+        char      name[32];
+
+        snprintf(name, sizeof(name), "matrix_%d", pair);
+        SETFLOAT(&argv[pair], 0.f);
+
+        if (order > 0)
+        {
+            t_word* coefs = stub_array_new(name, order);
+
+            for (int k = 0; k < order; ++k)
+            {
+                coefs[k].w_float = noise() * expf(-4.f * k / order);
+            }
+
+            SETSYMBOL(&argv[pair], gensym(name));
+        }
+    }
+
+    for (int b = 0; b < countof(budget_block_sizes); ++b)
+    {
+        const int block = budget_block_sizes[b];
+        t_pd*     pairs[countof(matrix_orders)];
+        t_sample* vecs[4 + 2 * countof(matrix_orders)];
+        t_atom    args[3];
+
+        // the matrix (ins, then outs), then a fir~ for each pair
+        SETFLOAT(&args[0], 2.f);
+        SETFLOAT(&args[1], 2.f);
+        SETFLOAT(&args[2], matrix_size);
+
+        t_pd* x = stub_new("firmatrix~", 3, args);
+
+        for (int v = 0; v < countof(vecs); ++v)
+        {
+            vecs[v] = (t_sample*)calloc(block, sizeof(t_sample));
+        }
+
+        stub_dsp_clear();
+
+        if (x != 0)
+        {
+            stub_message(x, "set", countof(matrix_orders), argv);
+            stub_dsp_add(x, 4, vecs, block, 48000.f);
+        }
+
+        for (int pair = 0; pair < countof(matrix_orders); ++pair)
+        {
+            pairs[pair] = (matrix_orders[pair] > 0) ?
+                          stub_new("fir~", 1, &argv[pair]) : 0;
+
+            if (pairs[pair] != 0)
+            {   // (reading its input's vector)
+                t_sample* io[] = {vecs[pair % 2], vecs[4 + 2 * pair + 1]};
+                stub_dsp_add(pairs[pair], 2, io, block, 48000.f);
+            }
+        }
+
+        for (int start = 0; start < golden_length; start += block)
+        {
+            const int count = (golden_length - start < block) ?
+                              golden_length - start : block;
+
+            for (int i = 0; i < 2; ++i)
+            {
+                memset(vecs[i], 0, sizeof(t_sample) * block);
+                memcpy(vecs[i], signals[i] + start, sizeof(t_sample) * count);
+            }
+
+            stub_tick();
+
+            for (int o = 0; o < 2; ++o)
+            {
+                for (int n = 0; n < count; ++n)
+                {
+                    output[o][start + n]   = vecs[2 + o][n];
+                    expected[o][start + n] = 0.f;
+
+                    for (int i = 0; i < 2; ++i)
+                    {
+                        expected[o][start + n] += (pairs[o * 2 + i] != 0) ?
+                            vecs[4 + 2 * (o * 2 + i) + 1][n] : 0.f;
+                    }
+                }
+            }
+        }
+
+        stub_dsp_clear();
+
+        for (int pair = 0; pair < countof(matrix_orders); ++pair)
+        {
+            if (pairs[pair] != 0)
+            {
+                stub_free(pairs[pair]);
+            }
+        }
+
+        for (int v = 0; v < countof(vecs); ++v)
+        {
+            free(vecs[v]);
+        }
+
+        for (int o = 0; o < 2; ++o)
+        {
+            const double error = (x != 0) ?
+                compare(output[o] + matrix_size, expected[o],
+                        golden_length - matrix_size) : 1e30;
+
+            printf("%s %-11s output %d  block %-5d error %g\n",
+                   (error <= tolerance) ? "ok  " : "FAIL", "firmatrix~", o,
+                   block, error);
+            failed |= (error > tolerance);
+        }
+
+        if (x != 0)
+        {
+            stub_free(x);
+        }
+    }
+
+    return failed;
+}
+
+/*
+ * cascade~ must fit a curve it can make exactly: two peak filters in series,
+ * 6 db down. the error it reports (the rms difference left, in db), and the
+ * largest difference between its response and the curve's (db, at 1/12
+ * octaves from 20 Hz. to 20 kHz.), must both be under fit_error_max.
+ */
+#define cascade_curve  "cascade_curve"
+#define cascade_length 8192
+
+static double fit_error_max = 0.5;
+
+static const float cascade_peaks[][3] = {{2.f, 6.f, 300.f},  // Q, dB, freq
+                                         {1.f, -4.f, 4000.f}};
+
+// the response of 'n' taps at 'freq' (db, at 48 kHz.)
+static double response_db(const t_sample* h, int n, double freq)
+{
+    const double w  = 2. * M_PI * freq / 48000.;
+    double       re = 0., im = 0.;
+
+    for (int k = 0; k < n; ++k)
+    {
+        re += h[k] * cos(w * k);
+        im -= h[k] * sin(w * k);
+    }
+
+    return 10. * log10(re * re + im * im + 1e-30);
+}
+
+static int check_cascade(void)
+{
+    const int nSections = countof(cascade_peaks);
+    t_sample* curve     = (t_sample*)calloc(cascade_length, sizeof(t_sample));
+    t_sample* fitted    = (t_sample*)calloc(cascade_length, sizeof(t_sample));
+    t_word*   table     = stub_array_new(cascade_curve, cascade_length);
+    t_sample* vecs[2];
+    t_atom    argv[2];
+    t_float   error     = -1.f;
+    double    worst     = 0.;
+
+    // the curve: an impulse through each peak filter in turn
+    curve[0] = 0.5f;
+
+    for (int s = 0; s < nSections; ++s)
+    {
+        hof_biquad* f = hof_biquad_new(hof_peak, 1, 48000.f);
+
+        hof_biquad_set(f, hof_Q, cascade_peaks[s][0]);
+        hof_biquad_set(f, hof_dB, cascade_peaks[s][1]);
+        hof_biquad_set(f, hof_freq, cascade_peaks[s][2]);
+        hof_biquad_process(f, (const float* const*)&curve, &curve,
+                           cascade_length);
+        hof_biquad_free(f);
+    }
+
+    for (int k = 0; k < cascade_length; ++k)
+    {
+        table[k].w_float = curve[k];
+    }
+
+    // fit it, and wait (up to a minute) for the fit to come back
+    SETFLOAT(&argv[0], nSections);
+
+    t_pd* x = stub_new("cascade~", 1, argv);
+
+    for (int v = 0; v < 2; ++v)
+    {
+        vecs[v] = (t_sample*)calloc(golden_block, sizeof(t_sample));
+    }
+
+    stub_dsp_clear();
+
+    if (x != 0)
+    {
+        const double began = now_ns();
+
+        stub_dsp_add(x, 2, vecs, golden_block, 48000.f);
+        nHeard = 0;
+        SETSYMBOL(&argv[0], gensym(cascade_curve));
+        SETFLOAT(&argv[1], nSections);
+        stub_message(x, "fit", 2, argv);
+
+        while (!heard("error", &error) && now_ns() - began < 60e9)
+        {
+            stub_tick();
+        }
+
+        // then play an impulse through what it fitted
+        stub_message(x, "clear", 0, 0);
+
+        for (int start = 0; start < cascade_length; start += golden_block)
+        {
+            vecs[0][0] = (start == 0) ? 1.f : 0.f;
+            stub_tick();
+            memcpy(fitted + start, vecs[1], sizeof(t_sample) * golden_block);
+        }
+
+        stub_dsp_clear();
+        stub_free(x);
+    }
+
+    for (double freq = 20.; freq <= 20000.; freq *= pow(2., 1. / 12.))
+    {
+        const double d = fabs(response_db(fitted, cascade_length, freq) -
+                              response_db(curve, cascade_length, freq));
+        worst = (d > worst) ? d : worst;
+    }
+
+    const int ok = (x != 0 && error >= 0.f && error <= fit_error_max &&
+                    worst <= fit_error_max);
+
+    printf("%s %-11s %d sections  error %g db  worst %g db\n",
+           ok ? "ok  " : "FAIL", "cascade~", nSections, error, worst);
+
+    for (int v = 0; v < 2; ++v)
+    {
+        free(vecs[v]);
+    }
+
+    free(curve);
+    free(fitted);
+    return !ok;
+}
+
+/*
+ * firdesign~ designs on its thread, then writes the table and sends "set".
+ * whatever it writes must meet its spec (see hof_fir_design_meets).
+ */
+#define firdesign_table "firdesign_table"
+
+typedef struct bench_design
+{
+    const char*  message; // what firdesign~ is asked for (Hz.), after...
+    const char*  method;  // ...this
+    hof_fir_spec spec;    // the same, in fractions of 48 kHz.
+
+} t_bench_design;
+
+static const t_bench_design designs[] =
+{
+    {"lowpass 6000 1000 60", "kaiser",
+     {hof_kaiser, hof_lowpass, 0.125f, 0.f, 1.f / 48.f, 60.f, 0.1f}},
+    {"lowpass 6000 1000 60", "remez",
+     {hof_remez, hof_lowpass, 0.125f, 0.f, 1.f / 48.f, 60.f, 0.1f}},
+    {"bandpass 2000 8000 1000 70", "kaiser",
+     {hof_kaiser, hof_bandpass, 2.f / 48.f, 8.f / 48.f, 1.f / 48.f, 70.f,
+      0.1f}},
+    {"notch 2000 8000 2000 50", "remez",
+     {hof_remez, hof_notch, 2.f / 48.f, 8.f / 48.f, 2.f / 48.f, 50.f, 0.1f}},
+};
+
+static int check_firdesign(void)
+{
+    int failed = 0;
+
+    stub_array_new(firdesign_table, 1);
+
+    for (int i = 0; i < countof(designs); ++i)
+    {
+        t_atom    argv[8];
+        t_garray* table;
+        t_word*   vec;
+        t_float   value = 0.f;
+        int       order = 0, ok = 0;
+
+        SETSYMBOL(&argv[0], gensym(firdesign_table));
+        SETSYMBOL(&argv[1], gensym(designs[i].method));
+
+        t_pd* x = stub_new("firdesign~", 2, argv);
+
+        if (x != 0)
+        {   // ask (at 48 kHz.), and wait up to a minute for the table
+            const double began = now_ns();
+            const int    nAtoms = parse_args(designs[i].message, argv, 8);
+
+            stub_dsp_clear();
+            stub_dsp_add(x, 0, 0, golden_block, 48000.f);
+            nHeard = 0;
+            stub_message(x, argv[0].a_w.w_symbol->s_name, nAtoms - 1,
+                         argv + 1);
+
+            while (!heard("set", &value) && now_ns() - began < 60e9)
+            {
+                stub_tick();
+            }
+
+            stub_free(x);
+        }
+
+        table = (t_garray*)pd_findbyclass(gensym(firdesign_table),
+                                          garray_class);
+
+        if (heard("set", &value) && garray_getfloatwords(table, &order, &vec))
+        {   // (the table's points aren't packed like floats)
+            float* coefs = (float*)malloc(sizeof(float) * order);
+
+            for (int k = 0; k < order; ++k)
+            {
+                coefs[k] = vec[k].w_float;
+            }
+
+            ok = hof_fir_design_meets(&designs[i].spec, coefs, order);
+            free(coefs);
+        }
+
+        printf("%s %-11s %-6s %-26s taps %d\n", ok ? "ok  " : "FAIL",
+               "firdesign~", designs[i].method, designs[i].message, order);
+        failed |= !ok;
+    }
+
+    return failed;
+}
+
+/*
+ * multirate and kernel changes are posted to the filter, which takes them
+ * with its next block (see hof_biquad_post_multirate), so they're sent while
+ * it's running.
+ * each one must be reported as its latency within a few blocks, and the
+ * output must stay finite throughout.
+ */
+typedef struct bench_posted
+{
+    const char* message;
+    int         latency; // what must be reported after it (lowpass~ 0.707 20)
+
+} t_bench_posted;
+
+static const t_bench_posted posted[] =
+{
+    {"multirate 1", 126},
+    {"multirate 0", 0},
+    {"multirate 1", 126},
+    {"kernel svf",  0},  // (multirate only applies to direct form 1)
+    {"kernel df1",  126},
+};
+
+static int check_posted(void)
+{
+    t_sample  in[golden_block], out[golden_block];
+    t_sample* vecs[2] = {in, out};
+    t_atom    argv[8];
+    int       failed  = 0;
+    t_pd*     x       = stub_new("lowpass~", parse_args("0.707 20", argv, 8),
+                                 argv);
+
+    if (x == 0)
+    {
+        printf("FAIL %-11s couldn't be made\n", "lowpass~");
+        return 1;
+    }
+
+    stub_dsp_clear();
+    stub_dsp_add(x, 2, vecs, golden_block, 48000.f);
+
+    for (int i = 0; i < countof(posted); ++i)
+    {
+        const int nAtoms = parse_args(posted[i].message, argv, 8);
+        t_float   latency = -1.f;
+        int       finite  = 1;
+
+        nHeard = 0;
+        stub_message(x, argv[0].a_w.w_symbol->s_name, nAtoms - 1, argv + 1);
+
+        for (int block = 0; block < 8; ++block)
+        {
+            for (int k = 0; k < golden_block; ++k)
+            {
+                in[k] = noise();
+            }
+
+            stub_tick();
+
+            for (int k = 0; k < golden_block; ++k)
+            {
+                finite &= isfinite(out[k]) != 0;
+            }
+        }
+
+        const int ok = heard("latency", &latency) &&
+                       (int)latency == posted[i].latency && finite;
+
+        printf("%s %-11s posted %-20s latency %g\n", ok ? "ok  " : "FAIL",
+               "lowpass~", posted[i].message, latency);
+        failed |= !ok;
+    }
+
+    stub_dsp_clear();
+    stub_free(x);
+    return failed;
+}
+
+/*
+ * delayed changes wait in the filter's schedule, which holds hof_max_scheduled
+ * of them: one more must be refused (reported with pd_error) rather than
+ * dropped later, and once they've all been applied there's room again.
+ */
+static int check_overflow(void)
+{
+    t_sample  in[golden_block] = {0}, out[golden_block];
+    t_sample* vecs[2] = {in, out};
+    t_atom    argv[2];
+    int       failed  = 0;
+    t_pd*     x       = stub_new("lowpass~", 0, 0);
+
+    if (x == 0)
+    {
+        printf("FAIL %-11s couldn't be made\n", "lowpass~");
+        return 1;
+    }
+
+    stub_dsp_clear();
+    stub_dsp_add(x, 2, vecs, golden_block, 48000.f);
+    stub_tick();
+
+    for (int round = 0; round < 2; ++round)
+    {
+        const int before = stub_errors;
+        int       taken  = 0;
+
+        for (int i = 0; i <= hof_max_scheduled; ++i)
+        {   // one more than there's room for, 0.1 ms. apart
+            SETFLOAT(&argv[0], 100.f + 10.f * i);
+            SETFLOAT(&argv[1], 0.1f * (i + 1));
+            stub_message(x, "freq", 2, argv);
+            taken += (stub_errors == before);
+        }
+
+        const int ok = (taken == hof_max_scheduled) &&
+                       (stub_errors == before + 1);
+
+        printf("%s %-11s %d delayed changes, %d taken\n", ok ? "ok  " : "FAIL",
+               "lowpass~", hof_max_scheduled + 1, taken);
+        failed |= !ok;
+
+        for (int block = 0; block < 8; ++block)
+        {   // (they're all due within 7 ms.)
+            stub_tick();
+        }
+    }
+
+    stub_dsp_clear();
+    stub_free(x);
+    return failed;
+}
+
+/*
+ * tools/hof_render runs the same engines as the objects, so it must match
+ * them exactly: each signal is written to a raw file and rendered, with
+ * fir~'s table written out as a wav and the object's message after its
+ * arguments, and the output compared with the object's (no tolerance). it's
+ * run with the same environment, so it picks the same fir~ kernel (see
+ * hof_tune).
+ */
+static const char* renderer = 0; // path to hof_render (0 to skip this)
+
+// sound files fir~ can open (and hof_render can read, as float wavs)
+typedef struct bench_wav
+{
+    const char* name;
+    int         bits;       // 16, 24 or 32
+    int         isFloat;    // 32 bit float (otherwise integers)
+    int         extensible; // a WAVE_FORMAT_EXTENSIBLE header
+    int         nChannels;  // the filter is in the last one (others are 0)
+    int         raw;        // no header at all (32 bit floats, one channel)
+
+} t_bench_wav;
+
+static const t_bench_wav wav_formats[] =
+{
+    {"float",      32, 1, 0, 1, 0},
+    {"int16",      16, 0, 0, 1, 0},
+    {"int24",      24, 0, 0, 1, 0},
+    {"extensible", 32, 1, 1, 1, 0},
+    {"stereo",     24, 0, 0, 2, 0},
+    {"raw",        32, 1, 0, 1, 1},
+};
+
+// little endian, whatever this machine is
+static void put_le(unsigned char* p, unsigned long value, int nBytes)
+{
+    for (int b = 0; b < nBytes; ++b)
+    {
+        p[b] = (unsigned char)(value >> (8 * b));
+    }
+}
+
+// integers hold what the file will: floats scaled like pd's soundfiler
+static float wav_quantize(const t_bench_wav* format, float x)
+{
+    const double scale = (double)(1ul << (format->bits - 1));
+
+    return format->isFloat ? x : (float)(lrint(x * (scale - 1.)) / scale);
+}
+
+/*
+ * write a 48 kHz. file of 'x' (returns 0 if it couldn't). quantize x first
+ * (see wav_quantize), so integers hold it exactly.
+ */
+static int save_wav(const char* path, const t_bench_wav* format,
+                    const float* x, int n)
+{
+    const int     bytes   = format->bits / 8;
+    const int     frame   = bytes * format->nChannels;
+    const int     fmtSize = format->extensible ? 40 : 16;
+    unsigned char header[68];
+    unsigned char* data   = (unsigned char*)calloc(n, frame);
+    FILE*         file    = (data != 0) ? fopen(path, "wb") : 0;
+    size_t        size    = 0;
+
+    if (file == 0)
+    {
+        free(data);
+        return 0;
+    }
+
+    memset(header, 0, sizeof(header));
+    memcpy(header, "RIFF", 4);
+    put_le(header + 4, 20 + fmtSize + (unsigned long)n * frame, 4);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    put_le(header + 16, fmtSize, 4);
+    put_le(header + 20, format->extensible ? 0xfffe : format->isFloat ? 3 : 1,
+           2);
+    put_le(header + 22, format->nChannels, 2);
+    put_le(header + 24, 48000, 4);
+    put_le(header + 28, 48000ul * frame, 4);
+    put_le(header + 32, frame, 2);
+    put_le(header + 34, format->bits, 2);
+
+    if (format->extensible)
+    {   // cbSize, valid bits, channel mask, then the sub-format's guid
+        static const unsigned char guid[14] = {0x00, 0x00, 0x00, 0x00, 0x10,
+                                               0x00, 0x80, 0x00, 0x00, 0xaa,
+                                               0x00, 0x38, 0x9b, 0x71};
+        put_le(header + 36, 22, 2);
+        put_le(header + 38, format->bits, 2);
+        put_le(header + 44, format->isFloat ? 3 : 1, 2);
+        memcpy(header + 46, guid, sizeof(guid));
+    }
+
+    memcpy(header + 20 + fmtSize, "data", 4);
+    put_le(header + 24 + fmtSize, (unsigned long)n * frame, 4);
+
+    for (int k = 0; k < n; ++k)
+    {
+        const double   scale = (double)(1ul << (format->bits - 1));
+        unsigned char* p     = data + (size_t)k * frame +
+                               bytes * (format->nChannels - 1);
+        unsigned int   word  = (unsigned int)lrint(x[k] * scale);
+
+        if (format->isFloat)
+        {
+            memcpy(&word, &x[k], sizeof(word));
+        }
+
+        put_le(p, word, bytes);
+    }
+
+    size = format->raw ? 0 : 28 + (size_t)fmtSize;
+
+    const int ok = fwrite(header, 1, size, file) == size &&
+                   fwrite(data, frame, n, file) == (size_t)n;
+
+    free(data);
+    return (fclose(file) == 0) && ok;
+}
+
+// fir~ set up the ways the renderer can be told to (see variants)
+static const t_bench_object rendered_firs[] =
+{
+    {"fir~", golden_fir,  0,                0},
+    {"fir~", golden_long, "latency 0",      0},
+    {"fir~", golden_long, "latency 1024",   0},
+    {"fir~", golden_long, "trim -60",       0},
+    {"fir~", golden_fir,  "sparse 1",       0},
+    {"fir~", golden_fir,  "precision half", 0},
+};
+
+// the -f spec for an object (fir~'s table becomes a wav in scratch)
+static int renderer_spec(const t_bench_object* object, char* spec, int size)
+{
+    const char* message = (object->message != 0) ? object->message : "";
+    const char* comma   = (object->message != 0) ? ", " : "";
+
+    if (strcmp(object->name, "fir~") != 0)
+    {
+        snprintf(spec, size, "%s %s%s%s", object->name, object->args, comma,
+                 message);
+        return 1;
+    }
+
+    t_garray* table = (t_garray*)pd_findbyclass(gensym(object->args),
+                                                garray_class);
+    t_word*   vec;
+    int       order = 0;
+
+    if (table == 0 || !garray_getfloatwords(table, &order, &vec))
+    {
+        return 0;
+    }
+
+    float* coefs = (float*)malloc(sizeof(float) * order);
+    char   path[1024];
+
+    for (int k = 0; k < order; ++k)
+    {   // (the table's points aren't packed like floats)
+        coefs[k] = vec[k].w_float;
+    }
+
+    snprintf(path, sizeof(path), "%s/%s.wav", scratch, object->args);
+    snprintf(spec, size, "fir~ %s%s%s", path, comma, message);
+
+    const int ok = save_wav(path, &wav_formats[0], coefs, order);
+
+    free(coefs);
+    return ok;
+}
+
+// render each signal through one object both ways
+static int check_rendered(const t_bench_object* object)
+{
+    t_sample output[golden_length], rendered[golden_length];
+    char     in[1024], out[1024], spec[1024], command[4096];
+    int      failed = 0;
+
+    snprintf(in, sizeof(in), "%s/in.f32", scratch);
+    snprintf(out, sizeof(out), "%s/out", scratch);
+    mkdir(out, 0777);
+    snprintf(out, sizeof(out), "%s/out/in.f32", scratch);
+
+    for (int which = 0; which < 3; ++which)
+    {
+        double error = 1e30;
+        int    ok    = renderer_spec(object, spec, sizeof(spec));
+
+        make_signal(which, output, golden_length);
+        snprintf(command, sizeof(command),
+                 "%s -raw 48000 1 -o %s/out -f \"%s\" %s",
+                 renderer, scratch, spec, in);
+        ok = ok && save(in, output) && system(command) == 0 &&
+             load(out, rendered) &&
+             render(object, which, golden_block, output, golden_length);
+
+        if (ok)
+        {
+            error = compare(output, rendered, golden_length);
+        }
+
+        printf("%s %-11s %-9s rendered %-16s error %g\n",
+               (error == 0.) ? "ok  " : "FAIL", object->name,
+               signal_names[which],
+               (object->message != 0) ? object->message : "", error);
+        failed |= (error != 0.);
+    }
+
+    return failed;
+}
+
+static int check_renderer(void)
+{
+    int failed = 0;
+
+    for (int i = 0; i < countof(biquads); ++i)
+    {
+        if (wanted(biquads[i].name))
+        {
+            failed |= check_rendered(&biquads[i]);
+        }
+    }
+
+    for (int i = 0; i < countof(variants); ++i)
+    {
+        if (wanted(variants[i].name))
+        {
+            failed |= check_rendered(&variants[i]);
+        }
+    }
+
+    for (int i = 0; i < countof(rendered_firs) && wanted("fir~"); ++i)
+    {
+        failed |= check_rendered(&rendered_firs[i]);
+    }
+
+    return failed;
+}
+
+/*
+ * hof_conv keeps long filters' spectra in the cache (see hof_cache_min): the
+ * first filter must store them, the same filter again must map them (and
+ * sound the same), a damaged file must be transformed again instead of
+ * played, and an edited filter must not be stored. it uses a directory of
+ * its own, so the files can be counted.
+ */
+#define cache_taps   8192
+#define cache_size   1024
+#define cache_length (cache_taps + cache_size) // (long enough to hear them all)
+
+// count the spectra files in 'dir', and name the last one found
+static int cache_files(const char* dir, char* last, int size)
+{
+    DIR*           d = opendir(dir);
+    struct dirent* entry;
+    int            n = 0;
+
+    while (d != 0 && (entry = readdir(d)) != 0)
+    {
+        const size_t length = strlen(entry->d_name);
+
+        if (length > 8 && !strcmp(entry->d_name + length - 8, ".spectra"))
+        {
+            snprintf(last, size, "%s/%s", dir, entry->d_name);
+            ++n;
+        }
+    }
+
+    if (d != 0)
+    {
+        closedir(d);
+    }
+
+    return n;
+}
+
+// filter noise with a new hof_conv, and say whether it was mapped
+static int cache_render(const float* coefs, t_sample* output, int* mapped)
+{
+    t_sample* in = (t_sample*)malloc(sizeof(t_sample) * cache_length);
+    hof_conv* c  = hof_conv_new(cache_size);
+    const int ok = (in != 0 && c != 0 &&
+                    hof_conv_set_coefs(c, coefs, cache_taps, 1));
+
+    if (ok)
+    {
+        *mapped = (c->mapping != 0);
+        make_signal(2, in, cache_length);
+        hof_conv_process(c, in, output, cache_length);
+    }
+
+    hof_conv_free(c);
+    free(in);
+    return ok;
+}
+
+static int check_cache(void)
+{
+    float*    coefs  = (float*)malloc(sizeof(float) * cache_taps);
+    t_sample* first  = (t_sample*)malloc(sizeof(t_sample) * cache_length);
+    t_sample* output = (t_sample*)malloc(sizeof(t_sample) * cache_length);
+    char      dir[64], file[1024] = "";
+    int       ok[4]  = {0, 0, 0, 0}, mapped = 1, failed = 0;
+    const char* steps[4] = {"store", "map", "checksum", "edit"};
+
+    snprintf(dir, sizeof(dir), "%s/cache-check", scratch);
+    hof_cache_set_dir(dir);
+    noise_state = 54321;
+
+    for (int k = 0; k < cache_taps; ++k)
+    {
+        coefs[k] = noise() * expf(-6.f * k / cache_taps);
+    }
+
+    // transformed, then stored
+    ok[0] = cache_render(coefs, first, &mapped) && !mapped &&
+            cache_files(dir, file, sizeof(file)) == 1;
+
+    // mapped, and the same
+    ok[1] = ok[0] && cache_render(coefs, output, &mapped) && mapped &&
+            compare(output, first, cache_length) == 0.;
+
+    // damaged: transformed again (and stored again, over it)
+    FILE* damaged = ok[0] ? fopen(file, "r+b") : 0;
+
+    if (damaged != 0)
+    {   // (a byte of the first partition's spectrum)
+        const int c = (fseek(damaged, 64 + 100, SEEK_SET) == 0) ?
+                      fgetc(damaged) : EOF;
+
+        ok[2] = (c != EOF) && fseek(damaged, 64 + 100, SEEK_SET) == 0 &&
+                fputc(c ^ 0x40, damaged) != EOF;
+        ok[2] = (fclose(damaged) == 0) && ok[2] &&
+                cache_render(coefs, output, &mapped) && !mapped &&
+                compare(output, first, cache_length) == 0.;
+    }
+
+    // edited (one tap): only its partition is transformed, and not stored
+    hof_conv* c = hof_conv_new(cache_size);
+
+    if (c != 0 && hof_conv_set_coefs(c, coefs, cache_taps, 1))
+    {
+        coefs[5000] += 0.1f;
+        ok[3] = hof_conv_set_coefs(c, coefs, cache_taps, 1) &&
+                c->mapping == 0 && cache_files(dir, file, sizeof(file)) == 1;
+    }
+
+    for (int i = 0; i < 4; ++i)
+    {
+        printf("%s %-11s %s\n", ok[i] ? "ok  " : "FAIL", "hof_cache",
+               steps[i]);
+        failed |= !ok[i];
+    }
+
+    hof_conv_free(c);
+    hof_cache_set_dir(hof_cache_path());
+    free(coefs);
+    free(first);
+    free(output);
+    return failed;
+}
+
+/*
+ * fir~ can open a sound file instead of using a table (see hof_irfile): each
+ * format must sound exactly like the same filter in a table (quantized the
+ * way the file holds it). files cut short inside their headers must be
+ * refused.
+ */
+static int check_open(void)
+{
+    t_sample  output[golden_length], golden[golden_length];
+    float     coefs[512], quantized[512];
+    t_garray* table = (t_garray*)pd_findbyclass(gensym(golden_fir),
+                                                garray_class);
+    t_word*   vec;
+    int       order = 0, failed = 0;
+
+    if (table == 0 || !garray_getfloatwords(table, &order, &vec) ||
+        order > 512)
+    {
+        printf("FAIL %-11s no %s to open\n", "fir~", golden_fir);
+        return 1;
+    }
+
+    for (int k = 0; k < order; ++k)
+    {
+        coefs[k] = vec[k].w_float;
+    }
+
+    for (int f = 0; f < countof(wav_formats); ++f)
+    {
+        const t_bench_wav* format = &wav_formats[f];
+        char               path[1024], name[64], message[1100];
+
+        snprintf(path, sizeof(path), "%s/open-%s.%s", scratch, format->name,
+                 format->raw ? "f32" : "wav");
+        snprintf(name, sizeof(name), "open_%s", format->name);
+        snprintf(message, sizeof(message), "open %s %d", path,
+                 format->nChannels - 1);
+
+        t_word* array = stub_array_new(name, order);
+
+        for (int k = 0; k < order; ++k)
+        {
+            quantized[k]      = wav_quantize(format, coefs[k]);
+            array[k].w_float = quantized[k];
+        }
+
+        const t_bench_object opened = {"fir~", "", message, 0};
+        const t_bench_object direct = {"fir~", name, 0, 0};
+        const int            saved  = save_wav(path, format, quantized, order);
+
+        for (int which = 0; which < 3; ++which)
+        {
+            const int ok = saved &&
+                           render(&direct, which, golden_block, golden,
+                                  golden_length) &&
+                           render(&opened, which, golden_block, output,
+                                  golden_length);
+            const double error = ok ? compare(output, golden, golden_length)
+                                    : 1e30;
+
+            printf("%s %-11s %-9s open %-10s error %g\n",
+                   (error == 0.) ? "ok  " : "FAIL", "fir~",
+                   signal_names[which], format->name, error);
+            failed |= (error != 0.);
+        }
+    }
+
+    for (int cut = 24; cut <= 64; cut += 40)
+    {   // inside an extensible "fmt " chunk, then inside "data"'s header
+        char path[1024], message[1100];
+        snprintf(path, sizeof(path), "%s/open-extensible.wav", scratch);
+        snprintf(message, sizeof(message), "open %s", path);
+
+        const t_bench_object opened = {"fir~", "", message, 0};
+        const int            errors = stub_errors;
+        const int            ok     = truncate(path, cut) == 0 &&
+                                      !render(&opened, 0, golden_block, output,
+                                              golden_length) &&
+                                      stub_errors == errors + 1;
+
+        printf("%s %-11s cut to %d bytes: refused\n", ok ? "ok  " : "FAIL",
+               "fir~", cut);
+        failed |= !ok;
+    }
+
+    return failed;
+}
+
+/*
+ * "trim" and "sparse" leave taps out of fir~ (see hof_convolver_set_trim),
+ * and report how many are left as "taps". a trimmed golden_long must sound
+ * exactly like a table of only that many of its taps. golden_fir with a gap
+ * in the middle and zeros after it must sound the same with "sparse 1" as
+ * without, while reporting fewer taps.
+ */
+#define sparse_table  "sparse_table"
+#define sparse_length 2048
+#define trimmed_table "trimmed_table"
+
+// (the taps are summed in another order, so only rounding may differ)
+static double sparse_tolerance = 1e-6;
+
+// render through fir~, and say how many taps it reported
+static int render_taps(const t_bench_object* object, int which,
+                       t_sample* output, t_float* taps)
+{
+    nHeard = 0;
+    *taps  = -1.f;
+    return render(object, which, golden_block, output, golden_length) &&
+           heard("taps", taps);
+}
+
+static int check_taps(void)
+{
+    t_sample  output[golden_length], golden[golden_length];
+    t_garray* table = (t_garray*)pd_findbyclass(gensym(golden_long),
+                                                garray_class);
+    t_word*   longest;
+    t_word*   fir;
+    int       order = 0, shorter = 0, failed = 0;
+
+    if (table == 0 || !garray_getfloatwords(table, &order, &longest) ||
+        (table = (t_garray*)pd_findbyclass(gensym(golden_fir),
+                                           garray_class)) == 0 ||
+        !garray_getfloatwords(table, &shorter, &fir))
+    {
+        printf("FAIL %-11s no %s or %s\n", "fir~", golden_long, golden_fir);
+        return 1;
+    }
+
+    // golden_fir, silent from tap 128 to 383, then zeros to sparse_length
+    t_word* sparse = stub_array_new(sparse_table, sparse_length);
+
+    for (int k = 0; k < shorter; ++k)
+    {
+        sparse[k].w_float = (k >= 128 && k < 384) ? 0.f : fir[k].w_float;
+    }
+
+    for (int which = 0; which < 3; ++which)
+    {
+        const t_bench_object trimmed = {"fir~", golden_long, "trim -60", 0};
+        const t_bench_object dense   = {"fir~", sparse_table, 0, 0};
+        const t_bench_object skipped = {"fir~", sparse_table, "sparse 1", 0};
+        t_float kept = 0.f, all = 0.f, fewer = 0.f;
+
+        // trim: against a table cut where it said it was trimmed
+        int ok = render_taps(&trimmed, which, output, &kept) &&
+                 kept > 0.f && kept < order;
+
+        if (ok)
+        {
+            const t_bench_object cut = {"fir~", trimmed_table, 0, 0};
+            t_word* taps = stub_array_new(trimmed_table, (int)kept);
+
+            for (int k = 0; k < (int)kept; ++k)
+            {
+                taps[k].w_float = longest[k].w_float;
+            }
+
+            ok = render(&cut, which, golden_block, golden, golden_length) &&
+                 compare(output, golden, golden_length) == 0.;
+        }
+
+        printf("%s %-11s %-9s trim -60 keeps %g of %d taps\n",
+               ok ? "ok  " : "FAIL", "fir~", signal_names[which], kept, order);
+        failed |= !ok;
+
+        // sparse: the same output, from fewer taps
+        ok = render_taps(&dense, which, golden, &all) &&
+             render_taps(&skipped, which, output, &fewer);
+
+        const double error = ok ? compare(output, golden, golden_length)
+                                : 1e30;
+
+        ok = ok && error <= sparse_tolerance && all == sparse_length &&
+             fewer <= shorter - 256;
+
+        printf("%s %-11s %-9s sparse uses %g of %g taps, error %g\n",
+               ok ? "ok  " : "FAIL", "fir~", signal_names[which], fewer, all,
+               error);
+        failed |= !ok;
+    }
+
+    return failed;
+}
+
+/*
+ * "minphase" makes fir~ the minimum phase version of its filter. from a
+ * linear phase lowpass (4 kHz., windowed sinc, its energy in the middle), the
+ * passband (1/12 octaves from 20 Hz. to 3 kHz.) must stay within
+ * minphase_error_max db of the source's, most of the energy (minphase_front)
+ * must move into the first quarter of the taps, and "minphase n" must report
+ * n taps, and be the first n of them, silent after.
+ */
+#define linear_table  "linear_table"
+#define linear_length 255
+#define minphase_keep 64
+
+static double minphase_error_max = 0.01;
+static double minphase_front     = 0.9;
+
+static int check_minphase(void)
+{
+    t_sample  output[golden_length], cut[golden_length];
+    t_sample  source[linear_length];
+    t_word*   table  = stub_array_new(linear_table, linear_length);
+    const int middle = linear_length / 2;
+    t_float   taps   = 0.f, kept = 0.f;
+    double    worst  = 0., front = 0., energy = 0., error = 1e30;
+
+    for (int k = 0; k < linear_length; ++k)
+    {   // sinc at 4 kHz., blackman window
+        const double t = k - middle;
+        const double w = 2. * M_PI * k / (linear_length - 1);
+        const double h = (t == 0.) ? 2. * 4000. / 48000.
+                                   : sin(2. * M_PI * 4000. / 48000. * t) /
+                                     (M_PI * t);
+
+        source[k]        = (t_sample)(h * (0.42 - 0.5 * cos(w) +
+                                           0.08 * cos(2. * w)));
+        table[k].w_float = source[k];
+    }
+
+    const t_bench_object whole   = {"fir~", linear_table, "minphase", 0};
+    const t_bench_object shorter = {"fir~", linear_table, "minphase 64", 0};
+
+    int ok = render_taps(&whole, 0, output, &taps) && taps == linear_length;
+
+    for (double freq = 20.; ok && freq <= 3000.; freq *= pow(2., 1. / 12.))
+    {
+        const double d = fabs(response_db(output, linear_length, freq) -
+                              response_db(source, linear_length, freq));
+        worst = (d > worst) ? d : worst;
+    }
+
+    for (int k = 0; k < linear_length; ++k)
+    {
+        const double e = (double)output[k] * output[k];
+        front  += (k < linear_length / 4) ? e : 0.;
+        energy += e;
+    }
+
+    front = (energy > 0.) ? front / energy : 0.;
+    ok    = ok && worst <= minphase_error_max && front >= minphase_front;
+
+    printf("%s %-11s minphase  passband within %g db, %.1f%% in front\n",
+           ok ? "ok  " : "FAIL", "fir~", worst, 100. * front);
+
+    int failed = !ok;
+
+    // and cut short
+    ok = render_taps(&shorter, 0, cut, &kept) && kept == minphase_keep;
+
+    if (ok)
+    {
+        error = compare(cut, output, minphase_keep);
+
+        for (int k = minphase_keep; k < golden_length; ++k)
+        {
+            ok = ok && cut[k] == 0.f;
+        }
+    }
+
+    ok = ok && error <= sparse_tolerance;
+
+    printf("%s %-11s minphase %d keeps %g taps, error %g\n",
+           ok ? "ok  " : "FAIL", "fir~", minphase_keep, kept, error);
+    return failed | !ok;
+}
+
+static int verify(const char* dir, int record)
+{
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/throughput.txt", dir);
+    FILE* baseline = fopen(path, record ? "w" : "r");
+
+    if (baseline == 0)
+    {
+        printf("FAIL couldn't open %s\n", path);
+        return 1;
+    }
+
+    // a fixed impulse response for fir~
+    t_word* coefs = stub_array_new(golden_fir, 512);
+    noise_state = 12345;
+
+    for (int k = 0; k < 512; ++k)
+    {
+        coefs[k].w_float = noise() * expf(-6.f * k / 512);
+    }
+
+    // and a longer one, for fir~'s partitions (and rooms for lms~ and
+    // pbfdaf~ to learn)
+    coefs = stub_array_new(golden_long, golden_long_length);
+
+    for (int k = 0; k < golden_long_length; ++k)
+    {
+        coefs[k].w_float = noise() * expf(-6.f * k / golden_long_length);
+    }
+
+    // where adaptive filters write their taps (more than any of them has)
+    stub_array_new(adaptive_taps, 2048);
+
+    const double reference = reference_ns();
+    int failed = 0;
+
+    for (int i = 0; i < countof(biquads); ++i)
+    {
+        if (wanted(biquads[i].name))
+        {
+            failed |= check(dir, record, &biquads[i], 5, 4, reference,
+                            baseline);
+        }
+    }
+
+    for (int i = 0; i < countof(variants); ++i)
+    {
+        if (wanted(variants[i].name))
+        {
+            failed |= check(dir, record, &variants[i], 5, 4, reference, 0);
+        }
+    }
+
+    if (wanted("fir~"))
+    {
+        const t_bench_object fir = {"fir~", golden_fir, 0, 0};
+
+        failed |= check(dir, record, &fir, 512, 3, reference, baseline);
+    }
+
+    if (wanted("fir~"))
+    {
+        failed |= check_budgets(dir, record);
+    }
+
+    if (wanted("lms~") && !record)
+    {   // (these are measured, not compared against references)
+        failed |= check_adaptive("lms~", "64 0.5", 64, coefs);
+    }
+
+    if (wanted("pbfdaf~") && !record)
+    {
+        failed |= check_adaptive("pbfdaf~", "1024 256 0.5", 1024, coefs);
+    }
+
+    if (wanted("cascade~") && !record)
+    {
+        failed |= check_cascade();
+    }
+
+    if (wanted("firdesign~") && !record)
+    {
+        failed |= check_firdesign();
+    }
+
+    if (wanted("firmatrix~") && !record)
+    {   // (checked against fir~)
+        failed |= check_firmatrix();
+    }
+
+    if (wanted("lowpass~") && !record)
+    {   // (changes posted while it runs, and too many of them)
+        failed |= check_posted();
+        failed |= check_overflow();
+    }
+
+    if (wanted("fir~") && !record)
+    {   // (fir~'s partitions)
+        failed |= check_cache();
+    }
+
+    if (wanted("fir~") && !record)
+    {   // (against the same filters in tables)
+        failed |= check_open();
+    }
+
+    if (wanted("fir~") && !record)
+    {   // (taps left out, and minimum phase)
+        failed |= check_taps();
+        failed |= check_minphase();
+    }
+
+    if (renderer != 0 && !record)
+    {   // (against the objects, not the references)
+        failed |= check_renderer();
+    }
+
+    if (wanted("multifilter~") && !record)
+    {   // (it has no references of its own to record)
+        failed |= check_multifilter(dir);
+    }
+
+    fclose(baseline);
+    printf(failed ? "verify: FAILED\n" : "verify: all ok\n");
+    return failed;
+}
+
+// main ------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+    const char* dir    = 0;
+    int         record = 0;
+
+    names = (char**)calloc(argc, sizeof(char*));
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-q") == 0)
+        {
+            work /= 16.;
+        }
+        else if (strcmp(argv[i], "-render") == 0 && i + 1 < argc)
+        {
+            renderer = argv[++i];
+        }
+        else if ((strcmp(argv[i], "-record") == 0 ||
+                  strcmp(argv[i], "-verify") == 0) && i + 1 < argc)
+        {
+            record = (strcmp(argv[i], "-record") == 0);
+            dir    = argv[++i];
+        }
+        else
+        {
+            names[nNames++] = argv[i];
+        }
+    }
+
+    if (mkdtemp(scratch) == 0)
+    {
+        fprintf(stderr, "couldn't make a directory in /tmp\n");
+        return 1;
+    }
+
+    // (the renderer inherits these, so it uses the same tuning)
+    char path[64];
+    atexit(remove_scratch);
+    snprintf(path, sizeof(path), "%s/cache", scratch);
+    setenv("HOF_CACHE", path, 1);
+    snprintf(path, sizeof(path), "%s/tuning", scratch);
+    setenv("HOF_TUNING", path, 1);
+
+    stub_setup();
+    stub_outlet_hook = hear;
+
+    if (dir != 0)
+    {
+        return verify(dir, record);
+    }
+
+    // decaying noise for fir~ to chew on
+    for (int i = 0; i < countof(fir_lengths); ++i)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "bench_fir_%d", fir_lengths[i]);
+        t_word* coefs = stub_array_new(name, fir_lengths[i]);
+
+        for (int k = 0; k < fir_lengths[i]; ++k)
+        {
+            coefs[k].w_float = noise() * expf(-6.f * k / fir_lengths[i]);
+        }
+    }
+
+    printf("ns. per sample per instance (fir~ kernel: %s)\n", hof_fir_kernel());
+    printf("%-11s %-20s %9s", "object", "arguments", "instances");
+
+    for (int b = 0; b < countof(block_sizes); ++b)
+    {
+        printf(" %6s%-3d", "block ", block_sizes[b]);
+    }
+
+    printf("\n");
+
+    for (int i = 0; i < countof(biquads); ++i)
+    {
+        if (wanted(biquads[i].name))
+        {
+            run(biquads[i].name, biquads[i].args, 5);
+        }
+    }
+
+    for (int i = 0; i < countof(fir_lengths) && wanted("fir~"); ++i)
+    {
+        char args[32];
+        snprintf(args, sizeof(args), "bench_fir_%d", fir_lengths[i]);
+        run("fir~", args, fir_lengths[i]);
+    }
+
+    for (int i = 0; i < countof(fir_lengths) && wanted("fir~"); ++i)
+    {   // (a short cost, so enough blocks run to fill several partitions)
+        const int cost = (fir_lengths[i] < 256) ? fir_lengths[i] : 256;
+
+        for (int b = 0; b < countof(fir_budgets); ++b)
+        {
+            char args[32];
+            snprintf(args, sizeof(args), "bench_fir_%d %d",
+                     fir_lengths[i], fir_budgets[b]);
+            run("fir~", args, cost);
+        }
+    }
+
+    return 0;
+}
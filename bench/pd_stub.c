@@ -0,0 +1,672 @@
+//------------------------------------------------------------------------------
+//  Higher Order Filter Project
+//
+//  pd_stub.c: a minimal pd host, for running the objects outside of pd
+//  Copyright (c) 2016 Elliot Patros. All rights reserved.
+//------------------------------------------------------------------------------
+
+#include "pd_stub.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// the objects in this project -------------------------------------------------
+void higher_order_filter_setup(void);
+
+void stub_setup(void)
+{
+    higher_order_filter_setup();
+}
+
+// symbols ---------------------------------------------------------------------
+typedef struct stub_symbol
+{
+    t_symbol            symbol;
+    struct stub_symbol* next;
+
+} t_stub_symbol;
+
+static t_stub_symbol* symbols = 0;
+
+t_symbol* gensym(const char* s)
+{
+    for (t_stub_symbol* sym = symbols; sym != 0; sym = sym->next)
+    {
+        if (strcmp(sym->symbol.s_name, s) == 0)
+        {
+            return &sym->symbol;
+        }
+    }
+
+    t_stub_symbol* sym = (t_stub_symbol*)calloc(1, sizeof(t_stub_symbol));
+    char* name = (char*)malloc(strlen(s) + 1);
+    strcpy(name, s);
+    sym->symbol.s_name = name;
+    sym->next = symbols;
+    symbols = sym;
+    return &sym->symbol;
+}
+
+// classes ---------------------------------------------------------------------
+/*
+ * a class remembers how to make, free and message its objects. argument
+ * types are kept so we can call methods the same way pd does: pointer
+ * arguments first, then float arguments.
+ */
+#define stub_max_args    6
+#define stub_max_methods 32
+
+typedef struct stub_method
+{
+    t_symbol*  selector;
+    t_method   fn;
+    t_atomtype arg[stub_max_args + 1]; // 0-terminated
+
+} t_stub_method;
+
+struct _class
+{
+    t_symbol*      name;
+    t_newmethod    newmethod;
+    t_method       freemethod;
+    size_t         size;
+    t_atomtype     arg[stub_max_args + 1]; // creation arguments, 0-terminated
+    t_stub_method  method[stub_max_methods];
+    int            nMethods;
+    struct _class* next;
+};
+
+static t_class* classes = 0;
+
+static void read_arg_types(t_atomtype* types, t_atomtype first, va_list ap)
+{
+    int i = 0;
+
+    for (t_atomtype type = first; type != A_NULL && i < stub_max_args;
+         type = (t_atomtype)va_arg(ap, int))
+    {
+        types[i++] = type;
+    }
+
+    types[i] = A_NULL;
+}
+
+t_class* class_new(t_symbol* name, t_newmethod newmethod, t_method freemethod,
+                   size_t size, int flags, t_atomtype arg1, ...)
+{
+    (void)flags;
+
+    t_class* c = (t_class*)calloc(1, sizeof(t_class));
+    c->name       = name;
+    c->newmethod  = newmethod;
+    c->freemethod = freemethod;
+    c->size       = size;
+
+    va_list ap;
+    va_start(ap, arg1);
+    read_arg_types(c->arg, arg1, ap);
+    va_end(ap);
+
+    c->next = classes;
+    classes = c;
+    return c;
+}
+
+void class_addmethod(t_class* c, t_method fn, t_symbol* sel,
+                     t_atomtype arg1, ...)
+{
+    if (c->nMethods >= stub_max_methods)
+    {
+        fprintf(stderr, "pd_stub: too many methods for %s\n", c->name->s_name);
+        return;
+    }
+
+    t_stub_method* m = &c->method[c->nMethods++];
+    m->selector = sel;
+    m->fn       = fn;
+
+    va_list ap;
+    va_start(ap, arg1);
+    read_arg_types(m->arg, arg1, ap);
+    va_end(ap);
+}
+
+void class_domainsignalin(t_class* c, int onset)
+{
+    (void)c;
+    (void)onset;
+}
+
+void class_addcreator(t_newmethod newmethod, t_symbol* s,
+                      t_atomtype type1, ...)
+{
+    (void)newmethod;
+    (void)s;
+    (void)type1;
+}
+
+void class_sethelpsymbol(t_class* c, t_symbol* s)
+{
+    (void)c;
+    (void)s;
+}
+
+// calling methods -------------------------------------------------------------
+/*
+ * like pd, we split arguments into pointers and floats, and call through a
+ * function type with room for all of them. pd relies on the same calling
+ * convention trick, so every method in this project is already written for it.
+ */
+typedef void* (*t_stub_fn)(void* x, t_int, t_int, t_int, t_int, t_int, t_int,
+                           t_floatarg, t_floatarg, t_floatarg,
+                           t_floatarg, t_floatarg, t_floatarg);
+typedef void* (*t_stub_gimme)(void* x, t_symbol* s, int argc, t_atom* argv);
+typedef void* (*t_stub_gimme_new)(t_symbol* s, int argc, t_atom* argv);
+typedef void* (*t_stub_new)(t_int, t_int, t_int, t_int, t_int, t_int,
+                            t_floatarg, t_floatarg, t_floatarg,
+                            t_floatarg, t_floatarg, t_floatarg);
+
+static void* call_typed(t_method fn, void* x, const t_atomtype* types,
+                        int argc, t_atom* argv)
+{
+    t_int      ai[stub_max_args] = {0};
+    t_floatarg af[stub_max_args] = {0};
+    int nInts = 0, nFloats = 0;
+
+    for (int i = 0; types[i] != A_NULL; ++i)
+    {
+        const t_atom* a = (i < argc) ? &argv[i] : 0;
+
+        switch (types[i])
+        {
+            case A_FLOAT:
+            case A_DEFFLOAT:
+                af[nFloats++] = (a != 0) ? atom_getfloat(a) : 0.f;
+                break;
+
+            case A_SYMBOL:
+            case A_DEFSYM:
+                ai[nInts++] = (t_int)((a != 0) ? atom_getsymbol(a)
+                                               : gensym(""));
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    if (x == 0)
+    {
+        return ((t_stub_new)fn)(ai[0], ai[1], ai[2], ai[3], ai[4], ai[5],
+                                af[0], af[1], af[2], af[3], af[4], af[5]);
+    }
+
+    return ((t_stub_fn)fn)(x, ai[0], ai[1], ai[2], ai[3], ai[4], ai[5],
+                           af[0], af[1], af[2], af[3], af[4], af[5]);
+}
+
+// objects ---------------------------------------------------------------------
+t_pd* pd_new(t_class* c)
+{
+    t_pd* x = (t_pd*)calloc(1, c->size);
+    *x = c;
+    return x;
+}
+
+t_pd* stub_new(const char* name, int argc, t_atom* argv)
+{
+    t_symbol* s = gensym(name);
+
+    for (t_class* c = classes; c != 0; c = c->next)
+    {
+        if (c->name == s)
+        {
+            return (t_pd*)((c->arg[0] == A_GIMME)
+                ? ((t_stub_gimme_new)c->newmethod)(s, argc, argv)
+                : call_typed((t_method)c->newmethod, 0, c->arg, argc, argv));
+        }
+    }
+
+    fprintf(stderr, "pd_stub: %s ... couldn't create\n", name);
+    return 0;
+}
+
+int stub_message(t_pd* x, const char* selector, int argc, t_atom* argv)
+{
+    t_class*  c = *x;
+    t_symbol* s = gensym(selector);
+
+    for (int i = 0; i < c->nMethods; ++i)
+    {
+        t_stub_method* m = &c->method[i];
+
+        if (m->selector != s)
+        {
+            continue;
+        }
+
+        if (m->arg[0] == A_GIMME)
+        {
+            ((t_stub_gimme)m->fn)(x, s, argc, argv);
+        }
+        else
+        {
+            call_typed(m->fn, x, m->arg, argc, argv);
+        }
+
+        return 1;
+    }
+
+    fprintf(stderr, "pd_stub: %s: no method for '%s'\n",
+            c->name->s_name, selector);
+    return 0;
+}
+
+void pd_free(t_pd* x)
+{
+    t_class* c = *x;
+
+    if (c->freemethod != 0)
+    {
+        ((void (*)(void*))c->freemethod)(x);
+    }
+
+    free(x);
+}
+
+void stub_free(t_pd* x)
+{
+    pd_free(x);
+}
+
+// inlets and outlets ----------------------------------------------------------
+struct _inlet
+{
+    t_object* owner;
+};
+
+struct _outlet
+{
+    t_object*       owner;
+    int             index;
+    struct _outlet* next;
+};
+
+static t_outlet* outlets = 0;
+
+void (*stub_outlet_hook)(t_pd* owner, int outlet, t_symbol* selector,
+                         int argc, t_atom* argv) = 0;
+
+t_inlet* inlet_new(t_object* owner, t_pd* dest, t_symbol* s1, t_symbol* s2)
+{
+    (void)dest;
+    (void)s1;
+    (void)s2;
+
+    t_inlet* i = (t_inlet*)calloc(1, sizeof(t_inlet));
+    i->owner = owner;
+    return i;
+}
+
+t_outlet* outlet_new(t_object* owner, t_symbol* s)
+{
+    (void)s;
+
+    t_outlet* o = (t_outlet*)calloc(1, sizeof(t_outlet));
+    o->owner = owner;
+
+    for (t_outlet* other = outlets; other != 0; other = other->next)
+    {
+        o->index += (other->owner == owner);
+    }
+
+    o->next = outlets;
+    outlets = o;
+    return o;
+}
+
+void outlet_anything(t_outlet* x, t_symbol* s, int argc, t_atom* argv)
+{
+    if (stub_outlet_hook != 0)
+    {
+        stub_outlet_hook(&x->owner->ob_pd, x->index, s, argc, argv);
+    }
+}
+
+void outlet_list(t_outlet* x, t_symbol* s, int argc, t_atom* argv)
+{
+    (void)s;
+    outlet_anything(x, gensym("list"), argc, argv);
+}
+
+void outlet_float(t_outlet* x, t_float f)
+{
+    t_atom a;
+    SETFLOAT(&a, f);
+    outlet_anything(x, gensym("float"), 1, &a);
+}
+
+void outlet_bang(t_outlet* x)
+{
+    outlet_anything(x, gensym("bang"), 0, 0);
+}
+
+// atoms -----------------------------------------------------------------------
+t_float atom_getfloat(const t_atom* a)
+{
+    return (a->a_type == A_FLOAT) ? a->a_w.w_float : 0.f;
+}
+
+t_int atom_getint(const t_atom* a)
+{
+    return (t_int)atom_getfloat(a);
+}
+
+t_symbol* atom_getsymbol(const t_atom* a)
+{
+    return (a->a_type == A_SYMBOL) ? a->a_w.w_symbol : gensym("symbol");
+}
+
+t_float atom_getfloatarg(int which, int argc, const t_atom* argv)
+{
+    return (which < argc) ? atom_getfloat(&argv[which]) : 0.f;
+}
+
+t_symbol* atom_getsymbolarg(int which, int argc, const t_atom* argv)
+{
+    return (which < argc) ? atom_getsymbol(&argv[which]) : gensym("");
+}
+
+// printing --------------------------------------------------------------------
+void post(const char* fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    fputc('\n', stderr);
+}
+
+int stub_errors = 0;
+
+void pd_error(const void* object, const char* fmt, ...)
+{
+    (void)object;
+    ++stub_errors;
+
+    va_list ap;
+    va_start(ap, fmt);
+    fputs("error: ", stderr);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    fputc('\n', stderr);
+}
+
+// arrays ----------------------------------------------------------------------
+struct _garray
+{
+    t_pd            pd;
+    t_symbol*       name;
+    t_word*         vec;
+    int             n;
+    struct _garray* next;
+};
+
+static t_class   garray_stub_class;
+t_class*         garray_class = &garray_stub_class;
+static t_garray* arrays = 0;
+
+t_word* stub_array_new(const char* name, int n)
+{
+    t_garray* a = (t_garray*)calloc(1, sizeof(t_garray));
+    a->pd   = garray_class;
+    a->name = gensym(name);
+    a->vec  = (t_word*)calloc(n, sizeof(t_word));
+    a->n    = n;
+    a->next = arrays;
+    arrays  = a;
+    return a->vec;
+}
+
+t_pd* pd_findbyclass(t_symbol* s, const t_class* c)
+{
+    if (c != garray_class)
+    {
+        return 0;
+    }
+
+    for (t_garray* a = arrays; a != 0; a = a->next)
+    {
+        if (a->name == s)
+        {
+            return &a->pd;
+        }
+    }
+
+    return 0;
+}
+
+int garray_getfloatwords(t_garray* x, int* size, t_word** vec)
+{
+    *size = x->n;
+    *vec  = x->vec;
+    return 1;
+}
+
+// (new points are zeros, like pd's)
+void garray_resize_long(t_garray* x, long n)
+{
+    t_word* vec = (t_word*)realloc(x->vec, sizeof(t_word) * (n + 1));
+
+    if (vec == 0)
+    {
+        return;
+    }
+
+    for (long i = x->n; i < n; ++i)
+    {
+        vec[i].w_float = 0.f;
+    }
+
+    x->vec = vec;
+    x->n   = (int)n;
+}
+
+void garray_usedindsp(t_garray* x)
+{
+    (void)x;
+}
+
+void garray_redraw(t_garray* x)
+{
+    (void)x;
+}
+
+// clocks ----------------------------------------------------------------------
+/*
+ * there's no logical time here: a clock that's set goes off at the start of
+ * the next stub_tick, whatever its delay.
+ */
+struct _clock
+{
+    void*          owner;
+    t_method       fn;
+    int            set;
+    struct _clock* next;
+};
+
+static t_clock* clocks = 0;
+
+t_clock* clock_new(void* owner, t_method fn)
+{
+    t_clock* c = (t_clock*)calloc(1, sizeof(t_clock));
+    c->owner = owner;
+    c->fn    = fn;
+    c->next  = clocks;
+    clocks   = c;
+    return c;
+}
+
+void clock_delay(t_clock* x, double delaytime)
+{
+    (void)delaytime;
+    x->set = 1;
+}
+
+void clock_unset(t_clock* x)
+{
+    x->set = 0;
+}
+
+void clock_free(t_clock* x)
+{
+    for (t_clock** c = &clocks; *c != 0; c = &(*c)->next)
+    {
+        if (*c == x)
+        {
+            *c = x->next;
+            break;
+        }
+    }
+
+    free(x);
+}
+
+static void clocks_run(void)
+{
+    for (t_clock* c = clocks; c != 0; c = c->next)
+    {
+        if (c->set)
+        {
+            c->set = 0;
+            ((void (*)(void*))c->fn)(c->owner);
+        }
+    }
+}
+
+// canvases --------------------------------------------------------------------
+// there are no patches, so paths are relative to the working directory
+t_glist* canvas_getcurrent(void)
+{
+    return 0;
+}
+
+void canvas_makefilename(const t_glist* c, const char* file, char* result,
+                         int resultsize)
+{
+    (void)c;
+    snprintf(result, resultsize, "%s", file);
+}
+
+// dsp -------------------------------------------------------------------------
+/*
+ * the dsp chain is a list of perform routines, each followed by its
+ * arguments, exactly the way pd lays it out. each perform routine returns a
+ * pointer to the next one, and a 0 ends the chain.
+ */
+static t_int* chain      = 0;
+static int    chainSize  = 0;
+static int    chainAlloc = 0;
+
+static void chain_push(t_int value)
+{
+    if (chainSize + 1 >= chainAlloc)
+    {
+        chainAlloc = (chainAlloc == 0) ? 256 : chainAlloc * 2;
+        chain = (t_int*)realloc(chain, sizeof(t_int) * chainAlloc);
+    }
+
+    chain[chainSize++] = value;
+    chain[chainSize]   = 0;
+}
+
+void dsp_add(t_perfroutine f, int n, ...)
+{
+    chain_push((t_int)f);
+
+    va_list ap;
+    va_start(ap, n);
+
+    for (int i = 0; i < n; ++i)
+    {
+        chain_push(va_arg(ap, t_int));
+    }
+
+    va_end(ap);
+}
+
+void dsp_addv(t_perfroutine f, int n, t_int* vec)
+{
+    chain_push((t_int)f);
+
+    for (int i = 0; i < n; ++i)
+    {
+        chain_push(vec[i]);
+    }
+}
+
+// the sample rate of the last stub_dsp_add (0 before one)
+static t_float stub_sr = 0.f;
+
+t_float sys_getsr(void)
+{
+    return stub_sr;
+}
+
+void stub_dsp_add(t_pd* x, int nVecs, t_sample** vecs, int n, t_float sr)
+{
+    t_signal*  signals = (t_signal*)calloc(nVecs, sizeof(t_signal));
+    t_signal** sig     = (t_signal**)calloc(nVecs + 1, sizeof(t_signal*));
+
+    for (int i = 0; i < nVecs; ++i)
+    {
+        signals[i].s_n       = n;
+        signals[i].s_vec     = vecs[i];
+        signals[i].s_sr      = sr;
+        signals[i].s_vecsize = n;
+        sig[i] = &signals[i];
+    }
+
+    // the dsp method takes a t_signal** (not atoms), so we call it directly
+    t_class* c = *x;
+
+    stub_sr = sr;
+
+    for (int i = 0; i < c->nMethods; ++i)
+    {
+        if (c->method[i].selector == gensym("dsp"))
+        {
+            ((void (*)(void*, t_signal**))c->method[i].fn)(x, sig);
+        }
+    }
+
+    free(sig);
+    free(signals);
+}
+
+void stub_dsp_clear(void)
+{
+    chainSize = 0;
+
+    if (chain != 0)
+    {
+        chain[0] = 0;
+    }
+}
+
+void stub_tick(void)
+{
+    clocks_run();
+
+    if (chain == 0)
+    {
+        return;
+    }
+
+    for (t_int* ptr = chain; *ptr != 0; )
+    {
+        ptr = ((t_perfroutine)*ptr)(ptr);
+    }
+}
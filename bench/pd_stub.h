@@ -0,0 +1,54 @@
+//------------------------------------------------------------------------------
+//  Higher Order Filter Project
+//
+//  pd_stub.h: a minimal pd host, for running the objects outside of pd
+//  Copyright (c) 2016 Elliot Patros. All rights reserved.
+//------------------------------------------------------------------------------
+
+#ifndef _pd_stub_h
+#define _pd_stub_h
+
+#include "m_pd.h"
+
+/*
+ * pd_stub.c implements the parts of m_pd.h that this project's objects use
+ * (class_new, dsp_add, garray_getfloatwords, ...), so the real object code
+ * can be linked into a plain program. objects are created by name, sent
+ * messages, and put into a dsp chain that runs one block per stub_tick().
+ */
+
+// setup every object in this project (like loading the library once)
+void stub_setup(void);
+
+// make an object, as if it were typed into a patch (0 if it failed)
+t_pd* stub_new(const char* name, int argc, t_atom* argv);
+
+// send an object a message (returns 0 if it has no such method)
+int stub_message(t_pd* x, const char* selector, int argc, t_atom* argv);
+
+// delete an object
+void stub_free(t_pd* x);
+
+// make a pd array named 'name' with n points, all zero (its points move if
+// it's resized)
+t_word* stub_array_new(const char* name, int n);
+
+// add an object to the dsp chain. 'vecs' holds its signal inlets' vectors,
+// followed by its signal outlets' vectors (each n samples long). sys_getsr
+// returns 'sr' from then on
+void stub_dsp_add(t_pd* x, int nVecs, t_sample** vecs, int n, t_float sr);
+
+// empty the dsp chain (objects stay alive)
+void stub_dsp_clear(void);
+
+// run any clocks that are set, then every perform routine in the dsp chain
+void stub_tick(void);
+
+// how many times objects have called pd_error
+extern int stub_errors;
+
+// called for every message an object sends out of an outlet (may be 0)
+extern void (*stub_outlet_hook)(t_pd* owner, int outlet, t_symbol* selector,
+                                int argc, t_atom* argv);
+
+#endif // _pd_stub_h defined
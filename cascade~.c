@@ -0,0 +1,418 @@
+//------------------------------------------------------------------------------
+//  Higher Order Filter Project
+//
+//  cascade~.c: second-order sections in series, fitted to an fir filter
+//  Copyright (c) 2016 Elliot Patros. All rights reserved.
+//------------------------------------------------------------------------------
+
+// Pd header and constants -----------------------------------------------------
+#include "m_pd.h"
+#include "higher_order_filter.h"
+
+#define cascade_poll_ms       10 // how often we check on a fit
+#define cascade_default_count 4  // sections fitted, unless we're told
+
+// pointer to this object's class ----------------------------------------------
+static t_class* cascade_class;
+
+// this object's struct --------------------------------------------------------
+typedef struct cascade
+{
+    // instance of this object. must always be first
+    t_object object;
+    
+    // state of each inlet value
+    t_float       sample;  // first inlet: audio, so not used for control rate
+    
+    // the filter engine (keeps coefficients and delay tables)
+    hof_cascade*  filter;
+    t_float       sr;      // sample rate the fits are made at
+    int           count;   // how many sections "fit" makes by default
+    t_outlet*     info;    // outlet for "peak", "gain", "coefs", "error" (and
+                           // "stats")
+    
+    // fitting a table's filter (see _fit), which happens on a thread of its
+    // own
+    hof_thread    fitter;  // the thread fitting
+    t_clock*      poll;    // checks whether it has finished
+    hof_atomic    fitted;  // 1 once it has
+    int           fitting; // 1 while it runs
+    int           stale;   // 1 if "coefs" came since (the fit is dropped)
+    t_symbol*     array_name; // the table being fitted
+    float*        source;  // a copy of its coefficients
+    int           source_order; // how many there are
+    int           nSections;    // how many sections to fit
+    float         fit_sr;       // sr when the fit started
+    float         param[hof_fit_max_peaks * hof_nParams + 1]; // the fit
+    float         error;   // and what's left (-1 if out of memory)
+    
+} t_cascade;
+
+// _perform --------------------------------------------------------------------
+/*
+ * called at the start of every block while 'dsp' is on.
+ * borrowing from miller's explanation, it's called with a single pointer 'ptr',
+ * where ptr[0] is our function's location in the dsp call list. we return a new
+ * pointer, which will point to the next dsp function. meanwhile, arguments that
+ * are useful for processing audio samples are packed after ptr[0], as specified
+ * in the _dsp function.
+ */
+static t_int* cascade_perform(t_int* ptr)
+{
+    t_float*    input    = (t_float*)  ptr[1];
+    t_float*    output   = (t_float*)  ptr[2];
+    const t_int nSamples = (t_int)     ptr[3];
+    t_cascade*  x        = (t_cascade*)ptr[4];
+    
+    // filter this block through every section (or copy it, with none)
+    hof_cascade_process(x->filter, (const float* const*)&input, &output,
+                        nSamples);
+    
+    return &ptr[5];
+}
+
+#ifdef HOF_STATS
+// report stats ----------------------------------------------------------------
+/*
+ * called when we get the message "stats" (only when built with HOF_STATS).
+ * sends this object's dsp counters out of the info outlet, or zeros them if
+ * the argument is "reset".
+ */
+static void cascade_stats(t_cascade* x, t_symbol* arg)
+{
+    stats_message(x->info, &x->filter->stats, arg);
+}
+#endif
+
+// report the coefficients -----------------------------------------------------
+/*
+ * sends every section's coefficients (B0 B1 B2 A1 A2 each) out of the info
+ * outlet, as one "coefs" message, which this object (or another) takes back.
+ */
+static void cascade_report_coefs(t_cascade* x)
+{
+    const hof_cascade* filter = x->filter;
+    const int          n      = 5 * filter->nSections;
+    t_atom*            coefs  = (t_atom*)malloc(sizeof(t_atom) * (n + 1));
+    
+    if (coefs == 0)
+    {
+        pd_error(x, "not enough memory for cascade~");
+        return;
+    }
+    
+    for (int s = 0; s < filter->nSections; ++s)
+    {
+        for (int k = 0; k < 3; ++k)
+        {
+            SETFLOAT(&coefs[5 * s + k], filter->b_coef[3 * s + k]);
+        }
+    
+        SETFLOAT(&coefs[5 * s + 3], filter->a_coef[2 * s]);
+        SETFLOAT(&coefs[5 * s + 4], filter->a_coef[2 * s + 1]);
+    }
+    
+    outlet_anything(x->info, gensym("coefs"), n, coefs);
+    free(coefs);
+}
+
+// _coefs ----------------------------------------------------------------------
+/*
+ * called when we get the message "coefs".
+ * sets every section at once, from 5 coefficients each (B0 B1 B2 A1 A2, the
+ * same as peak~ and the others use). no coefficients leaves no sections: a
+ * wire. this also drops any fit still being made.
+ */
+static void cascade_coefs(t_cascade* x, t_symbol* s, int argc, t_atom* argv)
+{
+    UNUSED_PARAM(s);
+    
+    float* coefs = (float*)malloc(sizeof(float) * (argc + 1));
+    
+    if (argc % 5 != 0)
+    {
+        pd_error(x, "cascade~: coefs needs 5 per section (B0 B1 B2 A1 A2)");
+    }
+    else if (coefs == 0)
+    {
+        pd_error(x, "not enough memory for cascade~");
+    }
+    else
+    {
+        for (int k = 0; k < argc; ++k)
+        {
+            coefs[k] = atom_getfloat(&argv[k]);
+        }
+    
+        if (hof_cascade_set_coefs(x->filter, coefs, argc / 5) == 0)
+        {   // sections failed to allocate memory
+            pd_error(x, "not enough memory for cascade~");
+        }
+    
+        x->stale = x->fitting;
+    }
+    
+    free(coefs);
+}
+
+// _clear ----------------------------------------------------------------------
+/*
+ * called when we get the message "clear".
+ * empties every section's delay tables (after a filter blew up, say).
+ */
+static void cascade_clear(t_cascade* x)
+{
+    hof_cascade_reset(x->filter);
+}
+
+// _free -----------------------------------------------------------------------
+/*
+ * called when this object is deleted.
+ * free any memory we've allocated.
+ */
+static void cascade_free(t_cascade* x)
+{
+    if (x->fitting)
+    {   // wait for the fit to finish
+        hof_thread_join(&x->fitter);
+    }
+    
+    if (x->poll != 0)
+    {
+        clock_free(x->poll);
+    }
+    
+    free(x->source);
+    hof_cascade_free(x->filter);
+}
+
+// _fit ------------------------------------------------------------------------
+/*
+ * runs on the fitting thread (see hof_fit_peaks, which is the slow part).
+ * nothing else touches param or error until 'fitted' says we're done.
+ */
+static void* cascade_fitter(void* arg)
+{
+    t_cascade* x = (t_cascade*)arg;
+    
+    x->error = hof_fit_peaks(x->source, x->source_order, 1, x->fit_sr,
+                             x->nSections, x->param);
+    hof_atomic_store(&x->fitted, 1);
+    return 0;
+}
+
+/*
+ * called by our clock while a fit is being made. once it's done, the
+ * sections take over (their delay tables are kept if there are as many as
+ * before), and the fit is reported: "peak Q dB freq" for each section (what
+ * peak~ would take, at the sample rate the fit was made at), "gain" (dB),
+ * then "coefs" (see _coefs) and "error", the rms difference left (dB).
+ */
+static void cascade_poll(t_cascade* x)
+{
+    t_atom value[3];
+    
+    if (!hof_atomic_load(&x->fitted))
+    {   // not yet
+        clock_delay(x->poll, cascade_poll_ms);
+        return;
+    }
+    
+    hof_thread_join(&x->fitter);
+    x->fitting = 0;
+    free(x->source);
+    x->source  = 0;
+    
+    if (x->stale)
+    {
+        return;
+    }
+    
+    if (x->error < 0.f ||
+        hof_cascade_set_peaks(x->filter, x->param, x->nSections,
+                              x->fit_sr) == 0)
+    {
+        pd_error(x, "not enough memory for cascade~");
+        return;
+    }
+    
+    for (int s = 0; s < x->nSections; ++s)
+    {
+        const float* p = x->param + s * hof_nParams;
+    
+        SETFLOAT(&value[0], p[hof_Q]);
+        SETFLOAT(&value[1], p[hof_dB]);
+        SETFLOAT(&value[2], p[hof_freq]);
+        outlet_anything(x->info, gensym("peak"), 3, value);
+    }
+    
+    SETFLOAT(&value[0], x->param[x->nSections * hof_nParams]);
+    outlet_anything(x->info, gensym("gain"), 1, value);
+    cascade_report_coefs(x);
+    SETFLOAT(&value[0], x->error);
+    outlet_anything(x->info, gensym("error"), 1, value);
+}
+
+/*
+ * called when we get the message "fit".
+ * fit peak sections (and a gain) to the magnitude response of the fir
+ * filter in table 'array_name', so a smooth curve (room correction, say)
+ * costs a few biquads instead of a long fir~. an argument sets the number of
+ * sections (the creation argument, by default), up to 16. the table is
+ * copied now, and fitted in the background; until then, the old sections
+ * keep playing.
+ */
+static void cascade_fit(t_cascade* x, t_symbol* array_name,
+                        t_floatarg nSections)
+{
+    t_garray* array;
+    t_word*   coefs;
+    int       order;
+    
+    if (x->fitting)
+    {
+        pd_error(x, "cascade~: still fitting %s", x->array_name->s_name);
+        return;
+    }
+    
+    if ((array = (t_garray*)pd_findbyclass(array_name, garray_class)) == 0)
+    {   // array name doesn't exist
+        pd_error(x, "%s: no such array", array_name->s_name);
+        return;
+    }
+    
+    if (garray_getfloatwords(array, &order, &coefs) == 0)
+    {   // array isn't for floats only
+        pd_error(x, "%s: bad array template for cascade~",
+                 array_name->s_name);
+        return;
+    }
+    
+    if ((x->source = (float*)malloc(sizeof(float) * (order + 1))) == 0)
+    {
+        pd_error(x, "not enough memory for cascade~");
+        return;
+    }
+    
+    for (int k = 0; k < order; ++k)
+    {   // copied now: the table can change while we work
+        x->source[k] = coefs[k].w_float;
+    }
+    
+    x->array_name   = array_name;
+    x->source_order = order;
+    x->nSections    = ((int)nSections > 0) ? (int)nSections : x->count;
+    x->nSections    = (x->nSections < hof_fit_max_peaks) ? x->nSections
+                                                          : hof_fit_max_peaks;
+    x->fit_sr       = x->sr; // (_dsp can change sr while we work)
+    x->stale        = 0;
+    hof_atomic_store(&x->fitted, 0);
+    
+    if (!hof_thread_start(&x->fitter, cascade_fitter, x))
+    {
+        pd_error(x, "cascade~: can't start fitting %s", array_name->s_name);
+        free(x->source);
+        x->source = 0;
+        return;
+    }
+    
+    x->fitting = 1;
+    clock_delay(x->poll, cascade_poll_ms);
+}
+
+// _new ------------------------------------------------------------------------
+/*
+ * called when this object is instantiated.
+ * initialize object members and allocate memory.
+ */
+static void* cascade_new(t_symbol* selector, int argc, t_atom* argv)
+{
+    UNUSED_PARAM(selector);
+    
+    // make a pointer to this object
+    t_cascade* x = (t_cascade*)pd_new(cascade_class);
+    
+    // make a filter engine with no sections yet (a wire), and fit at the
+    // default sample rate until dsp is turned on
+    x->sample     = 0.f;
+    x->sr         = default_sr;
+    x->fitting    = 0;
+    x->source     = 0;
+    x->array_name = 0;
+    x->poll       = clock_new(x, (t_method)cascade_poll);
+    x->filter     = hof_cascade_new(1);
+    
+    if (x->filter == 0)
+    {
+        pd_error(x, "not enough memory for cascade~");
+        pd_free(&x->object.ob_pd);
+        return 0;
+    }
+    
+    // make a signal outlet
+    outlet_new(&x->object, gensym("signal"));
+    
+    // make an outlet for the fit (and stats)
+    x->info = outlet_new(&x->object, 0);
+    
+    // get creation arguments from user if they exist (number of sections)
+    x->count = (argc > 0) ? (int)atom_getfloat(&argv[0]) : 0;
+    x->count = (x->count > 0) ? x->count : cascade_default_count;
+    
+    return (void*)x;
+}
+
+// _dsp ------------------------------------------------------------------------
+/*
+ * called when dsp is turned on.
+ * tell pd what arguments our _perform function needs, as well as where to find
+ * them. if necessary, any initialization that needs info about pd's dsp state
+ * should happen here to.
+ */
+static void cascade_dsp(t_cascade* x, t_signal** sig)
+{
+    // later fits are made at this sample rate (the sections we have already
+    // are just coefficients, so they stay as they are)
+    x->sr = sig[0]->s_sr;
+    
+    // add this object's dsp function to pd's dsp function list
+    dsp_add(cascade_perform, // this class' perform method
+            4,               // number of perform method parameters
+            sig[0]->s_vec,   // inlet sample vector
+            sig[1]->s_vec,   // outlet sample vector
+            sig[0]->s_n,     // block size (nSamples)
+            x);              // pointer to this object
+}
+
+// _setup ----------------------------------------------------------------------
+/*
+ * called the first time someone loads this object in the current pd session.
+ * tell pd about this object's "class", including our name, and which methods
+ * and arguments we can handle.
+ */
+void cascade_tilde_setup(void)
+{
+    // tell pd how to build our class
+    cascade_class = class_new(gensym("cascade~"),       // name
+                              (t_newmethod)cascade_new, // _new
+                              (t_method)cascade_free,   // _free
+                              sizeof(t_cascade),        // size
+                              CLASS_DEFAULT,            // flags
+                              A_GIMME,                  // arg types...
+                              0);                       // ...0-terminated
+    
+    // tell pd that our left inlet expects audio
+    CLASS_MAINSIGNALIN(cascade_class, t_cascade, sample);
+    
+    // tell pd which methods can be called by users (including dsp)
+    class_addmethod(cascade_class, (t_method)cascade_dsp, gensym("dsp"), 0);
+    class_addmethod(cascade_class, (t_method)cascade_fit, gensym("fit"),
+                    A_SYMBOL, A_DEFFLOAT, 0);
+    class_addmethod(cascade_class, (t_method)cascade_coefs, gensym("coefs"),
+                    A_GIMME, 0);
+    class_addmethod(cascade_class, (t_method)cascade_clear, gensym("clear"),
+                    0);
+#ifdef HOF_STATS
+    class_addmethod(cascade_class, (t_method)cascade_stats, gensym("stats"), A_DEFSYM, 0);
+#endif
+}
@@ -0,0 +1,405 @@
+//------------------------------------------------------------------------------
+//  Higher Order Filter Project
+//
+//  firdesign~.c: linear phase fir filters, designed into a table for fir~
+//  Copyright (c) 2016 Elliot Patros. All rights reserved.
+//------------------------------------------------------------------------------
+
+// Pd header and constants -----------------------------------------------------
+#include "m_pd.h"
+#include "higher_order_filter.h"
+
+#define firdesign_poll_ms        10   // how often we check on a design
+#define firdesign_default_stop   80.f // stopband attenuation (dB), by default
+#define firdesign_default_ripple 0.1f // most passband ripple (dB), by default
+
+// pointer to this object's class ----------------------------------------------
+static t_class* firdesign_class;
+
+// this object's struct --------------------------------------------------------
+typedef struct firdesign
+{
+    // instance of this object. must always be first
+    t_object object;
+    
+    // what to design (frequencies in Hz., until they're designed)
+    t_symbol*     array_name; // the table written to (0 if none)
+    hof_fir_spec  spec;       // the filter
+    int           has_spec;   // 1 once a response has been asked for
+    t_float       sr;         // sample rate it's designed at
+    t_outlet*     info;       // outlet for "taps", "delay" and "set"
+    
+    // designing (see _design), which happens on a thread of its own
+    hof_thread    designer;   // the thread designing
+    t_clock*      poll;       // checks whether it has finished
+    hof_atomic    designed;   // 1 once it has
+    int           designing;  // 1 while it runs
+    int           stale;      // 1 if the spec changed since (design again)
+    hof_atomic    cancel;     // 1 to stop it early
+    hof_fir_spec  job;        // the spec it's designing (fractions of sr)
+    float*        coefs;      // what it made
+    int           order;      // how many
+    int           ok;         // 0 if it couldn't
+    
+} t_firdesign;
+
+// _design ---------------------------------------------------------------------
+/*
+ * runs on the designing thread (see hof_fir_design, which is the slow part).
+ * nothing else touches coefs, order or ok until 'designed' says we're done.
+ */
+static void* firdesign_designer(void* arg)
+{
+    t_firdesign* x = (t_firdesign*)arg;
+    
+    x->ok = hof_fir_design(&x->job, &x->coefs, &x->order, &x->cancel);
+    hof_atomic_store(&x->designed, 1);
+    return 0;
+}
+
+/*
+ * design the spec at the current sample rate, in the background. if a design
+ * is already being made, it's stopped, and this one starts when it has (see
+ * _poll).
+ */
+static void firdesign_design(t_firdesign* x)
+{
+    if (!x->has_spec)
+    {   // nothing to design yet
+        return;
+    }
+    
+    if (x->designing)
+    {   // stop this one, and design again when it has
+        x->stale = 1;
+        hof_atomic_store(&x->cancel, 1);
+        return;
+    }
+    
+    x->job        = x->spec;
+    x->job.low   /= x->sr;
+    x->job.high  /= x->sr;
+    x->job.width /= x->sr;
+    
+    const int taps = hof_fir_design_taps(&x->job);
+    
+    if (taps == 0)
+    {
+        pd_error(x, "firdesign~: the bands don't fit between 0 and %g Hz.",
+                 x->sr / 2.f);
+        return;
+    }
+    
+    if (taps > hof_design_max_taps)
+    {
+        pd_error(x, "firdesign~: that needs more than %d taps (try a wider "
+                 "transition)", hof_design_max_taps);
+        return;
+    }
+    
+    x->stale = 0;
+    hof_atomic_store(&x->designed, 0);
+    hof_atomic_store(&x->cancel, 0);
+    
+    if (!hof_thread_start(&x->designer, firdesign_designer, x))
+    {
+        pd_error(x, "firdesign~: can't start designing");
+        return;
+    }
+    
+    x->designing = 1;
+    clock_delay(x->poll, firdesign_poll_ms);
+}
+
+/*
+ * called by our clock while a design is being made. once it's done, the
+ * table is resized to fit and filled, and the info outlet gets "taps" (its
+ * new size), "delay" (the filter's latency, in samples) and "set <table>",
+ * which tells fir~ to use it.
+ */
+static void firdesign_poll(t_firdesign* x)
+{
+    t_garray* array;
+    t_word*   vec;
+    t_atom    value;
+    int       size;
+    
+    if (!hof_atomic_load(&x->designed))
+    {   // not yet
+        clock_delay(x->poll, firdesign_poll_ms);
+        return;
+    }
+    
+    hof_thread_join(&x->designer);
+    x->designing = 0;
+    
+    if (x->stale)
+    {   // the spec (or sample rate) changed while we worked
+        free(x->coefs);
+        x->coefs = 0;
+        firdesign_design(x);
+        return;
+    }
+    
+    if (!x->ok)
+    {
+        pd_error(x, "firdesign~: can't meet that spec in %d taps",
+                 hof_design_max_taps);
+        return;
+    }
+    
+    if (x->array_name == 0 ||
+        (array = (t_garray*)pd_findbyclass(x->array_name, garray_class)) == 0)
+    {   // array name doesn't exist
+        pd_error(x, "%s: no such array",
+                 (x->array_name != 0) ? x->array_name->s_name : "(none)");
+    }
+    else
+    {
+        garray_resize_long(array, x->order);
+    
+        if (garray_getfloatwords(array, &size, &vec) == 0 || size != x->order)
+        {   // array isn't for floats only
+            pd_error(x, "%s: bad array template for firdesign~",
+                     x->array_name->s_name);
+        }
+        else
+        {
+            for (int k = 0; k < x->order; ++k)
+            {
+                vec[k].w_float = x->coefs[k];
+            }
+    
+            garray_redraw(array);
+            SETFLOAT(&value, x->order);
+            outlet_anything(x->info, gensym("taps"), 1, &value);
+            SETFLOAT(&value, (x->order - 1) / 2);
+            outlet_anything(x->info, gensym("delay"), 1, &value);
+            SETSYMBOL(&value, x->array_name);
+            outlet_anything(x->info, gensym("set"), 1, &value);
+        }
+    }
+    
+    free(x->coefs);
+    x->coefs = 0;
+}
+
+// set the response ------------------------------------------------------------
+/*
+ * called when we get the messages "lowpass", "highpass", "bandpass" or
+ * "notch": a response, a cutoff (or two), each the middle of a transition
+ * band 'width' wide (all in Hz.), and optionally the stopband attenuation
+ * (dB). any of these designs it again.
+ */
+static void firdesign_response(t_firdesign* x, const hof_type type,
+                               const t_float low, const t_float high,
+                               const t_float width, const t_float stop)
+{
+    x->spec.type  = type;
+    x->spec.low   = low;
+    x->spec.high  = high;
+    x->spec.width = width;
+    x->spec.stop  = (stop > 0.f) ? stop : x->spec.stop;
+    x->has_spec   = 1;
+    firdesign_design(x);
+}
+
+static void firdesign_lowpass(t_firdesign* x, t_floatarg freq,
+                              t_floatarg width, t_floatarg stop)
+{
+    firdesign_response(x, hof_lowpass, freq, 0.f, width, stop);
+}
+
+static void firdesign_highpass(t_firdesign* x, t_floatarg freq,
+                               t_floatarg width, t_floatarg stop)
+{
+    firdesign_response(x, hof_highpass, freq, 0.f, width, stop);
+}
+
+static void firdesign_bandpass(t_firdesign* x, t_floatarg low, t_floatarg high,
+                               t_floatarg width, t_floatarg stop)
+{
+    firdesign_response(x, hof_bandpass, low, high, width, stop);
+}
+
+static void firdesign_notch(t_firdesign* x, t_floatarg low, t_floatarg high,
+                            t_floatarg width, t_floatarg stop)
+{
+    firdesign_response(x, hof_notch, low, high, width, stop);
+}
+
+// _ripple ---------------------------------------------------------------------
+/*
+ * called when we get the message "ripple".
+ * sets the most the passband may ripple (dB), and designs it again.
+ */
+static void firdesign_ripple(t_firdesign* x, t_floatarg ripple)
+{
+    if (ripple <= 0.f)
+    {
+        pd_error(x, "firdesign~: ripple must be more than 0 dB.");
+        return;
+    }
+    
+    x->spec.ripple = ripple;
+    firdesign_design(x);
+}
+
+// _method ---------------------------------------------------------------------
+/*
+ * called when we get the message "method".
+ * "kaiser" windows a sinc (quick to design, but longer), "remez" makes an
+ * equiripple filter (the shortest that meets the spec, but it can take a
+ * while to design). designs it again.
+ */
+static void firdesign_method(t_firdesign* x, t_symbol* name)
+{
+    if      (name == gensym("kaiser")) { x->spec.method = hof_kaiser; }
+    else if (name == gensym("remez"))  { x->spec.method = hof_remez; }
+    else
+    {
+        pd_error(x, "firdesign~: method is \"kaiser\" or \"remez\"");
+        return;
+    }
+    
+    firdesign_design(x);
+}
+
+// _set ------------------------------------------------------------------------
+/*
+ * called when we get the message "set".
+ * design into another table from now on, starting with the filter we have
+ * (which comes straight from the cache, so this also writes it again if
+ * something else changed the table).
+ */
+static void firdesign_set(t_firdesign* x, t_symbol* array_name)
+{
+    x->array_name = array_name;
+    firdesign_design(x);
+}
+
+// _free -----------------------------------------------------------------------
+/*
+ * called when this object is deleted.
+ * free any memory we've allocated.
+ */
+static void firdesign_free(t_firdesign* x)
+{
+    if (x->designing)
+    {   // stop the design, and wait for it to
+        hof_atomic_store(&x->cancel, 1);
+        hof_thread_join(&x->designer);
+    }
+    
+    if (x->poll != 0)
+    {
+        clock_free(x->poll);
+    }
+    
+    free(x->coefs);
+}
+
+// _new ------------------------------------------------------------------------
+/*
+ * called when this object is instantiated.
+ * initialize object members and allocate memory.
+ */
+static void* firdesign_new(t_symbol* selector, int argc, t_atom* argv)
+{
+    UNUSED_PARAM(selector);
+    
+    // make a pointer to this object
+    t_firdesign* x = (t_firdesign*)pd_new(firdesign_class);
+    
+    // nothing to design until a response is asked for, at pd's sample rate
+    // (or the default, if it doesn't know yet)
+    x->array_name  = 0;
+    x->has_spec    = 0;
+    x->sr          = (sys_getsr() > 0.f) ? sys_getsr() : default_sr;
+    x->designing   = 0;
+    x->stale       = 0;
+    x->cancel      = 0;
+    x->coefs       = 0;
+    x->order       = 0;
+    x->ok          = 0;
+    x->poll        = clock_new(x, (t_method)firdesign_poll);
+    
+    memset(&x->spec, 0, sizeof(x->spec));
+    x->spec.method = hof_kaiser;
+    x->spec.type   = hof_lowpass;
+    x->spec.stop   = firdesign_default_stop;
+    x->spec.ripple = firdesign_default_ripple;
+    
+    // make an outlet for "taps", "delay" and "set"
+    x->info = outlet_new(&x->object, 0);
+    
+    // get creation arguments from user if they exist (table name, method)
+    if (argc > 0)
+    {
+        x->array_name = atom_getsymbol(&argv[0]);
+    }
+    
+    if (argc > 1)
+    {
+        firdesign_method(x, atom_getsymbol(&argv[1]));
+    }
+    
+    return (void*)x;
+}
+
+// _dsp ------------------------------------------------------------------------
+/*
+ * called when dsp is turned on.
+ * we don't make any sound, but this is where we hear about the sample rate:
+ * if it has changed, the filter is designed again for the new one (an
+ * anti-aliasing filter stays at the same frequency in Hz.).
+ */
+static void firdesign_dsp(t_firdesign* x, t_signal** sig)
+{
+    UNUSED_PARAM(sig);
+    
+    const t_float sr = sys_getsr();
+    
+    if (sr > 0.f && sr != x->sr)
+    {
+        x->sr = sr;
+        firdesign_design(x);
+    }
+}
+
+// _setup ----------------------------------------------------------------------
+/*
+ * called the first time someone loads this object in the current pd session.
+ * tell pd about this object's "class", including our name, and which methods
+ * and arguments we can handle.
+ */
+void firdesign_tilde_setup(void)
+{
+    // tell pd how to build our class
+    firdesign_class = class_new(gensym("firdesign~"),       // name
+                                (t_newmethod)firdesign_new, // _new
+                                (t_method)firdesign_free,   // _free
+                                sizeof(t_firdesign),        // size
+                                CLASS_DEFAULT,              // flags
+                                A_GIMME,                    // arg types...
+                                0);                         // ...0-terminated
+    
+    // tell pd which methods can be called by users (including dsp)
+    class_addmethod(firdesign_class, (t_method)firdesign_dsp, gensym("dsp"),
+                    0);
+    class_addmethod(firdesign_class, (t_method)firdesign_lowpass,
+                    gensym("lowpass"), A_FLOAT, A_FLOAT, A_DEFFLOAT, 0);
+    class_addmethod(firdesign_class, (t_method)firdesign_highpass,
+                    gensym("highpass"), A_FLOAT, A_FLOAT, A_DEFFLOAT, 0);
+    class_addmethod(firdesign_class, (t_method)firdesign_bandpass,
+                    gensym("bandpass"), A_FLOAT, A_FLOAT, A_FLOAT, A_DEFFLOAT,
+                    0);
+    class_addmethod(firdesign_class, (t_method)firdesign_notch,
+                    gensym("notch"), A_FLOAT, A_FLOAT, A_FLOAT, A_DEFFLOAT, 0);
+    class_addmethod(firdesign_class, (t_method)firdesign_ripple,
+                    gensym("ripple"), A_FLOAT, 0);
+    class_addmethod(firdesign_class, (t_method)firdesign_method,
+                    gensym("method"), A_SYMBOL, 0);
+    class_addmethod(firdesign_class, (t_method)firdesign_set, gensym("set"),
+                    A_SYMBOL, 0);
+}
@@ -0,0 +1,309 @@
+//------------------------------------------------------------------------------
+//  Higher Order Filter Project
+//
+//  firmatrix~.c: finite impulse response filters from every input to every
+//                output, sharing each input's transforms
+//  Copyright (c) 2016 Elliot Patros. All rights reserved.
+//------------------------------------------------------------------------------
+
+// Pd header and constants -----------------------------------------------------
+#include "m_pd.h"
+#include "higher_order_filter.h"
+
+#define firmatrix_max_channels 32 // inputs (and outputs), at most
+
+// pointer to this object's class ----------------------------------------------
+static t_class* firmatrix_class;
+
+// this object's struct --------------------------------------------------------
+typedef struct firmatrix
+{
+    // instance of this object. must always be first
+    t_object object;
+    
+    // state of each inlet value
+    t_float         sample;   // first inlet: audio, not used for control rate
+    
+    // the filter engine (keeps every pair's partitions and input history)
+    hof_convmatrix* filter;
+    
+    // each pair's array, output major (0 if none)
+    t_symbol*       array_names[firmatrix_max_channels *
+                                firmatrix_max_channels];
+    
+    // signal vectors, filled in by _perform
+    t_float*        ins[firmatrix_max_channels];
+    t_float*        outs[firmatrix_max_channels];
+#ifdef HOF_STATS
+    t_outlet*       info;     // outlet for the "stats" message
+#endif
+    
+} t_firmatrix;
+
+// _perform --------------------------------------------------------------------
+/*
+ * called at the start of every block while 'dsp' is on.
+ * borrowing from miller's explanation, we get a pointer (ptr), where ptr[0] is
+ * our function's location in the dsp call list. we return a new pointer, which
+ * points to the next dsp function. meanwhile, arguments that are useful for
+ * processing audio samples are packed after ptr[0], in the order specified in
+ * this object's _dsp function.
+ */
+static t_int* firmatrix_perform(t_int* ptr)
+{
+    // get this object's dsp-related state
+    t_firmatrix* x        = (t_firmatrix*)ptr[1];
+    const t_int  nSamples = (t_int)       ptr[2];
+    const int    nIns     = x->filter->nInputs;
+    const int    nOuts    = x->filter->nOutputs;
+    
+    for (int i = 0; i < nIns; ++i)
+    {
+        x->ins[i] = (t_float*)ptr[3 + i];
+    }
+    
+    for (int o = 0; o < nOuts; ++o)
+    {
+        x->outs[o] = (t_float*)ptr[3 + nIns + o];
+    }
+    
+    // convolve (pd may hand us the same buffer for ins and outs, which the
+    // engine handles)
+    hof_convmatrix_process(x->filter, (const float* const*)x->ins, x->outs,
+                           nSamples);
+    
+    return &ptr[3 + nIns + nOuts];
+}
+
+// update one pair -------------------------------------------------------------
+/*
+ * copy (and transform) the array for one input/output pair. a missing name
+ * (or one that isn't a float array) leaves the pair silent.
+ */
+static void firmatrix_update(t_firmatrix* x, int pair)
+{
+    const int input      = pair % x->filter->nInputs;
+    const int output     = pair / x->filter->nInputs;
+    t_symbol* array_name = x->array_names[pair];
+    t_garray* array;
+    t_word*   coefs;
+    int       order;
+    
+    if (array_name == 0)
+    {   // no filter for this pair
+        hof_convmatrix_set_coefs(x->filter, input, output, 0, 0, 1);
+    }
+    else if ((array = (t_garray*)pd_findbyclass(array_name, garray_class)) == 0)
+    {   // array name doesn't exist
+        pd_error(x, "%s: no such array", array_name->s_name);
+        hof_convmatrix_set_coefs(x->filter, input, output, 0, 0, 1);
+    }
+    else if (garray_getfloatwords(array, &order, &coefs) == 0)
+    {   // array isn't for floats only
+        pd_error(x, "%s: bad array template for firmatrix~",
+                 array_name->s_name);
+        hof_convmatrix_set_coefs(x->filter, input, output, 0, 0, 1);
+    }
+    else if (hof_convmatrix_set_coefs(x->filter, input, output,
+                                      &coefs[0].w_float, order,
+                                      sizeof(t_word) / sizeof(t_float)) == 0)
+    {   // partitions failed to allocate memory
+        pd_error(x, "not enough memory for firmatrix~");
+    }
+}
+
+// _set ------------------------------------------------------------------------
+/*
+ * called when we get the message "set".
+ * takes one array name per input/output pair: the filters from every input
+ * to the first output, then every input to the second output, and so on. a
+ * 0 (or a missing name at the end) means no filter for that pair. arrays are
+ * copied now, so later changes to them are heard after the next "set" (or
+ * when dsp is turned on again).
+ */
+static void firmatrix_set(t_firmatrix* x, t_symbol* s, int argc, t_atom* argv)
+{
+    UNUSED_PARAM(s);
+    
+    const int nPairs = x->filter->nInputs * x->filter->nOutputs;
+    
+    if (argc > nPairs)
+    {
+        pd_error(x, "firmatrix~: %d arrays for %d pairs (extras ignored)",
+                 argc, nPairs);
+    }
+    
+    for (int pair = 0; pair < nPairs; ++pair)
+    {
+        x->array_names[pair] = (pair < argc && argv[pair].a_type == A_SYMBOL) ?
+                               argv[pair].a_w.w_symbol : 0;
+        firmatrix_update(x, pair);
+    }
+}
+
+// clear -----------------------------------------------------------------------
+/*
+ * called when we get the message "clear".
+ * forget the input history (the filters stay).
+ */
+static void firmatrix_clear(t_firmatrix* x)
+{
+    hof_convmatrix_reset(x->filter);
+}
+
+#ifdef HOF_STATS
+// report stats ----------------------------------------------------------------
+/*
+ * called when we get the message "stats" (only when built with HOF_STATS).
+ * sends this object's dsp counters out of the info outlet, or zeros them if
+ * the argument is "reset".
+ */
+static void firmatrix_stats(t_firmatrix* x, t_symbol* arg)
+{
+    stats_message(x->info, &x->filter->stats, arg);
+}
+#endif
+
+// _free -----------------------------------------------------------------------
+/*
+ * called when this object is deleted.
+ * free any memory we've allocated.
+ */
+static void firmatrix_free(t_firmatrix* x)
+{
+    hof_convmatrix_free(x->filter);
+}
+
+// _new ------------------------------------------------------------------------
+/*
+ * called when a this object is instantiated.
+ * initialize object members and allocate memory.
+ * arguments are the number of inputs, the number of outputs (both 1 to
+ * firmatrix_max_channels, default 2) and the partition size (a power of
+ * two, default 256), which is also the latency.
+ */
+static void* firmatrix_new(t_symbol* s, int argc, t_atom* argv)
+{
+    UNUSED_PARAM(s);
+    
+    // setup this object with it's class
+    t_firmatrix* x = (t_firmatrix*)pd_new(firmatrix_class);
+    
+    // setup internal state
+    const int nIns  = (argc > 0) ? (int)atom_getfloat(&argv[0]) : 2;
+    const int nOuts = (argc > 1) ? (int)atom_getfloat(&argv[1]) : 2;
+    const int size  = (argc > 2) ? (int)atom_getfloat(&argv[2]) : 256;
+    
+    x->sample = 0;
+    x->filter = 0;
+    
+    for (int pair = 0; pair < firmatrix_max_channels * firmatrix_max_channels;
+         ++pair)
+    {
+        x->array_names[pair] = 0;
+    }
+    
+    if (nIns < 1 || nIns > firmatrix_max_channels || nOuts < 1 ||
+        nOuts > firmatrix_max_channels)
+    {
+        pd_error(x, "firmatrix~: 1 to %d inputs and outputs",
+                 firmatrix_max_channels);
+        pd_free(&x->object.ob_pd);
+        return 0;
+    }
+    
+    if ((x->filter = hof_convmatrix_new(nIns, nOuts, size)) == 0)
+    {
+        pd_error(x, "firmatrix~: partition size must be a power of two, at "
+                 "least %d (or out of memory)", hof_fir_pad);
+        pd_free(&x->object.ob_pd);
+        return 0;
+    }
+    
+    // setup audio inlets (the first comes with the class)
+    for (int i = 1; i < nIns; ++i)
+    {
+        inlet_new(&x->object, &x->object.ob_pd, gensym("signal"),
+                  gensym("signal"));
+    }
+    
+    // setup audio outlets
+    for (int o = 0; o < nOuts; ++o)
+    {
+        outlet_new(&x->object, gensym("signal"));
+    }
+#ifdef HOF_STATS
+    
+    // setup stats outlet
+    x->info = outlet_new(&x->object, 0);
+#endif
+    
+    return (void*)x;
+}
+
+// _dsp ------------------------------------------------------------------------
+/*
+ * called when dsp is turned on.
+ * tell pd what arguments our _perform function needs, as well as where to find
+ * them. if necessary, any initialization that needs info about pd's dsp state
+ * should happen here to.
+ */
+static void firmatrix_dsp(t_firmatrix* x, t_signal** sig)
+{
+    const int nIns  = x->filter->nInputs;
+    const int nOuts = x->filter->nOutputs;
+    t_int     args[2 + 2 * firmatrix_max_channels];
+    
+    // look the arrays up again, in case they were resized (or deleted). the
+    // engine checksums each pair's partitions, so unchanged ones aren't
+    // transformed again
+    for (int pair = 0; pair < nIns * nOuts; ++pair)
+    {
+        if (x->array_names[pair] != 0)
+        {
+            firmatrix_update(x, pair);
+        }
+    }
+    
+    args[0] = (t_int)x;           // pointer to this object
+    args[1] = (t_int)sig[0]->s_n; // block size (nSamples)
+    
+    for (int v = 0; v < nIns + nOuts; ++v)
+    {   // inlet sample vectors, then outlet sample vectors
+        args[2 + v] = (t_int)sig[v]->s_vec;
+    }
+    
+    dsp_addv(firmatrix_perform, 2 + nIns + nOuts, args);
+}
+
+// _setup ----------------------------------------------------------------------
+/*
+ * called the first time someone loads this object in the current pd session.
+ * tell pd about this object's "class", including our name, and which methods
+ * and arguments we can handle.
+ */
+void firmatrix_tilde_setup(void)
+{
+    // tell pd how to build our class
+    firmatrix_class = class_new(gensym("firmatrix~"),       // name
+                                (t_newmethod)firmatrix_new, // _new
+                                (t_method)firmatrix_free,   // _free
+                                sizeof(t_firmatrix),        // size
+                                CLASS_DEFAULT,              // flags
+                                A_GIMME,                    // arg types list...
+                                0);                         // ...0-terminated
+    
+    // tell pd that our left inlet expects audio
+    CLASS_MAINSIGNALIN(firmatrix_class, t_firmatrix, sample);
+    
+    // tell pd which methods can be called by users (including dsp)
+    class_addmethod(firmatrix_class, (t_method)firmatrix_dsp, gensym("dsp"), 0);
+    class_addmethod(firmatrix_class, (t_method)firmatrix_set, gensym("set"),
+                    A_GIMME, 0);
+    class_addmethod(firmatrix_class, (t_method)firmatrix_clear,
+                    gensym("clear"), 0);
+#ifdef HOF_STATS
+    class_addmethod(firmatrix_class, (t_method)firmatrix_stats,
+                    gensym("stats"), A_DEFSYM, 0);
+#endif
+}
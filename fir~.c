@@ -9,6 +9,8 @@
 #include "m_pd.h"
 #include "higher_order_filter.h"
 
+#define fir_poll_ms 10 // how often we check on a file being opened
+
 // pointer to this object's class ----------------------------------------------
 static t_class* fir_class;
 
@@ -19,13 +21,34 @@ typedef struct fir
     t_object object;
     
     // state of each inlet value
-    t_float  sample; // first inlet: audio, so not used for control rate
+    t_float        sample;     // first inlet: audio, not used for control rate
+    
+    // the filter engine (points to the coefficient array, keeps delay tables
+    // and partitions)
+    hof_convolver* filter;
+    t_symbol*      array_name; // name of the coefficient array (0 if none)
+    hof_irfile*    file;       // or the file the coefficients are in (or 0)
+    t_outlet*      info;       // outlet for "error", "latency", "taps" (and
+                               // "stats")
     
-    // filter coefficients and delay table
-    t_float* table;  // feed forward delay table
-    t_word*  coefs;  // 'B' coefficients from table
-    int      order;  // size of coefficient table
-    t_int    wptr;   // write pointer (for delay tables)
+    // opening a file (see _open), or making the minimum phase version of
+    // the filter (see _minphase), which happens on a thread of its own
+    t_canvas*      canvas;     // the patch, for relative paths
+    hof_thread     loader;     // the thread opening the file
+    t_clock*       poll;       // checks whether it has finished
+    hof_atomic     loaded;     // 1 once it has
+    int            loading;    // 1 while it runs
+    int            stale;      // 1 if "set" came since (the file is dropped)
+    char           path[MAXPDSTRING]; // the file (or what's converted)
+    int            channel;    // which of its channels
+    float*         source;     // or a copy of the coefficients to convert
+    int            source_order; // how many there are
+    int            keep;       // how many to keep
+    int            budget;     // the latency budget to plan for
+    float          trim;       // the tail threshold
+    int            sparse;     // whether to skip zeros
+    hof_irfile*    next_file;  // what it opened (0 if it couldn't)
+    hof_convolver* next;       // and the filter it planned for it
     
 } t_fir;
 
@@ -46,32 +69,177 @@ static t_int* fir_perform(t_int* ptr)
     const t_int nSamples = (t_int)   ptr[3];
     t_fir*      x        = (t_fir*)  ptr[4];
     
-    // zero-out output if there's no coefficient array
-    if (x->coefs == 0)
-    {
-        memset(output, 0, sizeof(t_float) * nSamples);
-        return &ptr[5];
+    // calculate fir (or silence, if there's no coefficient array)
+    hof_convolver_process(x->filter, input, output, nSamples);
+    
+    return &ptr[5];
+}
+
+#ifdef HOF_STATS
+// report stats ----------------------------------------------------------------
+/*
+ * called when we get the message "stats" (only when built with HOF_STATS).
+ * sends this object's dsp counters out of the info outlet, or zeros them if
+ * the argument is "reset".
+ */
+static void fir_stats(t_fir* x, t_symbol* arg)
+{
+    stats_message(x->info, &x->filter->stats, arg);
+}
+#endif
+
+// use an array ---------------------------------------------------------------
+/*
+ * if the table name is valid (exists, has floats, etc), we'll point to its
+ * contents and use them for FIR coefficients in the _perform function.
+ * direct form coefficients are read every block; partitioned ones (see
+ * _latency) are copied now, so edits to them are heard after the next "set"
+ * (which only transforms the partitions that changed, so it stays cheap).
+ * a table's contents move when it's resized, so messages that use the
+ * coefficients call this first, to look the table up again.
+ */
+static void fir_use_array(t_fir* x, t_symbol* array_name)
+{
+    t_garray* array;
+    t_word*   coefs;
+    int       order;
+    
+    if (array_name == 0)
+    {   // array name is empty
+        return;
     }
     
-    // calculate fir: y(n) = sum(x(n - k) * h(k))
-    for (t_int n = 0; n < nSamples; ++n, ++x->wptr)
+    x->array_name = array_name;
+    
+    if ((array = (t_garray*)pd_findbyclass(array_name, garray_class)) == 0)
+    {   // array name doesn't exist
+        pd_error(x, "%s: no such array", array_name->s_name);
+        hof_convolver_set_coefs(x->filter, 0, 0, 1);
+    }
+    else if (garray_getfloatwords(array, &order, &coefs) == 0)
+    {   // array isn't for floats only
+        pd_error(x, "%s: bad array template for fir~", array_name->s_name);
+        hof_convolver_set_coefs(x->filter, 0, 0, 1);
+    }
+    else if (hof_convolver_set_coefs(x->filter, &coefs[0].w_float, order,
+                                     sizeof(t_word) / sizeof(t_float)) == 0)
+    {   // delay line (or partitions) failed to allocate memory
+        pd_error(x, "not enough memory for fir~");
+    }
+    else
+    {   // we're reading the array in _perform from now on
+        garray_usedindsp(array);
+    }
+}
+
+// _precision ------------------------------------------------------------------
+/*
+ * called when we get the message "precision".
+ * "half" or "bfloat" keep the direct form coefficients as 16 bit floats,
+ * which long filters read faster (partitioned ones stay 32 bit). "float" (the
+ * default) keeps them exact. then we send the worst case difference it makes
+ * to any output sample out of the info outlet, as "error".
+ */
+static void fir_precision(t_fir* x, t_symbol* name)
+{
+    hof_precision precision;
+    t_atom        error;
+    
+    if      (name == gensym("float"))  { precision = hof_float32; }
+    else if (name == gensym("half"))   { precision = hof_float16; }
+    else if (name == gensym("bfloat")) { precision = hof_bfloat16; }
+    else
     {
-        x->wptr = (x->wptr < x->order) ? x->wptr : 0;
-        
-        const t_float x_n = input[n];
-        t_float y_n = x->coefs[0].w_float * x_n;
-        
-        for (t_int k = 1; k < x->order; ++k)
-        {
-            const t_int m = x->wptr - k;
-            y_n += x->coefs[k].w_float * x->table[(m < 0) ? x->order + m : m];
-        }
-        
-        output[n] = y_n;
-        x->table[x->wptr] = x_n;
+        pd_error(x, "fir~: precision must be float, half or bfloat");
+        return;
     }
     
-    return &ptr[5];
+    // the error is measured against the table as it is now
+    fir_use_array(x, x->array_name);
+    
+    if (hof_fir_set_precision(x->filter->head, precision) == 0)
+    {   // 16 bit coefficients failed to allocate memory
+        pd_error(x, "not enough memory for fir~");
+        return;
+    }
+    
+    SETFLOAT(&error, (t_float)hof_fir_error(x->filter->head));
+    outlet_anything(x->info, gensym("error"), 1, &error);
+}
+
+// report the plan -------------------------------------------------------------
+/*
+ * sends the latency of the current plan (in samples) out of the info outlet,
+ * as "latency", so it can be compensated for. then the number of taps it
+ * really uses (see _trim and _sparse), as "taps".
+ */
+static void fir_report_plan(t_fir* x)
+{
+    t_atom latency;
+    t_atom taps;
+    
+    SETFLOAT(&latency, (t_float)x->filter->latency);
+    outlet_anything(x->info, gensym("latency"), 1, &latency);
+    SETFLOAT(&taps, (t_float)hof_convolver_taps(x->filter));
+    outlet_anything(x->info, gensym("taps"), 1, &taps);
+}
+
+// _latency --------------------------------------------------------------------
+/*
+ * called when we get the message "latency".
+ * sets the latency budget in samples. we then pick the cheapest way to
+ * convolve that fits it: direct form, partitions of one size, or a direct form
+ * head followed by partitions that grow. a negative budget (the default) means
+ * direct form only. the latency we end up with is reported, and can be less.
+ */
+static void fir_latency(t_fir* x, t_floatarg budget)
+{
+    fir_use_array(x, x->array_name);
+    
+    if (hof_convolver_set_budget(x->filter, (int)budget) == 0)
+    {   // partitions failed to allocate memory (we're direct form now)
+        pd_error(x, "not enough memory for fir~");
+    }
+    
+    fir_report_plan(x);
+}
+
+// _trim -----------------------------------------------------------------------
+/*
+ * called when we get the message "trim".
+ * leaves out the tail of the filter whose energy is 'threshold' db below the
+ * whole filter's (-90, say), looking again whenever it's set. 0 (the
+ * default) keeps every tap.
+ */
+static void fir_trim(t_fir* x, t_floatarg threshold)
+{
+    fir_use_array(x, x->array_name);
+    
+    if (hof_convolver_set_trim(x->filter, threshold) == 0)
+    {   // partitions failed to allocate memory (we're direct form now)
+        pd_error(x, "not enough memory for fir~");
+    }
+    
+    fir_report_plan(x);
+}
+
+// _sparse ---------------------------------------------------------------------
+/*
+ * called when we get the message "sparse".
+ * 1 skips direct form taps that are zero (in blocks), looking for them
+ * whenever the filter is set. taps that become nonzero later aren't heard
+ * until the next "set". 0 (the default) uses every tap.
+ */
+static void fir_sparse(t_fir* x, t_floatarg sparse)
+{
+    fir_use_array(x, x->array_name);
+    
+    if (hof_convolver_set_sparse(x->filter, sparse != 0) == 0)
+    {   // partitions failed to allocate memory (we're direct form now)
+        pd_error(x, "not enough memory for fir~");
+    }
+    
+    fir_report_plan(x);
 }
 
 // _free -----------------------------------------------------------------------
@@ -81,56 +249,227 @@ static t_int* fir_perform(t_int* ptr)
  */
 static void fir_free(t_fir* x)
 {
-    x->coefs = 0;
-    x->order = 0;
+    if (x->loading)
+    {   // wait for the file to finish opening
+        hof_thread_join(&x->loader);
+        hof_convolver_free(x->next);
+        hof_irfile_free(x->next_file);
+        free(x->source);
+    }
     
-    if (x->table != 0)
+    if (x->poll != 0)
     {
-        free(x->table);
-        x->table = 0;
+        clock_free(x->poll);
     }
+    
+    hof_convolver_free(x->filter);
+    hof_irfile_free(x->file);
 }
 
 // _set ------------------------------------------------------------------------
 /*
  * called when we get the message "set".
- * if the table name is valid (exists, has floats, etc), we'll point to its
- * contents and use them for FIR coefficients in the _perform function.
+ * use the array named 'array_name' from now on, instead of any file (or file
+ * still being opened).
  */
 static void fir_set(t_fir* x, t_symbol* array_name)
 {
-    t_garray* array;
+    x->stale = x->loading;
+    fir_use_array(x, array_name);
+    fir_report_plan(x);
+    hof_irfile_free(x->file);
+    x->file = 0;
+}
+
+// _open -----------------------------------------------------------------------
+/*
+ * runs on the loader thread: map the file (or convert the coefficients),
+ * then plan (and transform) the filter for it, which is the slow part.
+ * nothing else touches next_file or next until 'loaded' says we're done.
+ */
+static void* fir_load(void* arg)
+{
+    t_fir*         x      = (t_fir*)arg;
+    hof_irfile*    file   = (x->source == 0) ?
+                            hof_irfile_open(x->path, x->channel) :
+                            hof_irfile_new(x->keep);
     
-    if (array_name == 0)
-    {   // array name is empty
+    if (file != 0 && x->source != 0 &&
+        hof_minimum_phase(x->source, x->source_order, 1, file->samples,
+                          x->keep) == 0)
+    {   // out of memory
+        hof_irfile_free(file);
+        file = 0;
+    }
+    
+    hof_convolver* filter = (file != 0) ? hof_convolver_new() : 0;
+    
+    if (filter != 0 &&
+        (hof_convolver_set_budget(filter, x->budget) == 0 ||
+         hof_convolver_set_trim(filter, x->trim) == 0 ||
+         hof_convolver_set_sparse(filter, x->sparse) == 0 ||
+         hof_convolver_set_coefs(filter, file->coefs, file->order,
+                                 file->stride) == 0))
+    {   // out of memory
+        hof_convolver_free(filter);
+        filter = 0;
+    }
+    
+    x->next_file = file;
+    x->next      = filter;
+    hof_atomic_store(&x->loaded, 1);
+    return 0;
+}
+
+/*
+ * called by our clock while a file is opening. once it's done, the new
+ * filter takes over (its delay tables start out empty), and the old one is
+ * freed here, not in _perform.
+ */
+static void fir_poll(t_fir* x)
+{
+    if (!hof_atomic_load(&x->loaded))
+    {   // not yet
+        clock_delay(x->poll, fir_poll_ms);
         return;
     }
-    else if ((array = (t_garray*)pd_findbyclass(array_name, garray_class)) == 0)
-    {   // array name doesn't exist
-        pd_error(x, "%s: no such array", array_name->s_name);
-        fir_free(x);
+    
+    const int converted = (x->source != 0);
+    
+    hof_thread_join(&x->loader);
+    x->loading = 0;
+    free(x->source);
+    x->source  = 0;
+    
+    if (x->stale || x->next == 0)
+    {
+        if (!x->stale && converted)
+        {
+            pd_error(x, "fir~: %s: not enough memory for minimum phase",
+                     x->path);
+        }
+        else if (!x->stale)
+        {
+            pd_error(x, "fir~: %s: can't open (or not enough memory)",
+                     x->path);
+        }
+    
+        hof_convolver_free(x->next);
+        hof_irfile_free(x->next_file);
         return;
     }
-    else if (garray_getfloatwords(array, &x->order, &x->coefs) == 0)
-    {   // array isn't for floats only
-        pd_error(x, "%s: bad array template for fir~", array_name->s_name);
-        fir_free(x);
+    
+    if ((x->next->budget != x->filter->budget &&
+         hof_convolver_set_budget(x->next, x->filter->budget) == 0) ||
+        (x->next->trim != x->filter->trim &&
+         hof_convolver_set_trim(x->next, x->filter->trim) == 0) ||
+        (x->next->sparse != x->filter->sparse &&
+         hof_convolver_set_sparse(x->next, x->filter->sparse) == 0))
+    {   // "latency" (or "trim", "sparse") came since, and partitions failed
+        // to allocate memory
+        pd_error(x, "not enough memory for fir~");
+    }
+    
+    hof_fir_set_precision(x->next->head, x->filter->head->precision);
+    hof_convolver_free(x->filter);
+    hof_irfile_free(x->file);
+    x->filter     = x->next;
+    x->file       = x->next_file;
+    x->array_name = 0;
+    fir_report_plan(x);
+}
+
+// start the loader thread (see fir_load), and poll until it's done
+static void fir_start(t_fir* x)
+{
+    x->budget    = x->filter->budget;
+    x->trim      = x->filter->trim;
+    x->sparse    = x->filter->sparse;
+    x->stale     = 0;
+    x->next      = 0;
+    x->next_file = 0;
+    hof_atomic_store(&x->loaded, 0);
+    
+    if (!hof_thread_start(&x->loader, fir_load, x))
+    {
+        pd_error(x, "fir~: can't start opening %s", x->path);
+        free(x->source);
+        x->source = 0;
         return;
     }
-    else if (x->table != 0)
-    {   // replace an old table
-        x->table = (t_float*)realloc(x->table, sizeof(t_float) * x->order);
+    
+    x->loading = 1;
+    clock_delay(x->poll, fir_poll_ms);
+}
+
+/*
+ * called when we get the message "open".
+ * use a sound file's channel (0, the first, by default) as coefficients,
+ * without a table: see hof_irfile for the files we can read. the file is
+ * mapped and planned on another thread, and the filter changes over once
+ * that's done (reporting "latency"). until then, the old one keeps playing.
+ */
+static void fir_open(t_fir* x, t_symbol* file, t_floatarg channel)
+{
+    if (x->loading)
+    {
+        pd_error(x, "fir~: still opening %s", x->path);
+        return;
     }
-    else
-    {   // reference a new table for the first time
-        x->table = (t_float*)calloc(x->order, sizeof(t_float));
+    
+    canvas_makefilename(x->canvas, file->s_name, x->path, MAXPDSTRING);
+    x->channel = (int)channel;
+    fir_start(x);
+}
+
+// _minphase -------------------------------------------------------------------
+/*
+ * called when we get the message "minphase".
+ * replace the filter with its minimum phase version (see hof_minimum_phase):
+ * the same magnitude response, without the pre-ringing (and latency) of a
+ * linear phase filter, so it can usually be much shorter. an argument keeps
+ * that many taps (0, the default, keeps them all). like _open, the work
+ * happens in the background; "set" goes back to the table.
+ */
+static void fir_minphase(t_fir* x, t_floatarg keep)
+{
+    const hof_convolver* filter = x->filter;
+    
+    if (x->loading)
+    {
+        pd_error(x, "fir~: still opening %s", x->path);
+        return;
     }
     
-    if (x->table == 0)
-    {   // delay line failed to allocate memory
+    // copy from the table as it is now
+    fir_use_array(x, x->array_name);
+    
+    if (filter->coefs == 0)
+    {
+        pd_error(x, "fir~: no filter to convert");
+        return;
+    }
+    
+    if ((x->source = (float*)malloc(sizeof(float) * filter->order)) == 0)
+    {
         pd_error(x, "not enough memory for fir~");
-        fir_free(x);
+        return;
+    }
+    
+    for (int k = 0; k < filter->order; ++k)
+    {   // copied now: the table can change while we work
+        x->source[k] = filter->coefs[k * filter->stride];
+    }
+    
+    if (x->array_name != 0)
+    {   // for messages (a file's path is there already)
+        strncpy(x->path, x->array_name->s_name, MAXPDSTRING - 1);
+        x->path[MAXPDSTRING - 1] = '\0';
     }
+    
+    x->source_order = filter->order;
+    x->keep         = ((int)keep > 0) ? (int)keep : filter->order;
+    fir_start(x);
 }
 
 // _new ------------------------------------------------------------------------
@@ -145,25 +484,39 @@ static void* fir_new(t_symbol* s, int argc, t_atom* argv)
     // setup this object with it's class
     t_fir* x = (t_fir*)pd_new(fir_class);
     
+    // setup internal state
+    x->sample     = 0;
+    x->array_name = 0;
+    x->file       = 0;
+    x->canvas     = canvas_getcurrent();
+    x->loading    = 0;
+    x->source     = 0;
+    x->poll       = clock_new(x, (t_method)fir_poll);
+    x->filter     = hof_convolver_new();
+    
+    if (x->filter == 0)
+    {
+        pd_error(x, "not enough memory for fir~");
+        pd_free(&x->object.ob_pd);
+        return 0;
+    }
+    
     // setup audio outlet
     outlet_new(&x->object, gensym("signal"));
     
-    // setup internal state
-    x->sample = 0;
-    x->table  = 0;
-    x->coefs  = 0;
-    x->order  = 0;
-    x->wptr   = 0;
+    // setup info outlet
+    x->info = outlet_new(&x->object, 0);
     
-    // parse any creation arguments
+    // parse any creation arguments (array name, then latency budget)
     t_symbol* array_name = (argc > 0) ? atom_getsymbol(&argv[0]) : 0;
-    fir_set(x, array_name);
     
-    if (x->coefs == 0 || x->table == 0)
+    if (argc > 1)
     {
-        fir_free(x);
+        hof_convolver_set_budget(x->filter, (int)atom_getfloat(&argv[1]));
     }
     
+    fir_use_array(x, array_name);
+    
     return (void*)x;
 }
 
@@ -176,6 +529,11 @@ static void* fir_new(t_symbol* s, int argc, t_atom* argv)
  */
 static void fir_dsp (t_fir* x, t_signal** sig)
 {
+    // look the array up again, in case it was resized (or deleted), and plan
+    // again
+    fir_use_array(x, x->array_name);
+    fir_report_plan(x);
+    
     dsp_add(fir_perform,   // this class' perform method
             4,             // number of perform method parameters
             sig[0]->s_vec, // inlet sample vector
@@ -192,6 +550,15 @@ static void fir_dsp (t_fir* x, t_signal** sig)
  */
 void fir_tilde_setup(void)
 {
+    // keep partitioned filters' spectra on disk, so loading the same filter
+    // again (in this session or the next) maps them instead of transforming
+    hof_cache_set_dir(hof_cache_path());
+    
+    // pick this machine's fastest kernel and measure what partitions cost,
+    // before any filter plays (kept in a file, so it's only slow once per
+    // machine, and never during dsp)
+    hof_tune(hof_tune_path());
+    
     // tell pd how to build our class
     fir_class = class_new(gensym("fir~"),       // name
                           (t_newmethod)fir_new, // _new
@@ -207,4 +574,19 @@ void fir_tilde_setup(void)
     // tell pd which methods can be called by users (including dsp)
     class_addmethod(fir_class, (t_method)fir_dsp, gensym("dsp"), 0);
     class_addmethod(fir_class, (t_method)fir_set, gensym("set"), A_SYMBOL, 0);
+    class_addmethod(fir_class, (t_method)fir_open, gensym("open"), A_SYMBOL,
+                    A_DEFFLOAT, 0);
+    class_addmethod(fir_class, (t_method)fir_minphase, gensym("minphase"),
+                    A_DEFFLOAT, 0);
+    class_addmethod(fir_class, (t_method)fir_precision, gensym("precision"),
+                    A_SYMBOL, 0);
+    class_addmethod(fir_class, (t_method)fir_latency, gensym("latency"),
+                    A_FLOAT, 0);
+    class_addmethod(fir_class, (t_method)fir_trim, gensym("trim"), A_FLOAT,
+                    0);
+    class_addmethod(fir_class, (t_method)fir_sparse, gensym("sparse"),
+                    A_FLOAT, 0);
+#ifdef HOF_STATS
+    class_addmethod(fir_class, (t_method)fir_stats, gensym("stats"), A_DEFSYM, 0);
+#endif
 }
@@ -0,0 +1,61 @@
+//------------------------------------------------------------------------------
+//  Higher Order Filter Project
+//
+//  higher_order_filter.c: every object in this project, as one library
+//  Copyright (c) 2016 Elliot Patros. All rights reserved.
+//------------------------------------------------------------------------------
+
+// Pd header and constants -----------------------------------------------------
+#include "m_pd.h"
+#include "higher_order_filter.h"
+
+/*
+ * built together with every object's source, this makes a single binary that
+ * pd loads once (with "pd -lib higher_order_filter", or [declare -lib
+ * higher_order_filter] in a patch). pd then knows about every class without
+ * searching its path for each object, and they all share one copy of libhof.
+ */
+
+// the objects in this project -------------------------------------------------
+void allpass_tilde_setup(void);
+void bandpass_tilde_setup(void);
+void cascade_tilde_setup(void);
+void fir_tilde_setup(void);
+void firdesign_tilde_setup(void);
+void firmatrix_tilde_setup(void);
+void highpass_tilde_setup(void);
+void highshelf_tilde_setup(void);
+void lms_tilde_setup(void);
+void lowpass_tilde_setup(void);
+void lowshelf_tilde_setup(void);
+void multifilter_tilde_setup(void);
+void notch_tilde_setup(void);
+void pbfdaf_tilde_setup(void);
+void peak_tilde_setup(void);
+
+// _setup ----------------------------------------------------------------------
+/*
+ * called when pd loads the library.
+ * tell pd about every class.
+ */
+void higher_order_filter_setup(void)
+{
+    allpass_tilde_setup();
+    bandpass_tilde_setup();
+    cascade_tilde_setup();
+    fir_tilde_setup();
+    firdesign_tilde_setup();
+    firmatrix_tilde_setup();
+    highpass_tilde_setup();
+    highshelf_tilde_setup();
+    lms_tilde_setup();
+    lowpass_tilde_setup();
+    lowshelf_tilde_setup();
+    multifilter_tilde_setup();
+    notch_tilde_setup();
+    pbfdaf_tilde_setup();
+    peak_tilde_setup();
+
+    post("higher order filter library loaded (fir~ kernel: %s)",
+         hof_fir_kernel());
+}
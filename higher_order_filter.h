@@ -8,61 +8,100 @@
 #ifndef _higher_order_filter_h
 #define _higher_order_filter_h
 
-// obligatory Pure Data header (plus any others we need) -----------------------
-#include <math.h>   // for tan and some constants
-#include <float.h>  // for FLT_EPSILON
-#include <string.h> // for memset
-#include <stdlib.h> // for *alloc family
+// the filter engines (plus any others headers we need) ------------------------
+#include "hof.h"      // libhof, where all the dsp math lives
+#include "hof_util.h" // constants, clipping and conversions
 
 // defines ---------------------------------------------------------------------
 #define UNUSED_PARAM(expr) do {(void)(expr); } while (0)
 
-// constants -------------------------------------------------------------------
-static const t_float default_Q = M_SQRT1_2;
-static const t_float default_freq = 1000.f;
-static const t_float default_dB = 0.f;
-static const t_float min_freq = FLT_EPSILON;
-static const t_float max_freq_ratio = 0.5f - FLT_EPSILON;
-static const t_float min_Q = FLT_EPSILON;
-static const t_float max_Q = 1000.f - FLT_EPSILON;
-static const t_float max_order = 65536.f;
-
-// comparisons -----------------------------------------------------------------
+// conversions -----------------------------------------------------------------
 static inline
-t_float clip_float(const t_float val, const t_float min, const t_float max)
+double ms_to_samples(const t_float ms, const t_float sr)
 {
-    return (val < min) ? min : (fminf(val, max));
+    return ms * sr * 0.001;
 }
 
+// latency ---------------------------------------------------------------------
+/*
+ * sends a filter's latency (samples) out of 'info' as "latency", unless it's
+ * the same as the one sent last time ('reported').
+ */
 static inline
-t_float clip_freq_ratio(const t_float freq, const t_float sr)
+void latency_message(t_outlet* info, const int latency, int* reported)
 {
-    return clip_float(freq / sr, min_freq, sr * max_freq_ratio);
-}
+    t_atom value;
 
-static inline
-t_float clip_Q(const t_float Q)
-{
-    return clip_float(Q, min_Q, max_Q);
+    if (latency != *reported)
+    {
+        *reported = latency;
+        SETFLOAT(&value, (t_float)latency);
+        outlet_anything(info, gensym("latency"), 1, &value);
+    }
 }
 
+#define latency_poll_ms 10 // how often we check on a posted change
+
+/*
+ * called by a biquad object's clock after it posts a multirate or kernel
+ * change, which the filter only takes at the start of its next block. once it
+ * has, the new latency is sent; until then the clock is set again.
+ */
 static inline
-t_int clip_order(const t_int order)
+void latency_poll(t_clock* poll, hof_biquad* f, t_outlet* info, int* reported)
 {
-    return lrintf(clip_float(order, 1.f, max_order));
+    if (hof_biquad_posted(f))
+    {   // not yet
+        clock_delay(poll, latency_poll_ms);
+        return;
+    }
+
+    latency_message(info, hof_biquad_latency(f), reported);
 }
 
-// conversions -----------------------------------------------------------------
+// instrumentation -------------------------------------------------------------
+#ifdef HOF_STATS
+/*
+ * sends a counter out of 'info' as two floats, high and low, where the count
+ * is high * 2^24 + low. a float only counts exactly to 2^24 (six minutes of
+ * samples at 44.1 kHz.), and the counters go well past that.
+ */
 static inline
-t_float dB_to_gain(const t_float dB)
+void counter_message(t_outlet* info, const char* name, unsigned long count)
 {
-    return clip_float(powf(10.f, dB * 0.05f), 0.f, FLT_MAX);
+    t_atom value[2];
+
+    SETFLOAT(&value[0], (t_float)(count >> 24));
+    SETFLOAT(&value[1], (t_float)(count & 0xffffff));
+    outlet_anything(info, gensym(name), 2, value);
 }
 
+/*
+ * answers the message "stats" for any object: sends its engine's counters out
+ * of 'info' as "blocks", "samples", "ns_mean" (per block), "ns_max",
+ * "updates" and "denormals" messages (the counts split as above), or zeros
+ * them after "stats reset".
+ */
 static inline
-t_float gain_to_dB(const t_float gain)
+void stats_message(t_outlet* info, hof_stats* s, const t_symbol* arg)
 {
-    return clip_float(20.f * log10f(gain), FLT_MIN, FLT_MAX);
+    t_atom value;
+
+    if (arg == gensym("reset"))
+    {
+        hof_stats_reset(s);
+        return;
+    }
+
+    counter_message(info, "blocks", s->nBlocks);
+    counter_message(info, "samples", s->nSamples);
+    SETFLOAT(&value, (s->nBlocks > 0) ? s->ns_total / s->nBlocks : 0.);
+    outlet_anything(info, gensym("ns_mean"), 1, &value);
+    SETFLOAT(&value, s->ns_max);
+    outlet_anything(info, gensym("ns_max"), 1, &value);
+    counter_message(info, "updates", s->nUpdates);
+    counter_message(info, "denormals", s->nDenormals);
 }
+#endif
 
 #endif // _higher_order_filter_h defined
@@ -0,0 +1,969 @@
+//------------------------------------------------------------------------------
+//  Higher Order Filter Project
+//
+//  hof.h: the filter engines behind the pd objects, usable without pd
+//  Copyright (c) 2016 Elliot Patros. All rights reserved.
+//------------------------------------------------------------------------------
+
+#ifndef _hof_h
+#define _hof_h
+
+/*
+ * libhof is the math from this project's pd objects, with plain float
+ * buffers in and out. the objects are thin wrappers around it, so a host that
+ * links libhof gets exactly the same output as pd does.
+ *
+ * every engine follows the same pattern:
+ *   hof_<engine>_new()     allocate (returns 0 if out of memory)
+ *   hof_<engine>_set...()  change parameters (from the same thread as process)
+ *   hof_<engine>_post()    change parameters (from any one other thread)
+ *   hof_<engine>_process() filter nChannels buffers of nSamples each
+ *   hof_<engine>_free()    release everything
+ *
+ * functions that can fail return 1 on success and 0 on failure.
+ */
+
+#include <stddef.h> // for size_t
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// instrumentation =============================================================
+
+/*
+ * built with HOF_STATS defined, every engine keeps these counters about its
+ * own _process calls. without it they (and the time they take) don't exist.
+ */
+#ifdef HOF_STATS
+typedef struct hof_stats
+{
+    unsigned long nBlocks;    // number of calls to _process
+    unsigned long nSamples;   // samples processed (per channel)
+    double        ns_total;   // time spent in _process (ns.)
+    double        ns_max;     // longest single call to _process (ns.)
+    unsigned long nUpdates;   // number of coefficient updates
+    unsigned long nDenormals; // calls whose output had denormal samples
+
+} hof_stats;
+
+// zero every counter
+void hof_stats_reset(hof_stats* s);
+#endif
+
+// second-order filters ========================================================
+
+// filter types (one per pd object) --------------------------------------------
+typedef enum hof_type
+{
+    hof_lowpass,
+    hof_highpass,
+    hof_bandpass,
+    hof_notch,
+    hof_allpass,
+    hof_peak,
+    hof_lowshelf,
+    hof_highshelf
+
+} hof_type;
+
+// filter parameters -----------------------------------------------------------
+typedef enum hof_param
+{
+    hof_Q,    // filter Q (arbitrary scalar, unused by the shelves)
+    hof_dB,   // filter gain (dB., used by peak and the shelves)
+    hof_freq, // filter cutoff frequency (Hz.)
+    hof_nParams
+
+} hof_param;
+
+// kernels ---------------------------------------------------------------------
+/*
+ * the same filters, computed two ways. direct form 1 is the default. the
+ * state variable filter (a trapezoidal, "topology preserving" one) keeps its
+ * state in integrators instead of past samples, so its coefficients can
+ * change on any sample, as fast as they like, without blowing up; it also
+ * stays accurate at low cutoffs. its coefficients are also cheaper to make.
+ */
+typedef enum hof_kernel
+{
+    hof_df1,
+    hof_svf
+
+} hof_kernel;
+
+// scheduled parameter changes -------------------------------------------------
+/*
+ * parameter changes can be scheduled some number of samples in the future.
+ * _process splits its buffers at those samples, so changes are sample
+ * accurate no matter how large the buffers are. the schedule's clock counts
+ * samples from the first call to _process.
+ */
+#define hof_max_scheduled 64
+
+typedef struct hof_event
+{
+    double    time;  // when to apply the change (samples)
+    hof_param param; // which parameter to change
+    float     value; // the parameter's new value
+
+} hof_event;
+
+typedef struct hof_schedule
+{
+    hof_event event[hof_max_scheduled]; // pending changes, sorted by time
+    int       size;                     // number of pending changes
+    double    clock;                    // time of the next sample processed
+
+} hof_schedule;
+
+// parameter changes from another thread ---------------------------------------
+/*
+ * _post hands parameter changes to the thread that calls _process, without
+ * locks. _process picks them up at the start of its next buffer, so it never
+ * sees half of a change. immediate changes to the same parameter replace each
+ * other (only the newest matters), so they can't overflow. delayed changes
+ * wait in a queue, which is safe for one posting thread at a time, and are
+ * refused once they'd overflow the schedule (counting the changes it held at
+ * the start of the last buffer).
+ */
+#define hof_max_posted hof_max_scheduled // must be a power of two
+
+typedef volatile int hof_atomic; // only used through hof_atomic_* (hof_util.h)
+
+typedef struct hof_mailbox
+{
+    hof_atomic changed;               // bit (1 << param) for each new value
+    hof_atomic value[hof_nParams];    // newest value of each parameter (bits)
+    hof_event  event[hof_max_posted]; // delayed changes (time is the delay)
+    hof_atomic write;                 // events posted (only the poster writes)
+    hof_atomic read;                  // events taken (only _process writes)
+    hof_atomic scheduled;             // schedule size (only _process writes)
+    hof_atomic multirate;             // 1 + the newest multirate (0 if none)
+    hof_atomic kernel;                // 1 + the newest kernel (0 if none)
+
+} hof_mailbox;
+
+// one channel's delay tables --------------------------------------------------
+typedef struct hof_biquad_state
+{
+    float f_feed[2]; // feedforward delay
+    float b_feed[2]; // feedback delay
+    int   wptr;      // write pointer (for delay tables)
+
+} hof_biquad_state;
+
+// one channel's integrators (for the state variable kernel)
+typedef struct hof_svf_state
+{
+    float ic1eq; // first integrator
+    float ic2eq; // second integrator
+
+} hof_svf_state;
+
+// lower sample rates ----------------------------------------------------------
+/*
+ * a cutoff far below nyquist puts the poles so close to z = 1 that a 32 bit
+ * recursion can't place them accurately (a 20 Hz. highpass at 192 kHz., say).
+ * in multirate mode, the band the filter changes is split off by halving the
+ * rate (with linear phase halfband filters) as many times as that band
+ * allows, filtered there, and brought back up, while the rest of the signal
+ * goes around, delayed to line up:
+ *
+ *     out = high * in (delayed) + up(filter(down(in)) - high * down(in))
+ *
+ * where 'high' is the filter's response far above its cutoff (0 for a
+ * lowpass, 1 for a highpass, the gain for a highshelf). the split is only
+ * clean where the filter is close to 'high', so the number of stages is
+ * chosen to balance that against the recursion's rounding error; bandpass,
+ * notch, peak and allpass filters (whose skirts fall slowly) split less
+ * often than the others.
+ *
+ * the most stages are chosen when multirate mode is turned on (and when the
+ * sample rate changes, or the filter is reset), and they set the latency.
+ * after that, the filter uses as many of them as suit the cutoff, with the
+ * input to fewer stages delayed so that every path has the same latency.
+ * when the cutoff moves far enough to change paths, the new one warms up
+ * beside the old one and then fades in, so nothing is cleared mid-stream.
+ */
+#define hof_halfband_taps  19   // length of each halfband filter
+#define hof_max_stages     8    // most times the rate is halved
+#define hof_multirate_size 8192 // delay line (more than the longest latency)
+#define hof_multirate_fade 2048 // samples to fade between paths
+
+typedef struct hof_halfband_state
+{
+    float in[2 * hof_halfband_taps];            // input, at the higher rate
+    float out[2 * (hof_halfband_taps / 2 + 1)]; // filtered, at the lower rate
+    int   wIn;                                  // next input
+    int   wOut;                                 // next filtered
+    int   phase;                                // 1 on samples kept (of 2)
+
+} hof_halfband_state;
+
+// one channel, with room for two paths (the one playing, and the one fading)
+typedef struct hof_multirate_state
+{
+    hof_halfband_state stage[2][hof_max_stages]; // each halving of the rate
+    hof_biquad_state   low[2];                    // the filter, at the lowest
+    float              delay[hof_multirate_size]; // the input, going around
+    int                wptr;                      // write pointer (for delay)
+
+} hof_multirate_state;
+
+// one path's coefficients
+typedef struct hof_multirate_path
+{
+    int   nStages; // times the rate is halved (or 0)
+    float high;    // response far above the cutoff
+    float b[3];    // 'B' at the lowest rate, less high
+    float a[2];    // 'A' at the lowest rate
+
+} hof_multirate_path;
+
+// second-order filter ---------------------------------------------------------
+typedef struct hof_biquad
+{
+    hof_type          type;              // which filter this is
+    float             sr;                // sample rate (Hz.)
+    float             param[hof_nParams]; // Q, dB and freq
+    float             b_coef[3];         // 'B' coefficients (B0, B1, B2)
+    float             a_coef[2];         // 'A' coefficients (A1, A2)
+    int               nChannels;         // number of channels filtered
+    hof_biquad_state* state;             // one set of delay tables per channel
+    hof_kernel        kernel;            // direct form 1, or state variable
+    float             svf_coef[3];       // state variable 'a' (a1, a2, a3)
+    float             svf_mix[3];        // input, band and low, to output
+    hof_svf_state*    svf;               // one set of integrators per channel
+    int               multirate;         // 1 to filter low cutoffs slower
+    int               maxStages;         // most times the rate is halved
+    int               restage;           // 1 to choose maxStages afresh
+    hof_multirate_path path[2];          // the path playing, and the last one
+    int               active;            // which path is playing
+    int               fade;              // samples into a fade (see above)
+    hof_multirate_state* multi;          // one per channel (0 if not multirate)
+    hof_schedule      schedule;          // parameter changes yet to happen
+    hof_mailbox       mailbox;           // changes posted by another thread
+#ifdef HOF_STATS
+    hof_stats         stats;             // counters (see hof_stats)
+#endif
+
+} hof_biquad;
+
+hof_biquad* hof_biquad_new(hof_type type, int nChannels, float sr);
+void hof_biquad_free(hof_biquad* f);
+
+// change a parameter now, or 'delay' samples from now
+void hof_biquad_set(hof_biquad* f, hof_param param, float value);
+int  hof_biquad_schedule(hof_biquad* f, hof_param param, float value,
+                         double delay);
+
+// change a parameter from another thread (returns 0 if the schedule is full)
+int  hof_biquad_post(hof_biquad* f, hof_param param, float value,
+                     double delay);
+
+// change the sample rate (coefficients are updated)
+void hof_biquad_set_sr(hof_biquad* f, float sr);
+
+/*
+ * turn multirate mode on or off (see above). the most stages (and so the
+ * latency) are chosen now, and again whenever the sample rate changes or the
+ * filter is reset. returns 0 if out of memory. the delay lines are kept when
+ * it's turned off, until _free.
+ */
+int hof_biquad_set_multirate(hof_biquad* f, int multirate);
+
+/*
+ * the same from another thread: the delay lines are allocated here, and the
+ * mode changes at the start of the next _process. returns 0 if out of memory.
+ */
+int hof_biquad_post_multirate(hof_biquad* f, int multirate);
+
+
+// the delay multirate mode adds (samples, 0 if it's off or not needed)
+int hof_biquad_latency(const hof_biquad* f);
+
+/*
+ * compute with direct form 1 or the state variable filter (see hof_kernel).
+ * multirate mode only applies to direct form 1, which is the one that needs
+ * it. the delay tables are cleared when the kernel changes.
+ */
+void hof_biquad_set_kernel(hof_biquad* f, hof_kernel kernel);
+
+// the same from another thread (taken at the start of the next _process)
+void hof_biquad_post_kernel(hof_biquad* f, hof_kernel kernel);
+
+// 1 while a posted multirate or kernel change hasn't been taken yet
+int hof_biquad_posted(hof_biquad* f);
+
+// clear every channel's delay tables
+void hof_biquad_reset(hof_biquad* f);
+
+// recalculate coefficients from the current parameters
+void hof_biquad_update(hof_biquad* f);
+
+// B and A coefficients of any type, from Q, dB and freq (see hof_param)
+void hof_biquad_coefs(hof_type type, const float* param, float sr, float* b,
+                      float* a);
+
+/*
+ * the state variable filter's coefficients for any type: 'a' (a1, a2, a3)
+ * runs the integrators, and 'mix' weighs the input, band and low outputs
+ * into the type's response (the same response as hof_biquad_coefs).
+ */
+void hof_svf_coefs(hof_type type, const float* param, float sr, float* a,
+                   float* mix);
+
+// filter in[c] into out[c] for every channel (in and out may be the same)
+void hof_biquad_process(hof_biquad* f, const float* const* in,
+                        float* const* out, int nSamples);
+
+/*
+ * the same, with a cutoff (Hz.) for every sample in 'freq' (which mustn't
+ * be the same memory as any 'out'). this always uses the state variable
+ * kernel, whatever f->kernel is, and hof_freq is ignored.
+ */
+void hof_biquad_process_freq(hof_biquad* f, const float* const* in,
+                             float* const* out, const float* freq,
+                             int nSamples);
+
+/*
+ * the lowpass, highpass, bandpass and notch responses of one channel at
+ * once (out[hof_lowpass] to out[hof_notch]), from one state variable
+ * recursion. the filter's type is ignored; its kernel must be hof_svf.
+ */
+void hof_biquad_process_multi(hof_biquad* f, const float* in,
+                              float* const* out, int nSamples);
+
+// second-order cascade --------------------------------------------------------
+/*
+ * any number of second-order sections, one after another, with the same
+ * coefficients as hof_biquad (B0, B1, B2, then A1, A2). sections are set
+ * all at once, not from parameters, so nothing is scheduled.
+ */
+typedef struct hof_cascade
+{
+    int               nSections; // number of sections (0 is a wire)
+    int               nChannels; // number of channels filtered
+    float*            b_coef;    // 'B' coefficients (3 per section)
+    float*            a_coef;    // 'A' coefficients (2 per section)
+    hof_biquad_state* state;     // delay tables (nSections per channel)
+#ifdef HOF_STATS
+    hof_stats         stats;     // counters (see hof_stats)
+#endif
+
+} hof_cascade;
+
+hof_cascade* hof_cascade_new(int nChannels);
+void hof_cascade_free(hof_cascade* c);
+
+/*
+ * set every section from 5 coefficients each (B0 B1 B2 A1 A2). delay tables
+ * are cleared only if the number of sections changes. returns 0 if out of
+ * memory.
+ */
+int hof_cascade_set_coefs(hof_cascade* c, const float* coefs, int nSections);
+
+/*
+ * set every section to a peak filter, from Q, dB and freq each (see
+ * hof_param), then an overall gain (dB), like hof_fit_peaks gives.
+ */
+int hof_cascade_set_peaks(hof_cascade* c, const float* param, int nSections,
+                          float sr);
+
+// clear every channel's delay tables
+void hof_cascade_reset(hof_cascade* c);
+
+// filter in[c] into out[c] for every channel (in and out may be the same)
+void hof_cascade_process(hof_cascade* c, const float* const* in,
+                         float* const* out, int nSamples);
+
+// finite impulse response filter ==============================================
+
+/*
+ * coefficients are read from the caller's memory, 'stride' floats apart (so pd
+ * arrays can be used without copying). they're copied into a packed buffer at
+ * the start of every _process, so changes to that memory are heard right
+ * away. the caller keeps it alive until the coefficients are replaced or the
+ * filter is freed.
+ */
+#define hof_fir_pad 32 // packed lengths are a multiple of this (floats)
+
+/*
+ * long filters can keep their packed coefficients as 16 bit floats, which
+ * halves the memory they stream through for every sample. the sums are still
+ * 32 bit floats. half has more precision, bfloat more range.
+ */
+typedef enum hof_precision
+{
+    hof_float32,  // ieee single (exact)
+    hof_float16,  // ieee half: 11 bit mantissa, +-65504
+    hof_bfloat16  // bfloat16: 8 bit mantissa, the same range as float
+
+} hof_precision;
+
+typedef struct hof_fir
+{
+    const float*    coefs;     // 'B' coefficients (not owned)
+    int             stride;    // distance between coefficients (floats)
+    int             order;     // number of coefficients
+    int             length;    // order (+3 if 16 bit), rounded to hof_fir_pad
+    int             nChannels; // number of channels filtered
+    hof_precision   precision; // how packed coefficients are stored
+    float*          packed;    // coefficients, reversed and zero padded
+    unsigned short* packed16;  // the same, as 16 bit floats (or 0)
+    float*          rounded;   // the same, rounded to 16 bits (or 0)
+    int             repack;    // 1 if packed16 and rounded are out of date
+    float*          table;     // delay tables (2 * length per channel)
+    int             wptr;      // write pointer (shared by every channel)
+    int             sparse;    // 1 to skip blocks of zero taps
+    int*            runs;      // the taps used: first packed float, length
+    int             nRuns;     // number of runs (0 if every tap is used)
+#ifdef HOF_STATS
+    hof_stats       stats;     // counters (see hof_stats)
+#endif
+
+} hof_fir;
+
+hof_fir* hof_fir_new(int nChannels);
+void hof_fir_free(hof_fir* f);
+
+// point to new coefficients (coefs == 0 clears them, and output is silent)
+int hof_fir_set_coefs(hof_fir* f, const float* coefs, int order, int stride);
+
+// store coefficients as 32 or 16 bit floats (returns 0 if out of memory)
+int hof_fir_set_precision(hof_fir* f, hof_precision precision);
+
+/*
+ * the largest difference the current precision can make to any output sample
+ * (compared to 32 bit coefficients), for input between -1 and 1. this is
+ * sum(|h(k) - rounded h(k)|).
+ */
+double hof_fir_error(const hof_fir* f);
+
+/*
+ * sparse filters (early reflections, say) are mostly zeros. with sparse on,
+ * the taps are looked at whenever coefficients are set, and hof_fir_pad tap
+ * blocks that are all zero are skipped from then on (if there are enough of
+ * them to be worth it, and only at 32 bits). so, unlike other changes, taps
+ * that become nonzero later aren't heard until coefficients are set again.
+ */
+void hof_fir_set_sparse(hof_fir* f, int sparse);
+
+// the number of taps multiplied for each sample (whole blocks, if sparse)
+int hof_fir_taps(const hof_fir* f);
+
+// clear every channel's delay table
+void hof_fir_reset(hof_fir* f);
+
+// name of the kernel chosen for this cpu ("avx512", "avx2", "sse2" or "c")
+const char* hof_fir_kernel(void);
+
+// use the named kernel instead (returns 0 if this cpu can't run it)
+int hof_fir_set_kernel(const char* name);
+
+// filter in[c] into out[c] for every channel (in and out may be the same)
+void hof_fir_process(hof_fir* f, const float* const* in,
+                     float* const* out, int nSamples);
+
+// fast fourier transforms =====================================================
+
+/*
+ * real ffts, for the engines that convolve (or adapt) in the frequency domain.
+ * a spectrum of a size n transform is n floats: the real parts of bins 0 to
+ * n/2 - 1, then their imaginary parts, except that the imaginary part of bin
+ * 0 (always 0) is replaced by the real part of bin n/2 (nyquist).
+ *
+ * an hof_fft has scratch memory, so two threads can't share one.
+ */
+typedef struct hof_fft
+{
+    int    size;    // transform size (a power of two, 16 or more)
+    int*   bitrev;  // bit reversed indices (size / 2)
+    float* twiddle; // complex twiddles for the size / 2 complex fft
+    float* rotate;  // complex twiddles that untangle the real spectrum
+    float* scratch; // size floats
+
+} hof_fft;
+
+// returns 0 if size isn't a power of two, 16 or more (or out of memory)
+hof_fft* hof_fft_new(int size);
+void hof_fft_free(hof_fft* f);
+
+// size samples into a spectrum (unscaled)
+void hof_fft_forward(hof_fft* f, const float* in, float* out);
+
+// a spectrum back into size samples (scaled, so forward then inverse is exact)
+void hof_fft_inverse(hof_fft* f, const float* in, float* out);
+
+// acc += x * h, bin by bin (every spectrum of the same size)
+void hof_spectrum_mac(float* acc, const float* x, const float* h, int size);
+
+// acc += conj(x) * h, bin by bin
+void hof_spectrum_mac_conj(float* acc, const float* x, const float* h,
+                           int size);
+
+// partitioned convolution =====================================================
+
+/*
+ * convolution with long filters, in the frequency domain. the coefficients
+ * are cut into partitions of 'size' samples (a power of two, hof_fir_pad or
+ * more), each transformed once, and the input is transformed once per
+ * partition's worth of samples. output is 'size' samples late.
+ *
+ * unlike hof_fir, the coefficients are copied (and transformed) by
+ * _set_coefs, so later changes to the caller's memory aren't heard until it's
+ * called again.
+ */
+typedef struct hof_conv
+{
+    int       size;     // partition size (the fft is twice this)
+    int       nParts;   // number of partitions
+    hof_fft*  fft;      // transform of size 2 * size
+    float*    parts;    // each partition's spectrum (nParts * 2 * size)
+    float*    fdl;      // recent input spectra (nParts * 2 * size)
+    int       slot;     // newest spectrum in fdl (older ones follow)
+    float*    input;    // last 2 * size input samples
+    float*    spectrum; // output spectrum (2 * size)
+    float*    output;   // its inverse: the second half is being played
+    int       pos;      // samples into the current partition
+    void*     mapping;  // parts' cache file, if they were mapped from one
+    unsigned long long* sums; // each partition's checksum (or 0 if unknown)
+#ifdef HOF_STATS
+    hof_stats stats;    // counters (see hof_stats)
+#endif
+
+} hof_conv;
+
+// returns 0 if size isn't a power of two, hof_fir_pad or more
+hof_conv* hof_conv_new(int size);
+void hof_conv_free(hof_conv* c);
+
+// copy and transform 'order' coefficients (coefs == 0 gives silence). only
+// partitions whose coefficients changed since the last call are transformed
+int hof_conv_set_coefs(hof_conv* c, const float* coefs, int order, int stride);
+
+// clear the input history
+void hof_conv_reset(hof_conv* c);
+
+// convolve one channel (in and out may be the same)
+void hof_conv_process(hof_conv* c, const float* in, float* out, int nSamples);
+
+// spectrum cache ==============================================================
+
+/*
+ * transforming a long filter's partitions takes a while, and a session can
+ * load hundreds of them. with a cache directory set, hof_conv keeps each
+ * filter's spectra there, keyed by a hash of the coefficients, their number
+ * and the partition size, and later maps the file back into memory instead
+ * of transforming again (the pages are shared by every process that maps
+ * them). filters shorter than hof_cache_min taps are quicker to transform.
+ * nothing is ever deleted from the directory; it can be emptied at any time.
+ */
+#define hof_cache_min 4096 // taps
+
+// keep spectra in 'dir', creating it if needed (0 or "" turns the cache off)
+int hof_cache_set_dir(const char* dir);
+
+/*
+ * where spectra are kept: $HOF_CACHE, or .hof_cache in the home directory.
+ * HOF_CACHE set to nothing turns the cache off.
+ */
+const char* hof_cache_path(void);
+
+// 64 bit fnv-1a over the coefficients' bits (hof_conv's keys hash each
+// partition's, then those hashes)
+unsigned long long hof_cache_hash(const float* coefs, int order, int stride);
+
+/*
+ * map the spectra stored under a key, read only. returns 0 if there aren't
+ * any, they don't match the checksum stored with them (so the caller
+ * transforms instead), or the cache is off; otherwise pass 'mapping' to
+ * hof_cache_unmap when they're no longer needed.
+ */
+float* hof_cache_map(unsigned long long hash, int order, int size, int nParts,
+                     void** mapping);
+void hof_cache_unmap(void* mapping);
+
+// store spectra under a key (quietly does nothing if it can't)
+void hof_cache_store(unsigned long long hash, int order, int size, int nParts,
+                     const float* parts);
+
+// impulse response files ======================================================
+
+/*
+ * one channel of a sound file, as coefficients for hof_fir, hof_conv or
+ * hof_convolver: a wav (16, 24 or 32 bit integer, or 32 bit float), or a
+ * file of 32 bit floats with no header (one channel). the file is mapped
+ * into memory, and 32 bit floats are used right where they are ('stride'
+ * floats apart, one per channel); integers are converted, like pd's
+ * soundfiler, into memory of their own. either way, the coefficients live
+ * until hof_irfile_free.
+ */
+typedef struct hof_irfile
+{
+    const float* coefs;   // the channel's first coefficient
+    int          order;   // number of coefficients
+    int          stride;  // distance between coefficients (floats)
+    float        sr;      // sample rate (Hz., 0 for raw files)
+    const void*  map;     // the whole file
+    size_t       mapSize; // its size (bytes)
+    float*       samples; // converted coefficients (or 0)
+
+} hof_irfile;
+
+// open one channel (counting from 0) of a file (returns 0 if it can't)
+hof_irfile* hof_irfile_open(const char* path, int channel);
+
+// 'order' coefficients of its own, not from a file (to be filled in)
+hof_irfile* hof_irfile_new(int order);
+void hof_irfile_free(hof_irfile* f);
+
+// latency budgets =============================================================
+
+/*
+ * a fir of any length, convolved as cheaply as a latency budget allows. the
+ * first taps may be direct form (an hof_fir, which has no latency), and the
+ * rest go to partitioned convolutions (hof_conv), one per partition size.
+ * late taps can wait longer, so partitions double in size, up to a limit:
+ *
+ *   budget -1  direct form only (the default, the same as hof_fir)
+ *   budget 0   direct form, or a direct form head and partitions after it
+ *   budget n   any of those, or partitions from the first tap (latency is
+ *              then the first partition size, n or less)
+ *
+ * within the budget, the plan with the lowest estimated cpu cost wins. like
+ * hof_fir, direct form taps are read from the caller's memory every
+ * _process; partitioned taps are copied (and transformed) by _set_coefs, so
+ * later changes to them aren't heard until it's called again.
+ */
+#define hof_convolver_max_size   16384 // largest partition
+#define hof_convolver_max_stages 10    // partition sizes from hof_fir_pad
+
+typedef struct hof_convolver
+{
+    const float* coefs;    // coefficients (not owned)
+    int          stride;   // distance between coefficients (floats)
+    int          order;    // number of coefficients
+    int          budget;   // latency budget (samples), or -1
+    int          latency;  // latency of the current plan (samples)
+    float        trim;     // tail threshold (db), or 0 to keep every tap
+    int          sparse;   // 1 to skip blocks of zero taps in the head
+    int          used;     // coefficients left after trimming
+    int*         live;     // sparse: nonzero tap blocks before each block
+    hof_fir*     head;     // the first taps, direct form
+    int          nStages;  // number of partition sizes used
+    hof_conv*    stages[hof_convolver_max_stages]; // smallest first
+    int          offsets[hof_convolver_max_stages]; // each one's first tap
+    float*       input;    // a chunk of input (in case it's the output too)
+    float*       sum;      // one stage's output for that chunk
+#ifdef HOF_STATS
+    hof_stats    stats;    // counters (see hof_stats)
+#endif
+
+} hof_convolver;
+
+hof_convolver* hof_convolver_new(void);
+void hof_convolver_free(hof_convolver* c);
+
+// point to new coefficients and plan for them (returns 0 if out of memory)
+int hof_convolver_set_coefs(hof_convolver* c, const float* coefs, int order,
+                            int stride);
+
+// set the latency budget and plan again (returns 0 if out of memory)
+int hof_convolver_set_budget(hof_convolver* c, int budget);
+
+/*
+ * many impulse responses end in a long, nearly silent tail. with a threshold
+ * below 0 db, the taps are looked at whenever coefficients are set, and the
+ * tail whose energy is that far below the whole filter's is left out (so
+ * -90 keeps all but the last billionth of the energy). 0 keeps every tap.
+ * returns 0 if out of memory, like _set_budget.
+ */
+int hof_convolver_set_trim(hof_convolver* c, float threshold);
+
+/*
+ * skip blocks of zero taps in the direct form head (see hof_fir_set_sparse),
+ * and any zeros at the end, then plan again (returns 0 if out of memory).
+ */
+int hof_convolver_set_sparse(hof_convolver* c, int sparse);
+
+// the number of taps the current plan really uses (after trimming, sparse)
+int hof_convolver_taps(const hof_convolver* c);
+
+/*
+ * what an fft butterfly and a partition's bin cost, in direct form taps (for
+ * every plan made after this). hof_tune measures them; values that aren't
+ * positive are ignored.
+ */
+void hof_convolver_set_costs(float butterfly, float bin);
+
+// clear all history
+void hof_convolver_reset(hof_convolver* c);
+
+// convolve one channel (in and out may be the same)
+void hof_convolver_process(hof_convolver* c, const float* in, float* out,
+                           int nSamples);
+
+// convolution matrices ========================================================
+
+/*
+ * every input convolved with its own filter to every output, partitioned like
+ * hof_conv (and 'size' samples late, like it). each input is transformed once
+ * per partition, and each output's spectra are summed before one inverse
+ * transform, so a block costs nInputs + nOutputs ffts, not
+ * nInputs * nOutputs. pairs without coefficients cost nothing.
+ */
+typedef struct hof_convmatrix
+{
+    int       size;      // partition size (the fft is twice this)
+    int       nInputs;   // number of inputs
+    int       nOutputs;  // number of outputs
+    hof_fft*  fft;       // transform of size 2 * size
+    int*      nParts;    // partitions in each pair's filter (0 if none)
+    float**   parts;     // each pair's partition spectra (output major)
+    unsigned long long** sums; // each pair's partition checksums (or 0)
+    int       depth;     // partitions in the longest filter
+    float*    fdl;       // each input's recent spectra (depth * 2 * size)
+    int       slot;      // newest spectrum in each fdl (older ones follow)
+    float*    input;     // each input's last 2 * size samples
+    float*    spectrum;  // scratch spectrum (2 * size)
+    float*    output;    // each output's samples being played (size)
+    int       pos;       // samples into the current partition
+#ifdef HOF_STATS
+    hof_stats stats;     // counters (see hof_stats)
+#endif
+
+} hof_convmatrix;
+
+// returns 0 if size isn't a power of two, hof_fir_pad or more
+hof_convmatrix* hof_convmatrix_new(int nInputs, int nOutputs, int size);
+void hof_convmatrix_free(hof_convmatrix* m);
+
+/*
+ * copy and transform the filter from 'input' to 'output' (coefs == 0 removes
+ * it). like hof_conv_set_coefs, only partitions whose checksums changed are
+ * transformed again, so setting a pair to the same filter is nearly free.
+ * returns 0 if out of memory, or there's no such pair.
+ */
+int hof_convmatrix_set_coefs(hof_convmatrix* m, int input, int output,
+                             const float* coefs, int order, int stride);
+
+// clear the input history
+void hof_convmatrix_reset(hof_convmatrix* m);
+
+// convolve in[i] into every out[o] (any of them may be the same)
+void hof_convmatrix_process(hof_convmatrix* m, const float* const* in,
+                            float* const* out, int nSamples);
+
+// adaptive filters ============================================================
+
+/*
+ * an nlms (normalized least mean squares) filter: a fir whose taps adapt,
+ * sample by sample, to make its output match a desired signal. for echo
+ * cancellation, x is the far end (what the speaker plays) and d is the
+ * microphone; e = d - y is then the microphone without the echo.
+ *
+ * each sample, every tap moves by mu * e * x / (power of the last 'order'
+ * inputs), and then loses 'leak' of itself. mu is 0 (frozen) to 2 (unstable
+ * above); 0.1 to 0.5 is usual. a small leak (1e-6 or so) keeps taps from
+ * drifting while x is quiet.
+ *
+ * it runs on the same simd kernels as hof_fir, and keeps its taps packed the
+ * same way (see hof_fir).
+ */
+typedef struct hof_lms
+{
+    int           order;  // number of taps
+    int           length; // order, rounded up to a multiple of hof_fir_pad
+    float         mu;     // step size (0 to 2)
+    float         leak;   // fraction of every tap lost per sample (0 to 1)
+    float*        taps;   // taps, reversed and zero padded (like hof_fir)
+    float*        table;  // delay table (2 * length, mirrored)
+    int           wptr;   // write pointer
+    double        energy; // sum of the squares of the last 'order' inputs
+#ifdef HOF_STATS
+    hof_stats     stats;  // counters (see hof_stats)
+#endif
+
+} hof_lms;
+
+// a filter with 'order' taps, all zero (returns 0 if out of memory)
+hof_lms* hof_lms_new(int order);
+void hof_lms_free(hof_lms* f);
+
+// step size and leak (clipped to 0 to 2, and 0 to 1)
+void hof_lms_set_mu(hof_lms* f, float mu);
+void hof_lms_set_leak(hof_lms* f, float leak);
+
+// copy the taps, h(0) first, into coefs[k * stride] for k < nCoefs (zeros
+// past the filter's order)
+void hof_lms_get_taps(const hof_lms* f, float* coefs, int nCoefs, int stride);
+
+// zero the taps and the delay table
+void hof_lms_reset(hof_lms* f);
+
+/*
+ * filter x into y and adapt towards d, with e = d - y. one channel only.
+ * any of the buffers may be the same.
+ */
+void hof_lms_process(hof_lms* f, const float* x, const float* d, float* y,
+                     float* e, int nSamples);
+
+/*
+ * a partitioned block frequency domain adaptive filter: the same job as
+ * hof_lms, for echo paths too long for it. filtering and adapting are both
+ * done a partition at a time, in the frequency domain (on an hof_conv), so
+ * the cost per sample grows with the log of the partition size, plus a few
+ * operations per partition. like hof_conv, y and e are 'size' samples late.
+ *
+ * mu is 0 (frozen) to 1. the order is rounded up to whole partitions.
+ */
+typedef struct hof_pbfdaf
+{
+    int       order;     // number of taps (a multiple of the partition size)
+    float     mu;        // step size (0 to 1)
+    hof_conv* conv;      // filters x: its partitions are the adapted weights
+    float*    power;     // smoothed input power in each bin (size + 1)
+    float*    desired;   // this partition's desired samples
+    float*    estimate;  // last partition's estimate (being played)
+    float*    error;     // last partition's error (being played)
+    float*    gradient;  // scratch spectrum (2 * size)
+    int       constrain; // the partition to clear the padding of next
+#ifdef HOF_STATS
+    hof_stats stats;     // counters (see hof_stats)
+#endif
+
+} hof_pbfdaf;
+
+// 'order' taps, in partitions of 'size' (returns 0 if it can't)
+hof_pbfdaf* hof_pbfdaf_new(int order, int size);
+void hof_pbfdaf_free(hof_pbfdaf* f);
+
+// step size (clipped to 0 to 1)
+void hof_pbfdaf_set_mu(hof_pbfdaf* f, float mu);
+
+// copy the taps, h(0) first, into coefs[k * stride] for k < nCoefs
+void hof_pbfdaf_get_taps(hof_pbfdaf* f, float* coefs, int nCoefs, int stride);
+
+// zero the taps and all history
+void hof_pbfdaf_reset(hof_pbfdaf* f);
+
+// filter x into y and adapt towards d, with e = d - y (any may be the same)
+void hof_pbfdaf_process(hof_pbfdaf* f, const float* x, const float* d,
+                        float* y, float* e, int nSamples);
+
+// tuning ======================================================================
+
+/*
+ * time this machine's fir kernels and fft once, then use the fastest kernel
+ * (see hof_fir_set_kernel) and plan with the measured costs (see
+ * hof_convolver_set_costs). the results are kept in the text file at 'path',
+ * one line per cpu, so only the first process on a machine pays for it (about
+ * a tenth of a second). path == 0 measures without a file. only the
+ * first call in a process does anything; returns 0 if the results couldn't
+ * be saved (they're still used).
+ */
+int hof_tune(const char* path);
+
+/*
+ * where tuning is kept: $HOF_TUNING, or .hof_tuning in the home directory.
+ * HOF_TUNING set to nothing gives 0 (measure every time).
+ */
+const char* hof_tune_path(void);
+
+// filter design ===============================================================
+
+/*
+ * the minimum phase filter with the same magnitude response as 'order'
+ * coefficients (by the real cepstrum), written to 'length' floats at 'out'
+ * (cut short, or padded with zeros). a linear phase filter's energy is in its
+ * middle; a minimum phase filter's comes as early as it can, so it has no
+ * pre-ringing, and usually fewer taps matter. this takes several ffts the
+ * size of the filter, so it's best done off the audio thread. returns 0 if
+ * out of memory.
+ */
+int hof_minimum_phase(const float* coefs, int order, int stride, float* out,
+                      int length);
+
+#define hof_fit_max_peaks 16 // most sections hof_fit_peaks will fit
+
+/*
+ * fit 'nSections' peak filters and an overall gain to the magnitude response
+ * of 'order' coefficients, at sample rate 'sr' (the coefficients are the same
+ * at any rate; only the frequencies are in Hz.). the fit is in dB, on
+ * frequencies spaced evenly in octaves from 20 Hz., and the response is
+ * smoothed to match, so smooth curves (room correction, say) fit well and
+ * fine detail is ignored. 'param' gets Q, dB and freq for each section, then
+ * the gain (dB): see hof_cascade_set_peaks. this can take a few hundred ms.
+ * (at hof_fit_max_peaks), so it's best done off the audio thread. returns
+ * the rms difference left (dB), or -1 if out of memory (or too many
+ * sections).
+ */
+float hof_fit_peaks(const float* coefs, int order, int stride, float sr,
+                    int nSections, float* param);
+
+// linear phase fir design -----------------------------------------------------
+typedef enum hof_design_method
+{
+    hof_kaiser, // windowed sinc, with a kaiser window
+    hof_remez   // equiripple (parks-mcclellan)
+
+} hof_design_method;
+
+/*
+ * what a filter has to do. frequencies are fractions of the sample rate (so
+ * a spec in Hz. is redesigned when the rate changes), and each cutoff is the
+ * middle of its transition band, 'width' wide. the type is hof_lowpass,
+ * hof_highpass, hof_bandpass or hof_notch (a band stop), whose second cutoff
+ * is 'high'.
+ */
+typedef struct hof_fir_spec
+{
+    hof_design_method method; // how it's designed
+    hof_type          type;   // which response
+    float             low;    // cutoff (or the lower one)
+    float             high;   // upper cutoff (bandpass and notch only)
+    float             width;  // transition width
+    float             stop;   // stopband attenuation (dB)
+    float             ripple; // most passband ripple (dB)
+
+} hof_fir_spec;
+
+#define hof_design_max_taps 16383 // longest filter hof_fir_design will make
+
+/*
+ * the number of taps (always odd) the spec needs, by kaiser's estimates:
+ * more than hof_design_max_taps if it's too long to make, or 0 if it can't be
+ * met at all (the bands overlap, or fall off either end). the design itself
+ * can end up a little longer.
+ */
+int hof_fir_design_taps(const hof_fir_spec* spec);
+
+/*
+ * the shortest filter that meets 'spec', as '*order' coefficients in memory
+ * of its own at '*coefs' (free() them when done). the last several designs
+ * are remembered, so asking again (from any thread) is just a copy; a new
+ * equiripple design can take seconds, so it's best done off the audio
+ * thread (one thousands of taps long may not converge at all, and is made
+ * with a kaiser window instead). if 'cancel' isn't 0, setting it to 1 from
+ * another thread stops the design early. returns 0 if the spec can't be met
+ * in hof_design_max_taps (or it was cancelled, or out of memory).
+ */
+int hof_fir_design(const hof_fir_spec* spec, float** coefs, int* order,
+                   hof_atomic* cancel);
+
+/*
+ * 1 if 'order' coefficients meet 'spec': the passband ripples no more than
+ * its ripple, and the stopband is at least its attenuation below a gain of 1
+ * (measured on 16 or more points per tap). hof_fir_design checks every
+ * design this way. returns 0 if out of memory.
+ */
+int hof_fir_design_meets(const hof_fir_spec* spec, const float* coefs,
+                         int order);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _hof_h defined
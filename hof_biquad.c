@@ -0,0 +1,1377 @@
+//------------------------------------------------------------------------------
+//  Higher Order Filter Project
+//
+//  hof_biquad.c: second-order filter engine
+//  Copyright (c) 2016 Elliot Patros. All rights reserved.
+//------------------------------------------------------------------------------
+
+#include "hof.h"
+#include "hof_util.h"
+
+// coefficients ----------------------------------------------------------------
+/*
+ * here we calculate the B and A coefficients for each filter type. the filter
+ * equations are the canonical second-order filters from DAFX vol.2 (p.50).
+ * the term 'Q' is a scalar for filter resonance.
+ * the term 'G' is linear gain, from dB.
+ * the term 'K' is a function of cutoff frequency and sampling rate.
+ * all other terms are derived from Q, G and K to minimize redundant
+ * computation.
+ */
+static void lowpass_BA(float* b, float* a, const float Q, const float K)
+{
+    const float KKQ          = K * K * Q;
+    const float rDenominator = 1.f / (KKQ + K + Q);
+
+    b[2] =
+    b[0] = KKQ             * rDenominator;
+    b[1] = 2.f * KKQ       * rDenominator;
+    a[0] = 2.f * (KKQ - Q) * rDenominator;
+    a[1] = ((KKQ - K) + Q) * rDenominator;
+}
+
+static void highpass_BA(float* b, float* a, const float Q, const float K)
+{
+    const float KKQ          = K * K * Q;
+    const float rDenominator = 1.f / (KKQ + K + Q);
+
+    b[2] =
+    b[0] = Q               * rDenominator;
+    b[1] = -2.f * Q        * rDenominator;
+    a[0] = 2.f * (KKQ - Q) * rDenominator;
+    a[1] = ((KKQ - K) + Q) * rDenominator;
+}
+
+static void bandpass_BA(float* b, float* a, const float Q, const float K)
+{
+    const float KKQ          = K * K * Q;
+    const float rDenominator = 1.f / (KKQ + K + Q);
+
+    b[0] = K               * rDenominator;
+    b[2] = -b[0];
+    b[1] = 0.f;
+    a[0] = 2.f * (KKQ - Q) * rDenominator;
+    a[1] = ((KKQ - K) + Q) * rDenominator;
+}
+
+static void notch_BA(float* b, float* a, const float Q, const float K)
+{
+    const float KKQ          = K * K * Q;
+    const float rDenominator = 1.f / (KKQ + K + Q);
+
+    b[2] =
+    b[0] = (Q + KKQ)       * rDenominator;
+    b[1] =
+    a[0] = 2.f * (KKQ - Q) * rDenominator;
+    a[1] = ((KKQ - K) + Q) * rDenominator;
+}
+
+static void allpass_BA(float* b, float* a, const float Q, const float K)
+{
+    const float KKQ          = K * K * Q;
+    const float rDenominator = 1.f / (KKQ + K + Q);
+
+    b[0] =
+    a[1] = ((KKQ - K) + Q) * rDenominator;
+    b[1] =
+    a[0] = 2.f * (KKQ - Q) * rDenominator;
+    b[2] = 1.f;
+}
+
+static void peak_BA(float* b, float* a, const float Q, const float G,
+                    const float K)
+{
+    const float KK  = K * K;
+    const float KrQ = K / Q;
+
+    if (G > 1.f)
+    {   // HF boost
+        const float KGrQ         = G * KrQ;
+        const float rDenominator = 1.f / (1.f + KrQ + KK);
+
+        b[0] = (1.f + KGrQ + KK) * rDenominator;
+        a[0] =
+        b[1] = 2.f * (KK - 1.f)  * rDenominator;
+        b[2] = (1.f - KGrQ + KK) * rDenominator;
+        a[1] = (1.f - KrQ + KK)  * rDenominator;
+    }
+    else
+    {   // HF attenuation
+        const float KrQG         = KrQ / G;
+        const float rDenominator = 1.f / (1.f + KrQG + KK);
+
+        b[0] = (1.f + KrQ + KK)  * rDenominator;
+        a[0] =
+        b[1] = 2.f * (KK - 1.f)  * rDenominator;
+        b[2] = (1.f - KrQ + KK)  * rDenominator;
+        a[1] = (1.f - KrQG + KK) * rDenominator;
+    }
+}
+
+static void lowshelf_BA(float* b, float* a, const float G, const float K)
+{
+    const float G2 = 2.f * G;
+    const float KK = K * K;
+    const float sqrt_2G_K = sqrtf(G2) * K;
+    const float sqrt_2_K = M_SQRT2 * K;
+
+    if (G > 1.f)
+    {   // HF boost
+        const float GKK = G * KK;
+        const float rDenominator = 1.f / (1.f + sqrt_2_K + KK);
+
+        b[0] = (1.f + sqrt_2G_K + GKK) * rDenominator;
+        b[1] = 2.f * (GKK - 1.f)       * rDenominator;
+        b[2] = (1.f - sqrt_2G_K + GKK) * rDenominator;
+        a[0] = 2.f * (KK - 1.f)        * rDenominator;
+        a[1] = (1.f - sqrt_2_K + KK)   * rDenominator;
+    }
+    else
+    {   // HF attenuation
+        const float rDenominator = 1.f / (G + sqrt_2G_K + KK);
+
+        b[0] = G * (1.f + sqrt_2_K + KK) * rDenominator;
+        b[1] = G2 * (KK - 1.f)           * rDenominator;
+        b[2] = G * (1.f - sqrt_2_K + KK) * rDenominator;
+        a[0] = 2.f * (KK - G)            * rDenominator;
+        a[1] = (G - sqrt_2G_K + KK)      * rDenominator;
+    }
+}
+
+static void highshelf_BA(float* b, float* a, const float G, const float K)
+{
+    const float G2        = 2.f * G;
+    const float KK        = K * K;
+    const float sqrt_2G_K = sqrtf(G2) * K;
+    const float sqrt_2_K  = M_SQRT2 * K;
+
+    if (G > 1.f)
+    {   // HF boost
+        const float rDenominator = 1.f / (1.f + sqrt_2_K + KK);
+
+        b[0] = (G + sqrt_2G_K + KK)  * rDenominator;
+        b[1] = 2.f * (KK - G)        * rDenominator;
+        b[2] = (G - sqrt_2G_K + KK)  * rDenominator;
+        a[0] = 2.f * (KK - 1.f)      * rDenominator;
+        a[1] = (1.f - sqrt_2_K + KK) * rDenominator;
+    }
+    else
+    {   // HF attenuation
+        const float rDenominator = 1.f / (1.f + sqrt_2G_K + G * KK);
+
+        b[0] = G * (1.f + sqrt_2_K + KK)  * rDenominator;
+        b[1] = G2 * (KK - 1.f)            * rDenominator;
+        b[2] = G * (1.f - sqrt_2_K + KK)  * rDenominator;
+        a[0] = (G2 * KK - 2.f)            * rDenominator;
+        a[1] = (1.f - sqrt_2G_K + G * KK) * rDenominator;
+    }
+}
+
+// update coefficients ---------------------------------------------------------
+void hof_biquad_coefs(hof_type type, const float* param, float sr, float* b,
+                      float* a)
+{
+    const float Q = clip_Q(param[hof_Q]);
+    const float G = dB_to_gain(param[hof_dB]);
+    const float K = tanf(M_PI * clip_freq_ratio(param[hof_freq], sr));
+
+    switch (type)
+    {
+        case hof_lowpass:   lowpass_BA(b, a, Q, K);   break;
+        case hof_highpass:  highpass_BA(b, a, Q, K);  break;
+        case hof_bandpass:  bandpass_BA(b, a, Q, K);  break;
+        case hof_notch:     notch_BA(b, a, Q, K);     break;
+        case hof_allpass:   allpass_BA(b, a, Q, K);   break;
+        case hof_peak:      peak_BA(b, a, Q, G, K);   break;
+        case hof_lowshelf:  lowshelf_BA(b, a, G, K);  break;
+        case hof_highshelf: highshelf_BA(b, a, G, K); break;
+    }
+}
+
+/*
+ * the state variable filter has band (v1) and low (v2) outputs, with
+ * g = K and k = 1 / Q:
+ *
+ *     v1 = gs / (s^2 + k gs + g^2), v2 = g^2 / (s^2 + k gs + g^2)
+ *
+ * so any of the filters above is the input and those two, mixed. the peak
+ * and shelves that cut move their poles (through k or g) the way their
+ * direct form 1 versions do, so both kernels have the same response.
+ * svf_shape finds k, the mix, and what the shelves scale g by; only g
+ * depends on the cutoff.
+ */
+static void svf_shape(hof_type type, const float* param, float* k,
+                      float* scale, float* mix)
+{
+    const float G = dB_to_gain(param[hof_dB]);
+
+    *k     = 1.f / clip_Q(param[hof_Q]);
+    *scale = 1.f;
+    mix[0] = 1.f;
+    mix[2] = 0.f;
+
+    switch (type)
+    {
+        case hof_lowpass:
+            mix[0] = 0.f;
+            mix[1] = 0.f;
+            mix[2] = 1.f;
+            break;
+        case hof_highpass:
+            mix[1] = -*k;
+            mix[2] = -1.f;
+            break;
+        case hof_bandpass:
+            mix[0] = 0.f;
+            mix[1] = *k;
+            break;
+        case hof_notch:
+            mix[1] = -*k;
+            break;
+        case hof_allpass:
+            mix[1] = -2.f * *k;
+            break;
+        case hof_peak:
+            *k     = (G > 1.f) ? *k : *k / G;
+            mix[1] = *k * (G - 1.f);
+            break;
+        case hof_lowshelf:
+            *k     = M_SQRT2;
+            *scale = (G > 1.f) ? 1.f : 1.f / sqrtf(G);
+            mix[1] = sqrtf(2.f * G) - *k;
+            mix[2] = G - 1.f;
+            break;
+        case hof_highshelf:
+            *k     = M_SQRT2;
+            *scale = (G > 1.f) ? 1.f : sqrtf(G);
+            mix[0] = G;
+            mix[1] = sqrtf(2.f * G) - *k * G;
+            mix[2] = 1.f - G;
+            break;
+    }
+}
+
+void hof_svf_coefs(hof_type type, const float* param, float sr, float* a,
+                   float* mix)
+{
+    float k, scale;
+
+    svf_shape(type, param, &k, &scale, mix);
+
+    const float g = scale *
+                    tanf(M_PI * clip_freq_ratio(param[hof_freq], sr));
+
+    a[0] = 1.f / (1.f + g * (g + k));
+    a[1] = g * a[0];
+    a[2] = g * a[1];
+}
+
+/*
+ * how far the response at 'ratio' of the sample rate is from 'target', for
+ * coefficients (B0, B1, B2) and (A1, A2). in double precision.
+ */
+static double biquad_distance(const float* b, const float* a,
+                              const double ratio, const double target)
+{
+    const double w   = 2. * M_PI * ratio;
+    const double c1  = cos(w), s1 = -sin(w);
+    const double c2  = cos(2. * w), s2 = -sin(2. * w);
+    const double nRe = b[0] + b[1] * c1 + b[2] * c2;
+    const double nIm = b[1] * s1 + b[2] * s2;
+    const double dRe = 1. + a[0] * c1 + a[1] * c2;
+    const double dIm = a[0] * s1 + a[1] * s2;
+    const double dd  = dRe * dRe + dIm * dIm;
+
+    return hypot((nRe * dRe + nIm * dIm) / dd - target,
+                 (nIm * dRe - nRe * dIm) / dd);
+}
+
+/*
+ * the delay of 'nStages' halvings, at the full rate. every stage adds 18
+ * samples at its own rate.
+ */
+static int multirate_latency(const int nStages)
+{
+    return (hof_halfband_taps - 1) * ((1 << nStages) - 1);
+}
+
+/*
+ * choose how many times to halve the rate (no more than 'most'). a
+ * recursion's rounding error grows as its cutoff falls, about FLT_EPSILON
+ * over the square of the cutoff in radians; splitting adds error where the
+ * halfband filters can't keep the lower rate clean, from a fifth of it up, so
+ * as much as the filter strays from 'high' there (times 3, which is what the
+ * split measured). the stages with the least error win.
+ */
+static int multirate_stages(const hof_biquad* f, const int most)
+{
+    double least   = 0.;
+    int    nStages = 0;
+    float  b[3], a[2];
+
+    for (int stage = most; stage >= 0; --stage)
+    {
+        const float  sr    = f->sr / (float)(1 << stage);
+        const double w     = 2. * M_PI *
+                             clip_freq_ratio(f->param[hof_freq], sr);
+        double       error = FLT_EPSILON / (w * w);
+
+        if (stage > 0)
+        {
+            if (f->param[hof_freq] >= 0.2f * sr)
+            {   // the cutoff is where the split isn't clean
+                continue;
+            }
+
+            hof_biquad_coefs(f->type, f->param, sr, b, a);
+            error += 3. * biquad_distance(b, a, 0.2, (b[0] - b[1] + b[2]) /
+                                                     (1.f - a[0] + a[1]));
+        }
+
+        if (stage == most || error < least)
+        {
+            least   = error;
+            nStages = stage;
+        }
+    }
+
+    return nStages;
+}
+
+/*
+ * a path's coefficients at its lowest rate, with 'high' (the response at
+ * that rate's nyquist) taken out.
+ */
+static void multirate_path_coefs(const hof_biquad* f, hof_multirate_path* p)
+{
+    float b[3], a[2];
+
+    hof_biquad_coefs(f->type, f->param, f->sr / (float)(1 << p->nStages), b,
+                     a);
+    p->high = (b[0] - b[1] + b[2]) / (1.f - a[0] + a[1]);
+    p->b[0] = b[0] - p->high;
+    p->b[1] = b[1] - p->high * a[0];
+    p->b[2] = b[2] - p->high * a[1];
+    p->a[0] = a[0];
+    p->a[1] = a[1];
+}
+
+/*
+ * choose the most stages afresh (which clears every channel), or else the
+ * path that suits the parameters now. a new path starts from silence, so it
+ * runs unheard for as long as it takes to fill and settle, and then fades
+ * in. the path isn't changed again until that's over.
+ */
+static void multirate_update(hof_biquad* f)
+{
+    if (f->restage)
+    {
+        f->maxStages       = multirate_stages(f, hof_max_stages);
+        f->restage         = 0;
+        f->active          = 0;
+        f->fade            = hof_multirate_fade;
+        f->path[0].nStages = f->maxStages;
+        memset(f->multi, 0, sizeof(hof_multirate_state) * f->nChannels);
+    }
+    else if (f->fade >= hof_multirate_fade)
+    {
+        const int nStages = multirate_stages(f, f->maxStages);
+
+        if (nStages != f->path[f->active].nStages)
+        {
+            f->active                  = !f->active;
+            f->path[f->active].nStages = nStages;
+            f->fade = -multirate_latency(nStages) - hof_multirate_fade;
+
+            for (int c = 0; c < f->nChannels; ++c)
+            {
+                memset(f->multi[c].stage[f->active], 0,
+                       sizeof(hof_halfband_state) * hof_max_stages);
+                memset(&f->multi[c].low[f->active], 0,
+                       sizeof(hof_biquad_state));
+            }
+        }
+    }
+
+    multirate_path_coefs(f, &f->path[f->active]);
+
+    if (f->fade < hof_multirate_fade)
+    {
+        multirate_path_coefs(f, &f->path[!f->active]);
+    }
+}
+
+/*
+ * called after filter parameters are changed.
+ */
+void hof_biquad_update(hof_biquad* f)
+{
+#ifdef HOF_STATS
+    f->stats.nUpdates += 1;
+#endif
+
+    if (f->kernel == hof_svf)
+    {
+        hof_svf_coefs(f->type, f->param, f->sr, f->svf_coef, f->svf_mix);
+        return;
+    }
+
+    hof_biquad_coefs(f->type, f->param, f->sr, f->b_coef, f->a_coef);
+
+    if (f->multirate)
+    {
+        multirate_update(f);
+    }
+}
+
+// kernel ----------------------------------------------------------------------
+/*
+ * filter nSamples of input into output using the current coefficients.
+ * this is direct form 1, with delay tables that swap places every sample.
+ */
+static void biquad_kernel(const float* b, const float* a, hof_biquad_state* s,
+                          const float* input, float* output,
+                          const int nSamples)
+{
+    for (int n = 0; n < nSamples; ++n)
+    {
+        // get wrapped read pointers and copy input sample
+        const int rptr1    = s->wptr;
+        const int rptr0    = 1 - rptr1;
+        const float sample = input[n];
+
+        // make output sample and write to feedback delay table
+        s->b_feed[s->wptr] =
+        output[n] =
+        sample           * b[0] +
+        s->f_feed[rptr0] * b[1] +
+        s->f_feed[rptr1] * b[2] -
+        s->b_feed[rptr0] * a[0] -
+        s->b_feed[rptr1] * a[1];
+
+        // write input sample to feedforward delay table
+        s->f_feed[s->wptr] = sample;
+
+        // toggle write pointer
+        s->wptr = rptr0;
+    }
+}
+
+/*
+ * the state variable filter: two trapezoidal integrators, which keep their
+ * state whatever the coefficients do. output is mixed from the input, band
+ * and low outputs.
+ */
+static void svf_kernel(const float* a, const float* mix, hof_svf_state* s,
+                       const float* input, float* output, const int nSamples)
+{
+    float ic1eq = s->ic1eq;
+    float ic2eq = s->ic2eq;
+
+    for (int n = 0; n < nSamples; ++n)
+    {
+        const float v0 = input[n];
+        const float v3 = v0 - ic2eq;
+        const float v1 = a[0] * ic1eq + a[1] * v3;
+        const float v2 = ic2eq + a[1] * ic1eq + a[2] * v3;
+
+        ic1eq     = 2.f * v1 - ic1eq;
+        ic2eq     = 2.f * v2 - ic2eq;
+        output[n] = mix[0] * v0 + mix[1] * v1 + mix[2] * v2;
+    }
+
+    s->ic1eq = ic1eq;
+    s->ic2eq = ic2eq;
+}
+
+/*
+ * the same, with the cutoff read from 'freq' every sample (as a ratio of the
+ * sample rate, once times 'inv_sr'). the integrators don't mind the
+ * coefficients changing, so neither does the output.
+ */
+static void svf_kernel_freq(const float k, const float scale,
+                            const float* mix, const float inv_sr,
+                            hof_svf_state* s, const float* input,
+                            const float* freq, float* output,
+                            const int nSamples)
+{
+    float ic1eq = s->ic1eq;
+    float ic2eq = s->ic2eq;
+
+    for (int n = 0; n < nSamples; ++n)
+    {
+        const float g  = scale * tan_pi(clip_float(freq[n] * inv_sr, min_freq,
+                                                   max_freq_ratio));
+        const float a0 = 1.f / (1.f + g * (g + k));
+        const float a1 = g * a0;
+        const float a2 = g * a1;
+        const float v0 = input[n];
+        const float v3 = v0 - ic2eq;
+        const float v1 = a0 * ic1eq + a1 * v3;
+        const float v2 = ic2eq + a1 * ic1eq + a2 * v3;
+
+        ic1eq     = 2.f * v1 - ic1eq;
+        ic2eq     = 2.f * v2 - ic2eq;
+        output[n] = mix[0] * v0 + mix[1] * v1 + mix[2] * v2;
+    }
+
+    s->ic1eq = ic1eq;
+    s->ic2eq = ic2eq;
+}
+
+/*
+ * the same recursion, with the lowpass, highpass, bandpass and notch
+ * responses each written out (bandpass with unity gain at its peak, as in
+ * bandpass_BA). 'k' is 1 / Q.
+ */
+static void svf_kernel_multi(const float* a, const float k, hof_svf_state* s,
+                             const float* input, float* const* output,
+                             const int offset, const int nSamples)
+{
+    float* low   = output[hof_lowpass] + offset;
+    float* high  = output[hof_highpass] + offset;
+    float* band  = output[hof_bandpass] + offset;
+    float* notch = output[hof_notch] + offset;
+    float  ic1eq = s->ic1eq;
+    float  ic2eq = s->ic2eq;
+
+    input += offset;
+
+    for (int n = 0; n < nSamples; ++n)
+    {   // input is read first, so it can share memory with any output
+        const float v0 = input[n];
+        const float v3 = v0 - ic2eq;
+        const float v1 = a[0] * ic1eq + a[1] * v3;
+        const float v2 = ic2eq + a[1] * ic1eq + a[2] * v3;
+        const float kv = k * v1;
+
+        ic1eq    = 2.f * v1 - ic1eq;
+        ic2eq    = 2.f * v2 - ic2eq;
+        low[n]   = v2;
+        high[n]  = v0 - kv - v2;
+        band[n]  = kv;
+        notch[n] = v0 - kv;
+    }
+
+    s->ic1eq = ic1eq;
+    s->ic2eq = ic2eq;
+}
+
+// multirate kernel ------------------------------------------------------------
+/*
+ * every stage uses the same halfband filter: 19 taps, flat to 0.000004 below
+ * a tenth of the higher rate and down 109 dB above four tenths. the middle
+ * tap is 0.5 and every other tap is zero, so only these (taps 1, 3, 5, 7
+ * and 9 away from the middle) are needed.
+ */
+static const float halfband[hof_halfband_taps / 4 + 1] =
+{
+    0.306035578f, -0.0740575865f, 0.0226414353f, -0.00527950609f,
+    0.000661683676f
+};
+
+#define hof_multirate_chunk 256 // samples filtered at a time (at most)
+
+/*
+ * take one sample at the higher rate. every other sample, returns 1 and
+ * writes a sample at the lower rate to 'output'.
+ */
+static int halfband_down(hof_halfband_state* s, const float sample,
+                         float* output)
+{
+    // the table is doubled, so the newest 19 samples are always in a row
+    s->in[s->wIn] = s->in[s->wIn + hof_halfband_taps] = sample;
+    s->wIn        = (s->wIn + 1 == hof_halfband_taps) ? 0 : s->wIn + 1;
+    s->phase      = !s->phase;
+
+    if (!s->phase)
+    {
+        return 0;
+    }
+
+    const float* x = s->in + s->wIn;
+    float        y = 0.5f * x[9];
+
+    for (int k = 0; k < hof_halfband_taps / 4 + 1; ++k)
+    {
+        y += halfband[k] * (x[8 - 2 * k] + x[10 + 2 * k]);
+    }
+
+    *output = y;
+    return 1;
+}
+
+/*
+ * make one sample at the higher rate, taking a new sample at the lower rate
+ * if 'kept' (every other sample, in step with halfband_down). between new
+ * samples, the output is an old one, 9 samples back at the higher rate.
+ */
+static float halfband_up(hof_halfband_state* s, const int kept,
+                         const float* input)
+{
+    const int n = hof_halfband_taps / 2 + 1;
+
+    if (!kept)
+    {
+        return s->out[s->wOut + 5];
+    }
+
+    s->out[s->wOut] = s->out[s->wOut + n] = *input;
+    s->wOut         = (s->wOut + 1 == n) ? 0 : s->wOut + 1;
+
+    const float* y   = s->out + s->wOut;
+    float        sum = 0.f;
+
+    for (int k = 0; k < hof_halfband_taps / 4 + 1; ++k)
+    {
+        sum += halfband[k] * (y[5 + k] + y[4 - k]);
+    }
+
+    return 2.f * sum;
+}
+
+/*
+ * filter 'samples' (in place) through path 'p', at the rate halved 'stage'
+ * times: halve it again and go deeper, or (at the lowest rate) run the
+ * kernel with 'high' taken out.
+ */
+static void multirate_run(const hof_multirate_path* path,
+                          hof_multirate_state* m, const int p,
+                          const int stage, float* samples, const int nSamples)
+{
+    if (stage == path->nStages)
+    {
+        biquad_kernel(path->b, path->a, &m->low[p], samples, samples,
+                      nSamples);
+        return;
+    }
+
+    hof_halfband_state* s     = &m->stage[p][stage];
+    const int           phase = s->phase;
+    float               low[hof_multirate_chunk];
+    int                 nLow  = 0;
+
+    for (int n = 0; n < nSamples; ++n)
+    {
+        float sample;
+
+        if (halfband_down(s, samples[n], &sample))
+        {
+            low[nLow++] = sample;
+        }
+    }
+
+    multirate_run(path, m, p, stage + 1, low, nLow);
+
+    for (int n = 0, q = phase, i = 0; n < nSamples; ++n)
+    {
+        q          = !q;
+        samples[n] = halfband_up(s, q, &low[i]);
+        i         += q;
+    }
+}
+
+/*
+ * filter one channel in multirate mode: what the filter changes comes from
+ * the lower rates, and the rest is the input delayed to match. a path with
+ * fewer stages than the most takes its input from further back in the delay
+ * line, so all of them come out at the same latency. while a new path fades
+ * in, both run, and 'fade' (plus how far into this buffer we are) says how
+ * much of each is heard.
+ */
+static void multirate_kernel(const hof_biquad* f, hof_multirate_state* m,
+                             const float* input, float* output,
+                             const int nSamples)
+{
+    const int mask    = hof_multirate_size - 1;
+    const int latency = hof_biquad_latency(f);
+    const int nPaths  = (f->fade < hof_multirate_fade) ? 2 : 1;
+    float     low[2][hof_multirate_chunk];
+
+    for (int start = 0, n; start < nSamples; start += n)
+    {
+        const int wptr = m->wptr;
+
+        n = nSamples - start;
+        n = (n < hof_multirate_chunk) ? n : hof_multirate_chunk;
+
+        for (int i = 0; i < n; ++i)
+        {
+            m->delay[(wptr + i) & mask] = input[start + i];
+        }
+
+        for (int k = 0; k < nPaths; ++k)
+        {   // the playing path first, then the one it's replacing
+            const int                 p     = f->active ^ k;
+            const hof_multirate_path* path  = &f->path[p];
+            const int                 delay = latency -
+                                              multirate_latency(path->nStages);
+
+            for (int i = 0; i < n; ++i)
+            {
+                low[k][i] = m->delay[(wptr + i - delay) & mask];
+            }
+
+            multirate_run(path, m, p, 0, low[k], n);
+
+            for (int i = 0; i < n; ++i)
+            {
+                low[k][i] += path->high *
+                             m->delay[(wptr + i - latency) & mask];
+            }
+        }
+
+        if (nPaths == 1)
+        {
+            memcpy(output + start, low[0], sizeof(float) * n);
+        }
+        else
+        {
+            for (int i = 0; i < n; ++i)
+            {
+                const float mix = clip_float((float)(f->fade + start + i) /
+                                             hof_multirate_fade, 0.f, 1.f);
+
+                output[start + i] = low[1][i] + mix * (low[0][i] - low[1][i]);
+            }
+        }
+
+        m->wptr = (wptr + n) & mask;
+    }
+}
+
+/*
+ * move any fade on by nSamples, once every channel has been filtered. when
+ * it's over, the path is chosen again, in case the parameters moved on.
+ */
+static void multirate_advance(hof_biquad* f, const int nSamples)
+{
+    if (f->fade < hof_multirate_fade)
+    {
+        f->fade += nSamples;
+
+        if (f->fade >= hof_multirate_fade)
+        {
+            f->fade = hof_multirate_fade;
+            multirate_update(f);
+        }
+    }
+}
+
+// scheduling ------------------------------------------------------------------
+/*
+ * apply every change that's due at sample 'offset' of the current buffer.
+ * returns the number of changes applied.
+ */
+static int schedule_apply(hof_biquad* f, const int offset)
+{
+    hof_schedule* s   = &f->schedule;
+    const double  now = s->clock + offset;
+    int nDue = 0;
+
+    while (nDue < s->size && s->event[nDue].time <= now)
+    {
+        f->param[s->event[nDue].param] = s->event[nDue].value;
+        ++nDue;
+    }
+
+    if (nDue > 0)
+    {
+        s->size -= nDue;
+        memmove(s->event, s->event + nDue, sizeof(hof_event) * s->size);
+    }
+
+    return nDue;
+}
+
+/*
+ * returns the offset of the next pending change inside the current buffer,
+ * or nSamples if nothing else happens before the buffer ends.
+ */
+static int schedule_next(const hof_schedule* s, const int nSamples)
+{
+    if (s->size == 0 || s->event[0].time >= s->clock + nSamples)
+    {
+        return nSamples;
+    }
+
+    return (int)(s->event[0].time - s->clock);
+}
+
+/*
+ * queue a change 'delay' samples from now. returns 0 if the queue is full.
+ * changes with the same time are applied in the order they arrived.
+ */
+int hof_biquad_schedule(hof_biquad* f, hof_param param, float value,
+                        double delay)
+{
+    hof_schedule* s = &f->schedule;
+
+    if (s->size >= hof_max_scheduled)
+    {
+        return 0;
+    }
+
+    const double time = s->clock + floor(delay + 0.5);
+    int i = s->size++;
+
+    for (; i > 0 && s->event[i - 1].time > time; --i)
+    {
+        s->event[i] = s->event[i - 1];
+    }
+
+    s->event[i].time  = time;
+    s->event[i].param = param;
+    s->event[i].value = value;
+    return 1;
+}
+
+// clear every channel's delay tables and integrators
+static void biquad_clear(hof_biquad* f)
+{
+    memset(f->state, 0, sizeof(hof_biquad_state) * f->nChannels);
+    memset(f->svf, 0, sizeof(hof_svf_state) * f->nChannels);
+}
+
+// mailbox ---------------------------------------------------------------------
+/*
+ * called from the posting thread. immediate changes overwrite the newest
+ * value and then flag it; delayed changes are written into the queue before
+ * 'write' moves past them. either way, _process sees the whole change or none
+ * of it.
+ */
+int hof_biquad_post(hof_biquad* f, hof_param param, float value, double delay)
+{
+    hof_mailbox* m = &f->mailbox;
+
+    if (delay <= 0.)
+    {
+        int bits;
+        memcpy(&bits, &value, sizeof(int));
+        hof_atomic_store(&m->value[param], bits);
+        hof_atomic_or(&m->changed, 1 << param);
+        return 1;
+    }
+
+    // (read before scheduled: _process stores them the other way around, so
+    // an event being moved into the schedule is counted at least once)
+    const int write   = hof_atomic_load(&m->write);
+    const int waiting = write - hof_atomic_load(&m->read);
+
+    if (waiting + hof_atomic_load(&m->scheduled) >= hof_max_scheduled)
+    {
+        return 0;
+    }
+
+    hof_event* e = &m->event[write & (hof_max_posted - 1)];
+    e->time  = delay;
+    e->param = param;
+    e->value = value;
+    hof_atomic_store(&m->write, write + 1);
+    return 1;
+}
+
+/*
+ * called from _process, before anything else. takes every posted change, and
+ * returns 1 if coefficients need updating. delayed changes are timed from
+ * the start of this buffer. _post leaves room for them in the schedule, going
+ * by the size stored here (changes applied during the buffer only free more).
+ * a multirate change only flips the mode here: its delay lines were allocated
+ * by the poster, and the update restages them. a new kernel clears the delay
+ * tables.
+ */
+static int mailbox_take(hof_biquad* f)
+{
+    hof_mailbox* m       = &f->mailbox;
+    const int    changed = (hof_atomic_load(&m->changed) != 0) ?
+                           hof_atomic_exchange(&m->changed, 0) : 0;
+    const int    write   = hof_atomic_load(&m->write);
+    int          read    = hof_atomic_load(&m->read);
+    const int    multi   = (hof_atomic_load(&m->multirate) != 0) ?
+                           hof_atomic_exchange(&m->multirate, 0) : 0;
+    const int    kernel  = (hof_atomic_load(&m->kernel) != 0) ?
+                           hof_atomic_exchange(&m->kernel, 0) : 0;
+
+    for (int p = 0; p < hof_nParams; ++p)
+    {
+        if (changed & (1 << p))
+        {
+            const int bits = hof_atomic_load(&m->value[p]);
+            memcpy(&f->param[p], &bits, sizeof(float));
+        }
+    }
+
+    for (; read != write; ++read)
+    {
+        const hof_event* e = &m->event[read & (hof_max_posted - 1)];
+        hof_biquad_schedule(f, e->param, e->value, e->time);
+    }
+
+    hof_atomic_store(&m->scheduled, f->schedule.size);
+    hof_atomic_store(&m->read, read);
+
+    if (multi != 0)
+    {
+        f->multirate = multi - 1;
+        f->restage   = 1;
+    }
+
+    if (kernel != 0 && (hof_kernel)(kernel - 1) != f->kernel)
+    {
+        f->kernel  = (hof_kernel)(kernel - 1);
+        f->restage = 1;
+        biquad_clear(f);
+    }
+
+    return changed != 0 || multi != 0 || kernel != 0;
+}
+
+int hof_biquad_posted(hof_biquad* f)
+{
+    return hof_atomic_load(&f->mailbox.multirate) != 0 ||
+           hof_atomic_load(&f->mailbox.kernel) != 0;
+}
+
+// parameters ------------------------------------------------------------------
+void hof_biquad_set(hof_biquad* f, hof_param param, float value)
+{
+    f->param[param] = value;
+    hof_biquad_update(f);
+}
+
+void hof_biquad_set_sr(hof_biquad* f, float sr)
+{
+    if (sr != f->sr)
+    {   // the stages (and latency) only change with the rate
+        f->restage = 1;
+    }
+
+    f->sr = sr;
+    hof_biquad_update(f);
+}
+
+/*
+ * the delay lines are only allocated, never freed, before _free: _process
+ * may still be running through them when multirate mode is turned off.
+ */
+static int multirate_alloc(hof_biquad* f)
+{
+    if (f->multi == 0)
+    {
+        f->multi = (hof_multirate_state*)
+            calloc(f->nChannels, sizeof(hof_multirate_state));
+    }
+
+    return f->multi != 0;
+}
+
+int hof_biquad_set_multirate(hof_biquad* f, int multirate)
+{
+    if (multirate && !multirate_alloc(f))
+    {
+        return 0;
+    }
+
+    f->multirate = (multirate != 0);
+    f->restage   = 1;
+    hof_biquad_update(f);
+    return 1;
+}
+
+int hof_biquad_post_multirate(hof_biquad* f, int multirate)
+{
+    if (multirate && !multirate_alloc(f))
+    {
+        return 0;
+    }
+
+    hof_atomic_store(&f->mailbox.multirate, 1 + (multirate != 0));
+    return 1;
+}
+
+void hof_biquad_set_kernel(hof_biquad* f, hof_kernel kernel)
+{
+    if (kernel != f->kernel)
+    {
+        f->kernel  = kernel;
+        f->restage = 1;
+        hof_biquad_reset(f);
+        hof_biquad_update(f);
+    }
+}
+
+void hof_biquad_post_kernel(hof_biquad* f, hof_kernel kernel)
+{
+    hof_atomic_store(&f->mailbox.kernel, 1 + (int)kernel);
+}
+
+int hof_biquad_latency(const hof_biquad* f)
+{
+    return (f->multirate && f->kernel == hof_df1) ?
+           multirate_latency(f->maxStages) : 0;
+}
+
+void hof_biquad_reset(hof_biquad* f)
+{
+    biquad_clear(f);
+
+    if (f->multirate)
+    {   // choose the stages afresh, now there's nothing to glitch
+        f->restage = 1;
+        hof_biquad_update(f);
+    }
+}
+
+// process ---------------------------------------------------------------------
+/*
+ * run the kernel for every channel, up to each scheduled parameter change.
+ */
+void hof_biquad_process(hof_biquad* f, const float* const* in,
+                        float* const* out, int nSamples)
+{
+#ifdef HOF_STATS
+    const double time = hof_now_ns();
+#endif
+
+    if (mailbox_take(f))
+    {
+        hof_biquad_update(f);
+    }
+
+    for (int start = 0, end; start < nSamples; start = end)
+    {
+        if (schedule_apply(f, start) > 0)
+        {
+            hof_biquad_update(f);
+        }
+
+        end = schedule_next(&f->schedule, nSamples);
+
+        for (int c = 0; c < f->nChannels; ++c)
+        {
+            if (f->kernel == hof_svf)
+            {
+                svf_kernel(f->svf_coef, f->svf_mix, &f->svf[c],
+                           in[c] + start, out[c] + start, end - start);
+            }
+            else if (f->multirate && f->maxStages > 0)
+            {
+                multirate_kernel(f, &f->multi[c], in[c] + start,
+                                 out[c] + start, end - start);
+            }
+            else
+            {
+                biquad_kernel(f->b_coef, f->a_coef, &f->state[c],
+                              in[c] + start, out[c] + start, end - start);
+            }
+        }
+
+        if (f->kernel == hof_df1 && f->multirate)
+        {
+            multirate_advance(f, end - start);
+        }
+    }
+
+    f->schedule.clock += nSamples;
+
+#ifdef HOF_STATS
+    hof_stats_block(&f->stats, time, out, f->nChannels, nSamples);
+#endif
+}
+
+/*
+ * the same as hof_biquad_process, with the cutoff from 'freq' (the other
+ * parameters still come from messages and the schedule).
+ */
+void hof_biquad_process_freq(hof_biquad* f, const float* const* in,
+                             float* const* out, const float* freq,
+                             int nSamples)
+{
+#ifdef HOF_STATS
+    const double time = hof_now_ns();
+#endif
+
+    if (mailbox_take(f))
+    {
+        hof_biquad_update(f);
+    }
+
+    for (int start = 0, end; start < nSamples; start = end)
+    {
+        float k, scale, mix[3];
+
+        if (schedule_apply(f, start) > 0)
+        {
+            hof_biquad_update(f);
+        }
+
+        end = schedule_next(&f->schedule, nSamples);
+        svf_shape(f->type, f->param, &k, &scale, mix);
+
+        for (int c = 0; c < f->nChannels; ++c)
+        {
+            svf_kernel_freq(k, scale, mix, 1.f / f->sr, &f->svf[c],
+                            in[c] + start, freq + start, out[c] + start,
+                            end - start);
+        }
+    }
+
+    f->schedule.clock += nSamples;
+
+#ifdef HOF_STATS
+    hof_stats_block(&f->stats, time, out, f->nChannels, nSamples);
+#endif
+}
+
+/*
+ * the same as hof_biquad_process, for the four responses of one channel.
+ */
+void hof_biquad_process_multi(hof_biquad* f, const float* in,
+                              float* const* out, int nSamples)
+{
+#ifdef HOF_STATS
+    const double time = hof_now_ns();
+#endif
+
+    if (mailbox_take(f))
+    {
+        hof_biquad_update(f);
+    }
+
+    for (int start = 0, end; start < nSamples; start = end)
+    {
+        if (schedule_apply(f, start) > 0)
+        {
+            hof_biquad_update(f);
+        }
+
+        end = schedule_next(&f->schedule, nSamples);
+
+        svf_kernel_multi(f->svf_coef, 1.f / clip_Q(f->param[hof_Q]),
+                         &f->svf[0], in, out, start, end - start);
+    }
+
+    f->schedule.clock += nSamples;
+
+#ifdef HOF_STATS
+    hof_stats_block(&f->stats, time, out, hof_notch + 1, nSamples);
+#endif
+}
+
+// new/free --------------------------------------------------------------------
+hof_biquad* hof_biquad_new(hof_type type, int nChannels, float sr)
+{
+    hof_biquad* f = (hof_biquad*)malloc(sizeof(hof_biquad));
+
+    if (f == 0)
+    {
+        return 0;
+    }
+
+    f->state = (hof_biquad_state*)calloc(nChannels, sizeof(hof_biquad_state));
+    f->svf   = (hof_svf_state*)calloc(nChannels, sizeof(hof_svf_state));
+
+    if (f->state == 0 || f->svf == 0)
+    {
+        free(f->state);
+        free(f->svf);
+        free(f);
+        return 0;
+    }
+
+    f->type            = type;
+    f->sr              = sr;
+    f->param[hof_Q]    = default_Q;
+    f->param[hof_dB]   = default_dB;
+    f->param[hof_freq] = default_freq;
+    f->nChannels       = nChannels;
+    f->kernel          = hof_df1;
+    f->multirate       = 0;
+    f->maxStages       = 0;
+    f->restage         = 0;
+    f->active          = 0;
+    f->fade            = hof_multirate_fade;
+    f->multi           = 0;
+    f->schedule.size   = 0;
+    f->schedule.clock  = 0.;
+
+    memset(&f->mailbox, 0, sizeof(hof_mailbox));
+
+#ifdef HOF_STATS
+    hof_stats_reset(&f->stats);
+#endif
+
+    hof_biquad_update(f);
+    return f;
+}
+
+void hof_biquad_free(hof_biquad* f)
+{
+    if (f != 0)
+    {
+        free(f->state);
+        free(f->svf);
+        free(f->multi);
+        free(f);
+    }
+}
+
+// cascades --------------------------------------------------------------------
+/*
+ * each channel runs through every section in turn, a whole buffer at a time
+ * (so after the first section, the output is filtered in place).
+ */
+void hof_cascade_process(hof_cascade* c, const float* const* in,
+                         float* const* out, int nSamples)
+{
+#ifdef HOF_STATS
+    const double time = hof_now_ns();
+#endif
+
+    for (int ch = 0; ch < c->nChannels; ++ch)
+    {
+        const float* input = in[ch];
+
+        for (int s = 0; s < c->nSections; ++s)
+        {
+            biquad_kernel(c->b_coef + 3 * s, c->a_coef + 2 * s,
+                          &c->state[ch * c->nSections + s], input, out[ch],
+                          nSamples);
+            input = out[ch];
+        }
+
+        if (c->nSections == 0 && out[ch] != in[ch])
+        {   // no sections is a wire
+            memcpy(out[ch], in[ch], sizeof(float) * nSamples);
+        }
+    }
+
+#ifdef HOF_STATS
+    hof_stats_block(&c->stats, time, out, c->nChannels, nSamples);
+#endif
+}
+
+/*
+ * make room for 'nSections'. the delay tables are only cleared if the number
+ * of sections changes.
+ */
+static int cascade_resize(hof_cascade* c, const int nSections)
+{
+    if (nSections == c->nSections && c->state != 0)
+    {
+        return 1;
+    }
+
+    const int         n = (nSections > 0) ? nSections : 1;
+    float*            b = (float*)malloc(sizeof(float) * 3 * n);
+    float*            a = (float*)malloc(sizeof(float) * 2 * n);
+    hof_biquad_state* state = (hof_biquad_state*)
+        calloc((size_t)n * c->nChannels, sizeof(hof_biquad_state));
+
+    if (b == 0 || a == 0 || state == 0)
+    {
+        free(b);
+        free(a);
+        free(state);
+        return 0;
+    }
+
+    free(c->b_coef);
+    free(c->a_coef);
+    free(c->state);
+    c->b_coef    = b;
+    c->a_coef    = a;
+    c->state     = state;
+    c->nSections = nSections;
+    return 1;
+}
+
+int hof_cascade_set_coefs(hof_cascade* c, const float* coefs, int nSections)
+{
+    if (nSections < 0 || !cascade_resize(c, nSections))
+    {
+        return 0;
+    }
+
+    for (int s = 0; s < nSections; ++s)
+    {
+        memcpy(c->b_coef + 3 * s, coefs + 5 * s, sizeof(float) * 3);
+        memcpy(c->a_coef + 2 * s, coefs + 5 * s + 3, sizeof(float) * 2);
+    }
+
+#ifdef HOF_STATS
+    c->stats.nUpdates += 1;
+#endif
+
+    return 1;
+}
+
+int hof_cascade_set_peaks(hof_cascade* c, const float* param, int nSections,
+                          float sr)
+{
+    if (nSections < 0 || !cascade_resize(c, nSections))
+    {
+        return 0;
+    }
+
+    for (int s = 0; s < nSections; ++s)
+    {
+        hof_biquad_coefs(hof_peak, param + s * hof_nParams, sr,
+                         c->b_coef + 3 * s, c->a_coef + 2 * s);
+    }
+
+    // the gain goes into the first section's feedforward coefficients
+    const float gain = dB_to_gain(param[nSections * hof_nParams]);
+
+    for (int k = 0; k < 3 && nSections > 0; ++k)
+    {
+        c->b_coef[k] *= gain;
+    }
+
+#ifdef HOF_STATS
+    c->stats.nUpdates += 1;
+#endif
+
+    return 1;
+}
+
+void hof_cascade_reset(hof_cascade* c)
+{
+    memset(c->state, 0, sizeof(hof_biquad_state) * c->nChannels *
+                        ((c->nSections > 0) ? c->nSections : 1));
+}
+
+hof_cascade* hof_cascade_new(int nChannels)
+{
+    hof_cascade* c = (hof_cascade*)calloc(1, sizeof(hof_cascade));
+
+    if (c == 0)
+    {
+        return 0;
+    }
+
+    c->nChannels = nChannels;
+
+#ifdef HOF_STATS
+    hof_stats_reset(&c->stats);
+#endif
+
+    if (!cascade_resize(c, 0))
+    {
+        hof_cascade_free(c);
+        return 0;
+    }
+
+    return c;
+}
+
+void hof_cascade_free(hof_cascade* c)
+{
+    if (c != 0)
+    {
+        free(c->b_coef);
+        free(c->a_coef);
+        free(c->state);
+        free(c);
+    }
+}
@@ -0,0 +1,225 @@
+//------------------------------------------------------------------------------
+//  Higher Order Filter Project
+//
+//  hof_cache.c: partition spectra kept on disk, and mapped back into memory
+//  Copyright (c) 2016 Elliot Patros. All rights reserved.
+//------------------------------------------------------------------------------
+
+#include "hof.h"
+#include "hof_util.h"
+
+#include <stdio.h>
+
+#ifdef _WIN32
+#include <direct.h> // for _mkdir
+#endif
+
+/*
+ * each filter's spectra are one file, named after its key:
+ *
+ *     <dir>/<hash>-<order>-<size>.spectra
+ *
+ * a 64 byte header (so the spectra stay aligned), then nParts spectra of
+ * 2 * size floats, in hof_fft's layout. files are written under another name
+ * and renamed, so a reader never sees half of one. the header's magic number
+ * changes whenever the layout does, so old files are just ignored, and it
+ * keeps a checksum of the spectra, so a file that was damaged (or changed
+ * by something else) is transformed again instead of played.
+ */
+#define cache_header 64
+#define cache_magic  "hofspec2"
+
+typedef struct cache_file
+{
+    char               magic[8]; // cache_magic
+    unsigned long long hash;     // the coefficients' hash (see hof_conv)
+    int                order;    // number of coefficients
+    int                size;     // partition size
+    int                nParts;   // number of partitions
+    unsigned long long check;    // the spectra's hash (see hof_cache_hash)
+
+} t_cache_file;
+
+typedef struct cache_mapping
+{
+    const void* base;  // the whole file
+    size_t      bytes; // its size
+
+} t_cache_mapping;
+
+static char cache_dir[1024] = "";
+
+// names -----------------------------------------------------------------------
+static int cache_name(char* name, const size_t n, const unsigned long long hash,
+                      const int order, const int size)
+{
+    return cache_dir[0] != '\0' &&
+           snprintf(name, n, "%s/%016llx-%d-%d.spectra", cache_dir, hash,
+                    order, size) < (int)n;
+}
+
+// expected size of a file with 'nParts' partitions of 'size'
+static size_t cache_bytes(const int size, const int nParts)
+{
+    return cache_header + sizeof(float) * 2 * (size_t)size * nParts;
+}
+
+// directory -------------------------------------------------------------------
+int hof_cache_set_dir(const char* dir)
+{
+    if (dir == 0 || dir[0] == '\0' || strlen(dir) >= sizeof(cache_dir))
+    {   // off
+        cache_dir[0] = '\0';
+        return dir == 0 || dir[0] == '\0';
+    }
+
+#ifdef _WIN32
+    _mkdir(dir);
+#else
+    mkdir(dir, 0777);
+#endif
+
+    strcpy(cache_dir, dir);
+    return 1;
+}
+
+const char* hof_cache_path(void)
+{
+    static char path[1024];
+    const char* dir = getenv("HOF_CACHE");
+
+#if defined(_WIN32)
+    const char* home = getenv("USERPROFILE");
+#else
+    const char* home = getenv("HOME");
+#endif
+
+    if (dir != 0)
+    {
+        return dir;
+    }
+
+    if (home == 0 ||
+        snprintf(path, sizeof(path), "%s/.hof_cache", home) >=
+        (int)sizeof(path))
+    {
+        return 0;
+    }
+
+    return path;
+}
+
+// keys ------------------------------------------------------------------------
+/*
+ * 64 bit fnv-1a over the coefficients' bits (not their addresses, so the
+ * same filter from another array or patch finds the same file).
+ */
+unsigned long long hof_cache_hash(const float* coefs, int order, int stride)
+{
+    unsigned long long hash = 14695981039346656037ull;
+
+    for (int k = 0; k < order; ++k)
+    {
+        unsigned int bits;
+        memcpy(&bits, &coefs[k * stride], sizeof(bits));
+
+        for (int b = 0; b < 4; ++b)
+        {
+            hash = (hash ^ ((bits >> (8 * b)) & 0xff)) * 1099511628211ull;
+        }
+    }
+
+    return hash;
+}
+
+// map -------------------------------------------------------------------------
+float* hof_cache_map(unsigned long long hash, int order, int size, int nParts,
+                     void** mapping)
+{
+    char             name[1100];
+    t_cache_mapping* m     = 0;
+    const void*      base  = 0;
+    size_t           bytes = 0;
+
+    *mapping = 0;
+
+    if (!cache_name(name, sizeof(name), hash, order, size) ||
+        (base = hof_map_file(name, &bytes)) == 0)
+    {
+        return 0;
+    }
+
+    const t_cache_file* header = (const t_cache_file*)base;
+    const float*        parts  = (const float*)((const char*)base +
+                                                cache_header);
+    const int           valid  = bytes == cache_bytes(size, nParts) &&
+                                 memcmp(header->magic, cache_magic, 8) == 0 &&
+                                 header->hash == hash &&
+                                 header->order == order &&
+                                 header->size == size &&
+                                 header->nParts == nParts &&
+                                 header->check ==
+                                 hof_cache_hash(parts, 2 * size * nParts, 1);
+
+    if (!valid || (m = (t_cache_mapping*)malloc(sizeof(*m))) == 0)
+    {   // someone else's file, or a damaged one (or out of memory)
+        hof_unmap_file(base, bytes);
+        return 0;
+    }
+
+    m->base  = base;
+    m->bytes = bytes;
+    *mapping = m;
+    return (float*)parts;
+}
+
+void hof_cache_unmap(void* mapping)
+{
+    t_cache_mapping* m = (t_cache_mapping*)mapping;
+
+    if (m != 0)
+    {
+        hof_unmap_file(m->base, m->bytes);
+        free(m);
+    }
+}
+
+// store -----------------------------------------------------------------------
+void hof_cache_store(unsigned long long hash, int order, int size, int nParts,
+                     const float* parts)
+{
+    char         name[1100];
+    char         temp[1200];
+    char         header[cache_header];
+    t_cache_file file;
+    FILE*        out;
+
+    if (!cache_name(name, sizeof(name), hash, order, size) ||
+        snprintf(temp, sizeof(temp), "%s.%.0f.tmp", name,
+                 fmod(hof_now_ns(), 1e12)) >= (int)sizeof(temp) ||
+        (out = fopen(temp, "wb")) == 0)
+    {
+        return;
+    }
+
+    memset(header, 0, sizeof(header));
+    memset(&file, 0, sizeof(file));
+    memcpy(file.magic, cache_magic, 8);
+    file.hash   = hash;
+    file.order  = order;
+    file.size   = size;
+    file.nParts = nParts;
+    file.check  = hof_cache_hash(parts, 2 * size * nParts, 1);
+    memcpy(header, &file, sizeof(file));
+
+    const size_t n  = (size_t)2 * size * nParts;
+    int          ok = fwrite(header, 1, sizeof(header), out) == sizeof(header)
+                      && fwrite(parts, sizeof(float), n, out) == n;
+
+    ok = (fclose(out) == 0) && ok;
+
+    if (!ok || rename(temp, name) != 0)
+    {   // (on windows, rename fails if another process got there first)
+        remove(temp);
+    }
+}
@@ -0,0 +1,1177 @@
+//------------------------------------------------------------------------------
+//  Higher Order Filter Project
+//
+//  hof_conv.c: partitioned fft convolution, fixed and adaptive
+//  Copyright (c) 2016 Elliot Patros. All rights reserved.
+//------------------------------------------------------------------------------
+
+#include "hof.h"
+#include "hof_util.h"
+
+/*
+ * uniformly partitioned overlap-save. the coefficients are cut into
+ * partitions of 'size' samples, and each is transformed once (zero padded to
+ * twice its size). every 'size' input samples, the last 2 * size inputs are
+ * transformed and pushed onto a frequency domain delay line. the output
+ * spectrum is the sum of each partition's spectrum times the input spectrum
+ * from that many partitions ago; its inverse transform's second half is the
+ * next 'size' output samples.
+ *
+ * a whole partition has to arrive before it can be transformed, so output
+ * is 'size' samples late.
+ */
+
+// partitioned convolution -----------------------------------------------------
+/*
+ * the new inputs are in the second half of c->input. afterwards, the next
+ * outputs are in the second half of c->output, and the new inputs have moved
+ * to the first half of c->input, ready for the next partition.
+ */
+static void conv_block(hof_conv* c)
+{
+    const int size   = 2 * c->size;
+    const int nParts = c->nParts;
+
+    c->slot = (c->slot + nParts - 1) % nParts;
+    hof_fft_forward(c->fft, c->input, c->fdl + c->slot * size);
+
+    memset(c->spectrum, 0, sizeof(float) * size);
+
+    for (int p = 0; p < nParts; ++p)
+    {
+        hof_spectrum_mac(c->spectrum, c->fdl + ((c->slot + p) % nParts) * size,
+                         c->parts + p * size, size);
+    }
+
+    hof_fft_inverse(c->fft, c->spectrum, c->output);
+    memcpy(c->input, c->input + c->size, sizeof(float) * c->size);
+}
+
+// transform up to fft->size / 2 coefficients (zero padded) into one partition
+static void conv_transform(hof_fft* fft, float* scratch, float* part,
+                           const float* coefs, const int n, const int stride)
+{
+    memset(scratch, 0, sizeof(float) * fft->size);
+
+    for (int k = 0; k < n; ++k)
+    {
+        scratch[k] = coefs[k * stride];
+    }
+
+    hof_fft_forward(fft, scratch, part);
+}
+
+// free the partitions (or unmap them, if they came from the cache)
+static void conv_release(hof_conv* c)
+{
+    if (c->mapping != 0)
+    {
+        hof_cache_unmap(c->mapping);
+    }
+    else
+    {
+        hof_free_aligned(c->parts);
+    }
+
+    c->parts   = 0;
+    c->mapping = 0;
+}
+
+/*
+ * make room for 'nParts' partitions (clears them, and the input spectra, if
+ * their number changes). 'mapped' partitions from the cache are used as they
+ * are, and unmapped with the filter; if this fails, they're still the
+ * caller's.
+ */
+static int conv_resize(hof_conv* c, const int nParts, float* mapped,
+                       void* mapping)
+{
+    const size_t size  = sizeof(float) * 2 * c->size * nParts;
+    const int    same  = (nParts == c->nParts);
+    float*       parts = (mapped != 0)                 ? mapped   :
+                         (same && c->mapping == 0)     ? c->parts :
+                         (float*)hof_calloc_aligned(size);
+    float*       fdl   = same ? c->fdl : (float*)hof_calloc_aligned(size);
+
+    if (parts == 0 || fdl == 0)
+    {   // failed to allocate memory
+        if (mapped == 0 && parts != c->parts)
+        {
+            hof_free_aligned(parts);
+        }
+
+        if (fdl != c->fdl)
+        {
+            hof_free_aligned(fdl);
+        }
+
+        return 0;
+    }
+
+    if (parts != c->parts)
+    {
+        conv_release(c);
+        c->parts   = parts;
+        c->mapping = mapping;
+    }
+
+    if (fdl != c->fdl)
+    {   // (the checksums were for the old partitions)
+        hof_free_aligned(c->fdl);
+        free(c->sums);
+        c->fdl    = fdl;
+        c->sums   = 0;
+        c->nParts = nParts;
+        c->slot   = 0;
+    }
+
+    return 1;
+}
+
+// copy mapped partitions into memory of our own, so some can be changed
+static int conv_own(hof_conv* c)
+{
+    const size_t size  = sizeof(float) * 2 * c->size * c->nParts;
+    float*       parts = (float*)hof_calloc_aligned(size);
+
+    if (parts == 0)
+    {
+        return 0;
+    }
+
+    memcpy(parts, c->parts, size);
+    conv_release(c);
+    c->parts = parts;
+    return 1;
+}
+
+void hof_conv_process(hof_conv* c, const float* in, float* out, int nSamples)
+{
+#ifdef HOF_STATS
+    const double time = hof_now_ns();
+    float* const first = out;
+#endif
+
+    while (nSamples > 0)
+    {   // up to the end of this partition (in before out, in case they're one)
+        const int n = (c->size - c->pos < nSamples) ? c->size - c->pos
+                                                    : nSamples;
+
+        memcpy(c->input + c->size + c->pos, in, sizeof(float) * n);
+        memcpy(out, c->output + c->size + c->pos, sizeof(float) * n);
+        in       += n;
+        out      += n;
+        nSamples -= n;
+        c->pos   += n;
+
+        if (c->pos == c->size)
+        {
+            conv_block(c);
+            c->pos = 0;
+        }
+    }
+
+#ifdef HOF_STATS
+    hof_stats_block(&c->stats, time, (float* const*)&first, 1,
+                    (int)(out - first));
+#endif
+}
+
+/*
+ * every partition has a checksum (hof_cache_hash of its coefficients), so
+ * when only some coefficients change, only their partitions are transformed
+ * again. a filter that changes completely (or whose number of partitions
+ * does) is looked up in the cache instead, by a hash of all the checksums.
+ * edited filters aren't stored there: they'd fill it with every step.
+ */
+int hof_conv_set_coefs(hof_conv* c, const float* coefs, int order, int stride)
+{
+    const int nParts = (order < 1) ? 1 : (order + c->size - 1) / c->size;
+    unsigned long long* sums = (unsigned long long*)
+                               malloc(sizeof(unsigned long long) * nParts);
+    unsigned long long  hash = 14695981039346656037ull;
+    int                 nChanged = 0;
+
+    if (sums == 0)
+    {
+        return 0;
+    }
+
+    for (int p = 0; p < nParts; ++p)
+    {
+        const int first = p * c->size;
+        const int n     = (order - first < c->size) ? order - first : c->size;
+
+        sums[p]   = (coefs != 0 && n > 0) ?
+                    hof_cache_hash(coefs + first * stride, n, stride) : 0;
+        hash      = (hash ^ sums[p]) * 1099511628211ull;
+        nChanged += (c->sums == 0 || nParts != c->nParts ||
+                     sums[p] != c->sums[p]);
+    }
+
+    const int edited = (nChanged < nParts);
+    const int cached = (coefs != 0 && order >= hof_cache_min && !edited);
+    void*     mapping = 0;
+    float*    mapped  = cached ? hof_cache_map(hash, order, c->size, nParts,
+                                               &mapping)
+                               : 0;
+
+    if ((edited && c->mapping != 0 && !conv_own(c)) ||
+        !conv_resize(c, nParts, mapped, mapping))
+    {   // failed to allocate memory
+        hof_cache_unmap(mapping);
+        free(sums);
+        return 0;
+    }
+
+    for (int p = 0; mapped == 0 && p < nParts; ++p)
+    {   // not in the cache (or too short for it, or only partly changed)
+        const int first = p * c->size;
+        const int n     = (order - first < c->size) ? order - first : c->size;
+
+        if (!edited || sums[p] != c->sums[p])
+        {
+            conv_transform(c->fft, c->spectrum, c->parts + p * 2 * c->size,
+                           (coefs != 0) ? coefs + first * stride : 0,
+                           (coefs != 0 && n > 0) ? n : 0, stride);
+        }
+    }
+
+    if (cached && mapped == 0)
+    {
+        hof_cache_store(hash, order, c->size, nParts, c->parts);
+    }
+
+    free(c->sums);
+    c->sums = sums;
+
+#ifdef HOF_STATS
+    c->stats.nUpdates += 1;
+#endif
+
+    return 1;
+}
+
+void hof_conv_reset(hof_conv* c)
+{
+    memset(c->fdl, 0, sizeof(float) * 2 * c->size * c->nParts);
+    memset(c->input, 0, sizeof(float) * 2 * c->size);
+    memset(c->output, 0, sizeof(float) * 2 * c->size);
+    c->pos = 0;
+}
+
+hof_conv* hof_conv_new(int size)
+{
+    if (size < hof_fir_pad || (size & (size - 1)) != 0)
+    {   // partitions must be a power of two
+        return 0;
+    }
+
+    hof_conv* c = (hof_conv*)calloc(1, sizeof(hof_conv));
+
+    if (c == 0)
+    {
+        return 0;
+    }
+
+    c->size     = size;
+    c->fft      = hof_fft_new(2 * size);
+    c->input    = (float*)hof_calloc_aligned(sizeof(float) * 2 * size);
+    c->spectrum = (float*)hof_calloc_aligned(sizeof(float) * 2 * size);
+    c->output   = (float*)hof_calloc_aligned(sizeof(float) * 2 * size);
+
+#ifdef HOF_STATS
+    hof_stats_reset(&c->stats);
+#endif
+
+    if (c->fft == 0 || c->input == 0 || c->spectrum == 0 || c->output == 0 ||
+        hof_conv_set_coefs(c, 0, 0, 1) == 0)
+    {
+        hof_conv_free(c);
+        return 0;
+    }
+
+    return c;
+}
+
+void hof_conv_free(hof_conv* c)
+{
+    if (c != 0)
+    {
+        conv_release(c);
+        free(c->sums);
+        hof_fft_free(c->fft);
+        hof_free_aligned(c->fdl);
+        hof_free_aligned(c->input);
+        hof_free_aligned(c->spectrum);
+        hof_free_aligned(c->output);
+        free(c);
+    }
+}
+
+// latency budgets -------------------------------------------------------------
+/*
+ * a plan has a latency d, a first partition size p0, and a largest one pmax.
+ * a partition of size p is p samples late, so with d samples allowed it can
+ * start at tap p - d; when d is 0, taps before p0 are direct form. each size
+ * up to pmax gets one partition, which ends exactly where the next (twice as
+ * big) one can start, and pmax takes the rest.
+ *
+ * costs are rough, per sample, in direct form taps: a size n fft costs about
+ * convolver_butterfly * n * log2(n), and a partition costs convolver_bin per
+ * bin per block.
+ */
+#define convolver_chunk 256 // samples per pass over the stages
+
+static float convolver_butterfly = 24.f; // (hof_tune measures these)
+static float convolver_bin       = 8.f;
+
+typedef struct convolver_plan
+{
+    int   latency;                           // d
+    int   head;                              // direct form taps
+    int   nStages;                           // number of partition sizes
+    int   sizes[hof_convolver_max_stages];   // partition sizes, smallest first
+    int   offsets[hof_convolver_max_stages]; // each size's first tap
+    float cost;                              // estimated, per sample
+
+} t_convolver_plan;
+
+static int log2_int(int n)
+{
+    int bits = 0;
+
+    while ((1 << bits) < n)
+    {
+        ++bits;
+    }
+
+    return bits;
+}
+
+/*
+ * what 'head' direct form taps cost: every block of hof_fir_pad of them, or
+ * only the blocks that aren't all zero, if 'live' counts them (sparse).
+ */
+static float convolver_head(const int* live, const int head)
+{
+    const int nBlocks = (head + hof_fir_pad - 1) / hof_fir_pad;
+    return (float)(hof_fir_pad * ((live != 0) ? live[nBlocks] : nBlocks));
+}
+
+static void convolver_layout(t_convolver_plan* plan, const int order,
+                             const int* live, const int latency,
+                             const int first, const int last)
+{
+    plan->latency = latency;
+    plan->head    = (first - latency < order) ? first - latency : order;
+    plan->nStages = 0;
+    plan->cost    = convolver_head(live, plan->head);
+
+    for (int size = first, tap = plan->head; tap < order; size *= 2)
+    {
+        const int nParts = (size < last) ? 1 : (order - tap + size - 1) / size;
+
+        plan->sizes[plan->nStages]   = size;
+        plan->offsets[plan->nStages] = tap;
+        plan->nStages += 1;
+        plan->cost    += 4.f * convolver_butterfly * log2_int(2 * size) +
+                         convolver_bin * nParts;
+        tap           += nParts * size;
+    }
+}
+
+// the cheapest plan for 'order' taps within 'budget' samples of latency
+static void convolver_plan(t_convolver_plan* best, const int order,
+                           const int* live, const int budget)
+{
+    t_convolver_plan plan;
+
+    // direct form only
+    best->latency = 0;
+    best->head    = order;
+    best->nStages = 0;
+    best->cost    = convolver_head(live, order);
+
+    for (int first = hof_fir_pad;
+         budget >= 0 && first < order && first <= hof_convolver_max_size;
+         first *= 2)
+    {
+        for (int last = first; last <= hof_convolver_max_size; last *= 2)
+        {
+            for (int latency = 0; latency <= first && latency <= budget;
+                 latency += first)
+            {
+                convolver_layout(&plan, order, live, latency, first, last);
+
+                if (plan.cost < best->cost)
+                {
+                    *best = plan;
+                }
+            }
+
+            if (last >= order)
+            {   // bigger partitions would only be padding
+                break;
+            }
+        }
+    }
+}
+
+/*
+ * look at the coefficients before planning. with a trim threshold, the tail
+ * is cut where what's left of its energy falls below the threshold (relative
+ * to the whole filter's). with trimming or sparse on, a tail of zeros goes
+ * too. with sparse on, 'live' counts the blocks of hof_fir_pad taps that
+ * aren't all zero, so plans know what a sparse head costs.
+ */
+static void convolver_analyze(hof_convolver* c)
+{
+    const double ratio = (c->trim < 0.f) ? pow(10., c->trim / 10.) : 0.;
+    double       total = 0.;
+    double       tail  = 0.;
+
+    c->used = c->order;
+
+    for (int k = 0; (c->trim < 0.f || c->sparse) && k < c->order; ++k)
+    {
+        const double h = c->coefs[k * c->stride];
+        total += h * h;
+    }
+
+    while ((c->trim < 0.f || c->sparse) && c->used > 0)
+    {
+        const double h = c->coefs[(c->used - 1) * c->stride];
+
+        if (tail + h * h > ratio * total)
+        {
+            break;
+        }
+
+        tail    += h * h;
+        c->used -= 1;
+    }
+
+    const int nBlocks = (c->used + hof_fir_pad - 1) / hof_fir_pad;
+    int*      live    = c->sparse ?
+                        (int*)realloc(c->live, sizeof(int) * (nBlocks + 1)) : 0;
+
+    if (live == 0)
+    {   // not sparse (or out of memory: plans count every tap)
+        free(c->live);
+        c->live = 0;
+        return;
+    }
+
+    c->live = live;
+    live[0] = 0;
+
+    for (int b = 0; b < nBlocks; ++b)
+    {
+        int nonzero = 0;
+
+        for (int k = b * hof_fir_pad;
+             !nonzero && k < (b + 1) * hof_fir_pad && k < c->used; ++k)
+        {
+            nonzero = (c->coefs[k * c->stride] != 0.f);
+        }
+
+        live[b + 1] = live[b] + nonzero;
+    }
+}
+
+/*
+ * plan, and build the stages the plan needs (stages that keep their size keep
+ * their history too). if anything fails, the filter falls back to direct
+ * form only.
+ */
+static int convolver_replan(hof_convolver* c)
+{
+    t_convolver_plan plan;
+    int              keep = 0;
+    int              ok   = 1;
+
+    convolver_plan(&plan, c->used, c->sparse ? c->live : 0, c->budget);
+
+    while (keep < c->nStages && keep < plan.nStages &&
+           c->stages[keep]->size == plan.sizes[keep])
+    {
+        ++keep;
+    }
+
+    for (int s = keep; s < c->nStages; ++s)
+    {
+        hof_conv_free(c->stages[s]);
+    }
+
+    c->nStages = keep;
+
+    for (int s = 0; s < plan.nStages && ok; ++s)
+    {
+        const int end = (s + 1 < plan.nStages) ? plan.offsets[s + 1]
+                                               : c->used;
+
+        if (s == c->nStages)
+        {
+            c->stages[s] = hof_conv_new(plan.sizes[s]);
+
+            if (c->stages[s] == 0)
+            {
+                ok = 0;
+                break;
+            }
+
+            c->nStages += 1;
+        }
+
+        c->offsets[s] = plan.offsets[s];
+        ok = hof_conv_set_coefs(c->stages[s],
+                                c->coefs + plan.offsets[s] * c->stride,
+                                end - plan.offsets[s], c->stride);
+    }
+
+    if (!ok)
+    {   // direct form only
+        for (int s = 0; s < c->nStages; ++s)
+        {
+            hof_conv_free(c->stages[s]);
+        }
+
+        c->nStages   = 0;
+        plan.head    = c->used;
+        plan.latency = 0;
+    }
+
+    c->latency = plan.latency;
+    return hof_fir_set_coefs(c->head, c->coefs, plan.head, c->stride) && ok;
+}
+
+void hof_convolver_process(hof_convolver* c, const float* in, float* out,
+                           int nSamples)
+{
+#ifdef HOF_STATS
+    const double time = hof_now_ns();
+    float* const first = out;
+#endif
+
+    while (nSamples > 0)
+    {
+        const int n = (nSamples < convolver_chunk) ? nSamples
+                                                   : convolver_chunk;
+
+        memcpy(c->input, in, sizeof(float) * n);
+        hof_fir_process(c->head, (const float* const*)&c->input, &out, n);
+
+        for (int s = 0; s < c->nStages; ++s)
+        {
+            hof_conv_process(c->stages[s], c->input, c->sum, n);
+
+            for (int k = 0; k < n; ++k)
+            {
+                out[k] += c->sum[k];
+            }
+        }
+
+        in       += n;
+        out      += n;
+        nSamples -= n;
+    }
+
+#ifdef HOF_STATS
+    hof_stats_block(&c->stats, time, (float* const*)&first, 1,
+                    (int)(out - first));
+#endif
+}
+
+int hof_convolver_set_coefs(hof_convolver* c, const float* coefs, int order,
+                            int stride)
+{
+    c->coefs  = (order > 0) ? coefs : 0;
+    c->order  = (coefs != 0 && order > 0) ? order : 0;
+    c->stride = stride;
+    convolver_analyze(c);
+
+#ifdef HOF_STATS
+    c->stats.nUpdates += 1;
+#endif
+
+    return convolver_replan(c);
+}
+
+int hof_convolver_set_budget(hof_convolver* c, int budget)
+{
+    c->budget = (budget < 0) ? -1 : budget;
+    return convolver_replan(c);
+}
+
+int hof_convolver_set_trim(hof_convolver* c, float threshold)
+{
+    c->trim = (threshold < 0.f) ? threshold : 0.f;
+    convolver_analyze(c);
+    return convolver_replan(c);
+}
+
+int hof_convolver_set_sparse(hof_convolver* c, int sparse)
+{
+    c->sparse = (sparse != 0);
+    hof_fir_set_sparse(c->head, c->sparse);
+    convolver_analyze(c);
+    return convolver_replan(c);
+}
+
+int hof_convolver_taps(const hof_convolver* c)
+{
+    const hof_fir* head = c->head;
+
+    return c->used - ((head->coefs != 0) ? head->order - hof_fir_taps(head)
+                                         : 0);
+}
+
+void hof_convolver_set_costs(float butterfly, float bin)
+{
+    if (butterfly > 0.f && bin > 0.f)
+    {
+        convolver_butterfly = butterfly;
+        convolver_bin       = bin;
+    }
+}
+
+void hof_convolver_reset(hof_convolver* c)
+{
+    hof_fir_reset(c->head);
+
+    for (int s = 0; s < c->nStages; ++s)
+    {
+        hof_conv_reset(c->stages[s]);
+    }
+}
+
+hof_convolver* hof_convolver_new(void)
+{
+    hof_convolver* c = (hof_convolver*)calloc(1, sizeof(hof_convolver));
+
+    if (c == 0)
+    {
+        return 0;
+    }
+
+    c->stride = 1;
+    c->budget = -1;
+    c->head   = hof_fir_new(1);
+    c->input  = (float*)hof_calloc_aligned(sizeof(float) * convolver_chunk);
+    c->sum    = (float*)hof_calloc_aligned(sizeof(float) * convolver_chunk);
+
+#ifdef HOF_STATS
+    hof_stats_reset(&c->stats);
+#endif
+
+    if (c->head == 0 || c->input == 0 || c->sum == 0)
+    {
+        hof_convolver_free(c);
+        return 0;
+    }
+
+    return c;
+}
+
+void hof_convolver_free(hof_convolver* c)
+{
+    if (c != 0)
+    {
+        for (int s = 0; s < c->nStages; ++s)
+        {
+            hof_conv_free(c->stages[s]);
+        }
+
+        hof_fir_free(c->head);
+        hof_free_aligned(c->input);
+        hof_free_aligned(c->sum);
+        free(c->live);
+        free(c);
+    }
+}
+
+// convolution matrices --------------------------------------------------------
+/*
+ * hof_conv's overlap-save, with one frequency domain delay line per input
+ * (as deep as the longest filter), shared by every output. each output's
+ * spectrum sums every input's contribution, then gets one inverse transform.
+ */
+static void convmatrix_block(hof_convmatrix* m)
+{
+    const int size  = 2 * m->size;
+    const int depth = m->depth;
+
+    m->slot = (m->slot + depth - 1) % depth;
+
+    for (int i = 0; i < m->nInputs; ++i)
+    {
+        float* input = m->input + i * size;
+
+        hof_fft_forward(m->fft, input, m->fdl + (i * depth + m->slot) * size);
+        memcpy(input, input + m->size, sizeof(float) * m->size);
+    }
+
+    for (int o = 0; o < m->nOutputs; ++o)
+    {
+        memset(m->spectrum, 0, sizeof(float) * size);
+
+        for (int i = 0; i < m->nInputs; ++i)
+        {
+            const int    pair = o * m->nInputs + i;
+            const float* fdl  = m->fdl + i * depth * size;
+
+            for (int p = 0; p < m->nParts[pair]; ++p)
+            {
+                hof_spectrum_mac(m->spectrum,
+                                 fdl + ((m->slot + p) % depth) * size,
+                                 m->parts[pair] + p * size, size);
+            }
+        }
+
+        // the second half of the inverse is the next partition of output
+        float* output = m->output + o * m->size;
+
+        hof_fft_inverse(m->fft, m->spectrum, m->spectrum);
+        memcpy(output, m->spectrum + m->size, sizeof(float) * m->size);
+    }
+}
+
+/*
+ * make every input's delay line 'depth' partitions deep (clearing them if
+ * that changes).
+ */
+static int convmatrix_deepen(hof_convmatrix* m, const int depth)
+{
+    if (depth == m->depth)
+    {
+        return 1;
+    }
+
+    float* fdl = (float*)hof_calloc_aligned(sizeof(float) * 2 * m->size *
+                                            depth * m->nInputs);
+
+    if (fdl == 0)
+    {
+        return 0;
+    }
+
+    hof_free_aligned(m->fdl);
+    m->fdl   = fdl;
+    m->depth = depth;
+    m->slot  = 0;
+    return 1;
+}
+
+void hof_convmatrix_process(hof_convmatrix* m, const float* const* in,
+                            float* const* out, int nSamples)
+{
+#ifdef HOF_STATS
+    const double time = hof_now_ns();
+#endif
+
+    for (int done = 0; done < nSamples; )
+    {   // up to the end of this partition (every input before any output)
+        const int n = (m->size - m->pos < nSamples - done) ? m->size - m->pos
+                                                           : nSamples - done;
+
+        for (int i = 0; i < m->nInputs; ++i)
+        {
+            memcpy(m->input + i * 2 * m->size + m->size + m->pos, in[i] + done,
+                   sizeof(float) * n);
+        }
+
+        for (int o = 0; o < m->nOutputs; ++o)
+        {
+            memcpy(out[o] + done, m->output + o * m->size + m->pos,
+                   sizeof(float) * n);
+        }
+
+        done   += n;
+        m->pos += n;
+
+        if (m->pos == m->size)
+        {
+            convmatrix_block(m);
+            m->pos = 0;
+        }
+    }
+
+#ifdef HOF_STATS
+    hof_stats_block(&m->stats, time, out, m->nOutputs, nSamples);
+#endif
+}
+
+int hof_convmatrix_set_coefs(hof_convmatrix* m, int input, int output,
+                             const float* coefs, int order, int stride)
+{
+    if (input < 0 || input >= m->nInputs || output < 0 ||
+        output >= m->nOutputs)
+    {   // no such pair
+        return 0;
+    }
+
+    const int pair   = output * m->nInputs + input;
+    const int nParts = (coefs == 0 || order < 1) ? 0
+                                                 : (order + m->size - 1) /
+                                                   m->size;
+    unsigned long long* sums = (nParts == 0) ? 0 : (unsigned long long*)
+                               malloc(sizeof(unsigned long long) * nParts);
+
+    if (nParts != 0 && sums == 0)
+    {   // failed to allocate memory
+        return 0;
+    }
+
+    for (int p = 0; p < nParts; ++p)
+    {
+        const int first = p * m->size;
+        const int n     = (order - first < m->size) ? order - first : m->size;
+
+        sums[p] = hof_cache_hash(coefs + first * stride, n, stride);
+    }
+
+    // (the old checksums are only good for the same number of partitions)
+    const int same = (nParts == m->nParts[pair] && m->sums[pair] != 0);
+
+    if (nParts != m->nParts[pair])
+    {
+        float* parts = (nParts == 0) ? 0 :
+            (float*)hof_calloc_aligned(sizeof(float) * 2 * m->size * nParts);
+
+        if (nParts != 0 && parts == 0)
+        {   // failed to allocate memory
+            free(sums);
+            return 0;
+        }
+
+        hof_free_aligned(m->parts[pair]);
+        m->parts[pair]  = parts;
+        m->nParts[pair] = nParts;
+    }
+
+    // the delay lines are as deep as the longest filter
+    int depth = 1;
+
+    for (int p = 0; p < m->nInputs * m->nOutputs; ++p)
+    {
+        depth = (m->nParts[p] > depth) ? m->nParts[p] : depth;
+    }
+
+    if (!convmatrix_deepen(m, depth))
+    {
+        hof_free_aligned(m->parts[pair]);
+        free(m->sums[pair]);
+        free(sums);
+        m->parts[pair]  = 0;
+        m->sums[pair]   = 0;
+        m->nParts[pair] = 0;
+        return 0;
+    }
+
+    for (int p = 0; p < nParts; ++p)
+    {
+        const int first = p * m->size;
+        const int n     = (order - first < m->size) ? order - first : m->size;
+
+        if (!same || sums[p] != m->sums[pair][p])
+        {
+            conv_transform(m->fft, m->spectrum,
+                           m->parts[pair] + p * 2 * m->size,
+                           coefs + first * stride, n, stride);
+        }
+    }
+
+    free(m->sums[pair]);
+    m->sums[pair] = sums;
+
+#ifdef HOF_STATS
+    m->stats.nUpdates += 1;
+#endif
+
+    return 1;
+}
+
+void hof_convmatrix_reset(hof_convmatrix* m)
+{
+    const int size = 2 * m->size;
+
+    memset(m->fdl, 0, sizeof(float) * size * m->depth * m->nInputs);
+    memset(m->input, 0, sizeof(float) * size * m->nInputs);
+    memset(m->output, 0, sizeof(float) * m->size * m->nOutputs);
+    m->pos = 0;
+}
+
+hof_convmatrix* hof_convmatrix_new(int nInputs, int nOutputs, int size)
+{
+    if (size < hof_fir_pad || (size & (size - 1)) != 0 || nInputs < 1 ||
+        nOutputs < 1)
+    {   // partitions must be a power of two
+        return 0;
+    }
+
+    hof_convmatrix* m = (hof_convmatrix*)calloc(1, sizeof(hof_convmatrix));
+
+    if (m == 0)
+    {
+        return 0;
+    }
+
+    const int nPairs = nInputs * nOutputs;
+
+    m->size     = size;
+    m->nInputs  = nInputs;
+    m->nOutputs = nOutputs;
+    m->fft      = hof_fft_new(2 * size);
+    m->nParts   = (int*)calloc(nPairs, sizeof(int));
+    m->parts    = (float**)calloc(nPairs, sizeof(float*));
+    m->sums     = (unsigned long long**)calloc(nPairs,
+                                               sizeof(unsigned long long*));
+    m->input    = (float*)hof_calloc_aligned(sizeof(float) * 2 * size *
+                                             nInputs);
+    m->spectrum = (float*)hof_calloc_aligned(sizeof(float) * 2 * size);
+    m->output   = (float*)hof_calloc_aligned(sizeof(float) * size * nOutputs);
+
+#ifdef HOF_STATS
+    hof_stats_reset(&m->stats);
+#endif
+
+    if (m->fft == 0 || m->nParts == 0 || m->parts == 0 || m->sums == 0 ||
+        m->input == 0 || m->spectrum == 0 || m->output == 0 ||
+        !convmatrix_deepen(m, 1))
+    {
+        hof_convmatrix_free(m);
+        return 0;
+    }
+
+    return m;
+}
+
+void hof_convmatrix_free(hof_convmatrix* m)
+{
+    if (m != 0)
+    {
+        for (int p = 0; p < m->nInputs * m->nOutputs; ++p)
+        {
+            if (m->parts != 0)
+            {
+                hof_free_aligned(m->parts[p]);
+            }
+
+            if (m->sums != 0)
+            {
+                free(m->sums[p]);
+            }
+        }
+
+        hof_fft_free(m->fft);
+        free(m->nParts);
+        free(m->parts);
+        free(m->sums);
+        hof_free_aligned(m->fdl);
+        hof_free_aligned(m->input);
+        hof_free_aligned(m->spectrum);
+        hof_free_aligned(m->output);
+        free(m);
+    }
+}
+
+// partitioned block adaptive filter -------------------------------------------
+/*
+ * the filtering is hof_conv's, with the partitions as the adapted weights.
+ * after each block, the error e = d - y is transformed (zero padded in front,
+ * which lines it up with the second half of the input transform), divided by
+ * a running estimate of the input power in each bin, and correlated with
+ * every partition's input spectrum: W(p) += mu * conj(X(p)) * E / power.
+ *
+ * done purely in the frequency domain, that correlation is circular, which
+ * would let the weights wrap around into each partition's zero padding. the
+ * proper fix (back to the time domain, clear the padding, forward again)
+ * costs two more ffts per partition, so it's done for one partition per
+ * block, in turn. the weights drift only a little between fixes.
+ */
+#define pbfdaf_smooth     0.9f // how slowly the bin powers follow the input
+#define pbfdaf_regularize 1e-6 // keeps the step finite in silence (per sample)
+
+static void pbfdaf_block(hof_pbfdaf* f)
+{
+    hof_conv* c      = f->conv;
+    const int half   = c->size;
+    const int size   = 2 * half;
+    const int nParts = c->nParts;
+
+    // filter
+    conv_block(c);
+
+    // error (which is played during the next block, with the estimate)
+    for (int n = 0; n < half; ++n)
+    {
+        f->estimate[n] = c->output[half + n];
+        f->error[n]    = f->desired[n] - f->estimate[n];
+    }
+
+    // input power in each bin (dc and nyquist are real)
+    const float* x = c->fdl + c->slot * size;
+
+    for (int k = 0; k < half; ++k)
+    {
+        const float power = (k == 0) ? x[0] * x[0]
+                                     : x[k] * x[k] + x[k + half] * x[k + half];
+        f->power[k] = pbfdaf_smooth * f->power[k] +
+                      (1.f - pbfdaf_smooth) * power;
+    }
+
+    f->power[half] = pbfdaf_smooth * f->power[half] +
+                     (1.f - pbfdaf_smooth) * x[half] * x[half];
+
+    // the error's spectrum, normalized
+    float* e = c->spectrum;
+
+    memset(e, 0, sizeof(float) * half);
+    memcpy(e + half, f->error, sizeof(float) * half);
+    hof_fft_forward(c->fft, e, f->gradient);
+
+    const float regularize = (float)(pbfdaf_regularize * size * half);
+    const float nyquist    = f->gradient[half] * f->mu /
+                             (nParts * f->power[half] + regularize);
+
+    for (int k = 0; k < half; ++k)
+    {
+        const float step = f->mu / (nParts * f->power[k] + regularize);
+        f->gradient[k]        *= step;
+        f->gradient[k + half] *= step;
+    }
+
+    f->gradient[half] = nyquist;
+
+    // adapt every partition
+    for (int p = 0; p < nParts; ++p)
+    {
+        hof_spectrum_mac_conj(c->parts + p * size,
+                              c->fdl + ((c->slot + p) % nParts) * size,
+                              f->gradient, size);
+    }
+
+    // and keep one partition's weights out of its zero padding
+    float* w = c->parts + f->constrain * size;
+
+    hof_fft_inverse(c->fft, w, e);
+    memset(e + half, 0, sizeof(float) * half);
+    hof_fft_forward(c->fft, e, w);
+    f->constrain = (f->constrain + 1) % nParts;
+}
+
+void hof_pbfdaf_process(hof_pbfdaf* f, const float* x, const float* d,
+                        float* y, float* e, int nSamples)
+{
+#ifdef HOF_STATS
+    const double time = hof_now_ns();
+#endif
+
+    hof_conv* c    = f->conv;
+    const int half = c->size;
+
+    for (int n = 0; n < nSamples; ++n)
+    {   // (read both inputs before writing, in case they're the outputs)
+        const float xn = x[n], dn = d[n];
+
+        y[n] = f->estimate[c->pos];
+        e[n] = f->error[c->pos];
+        c->input[half + c->pos] = xn;
+        f->desired[c->pos]      = dn;
+
+        if (++c->pos == half)
+        {
+            pbfdaf_block(f);
+            c->pos = 0;
+        }
+    }
+
+#ifdef HOF_STATS
+    hof_stats_block(&f->stats, time, &e, 1, nSamples);
+#endif
+}
+
+void hof_pbfdaf_set_mu(hof_pbfdaf* f, float mu)
+{
+    f->mu = clip_float(mu, 0.f, 1.f);
+}
+
+void hof_pbfdaf_get_taps(hof_pbfdaf* f, float* coefs, int nCoefs, int stride)
+{
+    hof_conv* c = f->conv;
+    float*    w = c->spectrum;
+
+    for (int p = 0; p * c->size < nCoefs; ++p)
+    {
+        if (p < c->nParts)
+        {
+            hof_fft_inverse(c->fft, c->parts + p * 2 * c->size, w);
+        }
+
+        for (int k = p * c->size; k < (p + 1) * c->size && k < nCoefs; ++k)
+        {
+            coefs[k * stride] = (p < c->nParts) ? w[k - p * c->size] : 0.f;
+        }
+    }
+}
+
+void hof_pbfdaf_reset(hof_pbfdaf* f)
+{
+    hof_conv* c = f->conv;
+
+    memset(c->parts, 0, sizeof(float) * 2 * c->size * c->nParts);
+    hof_conv_reset(c);
+    memset(f->power, 0, sizeof(float) * (c->size + 1));
+    memset(f->estimate, 0, sizeof(float) * c->size);
+    memset(f->error, 0, sizeof(float) * c->size);
+    f->constrain = 0;
+}
+
+hof_pbfdaf* hof_pbfdaf_new(int order, int size)
+{
+    hof_pbfdaf* f = (hof_pbfdaf*)calloc(1, sizeof(hof_pbfdaf));
+
+    if (f == 0)
+    {
+        return 0;
+    }
+
+    f->order    = (size > 0) ? (clip_order(order) + size - 1) / size * size
+                             : 0;
+    f->mu       = 0.5f;
+    f->conv     = hof_conv_new(size);
+    f->power    = (float*)hof_calloc_aligned(sizeof(float) * (size + 1));
+    f->desired  = (float*)hof_calloc_aligned(sizeof(float) * size);
+    f->estimate = (float*)hof_calloc_aligned(sizeof(float) * size);
+    f->error    = (float*)hof_calloc_aligned(sizeof(float) * size);
+    f->gradient = (float*)hof_calloc_aligned(sizeof(float) * 2 * size);
+
+#ifdef HOF_STATS
+    hof_stats_reset(&f->stats);
+#endif
+
+    if (f->conv == 0 || f->power == 0 || f->desired == 0 ||
+        f->estimate == 0 || f->error == 0 || f->gradient == 0 ||
+        conv_resize(f->conv, (f->order + size - 1) / size, 0, 0) == 0)
+    {
+        hof_pbfdaf_free(f);
+        return 0;
+    }
+
+    return f;
+}
+
+void hof_pbfdaf_free(hof_pbfdaf* f)
+{
+    if (f != 0)
+    {
+        hof_conv_free(f->conv);
+        hof_free_aligned(f->power);
+        hof_free_aligned(f->desired);
+        hof_free_aligned(f->estimate);
+        hof_free_aligned(f->error);
+        hof_free_aligned(f->gradient);
+        free(f);
+    }
+}
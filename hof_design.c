@@ -0,0 +1,1457 @@
+//------------------------------------------------------------------------------
+//  Higher Order Filter Project
+//
+//  hof_design.c: filters made from specs, and from other filters
+//  Copyright (c) 2016 Elliot Patros. All rights reserved.
+//------------------------------------------------------------------------------
+
+#include "hof.h"
+#include "hof_util.h"
+
+// minimum phase ---------------------------------------------------------------
+/*
+ * a minimum phase filter's real cepstrum (the inverse transform of its log
+ * magnitude) is causal, and any filter's is even. so: take the log of the
+ * magnitude, transform it into a cepstrum, fold the negative quefrencies onto
+ * the positive ones, and transform back. the exponential of that is a
+ * spectrum with the same magnitude, and minimum phase.
+ *
+ * the cepstrum wraps around like any other dft, so the transform is
+ * design_oversample times longer than the filter. magnitudes are floored
+ * design_floor below the peak, so zeros (which have no log) become very deep
+ * notches instead.
+ */
+#define design_oversample 16
+#define design_floor      1e-10 // -200 db
+
+int hof_minimum_phase(const float* coefs, int order, int stride, float* out,
+                      int length)
+{
+    int size = 16;
+
+    while (size < design_oversample * order)
+    {
+        size *= 2;
+    }
+
+    const int half     = size / 2;
+    hof_fft*  fft      = hof_fft_new(size);
+    float*    buffer   = (float*)hof_calloc_aligned(sizeof(float) * size);
+    float*    spectrum = (float*)hof_calloc_aligned(sizeof(float) * size);
+
+    if (fft == 0 || buffer == 0 || spectrum == 0)
+    {
+        hof_fft_free(fft);
+        hof_free_aligned(buffer);
+        hof_free_aligned(spectrum);
+        return 0;
+    }
+
+    for (int k = 0; k < order; ++k)
+    {
+        buffer[k] = coefs[k * stride];
+    }
+
+    hof_fft_forward(fft, buffer, spectrum);
+
+    // log magnitudes (bin 0 and nyquist are real: see hof_fft)
+    float peak = 0.f;
+
+    for (int k = 0; k < half; ++k)
+    {
+        const float re = spectrum[k];
+        const float im = (k == 0) ? 0.f : spectrum[half + k];
+        const float nyquist = (k == 0) ? fabsf(spectrum[half]) : 0.f;
+
+        peak = fmaxf(peak, fmaxf(sqrtf(re * re + im * im), nyquist));
+    }
+
+    const float least = (float)(peak * design_floor);
+
+    for (int k = 0; k < half && peak > 0.f; ++k)
+    {
+        const float re = spectrum[k];
+        const float im = (k == 0) ? 0.f : spectrum[half + k];
+
+        if (k == 0)
+        {
+            spectrum[half] = logf(fmaxf(fabsf(spectrum[half]), least));
+        }
+        else
+        {
+            spectrum[half + k] = 0.f;
+        }
+
+        spectrum[k] = logf(fmaxf(sqrtf(re * re + im * im), least));
+    }
+
+    // fold the cepstrum, then back to a (log) spectrum
+    hof_fft_inverse(fft, spectrum, buffer);
+
+    for (int n = 1; n < half; ++n)
+    {
+        buffer[n]       *= 2.f;
+        buffer[half + n] = 0.f;
+    }
+
+    hof_fft_forward(fft, buffer, spectrum);
+
+    for (int k = 0; k < half && peak > 0.f; ++k)
+    {
+        if (k == 0)
+        {
+            spectrum[0]    = expf(spectrum[0]);
+            spectrum[half] = expf(spectrum[half]);
+        }
+        else
+        {
+            const float magnitude = expf(spectrum[k]);
+            const float phase     = spectrum[half + k];
+
+            spectrum[k]        = magnitude * cosf(phase);
+            spectrum[half + k] = magnitude * sinf(phase);
+        }
+    }
+
+    if (peak > 0.f)
+    {
+        hof_fft_inverse(fft, spectrum, buffer);
+    }
+
+    for (int n = 0; n < length; ++n)
+    {   // (silence stays silent)
+        out[n] = (n < size && peak > 0.f) ? buffer[n] : 0.f;
+    }
+
+    hof_fft_free(fft);
+    hof_free_aligned(buffer);
+    hof_free_aligned(spectrum);
+    return 1;
+}
+
+// peak fitting ----------------------------------------------------------------
+/*
+ * the filter's response is measured on fit_points frequencies, spaced evenly
+ * in octaves from fit_lowest Hz. to fit_highest of the sample rate, each the
+ * average power of the fft bins around it (so about a tenth of an octave of
+ * smoothing). peaks are added one at a time, each tried at the few biggest
+ * bumps in the difference, and after each try every peak so far is solved
+ * for at once (levenberg-marquardt) and the best try is kept. then each peak
+ * is taken out and put back the same way, in case a later one showed it
+ * somewhere better. the gain is always whatever leaves the difference with
+ * an average of 0 db.
+ */
+#define fit_points  128
+#define fit_lowest  20.f
+#define fit_highest 0.45f // (of the sample rate)
+#define fit_floor   60.f  // db below the loudest point that are ignored
+#define fit_rounds  50    // steps (at most) each time the peaks are solved
+#define fit_tries   4     // places tried for each new peak
+
+typedef struct fit
+{
+    float  sr;                 // sample rate (Hz.)
+    double phi[fit_points];    // sin(w/2)^2 at each point
+    double target[fit_points]; // the filter's response (dB)
+    double sum[fit_points];    // every peak's response (dB)
+
+} t_fit;
+
+// the response of a peak filter (dB) at every point
+static void fit_response(const t_fit* fit, const float* param, double* dB)
+{
+    float b[3];
+    float a[2];
+
+    hof_biquad_coefs(hof_peak, param, fit->sr, b, a);
+
+    for (int i = 0; i < fit_points; ++i)
+    {   // (in powers of sin(w/2)^2, which keeps low frequencies accurate)
+        const double p   = fit->phi[i];
+        const double b1  = (double)b[0] + b[1] + b[2];
+        const double a1  = 1. + a[0] + a[1];
+        const double num = b1 * b1 - 4. * p * (b[0] * (double)b[1] +
+                           4. * b[0] * (double)b[2] + b[1] * (double)b[2]) +
+                           16. * p * p * b[0] * (double)b[2];
+        const double den = a1 * a1 - 4. * p * (a[0] + 4. * a[1] +
+                           a[0] * (double)a[1]) + 16. * p * p * a[1];
+
+        dB[i] = 10. * log10((num > 1e-30 ? num : 1e-30) / den);
+    }
+}
+
+// squared difference left, with the best gain (the mean is taken out)
+static double fit_error(const t_fit* fit)
+{
+    double sum     = 0.;
+    double squares = 0.;
+
+    for (int i = 0; i < fit_points; ++i)
+    {
+        const double r = fit->target[i] - fit->sum[i];
+        sum     += r;
+        squares += r * r;
+    }
+
+    return squares - sum * sum / fit_points;
+}
+
+// the response of 'order' coefficients (dB) at every point
+static int fit_target(t_fit* fit, const float* coefs, const int order,
+                      const int stride)
+{
+    int size = 16384;
+
+    while (size < 2 * order)
+    {
+        size *= 2;
+    }
+
+    const int half     = size / 2;
+    hof_fft*  fft      = hof_fft_new(size);
+    float*    buffer   = (float*)hof_calloc_aligned(sizeof(float) * size);
+    float*    spectrum = (float*)hof_calloc_aligned(sizeof(float) * size);
+
+    if (fft == 0 || buffer == 0 || spectrum == 0)
+    {
+        hof_fft_free(fft);
+        hof_free_aligned(buffer);
+        hof_free_aligned(spectrum);
+        return 0;
+    }
+
+    for (int k = 0; k < order; ++k)
+    {
+        buffer[k] = coefs[k * stride];
+    }
+
+    hof_fft_forward(fft, buffer, spectrum);
+
+    for (int k = 0; k < half; ++k)
+    {   // power (nyquist ends up in buffer[half])
+        buffer[k] = (k == 0) ? spectrum[0] * spectrum[0]
+                             : spectrum[k] * spectrum[k] +
+                               spectrum[half + k] * spectrum[half + k];
+    }
+
+    buffer[half] = spectrum[half] * spectrum[half];
+
+    const double ratio   = fit_highest * fit->sr / fit_lowest;
+    double       loudest = -1e30;
+
+    for (int i = 0; i < fit_points; ++i)
+    {   // the bins half way (in octaves) to the neighbouring points
+        const double bin  = size / fit->sr;
+        const double step = pow(ratio, 0.5 / (fit_points - 1));
+        const double f    = fit_lowest * pow(step, 2. * i);
+        const double lo   = f / step * bin;
+        const double hi   = f * step * bin;
+        const double w    = 2. * M_PI * f / fit->sr;
+        double       power = 0.;
+        int          n     = 0;
+
+        for (int k = (int)ceil(lo); k < hi && k <= half; ++k, ++n)
+        {
+            power += buffer[k];
+        }
+
+        if (n == 0)
+        {   // narrower than a bin: between the two nearest
+            const double x = f * bin;
+            const int    k = (x < half) ? (int)x : half - 1;
+            power = buffer[k] + (x - k) * (buffer[k + 1] - buffer[k]);
+            n     = 1;
+        }
+
+        fit->phi[i]    = sin(w / 2.) * sin(w / 2.);
+        fit->target[i] = 10. * log10(power / n + 1e-30);
+        fit->sum[i]    = 0.;
+        loudest        = (fit->target[i] > loudest) ? fit->target[i] : loudest;
+    }
+
+    for (int i = 0; i < fit_points; ++i)
+    {
+        fit->target[i] = (fit->target[i] > loudest - fit_floor) ?
+                         fit->target[i] : loudest - fit_floor;
+    }
+
+    hof_fft_free(fft);
+    hof_free_aligned(buffer);
+    hof_free_aligned(spectrum);
+    return 1;
+}
+
+// clip a peak's parameters to what the fit allows
+static void fit_clip(const t_fit* fit, float* p)
+{
+    p[hof_freq] = clip_float(p[hof_freq], fit_lowest, fit_highest * fit->sr);
+    p[hof_Q]    = clip_float(p[hof_Q], 0.2f, 20.f);
+    p[hof_dB]   = clip_float(p[hof_dB], -24.f, 24.f);
+}
+
+// move parameter 'j' (of 3 per peak) by 'step' octaves (or db)
+static void fit_move(float* param, const int j, const double step)
+{
+    float* p = param + (j / 3) * hof_nParams;
+
+    switch (j % 3)
+    {
+        case 0:  p[hof_freq] *= (float)pow(2., step); break;
+        case 1:  p[hof_Q]    *= (float)pow(2., step); break;
+        default: p[hof_dB]   += (float)step;          break;
+    }
+}
+
+// solve a * x = y by cholesky, in place (returns 0 if a isn't positive)
+static int fit_cholesky(double* a, double* x, const double* y, const int n)
+{
+    for (int j = 0; j < n; ++j)
+    {
+        double d = a[j * n + j];
+
+        for (int k = 0; k < j; ++k)
+        {
+            d -= a[j * n + k] * a[j * n + k];
+        }
+
+        if (!(d > 0.))
+        {
+            return 0;
+        }
+
+        a[j * n + j] = sqrt(d);
+
+        for (int i = j + 1; i < n; ++i)
+        {
+            double v = a[i * n + j];
+
+            for (int k = 0; k < j; ++k)
+            {
+                v -= a[i * n + k] * a[j * n + k];
+            }
+
+            a[i * n + j] = v / a[j * n + j];
+        }
+    }
+
+    for (int i = 0; i < n; ++i)
+    {
+        double v = y[i];
+
+        for (int k = 0; k < i; ++k)
+        {
+            v -= a[i * n + k] * x[k];
+        }
+
+        x[i] = v / a[i * n + i];
+    }
+
+    for (int i = n - 1; i >= 0; --i)
+    {
+        double v = x[i];
+
+        for (int k = i + 1; k < n; ++k)
+        {
+            v -= a[k * n + i] * x[k];
+        }
+
+        x[i] = v / a[i * n + i];
+    }
+
+    return 1;
+}
+
+/*
+ * adjust all 'nPeaks' peaks at once (levenberg-marquardt), with frequency and
+ * Q in octaves and dB in dB. the gain is left out: it's always the mean of
+ * the difference, so the derivatives lose their means too. 'dB' holds each
+ * peak's response.
+ */
+static void fit_solve(t_fit* fit, float* param, double* dB, const int nPeaks)
+{
+    const int n      = 3 * nPeaks;
+    const int nBytes = sizeof(double) * (fit_points * (n + 1 + nPeaks) +
+                                         n * n + 3 * n);
+    double*   J      = (double*)malloc(nBytes);
+    float     trial[hof_fit_max_peaks * hof_nParams];
+    double    lambda = 1e-3;
+    double    error  = fit_error(fit);
+
+    if (J == 0)
+    {
+        return;
+    }
+
+    double* r     = J + fit_points * n;
+    double* moved = r + fit_points;          // each peak's trial response
+    double* A     = moved + fit_points * nPeaks;
+    double* g     = A + n * n;
+    double* x     = g + n;
+    double* diag  = x + n;
+
+    for (int round = 0; round < fit_rounds && lambda < 1e10; ++round)
+    {
+        double mean = 0.;
+
+        for (int i = 0; i < fit_points; ++i)
+        {
+            r[i]  = fit->target[i] - fit->sum[i];
+            mean += r[i] / fit_points;
+        }
+
+        for (int i = 0; i < fit_points; ++i)
+        {
+            r[i] -= mean;
+        }
+
+        for (int j = 0; j < n; ++j)
+        {   // (forward differences, a thousandth of an octave or db)
+            double* col  = moved;
+            double* mine = dB + (j / 3) * fit_points;
+            double  avg  = 0.;
+
+            memcpy(trial, param, sizeof(float) * nPeaks * hof_nParams);
+            fit_move(trial, j, 1e-3);
+            fit_clip(fit, trial + (j / 3) * hof_nParams);
+            fit_response(fit, trial + (j / 3) * hof_nParams, col);
+
+            for (int i = 0; i < fit_points; ++i)
+            {
+                J[i * n + j] = (col[i] - mine[i]) * 1e3;
+                avg         += J[i * n + j] / fit_points;
+            }
+
+            for (int i = 0; i < fit_points; ++i)
+            {
+                J[i * n + j] -= avg;
+            }
+        }
+
+        for (int j = 0; j < n; ++j)
+        {
+            g[j] = 0.;
+
+            for (int i = 0; i < fit_points; ++i)
+            {
+                g[j] += J[i * n + j] * r[i];
+            }
+
+            for (int k = 0; k <= j; ++k)
+            {
+                double v = 0.;
+
+                for (int i = 0; i < fit_points; ++i)
+                {
+                    v += J[i * n + j] * J[i * n + k];
+                }
+
+                A[j * n + k] = A[k * n + j] = v;
+            }
+
+            diag[j] = A[j * n + j];
+        }
+
+        // try steps, shorter each time, until one is better
+        int better = 0;
+
+        while (!better && lambda < 1e10)
+        {
+            for (int j = 0; j < n; ++j)
+            {
+                for (int k = 0; k < j; ++k)
+                {   // (cholesky overwrote the lower half last time)
+                    A[j * n + k] = A[k * n + j];
+                }
+
+                A[j * n + j] = diag[j] + lambda * (diag[j] + 1e-9);
+            }
+
+            if (!fit_cholesky(A, x, g, n))
+            {
+                lambda *= 4.;
+                continue;
+            }
+
+            memcpy(trial, param, sizeof(float) * nPeaks * hof_nParams);
+
+            for (int j = 0; j < n; ++j)
+            {
+                fit_move(trial, j, x[j]);
+            }
+
+            for (int k = 0; k < nPeaks; ++k)
+            {
+                fit_clip(fit, trial + k * hof_nParams);
+                fit_response(fit, trial + k * hof_nParams,
+                             moved + k * fit_points);
+            }
+
+            // swap the trial in, and keep it if it's better
+            for (int k = 0; k < nPeaks * fit_points; ++k)
+            {
+                fit->sum[k % fit_points] += moved[k] - dB[k];
+            }
+
+            const double e = fit_error(fit);
+
+            if (e < error)
+            {
+                better = 1;
+                lambda = (lambda > 1e-9) ? lambda / 3. : lambda;
+                memcpy(param, trial, sizeof(float) * nPeaks * hof_nParams);
+                memcpy(dB, moved, sizeof(double) * nPeaks * fit_points);
+            }
+            else
+            {
+                lambda *= 4.;
+
+                for (int k = 0; k < nPeaks * fit_points; ++k)
+                {
+                    fit->sum[k % fit_points] -= moved[k] - dB[k];
+                }
+            }
+
+            if (better && error - e < 1e-9 * error)
+            {   // (as good as it gets)
+                lambda = 1e10;
+            }
+
+            error = better ? e : error;
+        }
+    }
+
+    free(J);
+}
+
+// every peak's response but 'skip' (-1 for none), into fit->sum
+static void fit_sum(t_fit* fit, const double* dB, const int nPeaks,
+                    const int skip)
+{
+    for (int i = 0; i < fit_points; ++i)
+    {
+        fit->sum[i] = 0.;
+    }
+
+    for (int k = 0; k < nPeaks; ++k)
+    {
+        for (int i = 0; i < fit_points && k != skip; ++i)
+        {
+            fit->sum[i] += dB[k * fit_points + i];
+        }
+    }
+}
+
+// a new peak at point 'top', as high and wide as the difference there
+static void fit_place(t_fit* fit, float* p, double* dB, const int top)
+{
+    const double ratio = fit_highest * fit->sr / fit_lowest;
+    double       mean  = 0.;
+
+    for (int i = 0; i < fit_points; ++i)
+    {
+        mean += (fit->target[i] - fit->sum[i]) / fit_points;
+    }
+
+    // its width is where the difference falls to half
+    const double height = fit->target[top] - fit->sum[top] - mean;
+    int          lo     = top;
+    int          hi     = top;
+
+    while (lo > 0 && (fit->target[lo] - fit->sum[lo] - mean) / height > 0.5)
+    {
+        --lo;
+    }
+
+    while (hi < fit_points - 1 &&
+           (fit->target[hi] - fit->sum[hi] - mean) / height > 0.5)
+    {
+        ++hi;
+    }
+
+    const double octaves = log2(ratio) * (hi - lo + 1) / (fit_points - 1);
+
+    p[hof_freq] = fit_lowest * (float)pow(ratio,
+                                          (double)top / (fit_points - 1));
+    p[hof_Q]    = (float)(1. / (pow(2., octaves / 2.) -
+                                pow(2., -octaves / 2.)));
+    p[hof_dB]   = (float)height;
+
+    fit_clip(fit, p);
+    fit_response(fit, p, dB);
+
+    for (int i = 0; i < fit_points; ++i)
+    {
+        fit->sum[i] += dB[i];
+    }
+}
+
+// the (up to) fit_tries biggest bumps in the difference, either way
+static int fit_bumps(const t_fit* fit, int* top)
+{
+    double r[fit_points];
+    double mean  = 0.;
+    int    nTops = 0;
+
+    for (int i = 0; i < fit_points; ++i)
+    {
+        mean += (fit->target[i] - fit->sum[i]) / fit_points;
+    }
+
+    for (int i = 0; i < fit_points; ++i)
+    {
+        r[i] = fabs(fit->target[i] - fit->sum[i] - mean);
+    }
+
+    for (int i = 0; i < fit_points; ++i)
+    {
+        int k = nTops;
+
+        if ((i > 0 && r[i] < r[i - 1]) ||
+            (i < fit_points - 1 && r[i] <= r[i + 1]))
+        {   // (not the top of a bump)
+            continue;
+        }
+
+        for (; k > 0 && r[i] > r[top[k - 1]]; --k)
+        {
+            if (k < fit_tries)
+            {
+                top[k] = top[k - 1];
+            }
+        }
+
+        if (k < fit_tries)
+        {
+            top[k] = i;
+            nTops  = (nTops < fit_tries) ? nTops + 1 : nTops;
+        }
+    }
+
+    return nTops;
+}
+
+/*
+ * put peak 's' of 'nPeaks' (again), at whichever of the biggest bumps in the
+ * difference fits best once every peak is solved again. the other peaks are
+ * in 'param' and 'dB', whose second and third halves are room for the
+ * starting point and the best so far. returns the squared difference.
+ */
+static double fit_add(t_fit* fit, float* param, double* dB, const int s,
+                      const int nPeaks)
+{
+    const size_t nParams = nPeaks * hof_nParams;
+    const size_t nCurves = nPeaks * fit_points;
+    float*       start   = param + nParams;
+    float*       best    = start + nParams;
+    double*      startDB = dB + nCurves;
+    double*      bestDB  = startDB + nCurves;
+    double       least   = -1.;
+    int          top[fit_tries];
+
+    fit_sum(fit, dB, nPeaks, s);
+
+    const int nTops = fit_bumps(fit, top);
+
+    memcpy(start, param, sizeof(float) * nParams);
+    memcpy(startDB, dB, sizeof(double) * nCurves);
+
+    for (int t = 0; t < nTops; ++t)
+    {
+        memcpy(param, start, sizeof(float) * nParams);
+        memcpy(dB, startDB, sizeof(double) * nCurves);
+        fit_sum(fit, dB, nPeaks, s);
+        fit_place(fit, param + s * hof_nParams, dB + s * fit_points, top[t]);
+        fit_solve(fit, param, dB, nPeaks);
+
+        const double e = fit_error(fit);
+
+        if (least < 0. || e < least)
+        {
+            least = e;
+            memcpy(best, param, sizeof(float) * nParams);
+            memcpy(bestDB, dB, sizeof(double) * nCurves);
+        }
+    }
+
+    if (nTops == 0)
+    {   // (nothing left to fit)
+        param[s * hof_nParams + hof_dB] = 0.f;
+        fit_response(fit, param + s * hof_nParams, dB + s * fit_points);
+        fit_sum(fit, dB, nPeaks, -1);
+        return fit_error(fit);
+    }
+
+    memcpy(param, best, sizeof(float) * nParams);
+    memcpy(dB, bestDB, sizeof(double) * nCurves);
+    fit_sum(fit, dB, nPeaks, -1);
+    return least;
+}
+
+float hof_fit_peaks(const float* coefs, int order, int stride, float sr,
+                    int nSections, float* param)
+{
+    const int n   = (nSections > 0) ? nSections : 1;
+    t_fit*    fit = (t_fit*)malloc(sizeof(t_fit));
+    double*   dB  = (double*)malloc(sizeof(double) * fit_points * 3 * n);
+    float*    p   = (float*)malloc(sizeof(float) * hof_nParams * 3 * n);
+
+    if (fit == 0 || dB == 0 || p == 0 || nSections > hof_fit_max_peaks ||
+        (fit->sr = sr, !fit_target(fit, coefs, order, stride)))
+    {
+        free(fit);
+        free(dB);
+        free(p);
+        return -1.f;
+    }
+
+    fit_sum(fit, dB, 0, -1);
+
+    for (int s = 0; s < nSections; ++s)
+    {   // one more peak, where it helps most
+        fit_add(fit, p, dB, s, s + 1);
+    }
+
+    /*
+     * then each peak is taken out and put back, in case an early one settled
+     * somewhere a later one does better. it stays only if the whole fit
+     * improves.
+     */
+    for (int s = 0; s < nSections && nSections > 1; ++s)
+    {
+        const size_t nParams = sizeof(float) * hof_nParams * nSections;
+        const size_t nCurves = sizeof(double) * fit_points * nSections;
+        const double error   = fit_error(fit);
+
+        memcpy(param, p, nParams);
+        memcpy(dB + 2 * nSections * fit_points, dB, nCurves);
+
+        if (fit_add(fit, p, dB, s, nSections) >= error)
+        {
+            memcpy(p, param, nParams);
+            memcpy(dB, dB + 2 * nSections * fit_points, nCurves);
+            fit_sum(fit, dB, nSections, -1);
+        }
+    }
+
+    // the gain, and what's left
+    double gain = 0.;
+
+    for (int i = 0; i < fit_points; ++i)
+    {
+        gain += (fit->target[i] - fit->sum[i]) / fit_points;
+    }
+
+    const float error = (float)sqrt(fit_error(fit) / fit_points);
+
+    memcpy(param, p, sizeof(float) * hof_nParams * nSections);
+    param[nSections * hof_nParams] = (float)gain;
+    free(fit);
+    free(dB);
+    free(p);
+    return error;
+}
+
+// windowed sinc ---------------------------------------------------------------
+/*
+ * a kaiser window's ripple is the same in both bands, so it's designed for
+ * whichever of the two is stricter. kaiser's formulas give its shape (beta)
+ * and length from that attenuation and the transition width.
+ */
+// zeroth order modified bessel function of the first kind (its series)
+static double design_bessel(const double x)
+{
+    double sum  = 1.;
+    double term = 1.;
+
+    for (int k = 1; k < 64 && term > 1e-12 * sum; ++k)
+    {
+        term *= (x / (2. * k)) * (x / (2. * k));
+        sum  += term;
+    }
+
+    return sum;
+}
+
+// attenuation (dB) a kaiser design needs to meet both bands
+static double design_attenuation(const hof_fir_spec* spec)
+{
+    const double g      = pow(10., spec->ripple / 20.);
+    const double ripple = -20. * log10((g - 1.) / (g + 1.));
+
+    return (spec->stop > ripple) ? spec->stop : ripple;
+}
+
+// an ideal lowpass with cutoff 'fc', 'n' samples from the middle
+static double design_sinc(const double fc, const int n)
+{
+    return (n == 0) ? 2. * fc : sin(2. * M_PI * fc * n) / (M_PI * n);
+}
+
+static void design_kaiser(const hof_fir_spec* spec, float* h, const int order)
+{
+    const double A    = design_attenuation(spec);
+    const double beta = (A > 50.) ? 0.1102 * (A - 8.7) :
+                        (A > 21.) ? 0.5842 * pow(A - 21., 0.4) +
+                                    0.07886 * (A - 21.) : 0.;
+    const int    M    = order / 2;
+    const double norm = design_bessel(beta);
+
+    for (int n = -M; n <= M; ++n)
+    {
+        const double r = (double)n / M;
+        const double w = design_bessel(beta * sqrt(1. - r * r)) / norm;
+        const double d = (n == 0) ? 1. : 0.;
+        double       ideal;
+
+        switch (spec->type)
+        {
+            case hof_highpass:
+                ideal = d - design_sinc(spec->low, n);
+                break;
+            case hof_bandpass:
+                ideal = design_sinc(spec->high, n) - design_sinc(spec->low, n);
+                break;
+            case hof_notch:
+                ideal = d - design_sinc(spec->high, n) +
+                        design_sinc(spec->low, n);
+                break;
+            default:
+                ideal = design_sinc(spec->low, n);
+                break;
+        }
+
+        h[M + n] = (float)(ideal * w);
+    }
+}
+
+// equiripple ------------------------------------------------------------------
+/*
+ * the parks-mcclellan (remez exchange) algorithm, for odd lengths (so the
+ * delay is a whole number of samples). the response is a polynomial in
+ * cos(w) of degree M = order / 2, and the best one has M + 2 frequencies
+ * where the weighted error is largest, with alternating signs. starting from
+ * any M + 2 frequencies (on a dense grid of the bands), the polynomial with
+ * equal and opposite errors there is found by (barycentric) interpolation,
+ * then the peaks of its error become the next frequencies, until they stop
+ * moving. the stopbands are weighted so both bands' ripples meet the spec
+ * together. the (equal) error should only grow from one exchange to the
+ * next, so if it collapses instead, rounding has won (which happens to
+ * designs thousands of taps long), and the design stops there.
+ */
+#define design_density 16  // grid points per extremal
+#define design_passes  100 // most exchanges per design
+#define design_tries   24  // most lengths tried per design
+
+typedef struct remez
+{
+    int     nGrid;   // grid points
+    double* x;       // cos(w) at each
+    double* want;    // the response wanted there
+    double* weight;  // and its weight
+    double* error;   // the weighted error
+    int*    extreme; // the grid points of the M + 2 extremals
+    double* ax;      // cos(w) at the M + 1 points interpolated
+    double* ay;      // the response there
+    double* aw;      // their barycentric weights
+
+} t_remez;
+
+// the spec's bands: [from, to), desired response and weight, 3 at most
+static int remez_bands(const hof_fir_spec* spec, double* edge, double* want,
+                       double* weight)
+{
+    const double h  = spec->width / 2.;
+    const double g  = pow(10., spec->ripple / 20.);
+    const double ws = ((g - 1.) / (g + 1.)) / pow(10., -spec->stop / 20.);
+    const double lo[2] = {spec->low - h, spec->low + h};
+    const double hi[2] = {spec->high - h, spec->high + h};
+    const int    pass  = (spec->type == hof_lowpass || spec->type == hof_notch);
+    int          n     = 0;
+
+    // (band, band) edges as a flat list: 0, lo[0], lo[1], (hi[0], hi[1],) 0.5
+    edge[n++] = 0.;
+    edge[n++] = lo[0];
+    edge[n++] = lo[1];
+
+    if (spec->type == hof_bandpass || spec->type == hof_notch)
+    {
+        edge[n++] = hi[0];
+        edge[n++] = hi[1];
+    }
+
+    edge[n++] = 0.5;
+
+    for (int b = 0; b < n / 2; ++b)
+    {   // alternate pass and stop, starting with 'pass'
+        const int passes = (b % 2 == 0) ? pass : !pass;
+        want[b]   = passes ? 1. : 0.;
+        weight[b] = passes ? 1. : ws;
+    }
+
+    return n / 2;
+}
+
+// interpolate the response at cos(w) = 'x' (see remez_solve)
+static double remez_response(const t_remez* r, const int n, const double x)
+{
+    double num = 0.;
+    double den = 0.;
+
+    for (int k = 0; k < n; ++k)
+    {
+        const double d = x - r->ax[k];
+
+        if (fabs(d) < 1e-14)
+        {
+            return r->ay[k];
+        }
+
+        num += r->aw[k] * r->ay[k] / d;
+        den += r->aw[k] / d;
+    }
+
+    return num / den;
+}
+
+/*
+ * the equal ripple response through the current extremals. barycentric
+ * weights are products of M + 1 differences, which over- or underflow for
+ * long filters, so they're summed as logs and scaled by the largest.
+ * returns the ripple (delta).
+ */
+static double remez_solve(t_remez* r, const int nExtremes)
+{
+    const int n   = nExtremes;
+    double    num = 0.;
+    double    den = 0.;
+    double    top = -1e300;
+
+    for (int pass = 0; pass < 2; ++pass)
+    {   // all n extremals for delta, then the first n - 1 to interpolate
+        const int m = n - pass;
+
+        for (int k = 0; k < m; ++k)
+        {
+            double logw = 0.;
+            int    sign = 1;
+
+            r->ax[k] = r->x[r->extreme[k]];
+
+            for (int j = 0; j < m; ++j)
+            {
+                const double d = r->x[r->extreme[k]] - r->x[r->extreme[j]];
+
+                if (j != k)
+                {
+                    logw -= log(fabs(d) + 1e-300);
+                    sign  = (d < 0.) ? -sign : sign;
+                }
+            }
+
+            r->aw[k] = (double)sign;
+            r->ay[k] = logw;
+            top      = (logw > top) ? logw : top;
+        }
+
+        for (int k = 0; k < m; ++k)
+        {
+            r->aw[k] *= exp(r->ay[k] - top);
+        }
+
+        if (pass == 0)
+        {
+            for (int k = 0; k < n; ++k)
+            {
+                const int i = r->extreme[k];
+                num += r->aw[k] * r->want[i];
+                den += ((k % 2 == 0) ? 1. : -1.) * r->aw[k] / r->weight[i];
+            }
+
+            top = -1e300;
+        }
+    }
+
+    const double delta = num / den;
+
+    for (int k = 0; k < n - 1; ++k)
+    {
+        const int i = r->extreme[k];
+        r->ay[k] = r->want[i] - ((k % 2 == 0) ? 1. : -1.) * delta /
+                   r->weight[i];
+    }
+
+    return delta;
+}
+
+/*
+ * the next extremals: every peak of the error at least 'least', one per sign
+ * change (the biggest), then the smaller end dropped until there are
+ * nExtremes. returns 0 if there are too few (and leaves them alone).
+ */
+static int remez_exchange(t_remez* r, const int nExtremes, const double least,
+                          int* next)
+{
+    int n = 0;
+
+    for (int i = 0; i < r->nGrid; ++i)
+    {   // (neighbours in another band don't count: pass and stop alternate)
+        const double e    = r->error[i];
+        const double prev = (i > 0 && r->want[i - 1] == r->want[i]) ?
+                            r->error[i - 1] : 0.;
+        const double post = (i < r->nGrid - 1 &&
+                             r->want[i + 1] == r->want[i]) ?
+                            r->error[i + 1] : 0.;
+
+        if (fabs(e) < least ||
+            (fabs(prev) > fabs(e) && prev * e > 0.) ||
+            (fabs(post) >= fabs(e) && post * e > 0.))
+        {   // not a peak
+            continue;
+        }
+
+        if (n > 0 && r->error[next[n - 1]] * e > 0.)
+        {   // the same sign as the last: keep the bigger
+            next[n - 1] = (fabs(e) > fabs(r->error[next[n - 1]])) ?
+                          i : next[n - 1];
+            continue;
+        }
+
+        next[n++] = i;
+    }
+
+    if (n < nExtremes)
+    {
+        return 0;
+    }
+
+    while (n > nExtremes)
+    {
+        if (fabs(r->error[next[0]]) < fabs(r->error[next[n - 1]]))
+        {
+            memmove(next, next + 1, sizeof(int) * (n - 1));
+        }
+
+        --n;
+    }
+
+    return 1;
+}
+
+/*
+ * an equiripple design of 'order' taps (odd). returns 0 if it didn't converge
+ * (or was cancelled, or out of memory).
+ */
+static int design_remez(const hof_fir_spec* spec, float* h, const int order,
+                        hof_atomic* cancel)
+{
+    const int M         = order / 2;
+    const int nExtremes = M + 2;
+    double    edge[6], want[3], weight[3];
+    const int nBands    = remez_bands(spec, edge, want, weight);
+    double    span      = 0.;
+    t_remez   r;
+
+    for (int b = 0; b < nBands; ++b)
+    {
+        span += edge[2 * b + 1] - edge[2 * b];
+    }
+
+    // the grid: design_density points per extremal, spread over the bands
+    const double step = span / (design_density * nExtremes);
+    int          size = 0;
+
+    for (int b = 0; b < nBands; ++b)
+    {
+        size += (int)((edge[2 * b + 1] - edge[2 * b]) / step) + 2;
+    }
+
+    double* memory = (double*)malloc(sizeof(double) * (4 * size + 3 *
+                                                       nExtremes));
+    int*    extreme = (int*)malloc(sizeof(int) * 2 * (size + nExtremes));
+
+    if (memory == 0 || extreme == 0)
+    {
+        free(memory);
+        free(extreme);
+        return 0;
+    }
+
+    r.x       = memory;
+    r.want    = r.x + size;
+    r.weight  = r.want + size;
+    r.error   = r.weight + size;
+    r.ax      = r.error + size;
+    r.ay      = r.ax + nExtremes;
+    r.aw      = r.ay + nExtremes;
+    r.extreme = extreme;
+    r.nGrid   = 0;
+
+    for (int b = 0; b < nBands; ++b)
+    {
+        const int n = (int)((edge[2 * b + 1] - edge[2 * b]) / step) + 2;
+
+        for (int i = 0; i < n; ++i)
+        {
+            const double f = edge[2 * b] +
+                             (edge[2 * b + 1] - edge[2 * b]) * i / (n - 1);
+            r.x[r.nGrid]      = cos(2. * M_PI * f);
+            r.want[r.nGrid]   = want[b];
+            r.weight[r.nGrid] = weight[b];
+            ++r.nGrid;
+        }
+    }
+
+    // start from the peaks of a kaiser design's error, which are nearly in
+    // the right places (or, failing that, spread evenly)
+    int* next = extreme + size + nExtremes;
+
+    design_kaiser(spec, h, order);
+
+    for (int i = 0; i < r.nGrid; ++i)
+    {   // (cos(k w) by chebyshev's recurrence, good enough for a guess)
+        double a    = h[M];
+        double prev = 1.;
+        double c    = r.x[i];
+
+        for (int k = 1; k <= M; ++k)
+        {
+            const double next_c = 2. * r.x[i] * c - prev;
+
+            a   += 2. * h[M + k] * c;
+            prev = c;
+            c    = next_c;
+        }
+
+        r.error[i] = r.weight[i] * (r.want[i] - a);
+    }
+
+    for (int k = 0; k < nExtremes; ++k)
+    {
+        r.extreme[k] = (int)((double)k * (r.nGrid - 1) / (nExtremes - 1));
+    }
+
+    if (remez_exchange(&r, nExtremes, 0., next))
+    {
+        memcpy(r.extreme, next, sizeof(int) * nExtremes);
+    }
+
+    double delta = 0.;
+    double last  = 0.;
+    int    done  = 0;
+
+    for (int pass = 0; pass < design_passes && !done; ++pass)
+    {
+        delta = remez_solve(&r, nExtremes);
+
+        if (fabs(delta) < last / 2. ||
+            (cancel != 0 && hof_atomic_load(cancel)))
+        {   // (see above)
+            break;
+        }
+
+        last = (fabs(delta) > last) ? fabs(delta) : last;
+
+        for (int i = 0; i < r.nGrid; ++i)
+        {
+            r.error[i] = r.weight[i] *
+                         (r.want[i] - remez_response(&r, nExtremes - 1,
+                                                     r.x[i]));
+        }
+
+        if (!remez_exchange(&r, nExtremes, fabs(delta) * (1. - 1e-6),
+                            next) &&
+            !remez_exchange(&r, nExtremes, 0., next))
+        {   // (a tiny delta is mostly rounding, so any peak will do)
+            break;
+        }
+
+        done = memcmp(next, r.extreme, sizeof(int) * nExtremes) == 0;
+        memcpy(r.extreme, next, sizeof(int) * nExtremes);
+    }
+
+    if (!done)
+    {
+        free(memory);
+        free(extreme);
+        return 0;
+    }
+
+    // the taps, from the response at 'order' evenly spaced frequencies
+    double* A = r.error; // (no longer needed)
+
+    for (int j = 0; j <= M; ++j)
+    {
+        A[j] = remez_response(&r, nExtremes - 1, cos(2. * M_PI * j / order));
+    }
+
+    for (int m = 0; m <= M; ++m)
+    {
+        double sum = A[0];
+
+        for (int j = 1; j <= M; ++j)
+        {
+            sum += 2. * A[j] * cos(2. * M_PI * j * m / order);
+        }
+
+        h[M + m] = h[M - m] = (float)(sum / order);
+    }
+
+    free(memory);
+    free(extreme);
+    return 1;
+}
+
+// designs ---------------------------------------------------------------------
+/*
+ * kaiser's formulas are estimates (and miss by a little when two transitions
+ * share the stopband), and equiripple designs only meet the spec on their
+ * grid, so every design is checked on an fft 16 times its length, and made
+ * longer if it misses by more than 1% of its ripple or 0.05 db of stopband.
+ */
+#define design_cached 16 // designs remembered
+
+typedef struct design
+{
+    hof_fir_spec spec;  // what was asked for
+    float*       coefs; // what it got (0 if this is empty)
+    int          order; // how many
+    unsigned int used;  // when it was last asked for
+
+} t_design;
+
+static t_design   design_cache[design_cached];
+static hof_atomic design_lock = 0;
+static unsigned   design_clock = 0;
+
+// the spec with anything it doesn't use zeroed (so equal designs compare so)
+static hof_fir_spec design_key(const hof_fir_spec* spec)
+{
+    hof_fir_spec key;
+
+    memset(&key, 0, sizeof(key));
+    key.method = spec->method;
+    key.type   = spec->type;
+    key.low    = spec->low;
+    key.high   = (spec->type == hof_bandpass || spec->type == hof_notch) ?
+                 spec->high : 0.f;
+    key.width  = spec->width;
+    key.stop   = spec->stop;
+    key.ripple = spec->ripple;
+    return key;
+}
+
+int hof_fir_design_meets(const hof_fir_spec* spec, const float* h,
+                         const int order)
+{
+    int size = 1024;
+
+    while (size < 16 * order)
+    {
+        size *= 2;
+    }
+
+    const int    half   = size / 2;
+    const double edge   = spec->width / 2.;
+    hof_fft*     fft    = hof_fft_new(size);
+    float*       buffer = (float*)hof_calloc_aligned(sizeof(float) * size);
+    float*       out    = (float*)hof_calloc_aligned(sizeof(float) * size);
+    double       most   = 0.;
+    double       least  = 1e30;
+    double       stop   = 0.;
+
+    if (fft == 0 || buffer == 0 || out == 0)
+    {
+        hof_fft_free(fft);
+        hof_free_aligned(buffer);
+        hof_free_aligned(out);
+        return 0;
+    }
+
+    memcpy(buffer, h, sizeof(float) * order);
+    hof_fft_forward(fft, buffer, out);
+
+    for (int k = 0; k <= half; ++k)
+    {
+        const double f    = (double)k / size;
+        const double re   = (k == half) ? out[half] : out[k];
+        const double im   = (k == 0 || k == half) ? 0. : out[half + k];
+        const double gain = sqrt(re * re + im * im);
+        const int    below = f <= spec->low - edge;
+        const int    above = f >= spec->low + edge;
+        const int    inner = f >= spec->low + edge && f <= spec->high - edge;
+        const int    outer = f <= spec->low - edge || f >= spec->high + edge;
+        int          pass;
+
+        switch (spec->type)
+        {
+            case hof_highpass: pass = above ? 1 : below ? 0 : -1; break;
+            case hof_bandpass: pass = inner ? 1 : outer ? 0 : -1; break;
+            case hof_notch:    pass = outer ? 1 : inner ? 0 : -1; break;
+            default:           pass = below ? 1 : above ? 0 : -1; break;
+        }
+
+        if (pass == 1)
+        {
+            most  = (gain > most) ? gain : most;
+            least = (gain < least) ? gain : least;
+        }
+        else if (pass == 0)
+        {
+            stop = (gain > stop) ? gain : stop;
+        }
+    }
+
+    hof_fft_free(fft);
+    hof_free_aligned(buffer);
+    hof_free_aligned(out);
+
+    return least > 0. &&
+           20. * log10(most / least) <= spec->ripple * 1.01 &&
+           20. * log10(stop + 1e-30) <= -spec->stop + 0.05;
+}
+
+int hof_fir_design_taps(const hof_fir_spec* spec)
+{
+    const int    two = (spec->type == hof_bandpass || spec->type == hof_notch);
+    const double h   = spec->width / 2.;
+
+    if (!(spec->width > 0.f) || !(spec->low - h > 0.) ||
+        !(spec->stop > 0.f) || !(spec->ripple > 0.f) ||
+        (two ? !(spec->low + h < spec->high - h) ||
+               !(spec->high + h < 0.5) : !(spec->low + h < 0.5)))
+    {   // no room for the bands
+        return 0;
+    }
+
+    double taps;
+
+    if (spec->method == hof_kaiser)
+    {
+        taps = (design_attenuation(spec) - 7.95) / (14.36 * spec->width) + 1.;
+    }
+    else
+    {
+        const double g  = pow(10., spec->ripple / 20.);
+        const double dp = (g - 1.) / (g + 1.);
+        const double ds = pow(10., -spec->stop / 20.);
+        taps = (-20. * log10(sqrt(dp * ds)) - 13.) / (14.6 * spec->width) + 1.;
+    }
+
+    if (taps > hof_design_max_taps)
+    {   // (too long, whatever it is)
+        return hof_design_max_taps + 2;
+    }
+
+    return (taps < 3.) ? 3 : (int)ceil(taps) | 1;
+}
+
+int hof_fir_design(const hof_fir_spec* spec, float** coefs, int* order,
+                   hof_atomic* cancel)
+{
+    const hof_fir_spec key    = design_key(spec);
+    hof_fir_spec       design = key;
+    int                taps   = hof_fir_design_taps(&key);
+    float*             h      = 0;
+
+    *coefs = 0;
+    *order = 0;
+
+    if (taps == 0 || taps > hof_design_max_taps)
+    {
+        return 0;
+    }
+
+    while (hof_atomic_exchange(&design_lock, 1))
+    {   // (someone else is looking)
+    }
+
+    for (int i = 0; i < design_cached && h == 0; ++i)
+    {
+        t_design* d = &design_cache[i];
+
+        if (d->coefs != 0 && memcmp(&d->spec, &key, sizeof(key)) == 0 &&
+            (h = (float*)malloc(sizeof(float) * d->order)) != 0)
+        {
+            memcpy(h, d->coefs, sizeof(float) * d->order);
+            taps    = d->order;
+            d->used = ++design_clock;
+        }
+    }
+
+    hof_atomic_store(&design_lock, 0);
+
+    if (h != 0)
+    {
+        *coefs = h;
+        *order = taps;
+        return 1;
+    }
+
+    for (int t = 0; t < design_tries && taps <= hof_design_max_taps; ++t)
+    {   // longer until it meets the spec
+        if ((cancel != 0 && hof_atomic_load(cancel)) ||
+            (h = (float*)malloc(sizeof(float) * taps)) == 0)
+        {
+            return 0;
+        }
+
+        if (design.method == hof_kaiser)
+        {
+            design_kaiser(&design, h, taps);
+        }
+        else if (!design_remez(&design, h, taps, cancel))
+        {   // an equiripple design that won't converge is a kaiser one
+            free(h);
+            h             = 0;
+            design.method = hof_kaiser;
+            taps          = (taps > hof_fir_design_taps(&design)) ?
+                            taps : hof_fir_design_taps(&design);
+            continue;
+        }
+
+        if (hof_fir_design_meets(&design, h, taps))
+        {
+            break;
+        }
+
+        free(h);
+        h     = 0;
+        taps += 2 + 2 * (taps / 64);
+    }
+
+    if (h == 0)
+    {
+        return 0;
+    }
+
+    // remember it, in place of the oldest
+    float* copy = (float*)malloc(sizeof(float) * taps);
+
+    while (hof_atomic_exchange(&design_lock, 1))
+    {
+    }
+
+    t_design* oldest = &design_cache[0];
+
+    for (int i = 1; i < design_cached; ++i)
+    {
+        oldest = (design_cache[i].used < oldest->used) ? &design_cache[i]
+                                                       : oldest;
+    }
+
+    if (copy != 0)
+    {
+        memcpy(copy, h, sizeof(float) * taps);
+        free(oldest->coefs);
+        oldest->spec  = key;
+        oldest->coefs = copy;
+        oldest->order = taps;
+        oldest->used  = ++design_clock;
+    }
+
+    hof_atomic_store(&design_lock, 0);
+
+    *coefs = h;
+    *order = taps;
+    return 1;
+}
@@ -0,0 +1,327 @@
+//------------------------------------------------------------------------------
+//  Higher Order Filter Project
+//
+//  hof_fft.c: real fast fourier transforms, and arithmetic on their spectra
+//  Copyright (c) 2016 Elliot Patros. All rights reserved.
+//------------------------------------------------------------------------------
+
+#include "hof.h"
+#include "hof_util.h"
+
+/*
+ * a real fft of size n is done as a complex fft of size n / 2 (the even
+ * samples are the real parts, the odd samples the imaginary parts), then
+ * untangled into the n / 2 + 1 bins of the real signal. the complex fft is an
+ * iterative radix-2 fft, with its twiddles and bit reversal worked out once,
+ * in hof_fft_new.
+ */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HOF_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+// complex fft -----------------------------------------------------------------
+/*
+ * in place, on 'half' interleaved complex numbers that are already in bit
+ * reversed order. 'sign' is 1 for the forward transform, -1 for the inverse
+ * (which isn't scaled).
+ */
+static void fft_complex(const hof_fft* f, float* z, const float sign)
+{
+    const int half = f->size / 2;
+
+    for (int len = 2; len <= half; len <<= 1)
+    {
+        const int step = half / len;
+
+        for (int i = 0; i < half; i += len)
+        {
+            for (int j = 0; j < len / 2; ++j)
+            {
+                const float wr = f->twiddle[2 * j * step];
+                const float wi = f->twiddle[2 * j * step + 1] * sign;
+                float* u = z + 2 * (i + j);
+                float* v = z + 2 * (i + j + len / 2);
+                const float vr = v[0] * wr - v[1] * wi;
+                const float vi = v[0] * wi + v[1] * wr;
+
+                v[0] = u[0] - vr;
+                v[1] = u[1] - vi;
+                u[0] += vr;
+                u[1] += vi;
+            }
+        }
+    }
+}
+
+// real fft --------------------------------------------------------------------
+void hof_fft_forward(hof_fft* f, const float* in, float* out)
+{
+    const int half = f->size / 2;
+    float*    z    = f->scratch;
+    float*    re   = out;
+    float*    im   = out + half;
+
+    // pairs of samples become complex numbers, in bit reversed order
+    for (int k = 0; k < half; ++k)
+    {
+        z[2 * f->bitrev[k]]     = in[2 * k];
+        z[2 * f->bitrev[k] + 1] = in[2 * k + 1];
+    }
+
+    fft_complex(f, z, 1.f);
+
+    // dc and nyquist are both real
+    re[0] = z[0] + z[1];
+    im[0] = z[0] - z[1];
+
+    for (int k = 1; k < half; ++k)
+    {   // X(k) = E(k) + W^k P(k), where E and P are the even and odd spectra
+        const float* zk = z + 2 * k;
+        const float* zc = z + 2 * (half - k);
+        const float  er = 0.5f * (zk[0] + zc[0]);
+        const float  ei = 0.5f * (zk[1] - zc[1]);
+        const float  pr = 0.5f * (zk[1] + zc[1]);
+        const float  pi = -0.5f * (zk[0] - zc[0]);
+        const float  wr = f->rotate[2 * k];
+        const float  wi = f->rotate[2 * k + 1];
+
+        re[k] = er + wr * pr - wi * pi;
+        im[k] = ei + wr * pi + wi * pr;
+    }
+}
+
+void hof_fft_inverse(hof_fft* f, const float* in, float* out)
+{
+    const int    half  = f->size / 2;
+    const float  scale = 1.f / half;
+    const float* re    = in;
+    const float* im    = in + half;
+    float*       z     = f->scratch;
+
+    for (int k = 0; k < half; ++k)
+    {   // E(k) + i P(k), from X(k) and X(half - k)
+        const float xr = re[k];
+        const float xi = (k == 0) ? 0.f   : im[k];
+        const float cr = (k == 0) ? im[0] : re[half - k];
+        const float ci = (k == 0) ? 0.f   : -im[half - k];
+        const float er = 0.5f * (xr + cr);
+        const float ei = 0.5f * (xi + ci);
+        const float dr = 0.5f * (xr - cr);
+        const float di = 0.5f * (xi - ci);
+        const float wr = f->rotate[2 * k];
+        const float wi = -f->rotate[2 * k + 1];
+        const float pr = dr * wr - di * wi;
+        const float pi = dr * wi + di * wr;
+        float*      zk = z + 2 * f->bitrev[k];
+
+        zk[0] = (er - pi) * scale;
+        zk[1] = (ei + pr) * scale;
+    }
+
+    fft_complex(f, z, -1.f);
+    memcpy(out, z, sizeof(float) * f->size);
+}
+
+// spectra ---------------------------------------------------------------------
+/*
+ * acc += x * h, or acc += conj(x) * h, bin by bin. bin 0 holds two real
+ * numbers (dc and nyquist), so it's fixed up afterwards.
+ */
+typedef void (*t_spectrum_mac)(float* acc, const float* x, const float* h,
+                               const int half);
+
+static void mac_c(float* acc, const float* x, const float* h, const int half)
+{
+    for (int k = 0; k < half; ++k)
+    {
+        const float xr = x[k], xi = x[k + half];
+        const float hr = h[k], hi = h[k + half];
+
+        acc[k]        += xr * hr - xi * hi;
+        acc[k + half] += xr * hi + xi * hr;
+    }
+}
+
+static void mac_conj_c(float* acc, const float* x, const float* h,
+                       const int half)
+{
+    for (int k = 0; k < half; ++k)
+    {
+        const float xr = x[k], xi = x[k + half];
+        const float hr = h[k], hi = h[k + half];
+
+        acc[k]        += xr * hr + xi * hi;
+        acc[k + half] += xr * hi - xi * hr;
+    }
+}
+
+#ifdef HOF_X86_DISPATCH
+__attribute__((target("avx2,fma")))
+static void mac_avx2(float* acc, const float* x, const float* h,
+                     const int half)
+{
+    for (int k = 0; k < half; k += 8)
+    {
+        const __m256 xr = _mm256_loadu_ps(x + k);
+        const __m256 xi = _mm256_loadu_ps(x + k + half);
+        const __m256 hr = _mm256_loadu_ps(h + k);
+        const __m256 hi = _mm256_loadu_ps(h + k + half);
+        const __m256 ar = _mm256_loadu_ps(acc + k);
+        const __m256 ai = _mm256_loadu_ps(acc + k + half);
+
+        _mm256_storeu_ps(acc + k, _mm256_fnmadd_ps(xi, hi,
+                                  _mm256_fmadd_ps(xr, hr, ar)));
+        _mm256_storeu_ps(acc + k + half, _mm256_fmadd_ps(xi, hr,
+                                         _mm256_fmadd_ps(xr, hi, ai)));
+    }
+}
+
+__attribute__((target("avx2,fma")))
+static void mac_conj_avx2(float* acc, const float* x, const float* h,
+                          const int half)
+{
+    for (int k = 0; k < half; k += 8)
+    {
+        const __m256 xr = _mm256_loadu_ps(x + k);
+        const __m256 xi = _mm256_loadu_ps(x + k + half);
+        const __m256 hr = _mm256_loadu_ps(h + k);
+        const __m256 hi = _mm256_loadu_ps(h + k + half);
+        const __m256 ar = _mm256_loadu_ps(acc + k);
+        const __m256 ai = _mm256_loadu_ps(acc + k + half);
+
+        _mm256_storeu_ps(acc + k, _mm256_fmadd_ps(xi, hi,
+                                  _mm256_fmadd_ps(xr, hr, ar)));
+        _mm256_storeu_ps(acc + k + half, _mm256_fnmadd_ps(xi, hr,
+                                         _mm256_fmadd_ps(xr, hi, ai)));
+    }
+}
+#endif // HOF_X86_DISPATCH defined
+
+static t_spectrum_mac spectrum_mac      = 0;
+static t_spectrum_mac spectrum_mac_conj = 0;
+
+static void spectrum_dispatch(void)
+{
+    t_spectrum_mac conj = mac_conj_c;
+    t_spectrum_mac mac  = mac_c;
+
+#ifdef HOF_X86_DISPATCH
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    {
+        conj = mac_conj_avx2;
+        mac  = mac_avx2;
+    }
+#endif
+
+    spectrum_mac_conj = conj;
+    spectrum_mac      = mac;
+}
+
+void hof_spectrum_mac(float* acc, const float* x, const float* h, int size)
+{
+    const int   half = size / 2;
+    const float dc   = acc[0] + x[0] * h[0];
+    const float nyq  = acc[half] + x[half] * h[half];
+
+    spectrum_mac(acc, x, h, half);
+    acc[0]    = dc;
+    acc[half] = nyq;
+}
+
+void hof_spectrum_mac_conj(float* acc, const float* x, const float* h,
+                           int size)
+{
+    const int   half = size / 2;
+    const float dc   = acc[0] + x[0] * h[0];
+    const float nyq  = acc[half] + x[half] * h[half];
+
+    spectrum_mac_conj(acc, x, h, half);
+    acc[0]    = dc;
+    acc[half] = nyq;
+}
+
+// new/free --------------------------------------------------------------------
+hof_fft* hof_fft_new(int size)
+{
+    if (size < 16 || (size & (size - 1)) != 0)
+    {   // not a power of two (or too small for the simd spectrum functions)
+        return 0;
+    }
+
+    hof_fft* f = (hof_fft*)malloc(sizeof(hof_fft));
+
+    if (f == 0)
+    {
+        return 0;
+    }
+
+    if (spectrum_mac == 0)
+    {
+        spectrum_dispatch();
+    }
+
+    const int half = size / 2;
+
+    f->size    = size;
+    f->bitrev  = (int*)malloc(sizeof(int) * half);
+    f->twiddle = (float*)malloc(sizeof(float) * half);
+    f->rotate  = (float*)malloc(sizeof(float) * size);
+    f->scratch = (float*)hof_calloc_aligned(sizeof(float) * size);
+
+    if (f->bitrev == 0 || f->twiddle == 0 || f->rotate == 0 ||
+        f->scratch == 0)
+    {
+        hof_fft_free(f);
+        return 0;
+    }
+
+    int bits = 0;
+
+    while ((1 << bits) < half)
+    {
+        ++bits;
+    }
+
+    for (int k = 0; k < half; ++k)
+    {
+        int reversed = 0;
+
+        for (int b = 0; b < bits; ++b)
+        {
+            reversed |= ((k >> b) & 1) << (bits - 1 - b);
+        }
+
+        f->bitrev[k] = reversed;
+    }
+
+    // e^(-2 pi i k / half) for the complex fft, e^(-2 pi i k / size) to
+    // untangle the real spectrum
+    for (int k = 0; k < half / 2; ++k)
+    {
+        f->twiddle[2 * k]     = (float)cos(2. * M_PI * k / half);
+        f->twiddle[2 * k + 1] = (float)-sin(2. * M_PI * k / half);
+    }
+
+    for (int k = 0; k < half; ++k)
+    {
+        f->rotate[2 * k]     = (float)cos(2. * M_PI * k / size);
+        f->rotate[2 * k + 1] = (float)-sin(2. * M_PI * k / size);
+    }
+
+    return f;
+}
+
+void hof_fft_free(hof_fft* f)
+{
+    if (f != 0)
+    {
+        free(f->bitrev);
+        free(f->twiddle);
+        free(f->rotate);
+        hof_free_aligned(f->scratch);
+        free(f);
+    }
+}
@@ -0,0 +1,1556 @@
+//------------------------------------------------------------------------------
+//  Higher Order Filter Project
+//
+//  hof_fir.c: nth order finite impulse response filter engines
+//  Copyright (c) 2016 Elliot Patros. All rights reserved.
+//------------------------------------------------------------------------------
+
+#include "hof.h"
+#include "hof_util.h"
+
+/*
+ * y(n) = sum(x(n - k) * h(k)) is a dot product between the last 'length'
+ * input samples and the coefficients, reversed. each channel's delay table is
+ * written twice (at wptr and wptr + length), so those samples are always
+ * contiguous, and the dot product can be done with whatever simd instructions
+ * this cpu has. the kernel is chosen once, the first time a filter is made.
+ */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HOF_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+// 16 bit floats ---------------------------------------------------------------
+/*
+ * round a float to the nearest half (ties to even, like the f16c
+ * instructions), and back. halves too big become infinity.
+ */
+static unsigned short float_to_half(const float value)
+{
+    unsigned int x;
+    memcpy(&x, &value, sizeof(x));
+
+    const unsigned int sign = (x >> 16) & 0x8000;
+    x &= 0x7fffffff;
+
+    if (x >= 0x47800000)
+    {   // too big (or infinity, or nan)
+        return (unsigned short)(sign | ((x > 0x7f800000) ? 0x7e00 : 0x7c00));
+    }
+
+    if (x < 0x38800000)
+    {   // a denormal half (or zero)
+        if (x < 0x33000000)
+        {
+            return (unsigned short)sign;
+        }
+
+        const unsigned int m     = (x & 0x7fffff) | 0x800000;
+        const int          shift = 126 - (int)(x >> 23);
+        const unsigned int rest  = m & ((1u << shift) - 1);
+        const unsigned int tie   = 1u << (shift - 1);
+        unsigned int h = m >> shift;
+        h += (rest > tie) || (rest == tie && (h & 1));
+        return (unsigned short)(sign | h);
+    }
+
+    // rebias the exponent (127 to 15), then round off 13 bits of mantissa
+    unsigned int h = (x - 0x38000000) >> 13;
+    const unsigned int rest = x & 0x1fff;
+    h += (rest > 0x1000) || (rest == 0x1000 && (h & 1));
+    return (unsigned short)(sign | h);
+}
+
+static float half_to_float(const unsigned short h)
+{
+    const unsigned int sign     = (unsigned int)(h & 0x8000) << 16;
+    const unsigned int exponent = (h >> 10) & 0x1f;
+    const unsigned int mantissa = h & 0x3ff;
+    unsigned int x;
+    float value;
+
+    if (exponent == 0)
+    {   // denormal (or zero)
+        value = mantissa * (1.f / 16777216.f);
+        return sign ? -value : value;
+    }
+
+    x = sign | ((exponent == 31) ? 0x7f800000 | (mantissa << 13)
+                                 : ((exponent + 112) << 23) | (mantissa << 13));
+    memcpy(&value, &x, sizeof(value));
+    return value;
+}
+
+// bfloat16 is the top half of a float (rounded, ties to even)
+static unsigned short float_to_bfloat(const float value)
+{
+    unsigned int x;
+    memcpy(&x, &value, sizeof(x));
+    return (unsigned short)((x + 0x7fff + ((x >> 16) & 1)) >> 16);
+}
+
+static float bfloat_to_float(const unsigned short b)
+{
+    const unsigned int x = (unsigned int)b << 16;
+    float value;
+    memcpy(&value, &x, sizeof(value));
+    return value;
+}
+
+// dot products ----------------------------------------------------------------
+/*
+ * sum(h[j] * x[j]) for 0 <= j < length (always a multiple of hof_fir_pad).
+ * h is aligned, x might not be. each version keeps several sums going, so
+ * each add doesn't wait for the one before it.
+ */
+static inline float dot_c(const float* h, const float* x, const int length)
+{
+    float sum[4] = {0.f, 0.f, 0.f, 0.f};
+
+    for (int j = 0; j < length; j += 4)
+    {
+        sum[0] += h[j]     * x[j];
+        sum[1] += h[j + 1] * x[j + 1];
+        sum[2] += h[j + 2] * x[j + 2];
+        sum[3] += h[j + 3] * x[j + 3];
+    }
+
+    return (sum[0] + sum[1]) + (sum[2] + sum[3]);
+}
+
+#ifdef HOF_X86_DISPATCH
+__attribute__((target("sse2")))
+static inline float dot_sse2(const float* h, const float* x, const int length)
+{
+    __m128 sum0 = _mm_setzero_ps(), sum1 = _mm_setzero_ps();
+    __m128 sum2 = _mm_setzero_ps(), sum3 = _mm_setzero_ps();
+
+    for (int j = 0; j < length; j += 16)
+    {
+        sum0 = _mm_add_ps(sum0, _mm_mul_ps(_mm_load_ps(h + j),
+                                           _mm_loadu_ps(x + j)));
+        sum1 = _mm_add_ps(sum1, _mm_mul_ps(_mm_load_ps(h + j + 4),
+                                           _mm_loadu_ps(x + j + 4)));
+        sum2 = _mm_add_ps(sum2, _mm_mul_ps(_mm_load_ps(h + j + 8),
+                                           _mm_loadu_ps(x + j + 8)));
+        sum3 = _mm_add_ps(sum3, _mm_mul_ps(_mm_load_ps(h + j + 12),
+                                           _mm_loadu_ps(x + j + 12)));
+    }
+
+    __m128 sum = _mm_add_ps(_mm_add_ps(sum0, sum1), _mm_add_ps(sum2, sum3));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum);
+}
+
+__attribute__((target("avx2,fma")))
+static inline float dot_avx2(const float* h, const float* x, const int length)
+{
+    __m256 sum0 = _mm256_setzero_ps(), sum1 = _mm256_setzero_ps();
+    __m256 sum2 = _mm256_setzero_ps(), sum3 = _mm256_setzero_ps();
+
+    for (int j = 0; j < length; j += 32)
+    {
+        sum0 = _mm256_fmadd_ps(_mm256_load_ps(h + j),
+                               _mm256_loadu_ps(x + j), sum0);
+        sum1 = _mm256_fmadd_ps(_mm256_load_ps(h + j + 8),
+                               _mm256_loadu_ps(x + j + 8), sum1);
+        sum2 = _mm256_fmadd_ps(_mm256_load_ps(h + j + 16),
+                               _mm256_loadu_ps(x + j + 16), sum2);
+        sum3 = _mm256_fmadd_ps(_mm256_load_ps(h + j + 24),
+                               _mm256_loadu_ps(x + j + 24), sum3);
+    }
+
+    const __m256 sum8 = _mm256_add_ps(_mm256_add_ps(sum0, sum1),
+                                      _mm256_add_ps(sum2, sum3));
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(sum8),
+                            _mm256_extractf128_ps(sum8, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum);
+}
+
+__attribute__((target("avx512f")))
+static inline float dot_avx512(const float* h, const float* x,
+                               const int length)
+{
+    __m512 sum0 = _mm512_setzero_ps(), sum1 = _mm512_setzero_ps();
+
+    for (int j = 0; j < length; j += 32)
+    {
+        sum0 = _mm512_fmadd_ps(_mm512_load_ps(h + j),
+                               _mm512_loadu_ps(x + j), sum0);
+        sum1 = _mm512_fmadd_ps(_mm512_load_ps(h + j + 16),
+                               _mm512_loadu_ps(x + j + 16), sum1);
+    }
+
+    return _mm512_reduce_add_ps(_mm512_add_ps(sum0, sum1));
+}
+
+/*
+ * the same, with 16 bit coefficients, converted to floats as they're loaded.
+ * halves use the f16c instructions, bfloats just shift into place.
+ */
+#define load_half8(h)   _mm256_cvtph_ps(_mm_load_si128((const __m128i*)(h)))
+#define load_bfloat8(h) _mm256_castsi256_ps(_mm256_slli_epi32(                 \
+                        _mm256_cvtepu16_epi32(                                 \
+                        _mm_load_si128((const __m128i*)(h))), 16))
+#define load_half16(h)   _mm512_cvtph_ps(_mm256_load_si256((const __m256i*)(h)))
+#define load_bfloat16(h) _mm512_castsi512_ps(_mm512_slli_epi32(                \
+                         _mm512_cvtepu16_epi32(                                \
+                         _mm256_load_si256((const __m256i*)(h))), 16))
+
+__attribute__((target("avx2,fma,f16c")))
+static inline float dot_half_avx2(const unsigned short* h, const float* x,
+                                  const int length)
+{
+    __m256 sum0 = _mm256_setzero_ps(), sum1 = _mm256_setzero_ps();
+    __m256 sum2 = _mm256_setzero_ps(), sum3 = _mm256_setzero_ps();
+
+    for (int j = 0; j < length; j += 32)
+    {
+        sum0 = _mm256_fmadd_ps(load_half8(h + j),
+                               _mm256_loadu_ps(x + j), sum0);
+        sum1 = _mm256_fmadd_ps(load_half8(h + j + 8),
+                               _mm256_loadu_ps(x + j + 8), sum1);
+        sum2 = _mm256_fmadd_ps(load_half8(h + j + 16),
+                               _mm256_loadu_ps(x + j + 16), sum2);
+        sum3 = _mm256_fmadd_ps(load_half8(h + j + 24),
+                               _mm256_loadu_ps(x + j + 24), sum3);
+    }
+
+    const __m256 sum8 = _mm256_add_ps(_mm256_add_ps(sum0, sum1),
+                                      _mm256_add_ps(sum2, sum3));
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(sum8),
+                            _mm256_extractf128_ps(sum8, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum);
+}
+
+__attribute__((target("avx2,fma")))
+static inline float dot_bfloat_avx2(const unsigned short* h, const float* x,
+                                    const int length)
+{
+    __m256 sum0 = _mm256_setzero_ps(), sum1 = _mm256_setzero_ps();
+    __m256 sum2 = _mm256_setzero_ps(), sum3 = _mm256_setzero_ps();
+
+    for (int j = 0; j < length; j += 32)
+    {
+        sum0 = _mm256_fmadd_ps(load_bfloat8(h + j),
+                               _mm256_loadu_ps(x + j), sum0);
+        sum1 = _mm256_fmadd_ps(load_bfloat8(h + j + 8),
+                               _mm256_loadu_ps(x + j + 8), sum1);
+        sum2 = _mm256_fmadd_ps(load_bfloat8(h + j + 16),
+                               _mm256_loadu_ps(x + j + 16), sum2);
+        sum3 = _mm256_fmadd_ps(load_bfloat8(h + j + 24),
+                               _mm256_loadu_ps(x + j + 24), sum3);
+    }
+
+    const __m256 sum8 = _mm256_add_ps(_mm256_add_ps(sum0, sum1),
+                                      _mm256_add_ps(sum2, sum3));
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(sum8),
+                            _mm256_extractf128_ps(sum8, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum);
+}
+
+__attribute__((target("avx512f")))
+static inline float dot_half_avx512(const unsigned short* h, const float* x,
+                                    const int length)
+{
+    __m512 sum0 = _mm512_setzero_ps(), sum1 = _mm512_setzero_ps();
+
+    for (int j = 0; j < length; j += 32)
+    {
+        sum0 = _mm512_fmadd_ps(load_half16(h + j),
+                               _mm512_loadu_ps(x + j), sum0);
+        sum1 = _mm512_fmadd_ps(load_half16(h + j + 16),
+                               _mm512_loadu_ps(x + j + 16), sum1);
+    }
+
+    return _mm512_reduce_add_ps(_mm512_add_ps(sum0, sum1));
+}
+
+__attribute__((target("avx512f")))
+static inline float dot_bfloat_avx512(const unsigned short* h, const float* x,
+                                      const int length)
+{
+    __m512 sum0 = _mm512_setzero_ps(), sum1 = _mm512_setzero_ps();
+
+    for (int j = 0; j < length; j += 32)
+    {
+        sum0 = _mm512_fmadd_ps(load_bfloat16(h + j),
+                               _mm512_loadu_ps(x + j), sum0);
+        sum1 = _mm512_fmadd_ps(load_bfloat16(h + j + 16),
+                               _mm512_loadu_ps(x + j + 16), sum1);
+    }
+
+    return _mm512_reduce_add_ps(_mm512_add_ps(sum0, sum1));
+}
+
+/*
+ * four outputs at once, from windows that start one sample apart, so each
+ * coefficient is converted once for four multiply-adds.
+ */
+__attribute__((target("avx2,fma,f16c")))
+static inline void dot4_half_avx2(const unsigned short* h, const float* x,
+                                  const int length, float* y)
+{
+    __m256 sum0 = _mm256_setzero_ps(), sum1 = _mm256_setzero_ps();
+    __m256 sum2 = _mm256_setzero_ps(), sum3 = _mm256_setzero_ps();
+
+    for (int j = 0; j < length; j += 8)
+    {
+        const __m256 c = load_half8(h + j);
+        sum0 = _mm256_fmadd_ps(c, _mm256_loadu_ps(x + j), sum0);
+        sum1 = _mm256_fmadd_ps(c, _mm256_loadu_ps(x + j + 1), sum1);
+        sum2 = _mm256_fmadd_ps(c, _mm256_loadu_ps(x + j + 2), sum2);
+        sum3 = _mm256_fmadd_ps(c, _mm256_loadu_ps(x + j + 3), sum3);
+    }
+
+    // transpose-free horizontal sums: y[i] = sum of sum_i's 8 lanes
+    const __m256 s01 = _mm256_hadd_ps(sum0, sum1);
+    const __m256 s23 = _mm256_hadd_ps(sum2, sum3);
+    const __m256 s   = _mm256_hadd_ps(s01, s23);
+    _mm_storeu_ps(y, _mm_add_ps(_mm256_castps256_ps128(s),
+                                _mm256_extractf128_ps(s, 1)));
+}
+
+__attribute__((target("avx2,fma")))
+static inline void dot4_bfloat_avx2(const unsigned short* h, const float* x,
+                                    const int length, float* y)
+{
+    __m256 sum0 = _mm256_setzero_ps(), sum1 = _mm256_setzero_ps();
+    __m256 sum2 = _mm256_setzero_ps(), sum3 = _mm256_setzero_ps();
+
+    for (int j = 0; j < length; j += 8)
+    {
+        const __m256 c = load_bfloat8(h + j);
+        sum0 = _mm256_fmadd_ps(c, _mm256_loadu_ps(x + j), sum0);
+        sum1 = _mm256_fmadd_ps(c, _mm256_loadu_ps(x + j + 1), sum1);
+        sum2 = _mm256_fmadd_ps(c, _mm256_loadu_ps(x + j + 2), sum2);
+        sum3 = _mm256_fmadd_ps(c, _mm256_loadu_ps(x + j + 3), sum3);
+    }
+
+    const __m256 s01 = _mm256_hadd_ps(sum0, sum1);
+    const __m256 s23 = _mm256_hadd_ps(sum2, sum3);
+    const __m256 s   = _mm256_hadd_ps(s01, s23);
+    _mm_storeu_ps(y, _mm_add_ps(_mm256_castps256_ps128(s),
+                                _mm256_extractf128_ps(s, 1)));
+}
+
+__attribute__((target("avx512f")))
+static inline void dot4_half_avx512(const unsigned short* h, const float* x,
+                                    const int length, float* y)
+{
+    __m512 sum0 = _mm512_setzero_ps(), sum1 = _mm512_setzero_ps();
+    __m512 sum2 = _mm512_setzero_ps(), sum3 = _mm512_setzero_ps();
+
+    for (int j = 0; j < length; j += 16)
+    {
+        const __m512 c = load_half16(h + j);
+        sum0 = _mm512_fmadd_ps(c, _mm512_loadu_ps(x + j), sum0);
+        sum1 = _mm512_fmadd_ps(c, _mm512_loadu_ps(x + j + 1), sum1);
+        sum2 = _mm512_fmadd_ps(c, _mm512_loadu_ps(x + j + 2), sum2);
+        sum3 = _mm512_fmadd_ps(c, _mm512_loadu_ps(x + j + 3), sum3);
+    }
+
+    y[0] = _mm512_reduce_add_ps(sum0);
+    y[1] = _mm512_reduce_add_ps(sum1);
+    y[2] = _mm512_reduce_add_ps(sum2);
+    y[3] = _mm512_reduce_add_ps(sum3);
+}
+
+__attribute__((target("avx512f")))
+static inline void dot4_bfloat_avx512(const unsigned short* h, const float* x,
+                                      const int length, float* y)
+{
+    __m512 sum0 = _mm512_setzero_ps(), sum1 = _mm512_setzero_ps();
+    __m512 sum2 = _mm512_setzero_ps(), sum3 = _mm512_setzero_ps();
+
+    for (int j = 0; j < length; j += 16)
+    {
+        const __m512 c = load_bfloat16(h + j);
+        sum0 = _mm512_fmadd_ps(c, _mm512_loadu_ps(x + j), sum0);
+        sum1 = _mm512_fmadd_ps(c, _mm512_loadu_ps(x + j + 1), sum1);
+        sum2 = _mm512_fmadd_ps(c, _mm512_loadu_ps(x + j + 2), sum2);
+        sum3 = _mm512_fmadd_ps(c, _mm512_loadu_ps(x + j + 3), sum3);
+    }
+
+    y[0] = _mm512_reduce_add_ps(sum0);
+    y[1] = _mm512_reduce_add_ps(sum1);
+    y[2] = _mm512_reduce_add_ps(sum2);
+    y[3] = _mm512_reduce_add_ps(sum3);
+}
+#endif // HOF_X86_DISPATCH defined
+
+// kernels ---------------------------------------------------------------------
+/*
+ * filter one channel. returns the write pointer after the last sample.
+ * these are the same loop, compiled for different instruction sets.
+ */
+typedef int (*t_fir_kernel)(const float* h, const int length, float* table,
+                            int wptr, const float* input, float* output,
+                            const int nSamples);
+
+static int fir_kernel_c(const float* h, const int length, float* table,
+                        int wptr, const float* input, float* output,
+                        const int nSamples)
+{
+    for (int n = 0; n < nSamples; ++n)
+    {
+        table[wptr] = table[wptr + length] = input[n];
+        output[n] = dot_c(h, table + wptr + 1, length);
+        wptr = (wptr + 1 < length) ? wptr + 1 : 0;
+    }
+
+    return wptr;
+}
+
+/*
+ * the same, for sparse filters: only the runs of taps in 'runs' (pairs of
+ * first packed float and length, both multiples of hof_fir_pad) are summed.
+ */
+typedef int (*t_fir_kernel_runs)(const float* h, const int length,
+                                 const int* runs, const int nRuns,
+                                 float* table, int wptr, const float* input,
+                                 float* output, const int nSamples);
+
+static int fir_runs_c(const float* h, const int length, const int* runs,
+                      const int nRuns, float* table, int wptr,
+                      const float* input, float* output, const int nSamples)
+{
+    for (int n = 0; n < nSamples; ++n)
+    {
+        const float* x   = table + wptr + 1;
+        float        sum = 0.f;
+
+        table[wptr] = table[wptr + length] = input[n];
+
+        for (int r = 0; r < 2 * nRuns; r += 2)
+        {
+            sum += dot_c(h + runs[r], x + runs[r], runs[r + 1]);
+        }
+
+        output[n] = sum;
+        wptr = (wptr + 1 < length) ? wptr + 1 : 0;
+    }
+
+    return wptr;
+}
+
+#ifdef HOF_X86_DISPATCH
+__attribute__((target("sse2")))
+static int fir_kernel_sse2(const float* h, const int length, float* table,
+                           int wptr, const float* input, float* output,
+                           const int nSamples)
+{
+    for (int n = 0; n < nSamples; ++n)
+    {
+        table[wptr] = table[wptr + length] = input[n];
+        output[n] = dot_sse2(h, table + wptr + 1, length);
+        wptr = (wptr + 1 < length) ? wptr + 1 : 0;
+    }
+
+    return wptr;
+}
+
+__attribute__((target("avx2,fma")))
+static int fir_kernel_avx2(const float* h, const int length, float* table,
+                           int wptr, const float* input, float* output,
+                           const int nSamples)
+{
+    for (int n = 0; n < nSamples; ++n)
+    {
+        table[wptr] = table[wptr + length] = input[n];
+        output[n] = dot_avx2(h, table + wptr + 1, length);
+        wptr = (wptr + 1 < length) ? wptr + 1 : 0;
+    }
+
+    return wptr;
+}
+
+__attribute__((target("avx512f")))
+static int fir_kernel_avx512(const float* h, const int length, float* table,
+                             int wptr, const float* input, float* output,
+                             const int nSamples)
+{
+    for (int n = 0; n < nSamples; ++n)
+    {
+        table[wptr] = table[wptr + length] = input[n];
+        output[n] = dot_avx512(h, table + wptr + 1, length);
+        wptr = (wptr + 1 < length) ? wptr + 1 : 0;
+    }
+
+    return wptr;
+}
+
+__attribute__((target("sse2")))
+static int fir_runs_sse2(const float* h, const int length, const int* runs,
+                         const int nRuns, float* table, int wptr,
+                         const float* input, float* output, const int nSamples)
+{
+    for (int n = 0; n < nSamples; ++n)
+    {
+        const float* x   = table + wptr + 1;
+        float        sum = 0.f;
+
+        table[wptr] = table[wptr + length] = input[n];
+
+        for (int r = 0; r < 2 * nRuns; r += 2)
+        {
+            sum += dot_sse2(h + runs[r], x + runs[r], runs[r + 1]);
+        }
+
+        output[n] = sum;
+        wptr = (wptr + 1 < length) ? wptr + 1 : 0;
+    }
+
+    return wptr;
+}
+
+__attribute__((target("avx2,fma")))
+static int fir_runs_avx2(const float* h, const int length, const int* runs,
+                         const int nRuns, float* table, int wptr,
+                         const float* input, float* output, const int nSamples)
+{
+    for (int n = 0; n < nSamples; ++n)
+    {
+        const float* x   = table + wptr + 1;
+        float        sum = 0.f;
+
+        table[wptr] = table[wptr + length] = input[n];
+
+        for (int r = 0; r < 2 * nRuns; r += 2)
+        {
+            sum += dot_avx2(h + runs[r], x + runs[r], runs[r + 1]);
+        }
+
+        output[n] = sum;
+        wptr = (wptr + 1 < length) ? wptr + 1 : 0;
+    }
+
+    return wptr;
+}
+
+__attribute__((target("avx512f")))
+static int fir_runs_avx512(const float* h, const int length, const int* runs,
+                           const int nRuns, float* table, int wptr,
+                           const float* input, float* output,
+                           const int nSamples)
+{
+    for (int n = 0; n < nSamples; ++n)
+    {
+        const float* x   = table + wptr + 1;
+        float        sum = 0.f;
+
+        table[wptr] = table[wptr + length] = input[n];
+
+        for (int r = 0; r < 2 * nRuns; r += 2)
+        {
+            sum += dot_avx512(h + runs[r], x + runs[r], runs[r + 1]);
+        }
+
+        output[n] = sum;
+        wptr = (wptr + 1 < length) ? wptr + 1 : 0;
+    }
+
+    return wptr;
+}
+
+/*
+ * the same again, for 16 bit coefficients. there are only simd versions of
+ * these: without them, 16 bit coefficients are unpacked into floats (which is
+ * slower than not using them at all, but sounds the same).
+ *
+ * these work four samples at a time. writing four inputs before the first of
+ * the four outputs overwrites the three oldest samples in its window, so 16
+ * bit filters are padded with at least three zero coefficients (see
+ * fir_length).
+ */
+typedef int (*t_fir_kernel16)(const unsigned short* h, const int length,
+                              float* table, int wptr, const float* input,
+                              float* output, const int nSamples);
+
+__attribute__((target("avx2,fma,f16c")))
+static int fir_kernel_half_avx2(const unsigned short* h, const int length,
+                                float* table, int wptr, const float* input,
+                                float* output, const int nSamples)
+{
+    for (int n = 0; n < nSamples;)
+    {
+        if (n + 4 <= nSamples && wptr + 4 <= length)
+        {   // four at once
+            for (int i = 0; i < 4; ++i)
+            {
+                table[wptr + i] = table[wptr + i + length] = input[n + i];
+            }
+
+            dot4_half_avx2(h, table + wptr + 1, length, output + n);
+            wptr = (wptr + 4 < length) ? wptr + 4 : 0;
+            n += 4;
+        }
+        else
+        {   // one at a time, near the ends of the block and the delay table
+            table[wptr] = table[wptr + length] = input[n];
+            output[n] = dot_half_avx2(h, table + wptr + 1, length);
+            wptr = (wptr + 1 < length) ? wptr + 1 : 0;
+            n += 1;
+        }
+    }
+
+    return wptr;
+}
+
+__attribute__((target("avx2,fma")))
+static int fir_kernel_bfloat_avx2(const unsigned short* h, const int length,
+                                  float* table, int wptr, const float* input,
+                                  float* output, const int nSamples)
+{
+    for (int n = 0; n < nSamples;)
+    {
+        if (n + 4 <= nSamples && wptr + 4 <= length)
+        {   // four at once
+            for (int i = 0; i < 4; ++i)
+            {
+                table[wptr + i] = table[wptr + i + length] = input[n + i];
+            }
+
+            dot4_bfloat_avx2(h, table + wptr + 1, length, output + n);
+            wptr = (wptr + 4 < length) ? wptr + 4 : 0;
+            n += 4;
+        }
+        else
+        {   // one at a time, near the ends of the block and the delay table
+            table[wptr] = table[wptr + length] = input[n];
+            output[n] = dot_bfloat_avx2(h, table + wptr + 1, length);
+            wptr = (wptr + 1 < length) ? wptr + 1 : 0;
+            n += 1;
+        }
+    }
+
+    return wptr;
+}
+
+__attribute__((target("avx512f")))
+static int fir_kernel_half_avx512(const unsigned short* h, const int length,
+                                  float* table, int wptr, const float* input,
+                                  float* output, const int nSamples)
+{
+    for (int n = 0; n < nSamples;)
+    {
+        if (n + 4 <= nSamples && wptr + 4 <= length)
+        {   // four at once
+            for (int i = 0; i < 4; ++i)
+            {
+                table[wptr + i] = table[wptr + i + length] = input[n + i];
+            }
+
+            dot4_half_avx512(h, table + wptr + 1, length, output + n);
+            wptr = (wptr + 4 < length) ? wptr + 4 : 0;
+            n += 4;
+        }
+        else
+        {   // one at a time, near the ends of the block and the delay table
+            table[wptr] = table[wptr + length] = input[n];
+            output[n] = dot_half_avx512(h, table + wptr + 1, length);
+            wptr = (wptr + 1 < length) ? wptr + 1 : 0;
+            n += 1;
+        }
+    }
+
+    return wptr;
+}
+
+__attribute__((target("avx512f")))
+static int fir_kernel_bfloat_avx512(const unsigned short* h, const int length,
+                                    float* table, int wptr, const float* input,
+                                    float* output, const int nSamples)
+{
+    for (int n = 0; n < nSamples;)
+    {
+        if (n + 4 <= nSamples && wptr + 4 <= length)
+        {   // four at once
+            for (int i = 0; i < 4; ++i)
+            {
+                table[wptr + i] = table[wptr + i + length] = input[n + i];
+            }
+
+            dot4_bfloat_avx512(h, table + wptr + 1, length, output + n);
+            wptr = (wptr + 4 < length) ? wptr + 4 : 0;
+            n += 4;
+        }
+        else
+        {   // one at a time, near the ends of the block and the delay table
+            table[wptr] = table[wptr + length] = input[n];
+            output[n] = dot_bfloat_avx512(h, table + wptr + 1, length);
+            wptr = (wptr + 1 < length) ? wptr + 1 : 0;
+            n += 1;
+        }
+    }
+
+    return wptr;
+}
+
+/*
+ * round every packed coefficient to 16 bits at once. the 16 bit kernels need
+ * these (rounding one at a time costs more than the kernels save).
+ */
+typedef void (*t_fir_pack16)(const float* h, unsigned short* h16,
+                             const int length);
+
+__attribute__((target("avx2,f16c")))
+static void fir_pack_half_f16c(const float* h, unsigned short* h16,
+                               const int length)
+{
+    for (int j = 0; j < length; j += 8)
+    {
+        _mm_store_si128((__m128i*)(h16 + j),
+                        _mm256_cvtps_ph(_mm256_load_ps(h + j),
+                                        _MM_FROUND_TO_NEAREST_INT));
+    }
+}
+
+__attribute__((target("avx2")))
+static void fir_pack_bfloat_avx2(const float* h, unsigned short* h16,
+                                 const int length)
+{
+    const __m256i round = _mm256_set1_epi32(0x7fff);
+    const __m256i one   = _mm256_set1_epi32(1);
+
+    for (int j = 0; j < length; j += 16)
+    {
+        __m256i x0 = _mm256_castps_si256(_mm256_load_ps(h + j));
+        __m256i x1 = _mm256_castps_si256(_mm256_load_ps(h + j + 8));
+
+        // x + 0x7fff + (bit 16 of x), then keep the top half (like
+        // float_to_bfloat)
+        x0 = _mm256_add_epi32(x0, _mm256_add_epi32(round, _mm256_and_si256(
+                              _mm256_srli_epi32(x0, 16), one)));
+        x1 = _mm256_add_epi32(x1, _mm256_add_epi32(round, _mm256_and_si256(
+                              _mm256_srli_epi32(x1, 16), one)));
+
+        // packus works within 128 bit lanes, so put them back in order
+        const __m256i packed = _mm256_packus_epi32(_mm256_srli_epi32(x0, 16),
+                                                   _mm256_srli_epi32(x1, 16));
+        _mm256_store_si256((__m256i*)(h16 + j),
+                           _mm256_permute4x64_epi64(packed, 0xd8));
+    }
+}
+#endif // HOF_X86_DISPATCH defined
+
+// adaptive kernels ------------------------------------------------------------
+/*
+ * normalized lms, one sample at a time: filter the reference x, compare with
+ * the desired signal d, then move the taps towards whatever would have made
+ * the error e smaller, by a step normalized by the power of the last 'order'
+ * inputs (kept as a running sum in 'energy'). 'a' (1 - leak) shrinks every
+ * tap a little each sample. taps in the zero padding never change.
+ * returns the write pointer after the last sample.
+ */
+#define lms_regularize 1e-6 // keeps the step finite in silence (per tap)
+
+typedef int (*t_lms_kernel)(float* h, const int length, const int order,
+                            float* table, int wptr, double* energy,
+                            const float mu, const float a, const float* x,
+                            const float* d, float* y, float* e,
+                            const int nSamples);
+
+/*
+ * h[j] = a * h[j] + b * x[j], for start <= j < length. h is aligned (so the
+ * simd versions start with single steps until it is), x might not be.
+ */
+static inline void scale_add_c(float* h, const float* x, int j,
+                               const int length, const float a, const float b)
+{
+    for (; j < length; ++j)
+    {
+        h[j] = a * h[j] + b * x[j];
+    }
+}
+
+static int lms_kernel_c(float* h, const int length, const int order,
+                        float* table, int wptr, double* energy,
+                        const float mu, const float a, const float* x,
+                        const float* d, float* y, float* e,
+                        const int nSamples)
+{
+    const double regularize = order * lms_regularize;
+    double power = *energy;
+
+    for (int n = 0; n < nSamples; ++n)
+    {
+        const float xn = x[n], dn = d[n];
+        const float oldest = table[wptr + length - order];
+
+        table[wptr] = table[wptr + length] = xn;
+        power = fmax(power + (double)xn * xn - (double)oldest * oldest, 0.);
+
+        const float* window = table + wptr + 1;
+        const float  yn = dot_c(h, window, length);
+        const float  en = dn - yn;
+
+        scale_add_c(h, window, length - order, length, a,
+                    (float)(mu * en / (power + regularize)));
+        y[n] = yn;
+        e[n] = en;
+        wptr = (wptr + 1 < length) ? wptr + 1 : 0;
+    }
+
+    *energy = power;
+    return wptr;
+}
+
+#ifdef HOF_X86_DISPATCH
+__attribute__((target("sse2")))
+static inline void scale_add_sse2(float* h, const float* x, int j,
+                                  const int length, const float a,
+                                  const float b)
+{
+    for (; j < length && j % 4 != 0; ++j)
+    {
+        h[j] = a * h[j] + b * x[j];
+    }
+
+    const __m128 va = _mm_set1_ps(a), vb = _mm_set1_ps(b);
+
+    for (; j < length; j += 4)
+    {
+        _mm_store_ps(h + j, _mm_add_ps(_mm_mul_ps(va, _mm_load_ps(h + j)),
+                                       _mm_mul_ps(vb, _mm_loadu_ps(x + j))));
+    }
+}
+
+__attribute__((target("avx2,fma")))
+static inline void scale_add_avx2(float* h, const float* x, int j,
+                                  const int length, const float a,
+                                  const float b)
+{
+    for (; j < length && j % 8 != 0; ++j)
+    {
+        h[j] = a * h[j] + b * x[j];
+    }
+
+    const __m256 va = _mm256_set1_ps(a), vb = _mm256_set1_ps(b);
+
+    for (; j < length; j += 8)
+    {
+        _mm256_store_ps(h + j, _mm256_fmadd_ps(vb, _mm256_loadu_ps(x + j),
+                               _mm256_mul_ps(va, _mm256_load_ps(h + j))));
+    }
+}
+
+__attribute__((target("avx512f")))
+static inline void scale_add_avx512(float* h, const float* x, int j,
+                                    const int length, const float a,
+                                    const float b)
+{
+    for (; j < length && j % 16 != 0; ++j)
+    {
+        h[j] = a * h[j] + b * x[j];
+    }
+
+    const __m512 va = _mm512_set1_ps(a), vb = _mm512_set1_ps(b);
+
+    for (; j < length; j += 16)
+    {
+        _mm512_store_ps(h + j, _mm512_fmadd_ps(vb, _mm512_loadu_ps(x + j),
+                               _mm512_mul_ps(va, _mm512_load_ps(h + j))));
+    }
+}
+
+__attribute__((target("sse2")))
+static int lms_kernel_sse2(float* h, const int length, const int order,
+                           float* table, int wptr, double* energy,
+                           const float mu, const float a, const float* x,
+                           const float* d, float* y, float* e,
+                           const int nSamples)
+{
+    const double regularize = order * lms_regularize;
+    double power = *energy;
+
+    for (int n = 0; n < nSamples; ++n)
+    {
+        const float xn = x[n], dn = d[n];
+        const float oldest = table[wptr + length - order];
+
+        table[wptr] = table[wptr + length] = xn;
+        power = fmax(power + (double)xn * xn - (double)oldest * oldest, 0.);
+
+        const float* window = table + wptr + 1;
+        const float  yn = dot_sse2(h, window, length);
+        const float  en = dn - yn;
+
+        scale_add_sse2(h, window, length - order, length, a,
+                       (float)(mu * en / (power + regularize)));
+        y[n] = yn;
+        e[n] = en;
+        wptr = (wptr + 1 < length) ? wptr + 1 : 0;
+    }
+
+    *energy = power;
+    return wptr;
+}
+
+__attribute__((target("avx2,fma")))
+static int lms_kernel_avx2(float* h, const int length, const int order,
+                           float* table, int wptr, double* energy,
+                           const float mu, const float a, const float* x,
+                           const float* d, float* y, float* e,
+                           const int nSamples)
+{
+    const double regularize = order * lms_regularize;
+    double power = *energy;
+
+    for (int n = 0; n < nSamples; ++n)
+    {
+        const float xn = x[n], dn = d[n];
+        const float oldest = table[wptr + length - order];
+
+        table[wptr] = table[wptr + length] = xn;
+        power = fmax(power + (double)xn * xn - (double)oldest * oldest, 0.);
+
+        const float* window = table + wptr + 1;
+        const float  yn = dot_avx2(h, window, length);
+        const float  en = dn - yn;
+
+        scale_add_avx2(h, window, length - order, length, a,
+                       (float)(mu * en / (power + regularize)));
+        y[n] = yn;
+        e[n] = en;
+        wptr = (wptr + 1 < length) ? wptr + 1 : 0;
+    }
+
+    *energy = power;
+    return wptr;
+}
+
+__attribute__((target("avx512f")))
+static int lms_kernel_avx512(float* h, const int length, const int order,
+                             float* table, int wptr, double* energy,
+                             const float mu, const float a, const float* x,
+                             const float* d, float* y, float* e,
+                             const int nSamples)
+{
+    const double regularize = order * lms_regularize;
+    double power = *energy;
+
+    for (int n = 0; n < nSamples; ++n)
+    {
+        const float xn = x[n], dn = d[n];
+        const float oldest = table[wptr + length - order];
+
+        table[wptr] = table[wptr + length] = xn;
+        power = fmax(power + (double)xn * xn - (double)oldest * oldest, 0.);
+
+        const float* window = table + wptr + 1;
+        const float  yn = dot_avx512(h, window, length);
+        const float  en = dn - yn;
+
+        scale_add_avx512(h, window, length - order, length, a,
+                         (float)(mu * en / (power + regularize)));
+        y[n] = yn;
+        e[n] = en;
+        wptr = (wptr + 1 < length) ? wptr + 1 : 0;
+    }
+
+    *energy = power;
+    return wptr;
+}
+#endif // HOF_X86_DISPATCH defined
+
+// dispatch --------------------------------------------------------------------
+static t_fir_kernel      fir_kernel        = 0;
+static t_fir_kernel_runs fir_kernel_runs   = 0;
+static t_fir_kernel16    fir_kernel_half   = 0;
+static t_fir_kernel16    fir_kernel_bfloat = 0;
+static t_fir_pack16      fir_pack_half     = 0;
+static t_fir_pack16      fir_pack_bfloat   = 0;
+static t_lms_kernel      lms_kernel        = 0;
+static const char*       fir_kernel_name   = "c";
+
+/*
+ * use the kernels named 'name', if this cpu can run them (returns 0, and
+ * changes nothing, if it can't). every filter shares the choice.
+ */
+static int fir_select(const char* name)
+{
+    t_fir_kernel      kernel = 0;
+    t_fir_kernel_runs runs   = 0;
+    t_fir_kernel16    half   = 0;
+    t_fir_kernel16    bfloat = 0;
+    t_lms_kernel      lms    = 0;
+
+#ifdef HOF_X86_DISPATCH
+    __builtin_cpu_init();
+
+    if (strcmp(name, "avx512") == 0 && __builtin_cpu_supports("avx512f"))
+    {
+        kernel = fir_kernel_avx512;
+        runs   = fir_runs_avx512;
+        half   = fir_kernel_half_avx512;
+        bfloat = fir_kernel_bfloat_avx512;
+        lms    = lms_kernel_avx512;
+        fir_pack_half   = fir_pack_half_f16c;
+        fir_pack_bfloat = fir_pack_bfloat_avx2;
+        name   = "avx512";
+    }
+    else if (strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2") &&
+             __builtin_cpu_supports("fma"))
+    {
+        kernel = fir_kernel_avx2;
+        runs   = fir_runs_avx2;
+        half   = __builtin_cpu_supports("f16c") ? fir_kernel_half_avx2 : 0;
+        bfloat = fir_kernel_bfloat_avx2;
+        lms    = lms_kernel_avx2;
+        fir_pack_half   = fir_pack_half_f16c;
+        fir_pack_bfloat = fir_pack_bfloat_avx2;
+        name   = "avx2";
+    }
+    else if (strcmp(name, "sse2") == 0 && __builtin_cpu_supports("sse2"))
+    {
+        kernel = fir_kernel_sse2;
+        runs   = fir_runs_sse2;
+        lms    = lms_kernel_sse2;
+        name   = "sse2";
+    }
+#endif
+
+    if (strcmp(name, "c") == 0)
+    {
+        kernel = fir_kernel_c;
+        runs   = fir_runs_c;
+        lms    = lms_kernel_c;
+        name   = "c";
+    }
+
+    if (kernel == 0)
+    {
+        return 0;
+    }
+
+    fir_kernel_name   = name;
+    fir_kernel_runs   = runs;
+    fir_kernel_half   = half;
+    fir_kernel_bfloat = bfloat;
+    lms_kernel        = lms;
+    fir_kernel        = kernel;
+    return 1;
+}
+
+/*
+ * pick the widest kernels this cpu can run (hof_tune may pick others later).
+ * picking again always gives the same answer, so racing threads are harmless.
+ */
+static void fir_dispatch(void)
+{
+    const char* names[] = {"avx512", "avx2", "sse2", "c"};
+
+    int i = 0;
+
+    while (fir_select(names[i]) == 0)
+    {   // "c" always works
+        ++i;
+    }
+}
+
+int hof_fir_set_kernel(const char* name)
+{
+    if (fir_kernel == 0)
+    {
+        fir_dispatch();
+    }
+
+    return fir_select(name);
+}
+
+const char* hof_fir_kernel(void)
+{
+    if (fir_kernel == 0)
+    {
+        fir_dispatch();
+    }
+
+    return fir_kernel_name;
+}
+
+// process ---------------------------------------------------------------------
+/*
+ * copy the caller's coefficients into the packed buffer, last one first.
+ * the zero padding stays at the front (the oldest samples). at 16 bits, the
+ * copy is compared as it's made, and only if something changed (or 'repack'
+ * is set) are the coefficients rounded again: into packed16 for the 16 bit
+ * kernel, and into 'rounded' for the float kernels (which cpus without one
+ * use). returns the 16 bit kernel to use, or 0.
+ */
+static t_fir_kernel16 fir_pack(hof_fir* f)
+{
+    float* h       = f->packed + f->length - 1;
+    int    changed = f->repack;
+
+    if (f->precision == hof_float32)
+    {
+        for (int k = 0; k < f->order; ++k)
+        {
+            h[-k] = f->coefs[k * f->stride];
+        }
+
+        return 0;
+    }
+
+    for (int k = 0; k < f->order; ++k)
+    {
+        const float coef = f->coefs[k * f->stride];
+
+        changed |= (h[-k] != coef);
+        h[-k]    = coef;
+    }
+
+    if (changed)
+    {
+        const t_fir_pack16 pack = (f->precision == hof_float16) ?
+                                  fir_pack_half : fir_pack_bfloat;
+
+        if (pack != 0)
+        {
+            pack(f->packed, f->packed16, f->length);
+        }
+
+        for (int j = 0; j < f->length; ++j)
+        {
+            f->rounded[j] = (f->precision == hof_float16) ?
+                            half_to_float(float_to_half(f->packed[j])) :
+                            bfloat_to_float(float_to_bfloat(f->packed[j]));
+        }
+
+        f->repack = 0;
+    }
+
+    return (f->precision == hof_float16) ? fir_kernel_half : fir_kernel_bfloat;
+}
+
+void hof_fir_process(hof_fir* f, const float* const* in,
+                     float* const* out, int nSamples)
+{
+#ifdef HOF_STATS
+    const double time = hof_now_ns();
+#endif
+
+    if (f->coefs == 0)
+    {   // zero-out output if there's no coefficient array
+        for (int c = 0; c < f->nChannels; ++c)
+        {
+            memset(out[c], 0, sizeof(float) * nSamples);
+        }
+    }
+    else
+    {   // every channel starts from the same write pointer
+        int wptr = f->wptr;
+        const t_fir_kernel16 kernel16 = fir_pack(f);
+        const float*         h        = (f->precision == hof_float32) ?
+                                        f->packed : f->rounded;
+
+        for (int c = 0; c < f->nChannels; ++c)
+        {
+            float* table = f->table + c * 2 * f->length;
+
+            wptr = (kernel16 != 0) ?
+                   kernel16(f->packed16, f->length, table, f->wptr,
+                            in[c], out[c], nSamples) :
+                   (f->nRuns > 0) ?
+                   fir_kernel_runs(h, f->length, f->runs, f->nRuns,
+                                   table, f->wptr, in[c], out[c], nSamples) :
+                   fir_kernel(h, f->length, table, f->wptr,
+                              in[c], out[c], nSamples);
+        }
+
+        f->wptr = wptr;
+    }
+
+#ifdef HOF_STATS
+    hof_stats_block(&f->stats, time, out, f->nChannels, nSamples);
+#endif
+}
+
+// coefficients ----------------------------------------------------------------
+/*
+ * the packed length: the order, rounded up to a multiple of hof_fir_pad.
+ * 16 bit kernels write four samples ahead, so they need three zero
+ * coefficients (the oldest samples) first.
+ */
+static int fir_length(const int order, const hof_precision precision)
+{
+    const int padded = order + ((precision == hof_float32) ? 0 : 3);
+    return (padded + hof_fir_pad - 1) / hof_fir_pad * hof_fir_pad;
+}
+
+/*
+ * make room for 'order' coefficients at 'precision'. the packed coefficients
+ * and delay tables are resized (and cleared) only if the length changes;
+ * the 16 bit copies are only kept at 16 bits.
+ */
+static int fir_resize(hof_fir* f, const int order,
+                      const hof_precision precision)
+{
+    const int length = fir_length(order, precision);
+    const int is16   = (precision != hof_float32);
+
+    if (length != f->length || f->table == 0)
+    {
+        float* packed = (float*)hof_calloc_aligned(sizeof(float) * length);
+        float* table  = (float*)hof_calloc_aligned(sizeof(float) * length * 2 *
+                                                   f->nChannels);
+        unsigned short* packed16 = is16 ? (unsigned short*)
+            hof_calloc_aligned(sizeof(short) * length) : 0;
+        float* rounded = is16 ? (float*)
+            hof_calloc_aligned(sizeof(float) * length) : 0;
+
+        if (packed == 0 || table == 0 ||
+            (is16 && (packed16 == 0 || rounded == 0)))
+        {   // failed to allocate memory
+            hof_free_aligned(packed);
+            hof_free_aligned(table);
+            hof_free_aligned(packed16);
+            hof_free_aligned(rounded);
+            return 0;
+        }
+
+        hof_free_aligned(f->packed);
+        hof_free_aligned(f->table);
+        hof_free_aligned(f->packed16);
+        hof_free_aligned(f->rounded);
+        f->packed   = packed;
+        f->table    = table;
+        f->packed16 = packed16;
+        f->rounded  = rounded;
+        f->length   = length;
+        f->wptr     = 0;
+    }
+    else if (is16 && (f->packed16 == 0 || f->rounded == 0))
+    {
+        unsigned short* packed16 = (f->packed16 != 0) ? f->packed16 :
+            (unsigned short*)hof_calloc_aligned(sizeof(short) * length);
+        float* rounded = (f->rounded != 0) ? f->rounded :
+            (float*)hof_calloc_aligned(sizeof(float) * length);
+
+        f->packed16 = packed16;
+        f->rounded  = rounded;
+
+        if (packed16 == 0 || rounded == 0)
+        {
+            return 0;
+        }
+    }
+    else if (!is16)
+    {   // back to 32 bits: the 16 bit copies aren't needed
+        hof_free_aligned(f->packed16);
+        hof_free_aligned(f->rounded);
+        f->packed16 = 0;
+        f->rounded  = 0;
+    }
+
+    if (order < f->order)
+    {   // clear coefficients the new order no longer covers
+        memset(f->packed, 0, sizeof(float) * (length - order));
+    }
+
+    f->order  = order;
+    f->repack = 1;
+    return 1;
+}
+
+/*
+ * with sparse on, find the runs of hof_fir_pad tap blocks that aren't all
+ * zero, so the kernel can skip the rest. a run costs about a block more
+ * (its sum, and the loop around it), so runs are only used if they save
+ * more than that. 16 bit kernels work through every tap four samples at a
+ * time, so they never use runs. if memory runs out, every tap is used.
+ */
+static void fir_index(hof_fir* f)
+{
+    const int nBlocks = f->length / hof_fir_pad;
+    int       nLive   = 0;
+
+    f->nRuns = 0;
+
+    if (!f->sparse || f->coefs == 0 || f->precision != hof_float32)
+    {
+        return;
+    }
+
+    int* runs = (int*)realloc(f->runs, sizeof(int) * 2 * nBlocks);
+
+    if (runs == 0)
+    {
+        return;
+    }
+
+    f->runs = runs;
+
+    for (int b = 0; b < nBlocks; ++b)
+    {   // packed float j is coefficient length - 1 - j
+        const int first = b * hof_fir_pad;
+        int       live  = 0;
+
+        for (int j = first; !live && j < first + hof_fir_pad; ++j)
+        {
+            const int k = f->length - 1 - j;
+            live = (k < f->order && f->coefs[k * f->stride] != 0.f);
+        }
+
+        if (live && f->nRuns > 0 &&
+            runs[2 * f->nRuns - 2] + runs[2 * f->nRuns - 1] == first)
+        {   // the last run goes on
+            runs[2 * f->nRuns - 1] += hof_fir_pad;
+        }
+        else if (live)
+        {
+            runs[2 * f->nRuns]     = first;
+            runs[2 * f->nRuns + 1] = hof_fir_pad;
+            f->nRuns += 1;
+        }
+
+        nLive += live;
+    }
+
+    if (nLive + f->nRuns >= nBlocks)
+    {   // not sparse enough
+        f->nRuns = 0;
+    }
+}
+
+/*
+ * point to a new coefficient table.
+ */
+int hof_fir_set_coefs(hof_fir* f, const float* coefs, int order, int stride)
+{
+    if (coefs == 0 || order < 1)
+    {
+        f->coefs = 0;
+        return 1;
+    }
+
+    if (!fir_resize(f, order, f->precision))
+    {
+        f->coefs = 0;
+        return 0;
+    }
+
+    f->coefs  = coefs;
+    f->stride = stride;
+    fir_index(f);
+
+#ifdef HOF_STATS
+    f->stats.nUpdates += 1;
+#endif
+
+    return 1;
+}
+
+// sparse ----------------------------------------------------------------------
+void hof_fir_set_sparse(hof_fir* f, int sparse)
+{
+    f->sparse = (sparse != 0);
+    fir_index(f);
+}
+
+int hof_fir_taps(const hof_fir* f)
+{
+    int taps = 0;
+
+    for (int r = 0; r < f->nRuns; ++r)
+    {
+        taps += f->runs[2 * r + 1];
+    }
+
+    return (f->coefs == 0) ? 0 : (f->nRuns > 0) ? taps : f->order;
+}
+
+// precision -------------------------------------------------------------------
+int hof_fir_set_precision(hof_fir* f, hof_precision precision)
+{
+    if (f->order > 0 && !fir_resize(f, f->order, precision))
+    {
+        return 0;
+    }
+
+    f->precision = precision;
+    f->repack    = 1;
+    fir_index(f);
+    return 1;
+}
+
+double hof_fir_error(const hof_fir* f)
+{
+    double error = 0.;
+
+    for (int k = 0; f->coefs != 0 && k < f->order; ++k)
+    {
+        const float h = f->coefs[k * f->stride];
+        float rounded = h;
+
+        if (f->precision == hof_float16)
+        {
+            rounded = half_to_float(float_to_half(h));
+        }
+        else if (f->precision == hof_bfloat16)
+        {
+            rounded = bfloat_to_float(float_to_bfloat(h));
+        }
+
+        error += fabs((double)h - rounded);
+    }
+
+    return error;
+}
+
+void hof_fir_reset(hof_fir* f)
+{
+    if (f->table != 0)
+    {
+        memset(f->table, 0, sizeof(float) * f->length * 2 * f->nChannels);
+    }
+}
+
+// new/free --------------------------------------------------------------------
+hof_fir* hof_fir_new(int nChannels)
+{
+    hof_fir* f = (hof_fir*)malloc(sizeof(hof_fir));
+
+    if (f == 0)
+    {
+        return 0;
+    }
+
+    if (fir_kernel == 0)
+    {
+        fir_dispatch();
+    }
+
+    f->coefs     = 0;
+    f->stride    = 1;
+    f->order     = 0;
+    f->length    = 0;
+    f->nChannels = nChannels;
+    f->precision = hof_float32;
+    f->packed    = 0;
+    f->packed16  = 0;
+    f->rounded   = 0;
+    f->repack    = 1;
+    f->table     = 0;
+    f->wptr      = 0;
+    f->runs      = 0;
+    f->nRuns     = 0;
+    f->sparse    = 0;
+
+#ifdef HOF_STATS
+    hof_stats_reset(&f->stats);
+#endif
+
+    return f;
+}
+
+void hof_fir_free(hof_fir* f)
+{
+    if (f != 0)
+    {
+        hof_free_aligned(f->packed);
+        hof_free_aligned(f->packed16);
+        hof_free_aligned(f->rounded);
+        hof_free_aligned(f->table);
+        free(f->runs);
+        free(f);
+    }
+}
+
+// adaptive filters ------------------------------------------------------------
+hof_lms* hof_lms_new(int order)
+{
+    hof_lms* f = (hof_lms*)malloc(sizeof(hof_lms));
+
+    if (f == 0)
+    {
+        return 0;
+    }
+
+    if (fir_kernel == 0)
+    {
+        fir_dispatch();
+    }
+
+    f->order  = clip_order(order);
+    f->length = fir_length(f->order, hof_float32);
+    f->mu     = 0.1f;
+    f->leak   = 0.f;
+    f->taps   = (float*)hof_calloc_aligned(sizeof(float) * f->length);
+    f->table  = (float*)hof_calloc_aligned(sizeof(float) * f->length * 2);
+    f->wptr   = 0;
+    f->energy = 0.;
+
+#ifdef HOF_STATS
+    hof_stats_reset(&f->stats);
+#endif
+
+    if (f->taps == 0 || f->table == 0)
+    {
+        hof_lms_free(f);
+        return 0;
+    }
+
+    return f;
+}
+
+void hof_lms_free(hof_lms* f)
+{
+    if (f != 0)
+    {
+        hof_free_aligned(f->taps);
+        hof_free_aligned(f->table);
+        free(f);
+    }
+}
+
+void hof_lms_set_mu(hof_lms* f, float mu)
+{
+    f->mu = clip_float(mu, 0.f, 2.f);
+}
+
+void hof_lms_set_leak(hof_lms* f, float leak)
+{
+    f->leak = clip_float(leak, 0.f, 1.f);
+}
+
+void hof_lms_get_taps(const hof_lms* f, float* coefs, int nCoefs, int stride)
+{
+    const float* h = f->taps + f->length - 1;
+
+    for (int k = 0; k < nCoefs; ++k)
+    {
+        coefs[k * stride] = (k < f->order) ? h[-k] : 0.f;
+    }
+}
+
+void hof_lms_reset(hof_lms* f)
+{
+    memset(f->taps, 0, sizeof(float) * f->length);
+    memset(f->table, 0, sizeof(float) * f->length * 2);
+    f->energy = 0.;
+}
+
+void hof_lms_process(hof_lms* f, const float* x, const float* d, float* y,
+                     float* e, int nSamples)
+{
+#ifdef HOF_STATS
+    const double time = hof_now_ns();
+#endif
+
+    f->wptr = lms_kernel(f->taps, f->length, f->order, f->table, f->wptr,
+                         &f->energy, f->mu, 1.f - f->leak, x, d, y, e,
+                         nSamples);
+
+#ifdef HOF_STATS
+    hof_stats_block(&f->stats, time, &e, 1, nSamples);
+#endif
+}
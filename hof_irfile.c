@@ -0,0 +1,199 @@
+//------------------------------------------------------------------------------
+//  Higher Order Filter Project
+//
+//  hof_irfile.c: impulse responses read straight from sound files
+//  Copyright (c) 2016 Elliot Patros. All rights reserved.
+//------------------------------------------------------------------------------
+
+#include "hof.h"
+#include "hof_util.h"
+
+/*
+ * the file is mapped, not read. a 32 bit float wav (or raw file) is used
+ * where it lies, as long as its samples are aligned and this machine is
+ * little endian like the file; anything else is converted into memory of
+ * our own, the way pd's soundfiler (and tools/wav.c) converts it.
+ */
+
+// helpers ---------------------------------------------------------------------
+// wav files are little endian, whatever this machine is
+static unsigned long irfile_le(const unsigned char* p, const int nBytes)
+{
+    unsigned long value = 0;
+
+    for (int i = nBytes - 1; i >= 0; --i)
+    {
+        value = (value << 8) | p[i];
+    }
+
+    return value;
+}
+
+static int irfile_little_endian(void)
+{
+    const unsigned int one = 1;
+    return *(const unsigned char*)&one == 1;
+}
+
+/*
+ * find the samples of a wav file: walk the chunks after "RIFF....WAVE" for
+ * "fmt " and "data". returns the bytes per sample (0 if it isn't a wav file
+ * we can read). a "fmt " chunk is only read if all of it is in the file; a
+ * "data" chunk cut short is read as far as it goes.
+ */
+static int irfile_parse(const unsigned char* p, const size_t bytes,
+                        const unsigned char** data, long* nFrames,
+                        int* nChannels, float* sr, int* isFloat)
+{
+    const unsigned char* fmt   = 0;
+    int                  nBits = 0;
+
+    *data = 0;
+
+    for (size_t at = 12; at + 8 <= bytes; )
+    {
+        const unsigned char* chunk = p + at;
+        const unsigned long  size  = irfile_le(chunk + 4, 4);
+        const size_t         left  = bytes - at - 8; // (after its header)
+
+        if (memcmp(chunk, "fmt ", 4) == 0 && size >= 16 && size <= left)
+        {
+            fmt = chunk + 8;
+            const unsigned long tag = irfile_le(fmt, 2);
+
+            // WAVE_FORMAT_EXTENSIBLE keeps the real tag in its sub-format
+            *isFloat   = (tag == 0xfffe && size >= 26) ?
+                         irfile_le(fmt + 24, 2) == 3 : tag == 3;
+            *nChannels = (int)irfile_le(fmt + 2, 2);
+            *sr        = (float)irfile_le(fmt + 4, 4);
+            nBits      = (int)irfile_le(fmt + 14, 2);
+        }
+        else if (memcmp(chunk, "data", 4) == 0 && fmt != 0)
+        {
+            *data    = chunk + 8;
+            *nFrames = (long)((size < left) ? size : left);
+            break;
+        }
+
+        if (size >= left)
+        {   // (the last chunk, or one that runs past the end)
+            break;
+        }
+
+        at += 8 + ((size + 1) & ~1ul);
+    }
+
+    if (*data == 0 || *nChannels < 1 ||
+        (*isFloat ? nBits != 32 : (nBits != 16 && nBits != 24 &&
+                                   nBits != 32)))
+    {
+        return 0;
+    }
+
+    *nFrames /= (nBits / 8) * *nChannels;
+    return nBits / 8;
+}
+
+// open/free -------------------------------------------------------------------
+hof_irfile* hof_irfile_open(const char* path, int channel)
+{
+    hof_irfile* f = (hof_irfile*)calloc(1, sizeof(hof_irfile));
+
+    if (f == 0)
+    {
+        return 0;
+    }
+
+    if ((f->map = hof_map_file(path, &f->mapSize)) == 0)
+    {
+        hof_irfile_free(f);
+        return 0;
+    }
+
+    const unsigned char* file      = (const unsigned char*)f->map;
+    const unsigned char* data      = file;
+    long                 nFrames   = (long)(f->mapSize / sizeof(float));
+    int                  nChannels = 1;
+    int                  isFloat   = 1;
+    int                  bytes     = sizeof(float);
+
+    if (f->mapSize >= 12 && memcmp(file, "RIFF", 4) == 0 &&
+        memcmp(file + 8, "WAVE", 4) == 0)
+    {
+        bytes = irfile_parse(file, f->mapSize, &data, &nFrames, &nChannels,
+                             &f->sr, &isFloat);
+    }
+
+    if (bytes == 0 || channel < 0 || channel >= nChannels || nFrames < 1 ||
+        nFrames > 0x7fffffff)
+    {   // not a file we can read (or no such channel)
+        hof_irfile_free(f);
+        return 0;
+    }
+
+    const unsigned char* first = data + channel * bytes;
+
+    f->order = (int)nFrames;
+
+    if (isFloat && irfile_little_endian() &&
+        (size_t)first % sizeof(float) == 0)
+    {   // use the file as it is
+        f->coefs  = (const float*)first;
+        f->stride = nChannels;
+        return f;
+    }
+
+    if ((f->samples = (float*)malloc(sizeof(float) * nFrames)) == 0)
+    {
+        hof_irfile_free(f);
+        return 0;
+    }
+
+    for (long n = 0; n < nFrames; ++n)
+    {   // integers are scaled by a power of two, like pd's soundfiler
+        const unsigned char* p    = first + n * bytes * nChannels;
+        const unsigned long  bits = irfile_le(p, bytes);
+
+        if (isFloat)
+        {
+            const unsigned int word = (unsigned int)bits;
+            memcpy(&f->samples[n], &word, sizeof(float));
+        }
+        else
+        {
+            const int i = (int)(unsigned int)(bits << (32 - 8 * bytes));
+            f->samples[n] = (float)(i * (1. / 2147483648.));
+        }
+    }
+
+    f->coefs  = f->samples;
+    f->stride = 1;
+    return f;
+}
+
+hof_irfile* hof_irfile_new(int order)
+{
+    hof_irfile* f = (hof_irfile*)calloc(1, sizeof(hof_irfile));
+
+    if (f == 0 || order < 1 ||
+        (f->samples = (float*)calloc(order, sizeof(float))) == 0)
+    {
+        hof_irfile_free(f);
+        return 0;
+    }
+
+    f->coefs  = f->samples;
+    f->order  = order;
+    f->stride = 1;
+    return f;
+}
+
+void hof_irfile_free(hof_irfile* f)
+{
+    if (f != 0)
+    {
+        hof_unmap_file(f->map, f->mapSize);
+        free(f->samples);
+        free(f);
+    }
+}
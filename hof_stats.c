@@ -0,0 +1,24 @@
+//------------------------------------------------------------------------------
+//  Higher Order Filter Project
+//
+//  hof_stats.c: counters kept by every filter engine (built with HOF_STATS)
+//  Copyright (c) 2016 Elliot Patros. All rights reserved.
+//------------------------------------------------------------------------------
+
+#include "hof.h"
+#include "hof_util.h"
+
+#ifdef HOF_STATS
+
+// reset -----------------------------------------------------------------------
+void hof_stats_reset(hof_stats* s)
+{
+    s->nBlocks    = 0;
+    s->nSamples   = 0;
+    s->ns_total   = 0.;
+    s->ns_max     = 0.;
+    s->nUpdates   = 0;
+    s->nDenormals = 0;
+}
+
+#endif // HOF_STATS defined
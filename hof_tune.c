@@ -0,0 +1,371 @@
+//------------------------------------------------------------------------------
+//  Higher Order Filter Project
+//
+//  hof_tune.c: measuring this machine's kernels, and remembering the answer
+//  Copyright (c) 2016 Elliot Patros. All rights reserved.
+//------------------------------------------------------------------------------
+
+#include "hof.h"
+#include "hof_util.h"
+
+#include <stdio.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#endif
+
+/*
+ * the kernel dispatch picks the widest instructions a cpu has, which isn't
+ * always the fastest (avx512 can lower the clock, and some cpus split wide
+ * loads), and the convolver's plans are only as good as its idea of what an
+ * fft costs. so each kernel is timed once per machine, and the results are
+ * kept in a small text file, one line per cpu:
+ *
+ *     <kernel> <butterfly> <bin> <cpu name>
+ *
+ * later processes on the same cpu just read the line back.
+ */
+#define tune_block  64   // samples per call, like pd
+#define tune_length 8192 // samples per measurement
+#define tune_tries  5    // measurements per case (the fastest counts)
+#define tune_passes 8    // times hof_conv's measurements go through them
+
+static hof_atomic tune_done = 0; // set by the first call (see hof_tune)
+
+// cpu name --------------------------------------------------------------------
+static void tune_cpu_name(char* name, const int size)
+{
+    unsigned int regs[12] = {0};
+    int          ok       = 0;
+
+#if defined(_MSC_VER)
+    int info[4];
+
+    __cpuid(info, 0x80000000);
+
+    if ((unsigned int)info[0] >= 0x80000004)
+    {
+        for (int i = 0; i < 3; ++i)
+        {
+            __cpuid(info, 0x80000002 + i);
+            memcpy(regs + 4 * i, info, sizeof(info));
+        }
+
+        ok = 1;
+    }
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    ok = 1;
+
+    for (unsigned int i = 0; ok && i < 3; ++i)
+    {
+        ok = __get_cpuid(0x80000002 + i, &regs[4 * i], &regs[4 * i + 1],
+                         &regs[4 * i + 2], &regs[4 * i + 3]);
+    }
+#endif
+
+    const char* brand = ok ? (const char*)regs : "unknown";
+    int         n     = 0;
+
+    while (*brand == ' ')
+    {
+        ++brand;
+    }
+
+    for (int i = 0; n < size - 1 && i < 48 && brand[i] != '\0'; ++i)
+    {   // keep it on one line
+        name[n++] = (brand[i] == '\n' || brand[i] == '\r') ? ' ' : brand[i];
+    }
+
+    while (n > 0 && name[n - 1] == ' ')
+    {
+        --n;
+    }
+
+    name[n] = '\0';
+}
+
+// measurements ----------------------------------------------------------------
+/*
+ * nanoseconds per sample for hof_fir with 'order' taps (the fastest try).
+ * buffer holds tune_length samples of input, then room for the output.
+ */
+static double tune_fir(const float* coefs, const int order, float* buffer)
+{
+    hof_fir* f    = hof_fir_new(1);
+    double   best = 0.;
+
+    if (f == 0 || hof_fir_set_coefs(f, coefs, order, 1) == 0)
+    {
+        hof_fir_free(f);
+        return 0.;
+    }
+
+    for (int t = 0; t < tune_tries; ++t)
+    {
+        const double start = hof_now_ns();
+
+        for (int i = 0; i < tune_length; i += tune_block)
+        {
+            const float* in  = buffer + i;
+            float*       out = buffer + tune_length + i;
+            hof_fir_process(f, &in, &out, tune_block);
+        }
+
+        const double time = (hof_now_ns() - start) / tune_length;
+        best = (t == 0 || time < best) ? time : best;
+    }
+
+    hof_fir_free(f);
+    return best;
+}
+
+// nanoseconds per sample for hof_conv with 'nParts' partitions of 'size'
+static double tune_conv(const float* coefs, const int size, const int nParts,
+                        float* buffer)
+{
+    hof_conv* c    = hof_conv_new(size);
+    double    best = 0.;
+
+    if (c == 0 || hof_conv_set_coefs(c, coefs, size * nParts, 1) == 0)
+    {
+        hof_conv_free(c);
+        return 0.;
+    }
+
+    for (int t = 0; t < tune_tries; ++t)
+    {
+        const double start = hof_now_ns();
+
+        for (int i = 0; i < tune_passes * tune_length; i += tune_block)
+        {   // (a block every 'size' samples is fewer, so more passes)
+            const int j = i % tune_length;
+            hof_conv_process(c, buffer + j, buffer + tune_length + j,
+                             tune_block);
+        }
+
+        const double time = (hof_now_ns() - start) /
+                            (tune_passes * tune_length);
+        best = (t == 0 || time < best) ? time : best;
+    }
+
+    hof_conv_free(c);
+    return best;
+}
+
+// nanoseconds for one hof_spectrum_mac of 'size' (of the spectra in 'coefs')
+static double tune_mac(const float* coefs, const int size, float* buffer)
+{
+    double best = 0.;
+
+    memset(buffer, 0, sizeof(float) * size);
+
+    for (int t = 0; t < tune_tries; ++t)
+    {
+        const double start = hof_now_ns();
+
+        for (int i = 0; i < tune_length; ++i)
+        {
+            hof_spectrum_mac(buffer, coefs + (i % 4) * size,
+                             coefs + (4 + i % 4) * size, size);
+        }
+
+        const double time = (hof_now_ns() - start) / tune_length;
+        best = (t == 0 || time < best) ? time : best;
+    }
+
+    return best;
+}
+
+/*
+ * time every kernel this cpu runs and keep the fastest. then, with it, a tap
+ * is the slope between 1024 and 4096 taps. a bin is one partition's
+ * hof_spectrum_mac (every 256 samples), and the butterflies are what's left
+ * of hof_conv with 4 partitions (see convolver_layout):
+ *
+ *     t(4) = tap * (4 * butterfly * log2(2 * 256) + bin * 4)
+ *
+ * (both filters are shorter than hof_cache_min, so nothing is cached.)
+ */
+static int tune_measure(char* kernel, float* butterfly, float* bin)
+{
+    const char* names[] = {"avx512", "avx2", "sse2", "c"};
+    const int   longest = 4096;
+    float*      coefs   = (float*)malloc(sizeof(float) * longest);
+    float*      buffer  = (float*)malloc(sizeof(float) * 2 * tune_length);
+    double      best    = 0.;
+
+    if (coefs == 0 || buffer == 0)
+    {
+        free(coefs);
+        free(buffer);
+        return 0;
+    }
+
+    // a decaying noise, so nothing is denormal or silent
+    unsigned int seed = 1;
+
+    for (int k = 0; k < longest; ++k)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        coefs[k] = ((float)(seed >> 8) / 16777216.f - 0.5f) *
+                   expf(-4.f * k / longest);
+    }
+
+    for (int i = 0; i < tune_length; ++i)
+    {
+        seed = seed * 1664525u + 1013904223u;
+        buffer[i] = (float)(seed >> 8) / 16777216.f - 0.5f;
+    }
+
+    strcpy(kernel, "c");
+
+    for (int i = 0; i < 4; ++i)
+    {
+        if (hof_fir_set_kernel(names[i]))
+        {
+            const double time = tune_fir(coefs, 4096, buffer);
+
+            if (time > 0. && (best == 0. || time < best))
+            {
+                best = time;
+                strcpy(kernel, names[i]);
+            }
+        }
+    }
+
+    hof_fir_set_kernel(kernel);
+
+    const double tap = (tune_fir(coefs, 4096, buffer) -
+                        tune_fir(coefs, 1024, buffer)) / 3072.;
+    const double t4  = tune_conv(coefs, 256, 4, buffer);
+    const double mac = tune_mac(coefs, 512, buffer) / 256.; // (after an fft)
+
+    free(coefs);
+    free(buffer);
+
+    if (tap <= 0. || mac <= 0. || t4 <= 4. * mac)
+    {   // too noisy to tell (the defaults stay)
+        *butterfly = 0.f;
+        *bin       = 0.f;
+        return 1;
+    }
+
+    *bin       = (float)(mac / tap);
+    *butterfly = (float)((t4 / tap - 4. * *bin) / (4. * 9.));
+    return 1;
+}
+
+// cache -----------------------------------------------------------------------
+// this cpu's line from the file at 'path' (returns 0 if there isn't one)
+static int tune_load(const char* path, const char* cpu, char* kernel,
+                     float* butterfly, float* bin)
+{
+    FILE* file = fopen(path, "r");
+    char  line[256];
+    int   found = 0;
+
+    if (file == 0)
+    {
+        return 0;
+    }
+
+    while (!found && fgets(line, sizeof(line), file) != 0)
+    {
+        char name[16];
+        int  end = 0;
+
+        line[strcspn(line, "\r\n")] = '\0';
+
+        if (line[0] != '#' &&
+            sscanf(line, "%15s %f %f %n", name, butterfly, bin, &end) == 3 &&
+            end > 0 && strcmp(line + end, cpu) == 0)
+        {
+            strcpy(kernel, name);
+            found = 1;
+        }
+    }
+
+    fclose(file);
+    return found;
+}
+
+// add this cpu's line to the file at 'path' (returns 0 if it can't)
+static int tune_save(const char* path, const char* cpu, const char* kernel,
+                     const float butterfly, const float bin)
+{
+    FILE* file = fopen(path, "a");
+
+    if (file == 0)
+    {
+        return 0;
+    }
+
+    if (ftell(file) == 0)
+    {
+        fprintf(file, "# higher order filter tuning: kernel, butterfly and "
+                      "bin cost (in taps), cpu\n");
+    }
+
+    fprintf(file, "%s %g %g %s\n", kernel, butterfly, bin, cpu);
+    return fclose(file) == 0;
+}
+
+// tune ------------------------------------------------------------------------
+int hof_tune(const char* path)
+{
+    char  cpu[64];
+    char  kernel[16];
+    float butterfly = 0.f;
+    float bin       = 0.f;
+    int   ok        = 1;
+
+    if (hof_atomic_exchange(&tune_done, 1))
+    {   // (another call measured, or is measuring)
+        return 1;
+    }
+
+    tune_cpu_name(cpu, sizeof(cpu));
+
+    if (path == 0 || !tune_load(path, cpu, kernel, &butterfly, &bin))
+    {
+        if (!tune_measure(kernel, &butterfly, &bin))
+        {
+            hof_atomic_store(&tune_done, 0); // (out of memory: try again)
+            return 0;
+        }
+
+        ok = (path == 0) || tune_save(path, cpu, kernel, butterfly, bin);
+    }
+
+    hof_fir_set_kernel(kernel); // (unless this cpu can't run it after all)
+    hof_convolver_set_costs(butterfly, bin);
+    return ok;
+}
+
+const char* hof_tune_path(void)
+{
+    static char path[1024];
+    const char* file = getenv("HOF_TUNING");
+
+#if defined(_WIN32)
+    const char* home = getenv("USERPROFILE");
+#else
+    const char* home = getenv("HOME");
+#endif
+
+    if (file != 0)
+    {
+        return (file[0] != '\0') ? file : 0;
+    }
+
+    if (home == 0 ||
+        snprintf(path, sizeof(path), "%s/.hof_tuning", home) >=
+        (int)sizeof(path))
+    {
+        return 0;
+    }
+
+    return path;
+}
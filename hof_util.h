@@ -0,0 +1,386 @@
+//------------------------------------------------------------------------------
+//  Higher Order Filter Project
+//
+//  hof_util.h: constants and helper functions shared by the filter engines
+//  Copyright (c) 2016 Elliot Patros. All rights reserved.
+//------------------------------------------------------------------------------
+
+#ifndef _hof_util_h
+#define _hof_util_h
+
+// standard headers ------------------------------------------------------------
+#include <math.h>   // for tan and some constants
+#include <float.h>  // for FLT_EPSILON
+#include <string.h> // for memset
+#include <stdlib.h> // for *alloc family
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+#ifndef M_SQRT2
+#define M_SQRT2 1.41421356237309504880
+#endif
+
+#ifndef M_SQRT1_2
+#define M_SQRT1_2 0.70710678118654752440
+#endif
+
+// constants -------------------------------------------------------------------
+static const float default_Q = M_SQRT1_2;
+static const float default_freq = 1000.f;
+static const float default_dB = 0.f;
+static const float default_sr = 44100.f;
+static const float min_freq = FLT_EPSILON;
+static const float max_freq_ratio = 0.5f - FLT_EPSILON;
+static const float min_Q = FLT_EPSILON;
+static const float max_Q = 1000.f - FLT_EPSILON;
+static const float max_order = 65536.f;
+
+// comparisons -----------------------------------------------------------------
+static inline
+float clip_float(const float val, const float min, const float max)
+{
+    return (val < min) ? min : (fminf(val, max));
+}
+
+// 'sr' is the rate the filter runs at (which may be lower than pd's)
+static inline
+float clip_freq_ratio(const float freq, const float sr)
+{
+    return clip_float(freq / sr, min_freq, max_freq_ratio);
+}
+
+static inline
+float clip_Q(const float Q)
+{
+    return clip_float(Q, min_Q, max_Q);
+}
+
+static inline
+int clip_order(const int order)
+{
+    return lrintf(clip_float(order, 1.f, max_order));
+}
+
+// conversions -----------------------------------------------------------------
+static inline
+float dB_to_gain(const float dB)
+{
+    return clip_float(powf(10.f, dB * 0.05f), 0.f, FLT_MAX);
+}
+
+static inline
+float gain_to_dB(const float gain)
+{
+    return clip_float(20.f * log10f(gain), FLT_MIN, FLT_MAX);
+}
+
+/*
+ * tan(pi * ratio) for 0 < ratio < 0.5, cheaply enough to do every sample: a
+ * [5/4] pade approximant up to a quarter, and 1 / tan of the rest above it
+ * (within 0.0002 of tanf, relatively, which is float rounding near nyquist).
+ */
+static inline
+float tan_pi(const float ratio)
+{
+    const float t  = (float)M_PI * ((ratio > 0.25f) ? 0.5f - ratio : ratio);
+    const float t2 = t * t;
+    const float y  = t * (945.f + t2 * (t2 - 105.f)) /
+                     (945.f + t2 * (15.f * t2 - 420.f));
+
+    return (ratio > 0.25f) ? 1.f / y : y;
+}
+
+// memory ----------------------------------------------------------------------
+/*
+ * zeroed memory aligned to 'hof_align' bytes (enough for any simd register).
+ * the pointer malloc returned is kept just before the aligned block.
+ */
+#define hof_align 64
+
+static inline
+void* hof_calloc_aligned(const size_t size)
+{
+    char* memory = (char*)calloc(size + hof_align + sizeof(void*), 1);
+
+    if (memory == 0)
+    {
+        return 0;
+    }
+
+    char* aligned = memory + sizeof(void*);
+    aligned += (hof_align - (size_t)aligned % hof_align) % hof_align;
+    ((void**)aligned)[-1] = memory;
+    return aligned;
+}
+
+static inline
+void hof_free_aligned(void* aligned)
+{
+    if (aligned != 0)
+    {
+        free(((void**)aligned)[-1]);
+    }
+}
+
+// atomics ---------------------------------------------------------------------
+/*
+ * just enough to pass values between two threads: loads acquire, stores
+ * release, and 'or' and 'exchange' are atomic read-modify-writes.
+ */
+#if defined(_MSC_VER)
+#include <intrin.h>
+
+/*
+ * _ReadWriteBarrier only stops the compiler reordering, not the cpu (which
+ * arm does), so loads and stores are real acquires and releases: ldar and
+ * stlr on arm64, and interlocked (full barrier) operations elsewhere.
+ */
+static inline
+int hof_atomic_load(hof_atomic* a)
+{
+#if defined(_M_ARM64)
+    return (int)__ldar32((volatile unsigned __int32*)a);
+#else
+    return _InterlockedOr((volatile long*)a, 0);
+#endif
+}
+
+static inline
+void hof_atomic_store(hof_atomic* a, const int value)
+{
+#if defined(_M_ARM64)
+    __stlr32((volatile unsigned __int32*)a, (unsigned __int32)value);
+#else
+    _InterlockedExchange((volatile long*)a, value);
+#endif
+}
+
+static inline
+int hof_atomic_or(hof_atomic* a, const int value)
+{
+    return _InterlockedOr((volatile long*)a, value);
+}
+
+static inline
+int hof_atomic_exchange(hof_atomic* a, const int value)
+{
+    return _InterlockedExchange((volatile long*)a, value);
+}
+#else
+static inline
+int hof_atomic_load(hof_atomic* a)
+{
+    return __atomic_load_n(a, __ATOMIC_ACQUIRE);
+}
+
+static inline
+void hof_atomic_store(hof_atomic* a, const int value)
+{
+    __atomic_store_n(a, value, __ATOMIC_RELEASE);
+}
+
+static inline
+int hof_atomic_or(hof_atomic* a, const int value)
+{
+    return __atomic_fetch_or(a, value, __ATOMIC_ACQ_REL);
+}
+
+static inline
+int hof_atomic_exchange(hof_atomic* a, const int value)
+{
+    return __atomic_exchange_n(a, value, __ATOMIC_ACQ_REL);
+}
+#endif
+
+// clock -----------------------------------------------------------------------
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+static inline
+double hof_now_ns(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER t, f;
+    QueryPerformanceCounter(&t);
+    QueryPerformanceFrequency(&f);
+    return (double)t.QuadPart * 1e9 / (double)f.QuadPart;
+#else
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1e9 + t.tv_nsec;
+#endif
+}
+
+// mapped files ----------------------------------------------------------------
+/*
+ * a whole file, mapped read only (0 if it can't be, or it's empty). 'bytes'
+ * gets its size, which hof_unmap_file needs back.
+ */
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static inline
+const void* hof_map_file(const char* path, size_t* bytes)
+{
+    void* map = 0;
+
+#ifdef _WIN32
+    HANDLE        file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, 0,
+                                     OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    LARGE_INTEGER size;
+
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return 0;
+    }
+
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+    {
+        HANDLE view = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+
+        if (view != 0)
+        {
+            map = MapViewOfFile(view, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(view); // (the view keeps it open)
+        }
+
+        *bytes = (size_t)size.QuadPart;
+    }
+
+    CloseHandle(file);
+#else
+    const int   file = open(path, O_RDONLY);
+    struct stat info;
+
+    if (file < 0)
+    {
+        return 0;
+    }
+
+    if (fstat(file, &info) == 0 && info.st_size > 0)
+    {
+        map = mmap(0, info.st_size, PROT_READ, MAP_SHARED, file, 0);
+        map = (map == MAP_FAILED) ? 0 : map;
+        *bytes = (size_t)info.st_size;
+    }
+
+    close(file);
+#endif
+
+    return map;
+}
+
+static inline
+void hof_unmap_file(const void* map, const size_t bytes)
+{
+    if (map != 0)
+    {
+#ifdef _WIN32
+        (void)bytes;
+        UnmapViewOfFile(map);
+#else
+        munmap((void*)map, bytes);
+#endif
+    }
+}
+
+// threads ---------------------------------------------------------------------
+/*
+ * just enough to run one function in the background, and wait for it to
+ * finish. the hof_thread has to stay put until then.
+ */
+#ifdef _WIN32
+typedef struct hof_thread
+{
+    HANDLE handle;
+    void*  (*fn)(void*);
+    void*  arg;
+
+} hof_thread;
+
+static inline
+DWORD WINAPI hof_thread_main(LPVOID t)
+{
+    ((hof_thread*)t)->fn(((hof_thread*)t)->arg);
+    return 0;
+}
+
+static inline
+int hof_thread_start(hof_thread* t, void* (*fn)(void*), void* arg)
+{
+    t->fn     = fn;
+    t->arg    = arg;
+    t->handle = CreateThread(0, 0, hof_thread_main, t, 0, 0);
+    return t->handle != 0;
+}
+
+static inline
+void hof_thread_join(hof_thread* t)
+{
+    WaitForSingleObject(t->handle, INFINITE);
+    CloseHandle(t->handle);
+}
+#else
+#include <pthread.h>
+
+typedef struct hof_thread
+{
+    pthread_t id;
+
+} hof_thread;
+
+static inline
+int hof_thread_start(hof_thread* t, void* (*fn)(void*), void* arg)
+{
+    return pthread_create(&t->id, 0, fn, arg) == 0;
+}
+
+static inline
+void hof_thread_join(hof_thread* t)
+{
+    pthread_join(t->id, 0);
+}
+#endif
+
+// instrumentation -------------------------------------------------------------
+#ifdef HOF_STATS
+
+/*
+ * called at the end of every _process, with the time it started. output that
+ * is nonzero but smaller than FLT_MIN is denormal, and usually means a filter
+ * is decaying into the (very slow) denormal range.
+ */
+static inline
+void hof_stats_block(hof_stats* s, const double start, float* const* out,
+                     const int nChannels, const int nSamples)
+{
+    const double elapsed = hof_now_ns() - start;
+    int denormal = 0;
+
+    for (int c = 0; c < nChannels && !denormal; ++c)
+    {
+        for (int n = 0; n < nSamples; ++n)
+        {
+            const float y = fabsf(out[c][n]);
+            denormal |= (y < FLT_MIN && y != 0.f);
+        }
+    }
+
+    s->nBlocks    += 1;
+    s->nSamples   += nSamples;
+    s->ns_total   += elapsed;
+    s->ns_max      = (elapsed > s->ns_max) ? elapsed : s->ns_max;
+    s->nDenormals += denormal;
+}
+#endif
+
+#endif // _hof_util_h defined
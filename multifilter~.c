@@ -0,0 +1,233 @@
+//------------------------------------------------------------------------------
+//  Higher Order Filter Project
+//
+//  multifilter~.c: lowpass, highpass, bandpass and notch from one filter
+//  Copyright (c) 2016 Elliot Patros. All rights reserved.
+//------------------------------------------------------------------------------
+
+/*
+ * lowpass~, highpass~, bandpass~ and notch~ with the same Q and freq have the
+ * same poles, so they can share one recursion. this is a state variable
+ * filter (see hof_kernel), with each response sent out of its own outlet, for
+ * about the price of one of those objects.
+ */
+
+// Pd header and constants -----------------------------------------------------
+#include "m_pd.h"
+#include "higher_order_filter.h"
+
+// pointer to this object's class ----------------------------------------------
+static t_class* multifilter_class;
+
+// this object's struct --------------------------------------------------------
+typedef struct multifilter
+{
+    // instance of this object. must always be first
+    t_object object;
+    
+    // state of each inlet value
+    t_float     sample; // first inlet: audio, so not used for control rate
+    
+    // the filter engine (keeps Q and freq, coefficients and integrators)
+    hof_biquad* filter;
+#ifdef HOF_STATS
+    t_outlet*   info;   // outlet for the "stats" message
+#endif
+    
+} t_multifilter;
+
+// _perform --------------------------------------------------------------------
+/*
+ * called at the start of every block while 'dsp' is on.
+ * borrowing from miller's explanation, it's called with a single pointer 'ptr',
+ * where ptr[0] is our function's location in the dsp call list. we return a new
+ * pointer, which will point to the next dsp function. meanwhile, arguments that
+ * are useful for processing audio samples are packed after ptr[0], as specified
+ * in the _dsp function.
+ */
+static t_int* multifilter_perform(t_int* ptr)
+{
+    t_float*       input    = (t_float*)      ptr[1];
+    const t_int    nSamples = (t_int)         ptr[6];
+    t_multifilter* x        = (t_multifilter*)ptr[7];
+    t_float*       output[4];
+    
+    // one output vector per response
+    for (int i = 0; i < 4; ++i)
+    {
+        output[i] = (t_float*)ptr[2 + i];
+    }
+    
+    // filter this block (the engine handles any scheduled changes)
+    hof_biquad_process_multi(x->filter, input, output, nSamples);
+    
+    return &ptr[8];
+}
+
+// update a parameter ----------------------------------------------------------
+/*
+ * called by the parameter messages below, which might not come from the audio
+ * thread (libpd hosts can send them from anywhere). the change is posted to the
+ * filter engine, which applies it at the start of the next block. a 'delay'
+ * (ms.) schedules it for that much later, on the right sample.
+ */
+static void multifilter_set(t_multifilter* x, hof_param param, t_floatarg value,
+                            t_floatarg delay)
+{
+    const double samples = (delay > 0.f) ? ms_to_samples(delay, x->filter->sr)
+                                         : 0.;
+    
+    if (hof_biquad_post(x->filter, param, value, samples) == 0)
+    {
+        pd_error(x, "multifilter~: too many scheduled parameter changes");
+    }
+}
+
+// update multifilter Q --------------------------------------------------------
+/*
+ * called when we get the message "Q".
+ * updates Q (arbitrary scalar).
+ * an optional second argument delays the change (ms.).
+ */
+static void multifilter_Q(t_multifilter* x, t_floatarg new_Q, t_floatarg delay)
+{
+    multifilter_set(x, hof_Q, new_Q, delay);
+}
+
+// update multifilter frequency ------------------------------------------------
+/*
+ * called when we get the message "freq".
+ * updates freq (Hz.).
+ * an optional second argument delays the change (ms.).
+ */
+static void multifilter_freq(t_multifilter* x, t_floatarg new_freq,
+                             t_floatarg delay)
+{
+    multifilter_set(x, hof_freq, new_freq, delay);
+}
+
+#ifdef HOF_STATS
+// report stats ----------------------------------------------------------------
+/*
+ * called when we get the message "stats" (only when built with HOF_STATS).
+ * sends this object's dsp counters out of the info outlet, or zeros them if
+ * the argument is "reset".
+ */
+static void multifilter_stats(t_multifilter* x, t_symbol* arg)
+{
+    stats_message(x->info, &x->filter->stats, arg);
+}
+#endif
+
+// _free -----------------------------------------------------------------------
+/*
+ * called when this object is deleted.
+ * free any memory we've allocated.
+ */
+static void multifilter_free(t_multifilter* x)
+{
+    hof_biquad_free(x->filter);
+}
+
+// _new ------------------------------------------------------------------------
+/*
+ * called when this object is instantiated.
+ * initialize object members and allocate memory.
+ */
+static void* multifilter_new(t_symbol* selector, int argc, t_atom* argv)
+{
+    UNUSED_PARAM(selector);
+    
+    // make a pointer to this object
+    t_multifilter* x = (t_multifilter*)pd_new(multifilter_class);
+    
+    // make a filter engine (sample rate gets updated when dsp is turned on)
+    x->sample = 0.f;
+    x->filter = hof_biquad_new(hof_lowpass, 1, default_sr);
+    
+    if (x->filter == 0)
+    {
+        pd_error(x, "not enough memory for multifilter~");
+        pd_free(&x->object.ob_pd);
+        return 0;
+    }
+    
+    // make a new inlet for each parameter
+    inlet_new(&x->object, &x->object.ob_pd, gensym("float"), gensym("Q"));
+    inlet_new(&x->object, &x->object.ob_pd, gensym("float"), gensym("freq"));
+    
+    // make a signal outlet for each response (lowpass, highpass, bandpass,
+    // notch)
+    for (int i = 0; i < 4; ++i)
+    {
+        outlet_new(&x->object, gensym("signal"));
+    }
+#ifdef HOF_STATS
+    
+    // make an outlet for stats
+    x->info = outlet_new(&x->object, 0);
+#endif
+    
+    // get creation arguments from user if they exist
+    x->filter->param[hof_Q]    = (argc > 0) ? atom_getfloat(&argv[0]) : default_Q;
+    x->filter->param[hof_freq] = (argc > 1) ? atom_getfloat(&argv[1]) : default_freq;
+    
+    // every response comes from the state variable kernel (which also
+    // updates its coefficients)
+    hof_biquad_set_kernel(x->filter, hof_svf);
+    
+    return (void*)x;
+}
+
+// _dsp ------------------------------------------------------------------------
+/*
+ * called when dsp is turned on.
+ * tell pd what arguments our _perform function needs, as well as where to find
+ * them. if necessary, any initialization that needs info about pd's dsp state
+ * should happen here to.
+ */
+static void multifilter_dsp(t_multifilter* x, t_signal** sig)
+{
+    // set the filter sampling rate (and update its coefficients)
+    hof_biquad_set_sr(x->filter, sig[0]->s_sr);
+    
+    // add this object's dsp function to pd's dsp function list
+    dsp_add(multifilter_perform, // this class' perform method
+            7,                   // number of perform method parameters
+            sig[0]->s_vec,       // inlet sample vector
+            sig[1]->s_vec,       // lowpass outlet sample vector
+            sig[2]->s_vec,       // highpass outlet sample vector
+            sig[3]->s_vec,       // bandpass outlet sample vector
+            sig[4]->s_vec,       // notch outlet sample vector
+            sig[0]->s_n,         // block size (nSamples)
+            x);                  // pointer to this object
+}
+
+// _setup ----------------------------------------------------------------------
+/*
+ * called the first time someone loads this object in the current pd session.
+ * tell pd about this object's "class", including our name, and which methods
+ * and arguments we can handle.
+ */
+void multifilter_tilde_setup(void)
+{
+    // tell pd how to build our class
+    multifilter_class = class_new(gensym("multifilter~"),       // name
+                                  (t_newmethod)multifilter_new, // _new
+                                  (t_method)multifilter_free,   // _free
+                                  sizeof(t_multifilter),        // size
+                                  CLASS_DEFAULT,                // flags
+                                  A_GIMME,                      // arg types...
+                                  0);                           // ...0-terminated
+    
+    // tell pd that our left inlet expects audio
+    CLASS_MAINSIGNALIN(multifilter_class, t_multifilter, sample);
+    
+    // tell pd which methods can be called by users (including dsp)
+    class_addmethod(multifilter_class, (t_method)multifilter_dsp, gensym("dsp"), 0);
+    class_addmethod(multifilter_class, (t_method)multifilter_Q, gensym("Q"), A_FLOAT, A_DEFFLOAT, 0);
+    class_addmethod(multifilter_class, (t_method)multifilter_freq, gensym("freq"), A_FLOAT, A_DEFFLOAT, 0);
+#ifdef HOF_STATS
+    class_addmethod(multifilter_class, (t_method)multifilter_stats, gensym("stats"), A_DEFSYM, 0);
+#endif
+}
@@ -0,0 +1,226 @@
+//------------------------------------------------------------------------------
+//  Higher Order Filter Project
+//
+//  pbfdaf~.c: long adaptive filter, adapted in the frequency domain
+//  Copyright (c) 2016 Elliot Patros. All rights reserved.
+//------------------------------------------------------------------------------
+
+// Pd header and constants -----------------------------------------------------
+#include "m_pd.h"
+#include "higher_order_filter.h"
+
+// pointer to this object's class ----------------------------------------------
+static t_class* pbfdaf_class;
+
+// this object's struct --------------------------------------------------------
+typedef struct pbfdaf
+{
+    // instance of this object. must always be first
+    t_object object;
+    
+    // state of each inlet value
+    t_float     sample; // first inlet: audio, so not used for control rate
+    
+    // the filter engine (keeps the taps, input spectra and mu)
+    hof_pbfdaf* filter;
+#ifdef HOF_STATS
+    t_outlet*   info;   // outlet for the "stats" message
+#endif
+    
+} t_pbfdaf;
+
+// _perform --------------------------------------------------------------------
+/*
+ * called at the start of every block while 'dsp' is on.
+ * borrowing from miller's explanation, we get a pointer (ptr), where ptr[0] is
+ * our function's location in the dsp call list. we return a new pointer, which
+ * points to the next dsp function. meanwhile, arguments that are useful for
+ * processing audio samples are packed after ptr[0], in the order specified in
+ * this object's _dsp function.
+ */
+static t_int* pbfdaf_perform(t_int* ptr)
+{
+    // get this object's dsp-related state
+    t_float*    reference = (t_float*) ptr[1];
+    t_float*    desired   = (t_float*) ptr[2];
+    t_float*    estimate  = (t_float*) ptr[3];
+    t_float*    error     = (t_float*) ptr[4];
+    const t_int nSamples  = (t_int)    ptr[5];
+    t_pbfdaf*   x         = (t_pbfdaf*)ptr[6];
+    
+    // filter and adapt (the outputs are one partition late, and pd may hand us
+    // the same buffer for ins and outs, which the engine handles)
+    hof_pbfdaf_process(x->filter, reference, desired, estimate, error,
+                       nSamples);
+    
+    return &ptr[7];
+}
+
+// update mu -------------------------------------------------------------------
+/*
+ * called when we get the message "mu".
+ * updates the step size (0 to 1). 0 stops adapting.
+ */
+static void pbfdaf_mu(t_pbfdaf* x, t_floatarg mu)
+{
+    hof_pbfdaf_set_mu(x->filter, mu);
+}
+
+// clear -----------------------------------------------------------------------
+/*
+ * called when we get the message "clear".
+ * forget everything: taps and input history go back to zero.
+ */
+static void pbfdaf_clear(t_pbfdaf* x)
+{
+    hof_pbfdaf_reset(x->filter);
+}
+
+// write -----------------------------------------------------------------------
+/*
+ * called when we get the message "write".
+ * copies the current taps into an array (h(0) first), so they can be seen or
+ * used by fir~. taps that don't fit are left out; extra array points are
+ * zeroed. this is the only time the taps leave the engine.
+ */
+static void pbfdaf_write(t_pbfdaf* x, t_symbol* array_name)
+{
+    t_garray* array;
+    t_word*   coefs;
+    int       size;
+    
+    if ((array = (t_garray*)pd_findbyclass(array_name, garray_class)) == 0)
+    {   // array name doesn't exist
+        pd_error(x, "%s: no such array", array_name->s_name);
+    }
+    else if (garray_getfloatwords(array, &size, &coefs) == 0)
+    {   // array isn't for floats only
+        pd_error(x, "%s: bad array template for pbfdaf~", array_name->s_name);
+    }
+    else
+    {
+        hof_pbfdaf_get_taps(x->filter, &coefs[0].w_float, size,
+                         sizeof(t_word) / sizeof(t_float));
+        garray_redraw(array);
+    }
+}
+
+#ifdef HOF_STATS
+// report stats ----------------------------------------------------------------
+/*
+ * called when we get the message "stats" (only when built with HOF_STATS).
+ * sends this object's dsp counters out of the info outlet, or zeros them if
+ * the argument is "reset".
+ */
+static void pbfdaf_stats(t_pbfdaf* x, t_symbol* arg)
+{
+    stats_message(x->info, &x->filter->stats, arg);
+}
+#endif
+
+// _free -----------------------------------------------------------------------
+/*
+ * called when this object is deleted.
+ * free any memory we've allocated.
+ */
+static void pbfdaf_free(t_pbfdaf* x)
+{
+    hof_pbfdaf_free(x->filter);
+}
+
+// _new ------------------------------------------------------------------------
+/*
+ * called when a this object is instantiated.
+ * initialize object members and allocate memory.
+ * arguments are order (number of taps), partition size and mu.
+ */
+static void* pbfdaf_new(t_symbol* s, int argc, t_atom* argv)
+{
+    UNUSED_PARAM(s);
+    
+    // setup this object with it's class
+    t_pbfdaf* x = (t_pbfdaf*)pd_new(pbfdaf_class);
+    
+    // setup internal state
+    const int order = (argc > 0) ? (int)atom_getfloat(&argv[0]) : 4096;
+    const int size  = (argc > 1) ? (int)atom_getfloat(&argv[1]) : 256;
+    
+    x->sample = 0;
+    x->filter = hof_pbfdaf_new(order, size);
+    
+    if (x->filter == 0)
+    {
+        pd_error(x, "pbfdaf~: partition size must be a power of two, at least "
+                 "%d (or out of memory)", hof_fir_pad);
+        pd_free(&x->object.ob_pd);
+        return 0;
+    }
+    
+    if (argc > 2)
+    {
+        hof_pbfdaf_set_mu(x->filter, atom_getfloat(&argv[2]));
+    }
+    
+    // setup a second audio inlet (the desired signal)
+    inlet_new(&x->object, &x->object.ob_pd, gensym("signal"), gensym("signal"));
+    
+    // setup audio outlets (the estimate and the error)
+    outlet_new(&x->object, gensym("signal"));
+    outlet_new(&x->object, gensym("signal"));
+#ifdef HOF_STATS
+    
+    // setup stats outlet
+    x->info = outlet_new(&x->object, 0);
+#endif
+    
+    return (void*)x;
+}
+
+// _dsp ------------------------------------------------------------------------
+/*
+ * called when dsp is turned on.
+ * tell pd what arguments our _perform function needs, as well as where to find
+ * them. if necessary, any initialization that needs info about pd's dsp state
+ * should happen here to.
+ */
+static void pbfdaf_dsp(t_pbfdaf* x, t_signal** sig)
+{
+    dsp_add(pbfdaf_perform, // this class' perform method
+            6,              // number of perform method parameters
+            sig[0]->s_vec,  // reference inlet sample vector
+            sig[1]->s_vec,  // desired inlet sample vector
+            sig[2]->s_vec,  // estimate outlet sample vector
+            sig[3]->s_vec,  // error outlet sample vector
+            sig[0]->s_n,    // block size (nSamples)
+            x);             // pointer to this object
+}
+
+// _setup ----------------------------------------------------------------------
+/*
+ * called the first time someone loads this object in the current pd session.
+ * tell pd about this object's "class", including our name, and which methods
+ * and arguments we can handle.
+ */
+void pbfdaf_tilde_setup(void)
+{
+    // tell pd how to build our class
+    pbfdaf_class = class_new(gensym("pbfdaf~"),       // name
+                             (t_newmethod)pbfdaf_new, // _new
+                             (t_method)pbfdaf_free,   // _free
+                             sizeof(t_pbfdaf),        // size
+                             CLASS_DEFAULT,           // flags
+                             A_GIMME,                 // arg types list...
+                             0);                      // ...0-terminated
+    
+    // tell pd that our left inlet expects audio
+    CLASS_MAINSIGNALIN(pbfdaf_class, t_pbfdaf, sample);
+    
+    // tell pd which methods can be called by users (including dsp)
+    class_addmethod(pbfdaf_class, (t_method)pbfdaf_dsp, gensym("dsp"), 0);
+    class_addmethod(pbfdaf_class, (t_method)pbfdaf_mu, gensym("mu"), A_FLOAT, 0);
+    class_addmethod(pbfdaf_class, (t_method)pbfdaf_clear, gensym("clear"), 0);
+    class_addmethod(pbfdaf_class, (t_method)pbfdaf_write, gensym("write"), A_SYMBOL, 0);
+#ifdef HOF_STATS
+    class_addmethod(pbfdaf_class, (t_method)pbfdaf_stats, gensym("stats"), A_DEFSYM, 0);
+#endif
+}
@@ -19,20 +19,13 @@ typedef struct peak
     t_object object;
     
     // state of each inlet value
-    t_float sample;    // first inlet: audio, so not used for control rate
-    t_float Q;         // second inlet: filter Q, or width
-    t_float dB;        // third inlet: filter dB, or height
-    t_float freq;      // fourth inlet: filter cutoff frequency (Hz.)
+    t_float     sample; // first inlet: audio, so not used for control rate
     
-    // state of pd audio
-    t_float sr;        // sample rate (for filter math)
-    
-    // second order filter stuff
-    t_float b_coef[3]; // 'B' coefficients (B0, B1, B2)
-    t_float a_coef[2]; // 'A' coefficients (A1, A2)
-    t_float f_feed[2]; // feedforward delay
-    t_float b_feed[2]; // feedback delay
-    t_int   wptr;      // write pointer (for delay tables)
+    // the filter engine (keeps Q, dB, freq, coefficients and delay tables)
+    hof_biquad* filter;
+    t_outlet*   info;    // outlet for "latency" (and "stats")
+    int         latency; // the latency last sent out of it
+    t_clock*    poll;    // sends it once a posted change is taken
     
 } t_peak;
 
@@ -47,109 +40,154 @@ typedef struct peak
  */
 static t_int* peak_perform(t_int* ptr)
 {
-    t_float*     input    = (t_float*)ptr[1];
-    t_float*     output   = (t_float*)ptr[2];
-    const t_int  nSamples = (t_int)   ptr[3];
-    t_peak*      x        = (t_peak*) ptr[4];
+    t_float*    input    = (t_float*)ptr[1];
+    t_float*    output   = (t_float*)ptr[2];
+    const t_int nSamples = (t_int)   ptr[3];
+    t_peak*     x        = (t_peak*) ptr[4];
     
-    for (t_int n = 0; n < nSamples; ++n)
-    {
-        // get wrapped read pointers and copy input sample
-        const t_int rptr1    = x->wptr;
-        const t_int rptr0    = 1 - rptr1;
-        const t_float sample = input[n];
-        
-        // make output sample and write to feedback delay table
-        x->b_feed[x->wptr] =
-        output[n] =
-        sample           * x->b_coef[0] +
-        x->f_feed[rptr0] * x->b_coef[1] +
-        x->f_feed[rptr1] * x->b_coef[2] -
-        x->b_feed[rptr0] * x->a_coef[0] -
-        x->b_feed[rptr1] * x->a_coef[1];
-        
-        // write input sample to feedforward delay table
-        x->f_feed[x->wptr] = sample;
-        
-        // toggle write pointer
-        x->wptr = rptr0;
-    }
+    // filter this block (the engine handles any scheduled changes)
+    hof_biquad_process(x->filter, (const float* const*)&input, &output,
+                       nSamples);
     
     return &ptr[5];
 }
 
-// update coefficients ---------------------------------------------------------
+// update a parameter ----------------------------------------------------------
 /*
- * called after filter parameters are changed.
- * here we calculate the B and A coefficients for this filter. the filter
- * equations are the canonical second-order filters from DAFX vol.2 (p.50).
- * the term 'Q' is a scalar for filter resonance.
- * the term 'K' is a function of cutoff frequency and sampling rate.
- * all other terms are derived from Q and K to minimize redundant computation.
+ * called by the parameter messages below, which might not come from the audio
+ * thread (libpd hosts can send them from anywhere). the change is posted to the
+ * filter engine, which applies it at the start of the next block. a 'delay'
+ * (ms.) schedules it for that much later, on the right sample.
  */
-static void peak_update_BA(t_peak* x)
+static void peak_set(t_peak* x, hof_param param, t_floatarg value,
+                     t_floatarg delay)
 {
-    const t_float Q   = clip_Q(x->Q);
-    const t_float G   = dB_to_gain(x->dB);
-    const t_float K   = tanf(M_PI * clip_freq_ratio(x->freq, x->sr));
-    const t_float KK  = K * K;
-    const t_float KrQ = K / Q;
-    
-    if (G > 1.f)
-    {   // HF boost
-        const t_float KGrQ         = G * KrQ;
-        const t_float rDenominator = 1.f / (1.f + KrQ + KK);
-        
-        x->b_coef[0] = (1.f + KGrQ + KK) * rDenominator;
-        x->a_coef[0] =
-        x->b_coef[1] = 2.f * (KK - 1.f)  * rDenominator;
-        x->b_coef[2] = (1.f - KGrQ + KK) * rDenominator;
-        x->a_coef[1] = (1.f - KrQ + KK)  * rDenominator;
-    }
-    else
-    {   // HF attenuation
-        const t_float KrQG         = KrQ / G;
-        const t_float rDenominator = 1.f / (1.f + KrQG + KK);
-        
-        x->b_coef[0] = (1.f + KrQ + KK)  * rDenominator;
-        x->a_coef[0] =
-        x->b_coef[1] = 2.f * (KK - 1.f)  * rDenominator;
-        x->b_coef[2] = (1.f - KrQ + KK)  * rDenominator;
-        x->a_coef[1] = (1.f - KrQG + KK) * rDenominator;
+    const double samples = (delay > 0.f) ? ms_to_samples(delay, x->filter->sr)
+                                         : 0.;
+    
+    if (hof_biquad_post(x->filter, param, value, samples) == 0)
+    {
+        pd_error(x, "peak~: too many scheduled parameter changes");
     }
 }
 
-// update peak Q ------------------------------------------------------------
+// update peak Q ---------------------------------------------------------------
 /*
  * called when we get the message "Q".
  * updates Q (arbitrary scalar).
+ * an optional second argument delays the change (ms.).
  */
-static void peak_Q(t_peak* x, t_floatarg new_Q)
+static void peak_Q(t_peak* x, t_floatarg new_Q, t_floatarg delay)
 {
-    x->Q = new_Q;
-    peak_update_BA(x);
+    peak_set(x, hof_Q, new_Q, delay);
 }
 
-// update highshelf dB ---------------------------------------------------------
+// update peak dB --------------------------------------------------------------
 /*
  * called when we get the message "dB".
  * updates dB.
+ * an optional second argument delays the change (ms.).
  */
-static void peak_dB(t_peak* x, t_floatarg new_dB)
+static void peak_dB(t_peak* x, t_floatarg new_dB, t_floatarg delay)
 {
-    x->dB = new_dB;
-    peak_update_BA(x);
+    peak_set(x, hof_dB, new_dB, delay);
 }
 
-// update peak frequency ----------------------------------------------------
+// update peak frequency -------------------------------------------------------
 /*
  * called when we get the message "freq".
  * updates freq (Hz.).
+ * an optional second argument delays the change (ms.).
+ */
+static void peak_freq(t_peak* x, t_floatarg new_freq, t_floatarg delay)
+{
+    peak_set(x, hof_freq, new_freq, delay);
+}
+
+// multirate mode --------------------------------------------------------------
+/*
+ * called when we get the message "multirate".
+ * 1 filters very low cutoffs at a lower sample rate, where they're more
+ * accurate (adding some latency, which is sent out of the info outlet as
+ * "latency" once the filter has taken the change); 0 turns it off.
+ */
+static void peak_multirate(t_peak* x, t_floatarg multirate)
+{
+    if (hof_biquad_post_multirate(x->filter, multirate != 0.f) == 0)
+    {
+        pd_error(x, "not enough memory for peak~ multirate");
+        return;
+    }
+    
+    // the audio thread takes it with the next block
+    clock_delay(x->poll, 0);
+}
+
+// latency ---------------------------------------------------------------------
+/*
+ * called by our clock after a multirate or kernel change, to send the new
+ * latency once the filter has taken it.
+ */
+static void peak_poll(t_peak* x)
+{
+    latency_poll(x->poll, x->filter, x->info, &x->latency);
+}
+
+// kernel ----------------------------------------------------------------------
+/*
+ * called when we get the message "kernel".
+ * "svf" computes the filter as a state variable filter, which takes fast
+ * parameter changes smoothly and stays accurate at low cutoffs; "df1" (the
+ * default) goes back to direct form 1. the delay tables are cleared when the
+ * filter takes the change, with its next block.
+ */
+static void peak_kernel(t_peak* x, t_symbol* kernel)
+{
+    if (kernel == gensym("svf"))
+    {
+        hof_biquad_post_kernel(x->filter, hof_svf);
+    }
+    else if (kernel == gensym("df1"))
+    {
+        hof_biquad_post_kernel(x->filter, hof_df1);
+    }
+    else
+    {
+        pd_error(x, "peak~: unknown kernel '%s' (svf or df1)",
+                 kernel->s_name);
+        return;
+    }
+    
+    // the audio thread takes it with the next block
+    clock_delay(x->poll, 0);
+}
+
+#ifdef HOF_STATS
+// report stats ----------------------------------------------------------------
+/*
+ * called when we get the message "stats" (only when built with HOF_STATS).
+ * sends this object's dsp counters out of the info outlet, or zeros them if
+ * the argument is "reset".
  */
-static void peak_freq(t_peak* x, t_floatarg new_freq)
+static void peak_stats(t_peak* x, t_symbol* arg)
 {
-    x->freq = new_freq;
-    peak_update_BA(x);
+    stats_message(x->info, &x->filter->stats, arg);
+}
+#endif
+
+// _free -----------------------------------------------------------------------
+/*
+ * called when this object is deleted.
+ * free any memory we've allocated.
+ */
+static void peak_free(t_peak* x)
+{
+    if (x->poll != 0)
+    {
+        clock_free(x->poll);
+    }
+    
+    hof_biquad_free(x->filter);
 }
 
 // _new ------------------------------------------------------------------------
@@ -164,7 +202,18 @@ static void* peak_new(t_symbol* selector, int argc, t_atom* argv)
     // make a pointer to this object
     t_peak* x = (t_peak*)pd_new(peak_class);
     
-    // make a new inlet for cutoff frequency and filter Q
+    // make a filter engine (sample rate gets updated when dsp is turned on)
+    x->sample = 0.f;
+    x->filter = hof_biquad_new(hof_peak, 1, default_sr);
+    
+    if (x->filter == 0)
+    {
+        pd_error(x, "not enough memory for peak~");
+        pd_free(&x->object.ob_pd);
+        return 0;
+    }
+    
+    // make a new inlet for each parameter
     inlet_new(&x->object, &x->object.ob_pd, gensym("float"), gensym("Q"));
     inlet_new(&x->object, &x->object.ob_pd, gensym("float"), gensym("dB"));
     inlet_new(&x->object, &x->object.ob_pd, gensym("float"), gensym("freq"));
@@ -172,15 +221,18 @@ static void* peak_new(t_symbol* selector, int argc, t_atom* argv)
     // make a signal outlet
     outlet_new(&x->object, gensym("signal"));
     
+    // make an outlet for latency (and stats)
+    x->info    = outlet_new(&x->object, 0);
+    x->latency = 0;
+    x->poll    = clock_new(x, (t_method)peak_poll);
+    
     // get creation arguments from user if they exist
-    x->sample = 0.f;
-    x->sr     = 44100.f; // just a guess (it gets updated when dsp is turned on)
-    x->Q      = (argc > 0) ? atom_getfloat(&argv[0]) : default_Q;
-    x->dB     = (argc > 1) ? atom_getfloat(&argv[1]) : default_dB;
-    x->freq   = (argc > 2) ? atom_getfloat(&argv[2]) : default_freq;
+    x->filter->param[hof_Q]    = (argc > 0) ? atom_getfloat(&argv[0]) : default_Q;
+    x->filter->param[hof_dB]   = (argc > 1) ? atom_getfloat(&argv[1]) : default_dB;
+    x->filter->param[hof_freq] = (argc > 2) ? atom_getfloat(&argv[2]) : default_freq;
     
     // update BA coefficients
-    peak_update_BA(x);
+    hof_biquad_update(x->filter);
     
     return (void*)x;
 }
@@ -192,11 +244,11 @@ static void* peak_new(t_symbol* selector, int argc, t_atom* argv)
  * them. if necessary, any initialization that needs info about pd's dsp state
  * should happen here to.
  */
-static void peak_dsp (t_peak* x, t_signal** sig)
+static void peak_dsp(t_peak* x, t_signal** sig)
 {
-    // init the peak filter
-    x->sr = sig[0]->s_sr;  // set the peak filter sampling rate
-    peak_update_BA(x);     // update BA coefficients
+    // set the peak filter sampling rate (and update BA coefficients)
+    hof_biquad_set_sr(x->filter, sig[0]->s_sr);
+    latency_message(x->info, hof_biquad_latency(x->filter), &x->latency);
     
     // add this object's dsp function to pd's dsp function list
     dsp_add(peak_perform,  // this class' perform method
@@ -218,7 +270,7 @@ void peak_tilde_setup(void)
     // tell pd how to build our class
     peak_class = class_new(gensym("peak~"),       // name
                            (t_newmethod)peak_new, // _new
-                           0,                     // _free
+                           (t_method)peak_free,   // _free
                            sizeof(t_peak),        // size
                            CLASS_DEFAULT,         // flags
                            A_GIMME,               // arg types...
@@ -229,7 +281,12 @@ void peak_tilde_setup(void)
     
     // tell pd which methods can be called by users (including dsp)
     class_addmethod(peak_class, (t_method)peak_dsp, gensym("dsp"), 0);
-    class_addmethod(peak_class, (t_method)peak_Q, gensym("Q"), A_FLOAT, 0);
-    class_addmethod(peak_class, (t_method)peak_dB, gensym("dB"), A_FLOAT, 0);
-    class_addmethod(peak_class, (t_method)peak_freq, gensym("freq"), A_FLOAT, 0);
-}
\ No newline at end of file
+    class_addmethod(peak_class, (t_method)peak_Q, gensym("Q"), A_FLOAT, A_DEFFLOAT, 0);
+    class_addmethod(peak_class, (t_method)peak_dB, gensym("dB"), A_FLOAT, A_DEFFLOAT, 0);
+    class_addmethod(peak_class, (t_method)peak_freq, gensym("freq"), A_FLOAT, A_DEFFLOAT, 0);
+    class_addmethod(peak_class, (t_method)peak_multirate, gensym("multirate"), A_FLOAT, 0);
+    class_addmethod(peak_class, (t_method)peak_kernel, gensym("kernel"), A_SYMBOL, 0);
+#ifdef HOF_STATS
+    class_addmethod(peak_class, (t_method)peak_stats, gensym("stats"), A_DEFSYM, 0);
+#endif
+}
@@ -0,0 +1,655 @@
+//------------------------------------------------------------------------------
+//  Higher Order Filter Project
+//
+//  hof_render.c: filter sound files offline, with the same engines as pd
+//  Copyright (c) 2016 Elliot Patros. All rights reserved.
+//------------------------------------------------------------------------------
+
+/*
+ * runs sound files through a chain of this project's filters, and writes the
+ * results as 32 bit float files. the chain is given the way the objects would
+ * be typed into a patch, one -f per object, in order. messages for an object
+ * follow its arguments, after commas, the way they'd be sent to it before
+ * dsp starts:
+ *
+ *   hof_render -f "highpass~ 0.707 80" -f "fir~ room.wav, latency 0" *.wav
+ *
+ * second-order filters take "Q", "dB" and "freq" (without a delay),
+ * "multirate" and "kernel"; fir~ takes "latency", "trim", "sparse" and
+ * "precision". only the settings they end up with matter.
+ *
+ * the filters are libhof's engines, the same code the objects run, so output
+ * matches pd's sample for sample (neither depends on the block size). that
+ * includes fir~'s kernel, which is picked the way fir~ picks it (see
+ * hof_tune, and HOF_TUNING). fir~ takes a sound file instead of an array
+ * name, and uses its first channel.
+ *
+ * input files are memory mapped, and processed in large blocks by a pool of
+ * threads. each job is one file, or one group of a file's channels (-g).
+ *
+ * usage: hof_render [options] -f "object args[, message...]" [-f ...] file ...
+ *   -f spec      add an object (and its messages) to the end of the chain
+ *   -o dir       write output files here (default: current directory)
+ *   -j n         number of threads (default: number of cpus)
+ *   -g n         channels per job (default: all of a file's channels)
+ *   -b n         block size (samples, default 4096)
+ *   -raw sr ch   input files are headerless 32 bit floats (output will be too)
+ */
+
+#include "hof.h"
+#include "hof_util.h"
+#include "wav.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// the chain -------------------------------------------------------------------
+/*
+ * one object in the chain, with its creation arguments parsed. objects take
+ * the same arguments, in the same order, as in pd.
+ */
+#define max_chain 64
+
+typedef struct link
+{
+    int           isFir;              // fir~ (otherwise a second-order one)
+    hof_type      type;               // which second-order filter
+    float         param[hof_nParams]; // its Q, dB and freq
+    int           multirate;          // its "multirate"
+    hof_kernel    kernel;             // and "kernel"
+    float*        coefs;              // fir~'s coefficients
+    int           order;              // number of fir~ coefficients
+    int           budget;             // its "latency"
+    float         trim;               // "trim"
+    int           sparse;             // "sparse"
+    hof_precision precision;          // and "precision"
+
+} t_link;
+
+typedef struct biquad_object
+{
+    const char* name;  // object name (without the ~)
+    hof_type    type;  // engine type
+    hof_param   args[3]; // what each creation argument sets
+    int         nArgs;
+
+} t_biquad_object;
+
+static const t_biquad_object biquad_objects[] =
+{
+    {"lowpass",   hof_lowpass,   {hof_Q, hof_freq},         2},
+    {"highpass",  hof_highpass,  {hof_Q, hof_freq},         2},
+    {"bandpass",  hof_bandpass,  {hof_Q, hof_freq},         2},
+    {"notch",     hof_notch,     {hof_Q, hof_freq},         2},
+    {"allpass",   hof_allpass,   {hof_Q, hof_freq},         2},
+    {"peak",      hof_peak,      {hof_Q, hof_dB, hof_freq}, 3},
+    {"lowshelf",  hof_lowshelf,  {hof_dB, hof_freq},        2},
+    {"highshelf", hof_highshelf, {hof_dB, hof_freq},        2},
+};
+
+#define countof(a) ((int)(sizeof(a) / sizeof((a)[0])))
+
+static t_link chain[max_chain];
+static int    nChain = 0;
+
+// read fir~'s coefficients from the first channel of a sound file
+static int load_fir(t_link* l, const char* path)
+{
+    t_wav ir;
+
+    if (!wav_open(&ir, path))
+    {
+        return 0;
+    }
+
+    l->isFir = 1;
+    l->order = (int)ir.nFrames;
+    l->coefs = (float*)malloc(sizeof(float) * (ir.nFrames + 1));
+
+    if (l->coefs == 0)
+    {
+        fprintf(stderr, "%s: not enough memory\n", path);
+        wav_close(&ir);
+        return 0;
+    }
+
+    wav_read(&ir, 0, 0, 1, &l->coefs, (int)ir.nFrames);
+    wav_close(&ir);
+    return 1;
+}
+
+// split one part of a spec into words, in place
+static int split(char* text, char** words, int maxWords)
+{
+    int nWords = 0;
+
+    for (char* w = strtok(text, " \t"); w != 0 && nWords < maxWords;
+         w = strtok(0, " \t"))
+    {
+        words[nWords++] = w;
+    }
+
+    return nWords;
+}
+
+// what messages call each parameter, and fir~'s precisions
+static const char* param_names[hof_nParams] = {"Q", "dB", "freq"};
+
+static const struct
+{
+    const char*   name;
+    hof_precision precision;
+
+} precisions[] = {{"float", hof_float32}, {"half", hof_float16},
+                  {"bfloat", hof_bfloat16}};
+
+/*
+ * apply "selector arg..." to a link, the way the object takes it ('o' is the
+ * second-order object, or 0 for fir~).
+ */
+static int link_message(t_link* l, const t_biquad_object* o, char** words,
+                        int nWords)
+{
+    const char* s = words[0];
+    const char* a = (nWords > 1) ? words[1] : "0";
+    const float f = (float)strtod(a, 0);
+
+    for (int i = 0; o != 0 && i < o->nArgs; ++i)
+    {
+        if (strcmp(s, param_names[o->args[i]]) != 0)
+        {
+            continue;
+        }
+
+        if (nWords > 2 && strtod(words[2], 0) > 0.)
+        {
+            fprintf(stderr, "%s: delayed changes can't be rendered\n", s);
+            return 0;
+        }
+
+        l->param[o->args[i]] = f;
+        return 1;
+    }
+
+    for (int i = 0; o == 0 && i < countof(precisions); ++i)
+    {
+        if (!strcmp(s, "precision") && !strcmp(a, precisions[i].name))
+        {
+            l->precision = precisions[i].precision;
+            return 1;
+        }
+    }
+
+    if (o != 0 && !strcmp(s, "multirate"))
+    {
+        l->multirate = (f != 0.f);
+    }
+    else if (o != 0 && !strcmp(s, "kernel") &&
+             (!strcmp(a, "svf") || !strcmp(a, "df1")))
+    {
+        l->kernel = !strcmp(a, "svf") ? hof_svf : hof_df1;
+    }
+    else if (o == 0 && !strcmp(s, "latency"))
+    {
+        l->budget = (int)f;
+    }
+    else if (o == 0 && !strcmp(s, "trim"))
+    {
+        l->trim = f;
+    }
+    else if (o == 0 && !strcmp(s, "sparse"))
+    {
+        l->sparse = (f != 0.f);
+    }
+    else
+    {
+        fprintf(stderr, "%s~: can't take \"%s %s\"\n",
+                (o != 0) ? o->name : "fir", s, (nWords > 1) ? a : "");
+        return 0;
+    }
+
+    return 1;
+}
+
+/*
+ * parse "name arg arg..., message..., ..." into the next link. numbers are
+ * read the way pd reads them (as doubles, then rounded to float).
+ */
+static int add_link(const char* spec)
+{
+    char  copy[1024], *words[8];
+    const t_biquad_object* o = 0;
+
+    if (nChain == max_chain)
+    {
+        fprintf(stderr, "too many objects in the chain\n");
+        return 0;
+    }
+
+    snprintf(copy, sizeof(copy), "%s", spec);
+
+    char* message = strchr(copy, ',');
+
+    if (message != 0)
+    {   // the messages follow the first comma
+        *message++ = '\0';
+    }
+
+    const int nWords = split(copy, words, 8);
+
+    if (nWords == 0)
+    {
+        fprintf(stderr, "empty object in the chain\n");
+        return 0;
+    }
+
+    t_link* l = &chain[nChain];
+    const size_t nameLength = strcspn(words[0], "~");
+    memset(l, 0, sizeof(t_link));
+    l->budget = -1;
+
+    if (strncmp(words[0], "fir", nameLength) == 0 && nameLength == 3)
+    {
+        if (nWords < 2)
+        {
+            fprintf(stderr, "fir~ needs a sound file\n");
+            return 0;
+        }
+
+        if (!load_fir(l, words[1]))
+        {
+            return 0;
+        }
+
+        if (nWords > 2)
+        {   // (fir~'s second argument)
+            l->budget = (int)strtod(words[2], 0);
+        }
+    }
+
+    for (int i = 0; !l->isFir && i < countof(biquad_objects); ++i)
+    {
+        if (strlen(biquad_objects[i].name) == nameLength &&
+            strncmp(words[0], biquad_objects[i].name, nameLength) == 0)
+        {
+            o = &biquad_objects[i];
+        }
+    }
+
+    if (!l->isFir && o == 0)
+    {
+        fprintf(stderr, "%s: no such object\n", words[0]);
+        return 0;
+    }
+
+    if (o != 0)
+    {
+        l->type            = o->type;
+        l->param[hof_Q]    = default_Q;
+        l->param[hof_dB]   = default_dB;
+        l->param[hof_freq] = default_freq;
+
+        for (int a = 0; a < o->nArgs && a + 1 < nWords; ++a)
+        {
+            l->param[o->args[a]] = (float)strtod(words[a + 1], 0);
+        }
+    }
+
+    ++nChain; // (so its coefficients are freed, even if a message is wrong)
+
+    while (message != 0)
+    {
+        char* next = strchr(message, ',');
+
+        if (next != 0)
+        {
+            *next++ = '\0';
+        }
+
+        const int n = split(message, words, 8);
+
+        if (n > 0 && !link_message(l, o, words, n))
+        {
+            return 0;
+        }
+
+        message = next;
+    }
+
+    return 1;
+}
+
+// jobs ------------------------------------------------------------------------
+typedef struct job
+{
+    t_wav* in;        // input file
+    t_wav* out;       // output file
+    int    channel;   // first channel
+    int    nChannels; // number of channels
+
+} t_job;
+
+static t_job*          jobs      = 0;
+static int             nJobs     = 0;
+static int             nextJob   = 0;
+static int             blockSize = 4096;
+static int             failed    = 0;
+static pthread_mutex_t jobLock   = PTHREAD_MUTEX_INITIALIZER;
+
+/*
+ * fir~'s engine, for one channel, set up the way its messages left it (in
+ * the order fir~ sets up a filter it has opened).
+ */
+static hof_convolver* fir_engine(const t_link* l)
+{
+    hof_convolver* c = hof_convolver_new();
+
+    if (c != 0 &&
+        (hof_convolver_set_budget(c, l->budget) == 0 ||
+         hof_convolver_set_trim(c, l->trim) == 0 ||
+         hof_convolver_set_sparse(c, l->sparse) == 0 ||
+         hof_convolver_set_coefs(c, l->coefs, l->order, 1) == 0 ||
+         hof_fir_set_precision(c->head, l->precision) == 0))
+    {   // out of memory
+        hof_convolver_free(c);
+        c = 0;
+    }
+
+    return c;
+}
+
+/*
+ * make engines for each link, for this job's channels (a second-order
+ * filter runs them all, fir~ needs one per channel), and run the whole file
+ * through them a block at a time.
+ */
+static int run_job(const t_job* job)
+{
+    void*   engines[max_chain];
+    float** buffers = (float**)calloc(job->nChannels, sizeof(float*));
+    int     ok      = (buffers != 0);
+
+    for (int c = 0; ok && c < job->nChannels; ++c)
+    {
+        ok = ((buffers[c] = (float*)malloc(sizeof(float) * blockSize)) != 0);
+    }
+
+    for (int i = 0; i < nChain; ++i)
+    {
+        const t_link* l = &chain[i];
+
+        if (!ok)
+        {
+            engines[i] = 0;
+        }
+        else if (l->isFir)
+        {
+            hof_convolver** c = (hof_convolver**)
+                                calloc(job->nChannels, sizeof(hof_convolver*));
+
+            ok = (c != 0);
+
+            for (int ch = 0; ok && ch < job->nChannels; ++ch)
+            {
+                ok = ((c[ch] = fir_engine(l)) != 0);
+            }
+
+            engines[i] = c;
+        }
+        else
+        {
+            hof_biquad* f = hof_biquad_new(l->type, job->nChannels,
+                                           job->in->sr);
+
+            if ((ok = (f != 0)))
+            {
+                memcpy(f->param, l->param, sizeof(l->param));
+                hof_biquad_set_kernel(f, l->kernel);
+                ok = !l->multirate || hof_biquad_set_multirate(f, 1);
+                hof_biquad_update(f);
+            }
+
+            engines[i] = f;
+        }
+    }
+
+    for (long frame = 0; ok && frame < job->in->nFrames; frame += blockSize)
+    {
+        const long left    = job->in->nFrames - frame;
+        const int  nFrames = (left < blockSize) ? (int)left : blockSize;
+
+        wav_read(job->in, frame, job->channel, job->nChannels, buffers,
+                 nFrames);
+
+        for (int i = 0; i < nChain; ++i)
+        {
+            if (chain[i].isFir)
+            {
+                for (int c = 0; c < job->nChannels; ++c)
+                {
+                    hof_convolver_process(((hof_convolver**)engines[i])[c],
+                                          buffers[c], buffers[c], nFrames);
+                }
+            }
+            else
+            {
+                hof_biquad_process((hof_biquad*)engines[i],
+                                   (const float* const*)buffers, buffers,
+                                   nFrames);
+            }
+        }
+
+        wav_write(job->out, frame, job->channel, job->nChannels,
+                  (const float* const*)buffers, nFrames);
+    }
+
+    for (int i = 0; i < nChain; ++i)
+    {
+        if (chain[i].isFir)
+        {
+            for (int c = 0; engines[i] != 0 && c < job->nChannels; ++c)
+            {
+                hof_convolver_free(((hof_convolver**)engines[i])[c]);
+            }
+
+            free(engines[i]);
+        }
+        else
+        {
+            hof_biquad_free((hof_biquad*)engines[i]);
+        }
+    }
+
+    for (int c = 0; buffers != 0 && c < job->nChannels; ++c)
+    {
+        free(buffers[c]);
+    }
+
+    free(buffers);
+    return ok;
+}
+
+static void* worker(void* unused)
+{
+    (void)unused;
+
+    for (;;)
+    {
+        pthread_mutex_lock(&jobLock);
+        const int j = nextJob++;
+        pthread_mutex_unlock(&jobLock);
+
+        if (j >= nJobs)
+        {
+            return 0;
+        }
+
+        if (!run_job(&jobs[j]))
+        {
+            fprintf(stderr, "not enough memory for a job\n");
+            pthread_mutex_lock(&jobLock);
+            failed = 1;
+            pthread_mutex_unlock(&jobLock);
+        }
+    }
+}
+
+// main ------------------------------------------------------------------------
+static void usage(void)
+{
+    fprintf(stderr,
+            "usage: hof_render [options] -f \"object args[, message...]\" "
+            "[-f ...] file ...\n"
+            "  -f spec      add an object (and its messages) to the chain\n"
+            "  -o dir       write output files here (default: .)\n"
+            "  -j n         number of threads (default: number of cpus)\n"
+            "  -g n         channels per job (default: all)\n"
+            "  -b n         block size (samples, default 4096)\n"
+            "  -raw sr ch   input is headerless 32 bit floats\n");
+}
+
+int main(int argc, char** argv)
+{
+    const char* outDir   = ".";
+    int         nThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int         group    = 0;
+    int         raw      = 0, rawChannels = 1;
+    float       rawSr    = 0.f;
+    char**      paths    = (char**)calloc(argc, sizeof(char*));
+    int         nPaths   = 0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const int more = argc - i - 1;
+
+        if      (!strcmp(argv[i], "-f") && more >= 1)
+        {
+            if (!add_link(argv[++i])) return 1;
+        }
+        else if (!strcmp(argv[i], "-o") && more >= 1) outDir    = argv[++i];
+        else if (!strcmp(argv[i], "-j") && more >= 1) nThreads  = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-g") && more >= 1) group     = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-b") && more >= 1) blockSize = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "-raw") && more >= 2)
+        {
+            raw         = 1;
+            rawSr       = (float)atof(argv[++i]);
+            rawChannels = atoi(argv[++i]);
+        }
+        else if (argv[i][0] == '-')
+        {
+            usage();
+            return 1;
+        }
+        else
+        {
+            paths[nPaths++] = argv[i];
+        }
+    }
+
+    if (nPaths == 0 || nChain == 0 || blockSize < 1 || rawChannels < 1 ||
+        (raw && rawSr <= 0.f))
+    {
+        usage();
+        return 1;
+    }
+
+    nThreads = (nThreads < 1) ? 1 : nThreads;
+
+    // use the kernel fir~ would use on this machine (it sums in a different
+    // order from the others, so the output would differ in the last bits),
+    // and plan partitions the same way, with the same spectra cache
+    hof_cache_set_dir(hof_cache_path());
+    hof_tune(hof_tune_path());
+
+    // open every file, and split them into jobs
+    t_wav* in  = (t_wav*)calloc(nPaths, sizeof(t_wav));
+    t_wav* out = (t_wav*)calloc(nPaths, sizeof(t_wav));
+    int    nOpen = 0;
+
+    jobs = (t_job*)calloc(nPaths, sizeof(t_job));
+
+    for (int p = 0; p < nPaths; ++p)
+    {
+        char        path[4096];
+        const char* name = strrchr(paths[p], '/');
+        name = (name != 0) ? name + 1 : paths[p];
+        snprintf(path, sizeof(path), "%s/%s", outDir, name);
+
+        if (!strcmp(path, paths[p]))
+        {
+            fprintf(stderr, "%s: output would replace input\n", paths[p]);
+            failed = 1;
+            continue;
+        }
+
+        const int opened = raw ? wav_open_raw(&in[nOpen], paths[p],
+                                              rawChannels, rawSr)
+                               : wav_open(&in[nOpen], paths[p]);
+
+        if (!opened || !wav_create(&out[nOpen], path, in[nOpen].nFrames,
+                                   in[nOpen].nChannels, in[nOpen].sr, raw))
+        {
+            if (opened)
+            {
+                wav_close(&in[nOpen]);
+            }
+
+            failed = 1;
+            continue;
+        }
+
+        const int g = (group < 1 || group > in[nOpen].nChannels) ?
+                      in[nOpen].nChannels : group;
+
+        jobs = (t_job*)realloc(jobs, sizeof(t_job) *
+                               (nJobs + (in[nOpen].nChannels + g - 1) / g));
+
+        for (int c = 0; c < in[nOpen].nChannels; c += g)
+        {
+            jobs[nJobs].in        = &in[nOpen];
+            jobs[nJobs].out       = &out[nOpen];
+            jobs[nJobs].channel   = c;
+            jobs[nJobs].nChannels = (c + g > in[nOpen].nChannels) ?
+                                    in[nOpen].nChannels - c : g;
+            ++nJobs;
+        }
+
+        ++nOpen;
+    }
+
+    // run every job
+    nThreads = (nThreads > nJobs) ? nJobs : nThreads;
+    pthread_t* threads = (pthread_t*)calloc(nThreads + 1, sizeof(pthread_t));
+
+    for (int t = 0; t < nThreads; ++t)
+    {
+        pthread_create(&threads[t], 0, worker, 0);
+    }
+
+    for (int t = 0; t < nThreads; ++t)
+    {
+        pthread_join(threads[t], 0);
+    }
+
+    for (int p = 0; p < nOpen; ++p)
+    {
+        wav_close(&in[p]);
+        wav_close(&out[p]);
+    }
+
+    for (int i = 0; i < nChain; ++i)
+    {
+        free(chain[i].coefs);
+    }
+
+    free(threads);
+    free(jobs);
+    free(in);
+    free(out);
+    free(paths);
+    return failed;
+}
@@ -0,0 +1,326 @@
+//------------------------------------------------------------------------------
+//  Higher Order Filter Project
+//
+//  wav.c: memory-mapped wav (and raw float) files, for the offline tools
+//  Copyright (c) 2016 Elliot Patros. All rights reserved.
+//------------------------------------------------------------------------------
+
+#include "wav.h"
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// helpers ---------------------------------------------------------------------
+// wav files are little endian, whatever this machine is
+static unsigned long get_le(const unsigned char* p, int nBytes)
+{
+    unsigned long value = 0;
+
+    for (int i = nBytes - 1; i >= 0; --i)
+    {
+        value = (value << 8) | p[i];
+    }
+
+    return value;
+}
+
+static void put_le(unsigned char* p, unsigned long value, int nBytes)
+{
+    for (int i = 0; i < nBytes; ++i, value >>= 8)
+    {
+        p[i] = (unsigned char)(value & 0xff);
+    }
+}
+
+static int bytes_per_sample(const wav_format format)
+{
+    switch (format)
+    {
+        case wav_pcm16: return 2;
+        case wav_pcm24: return 3;
+        default:        return 4;
+    }
+}
+
+// map a whole file (0 if it can't be)
+static unsigned char* map_file(const char* path, size_t* size)
+{
+    struct stat info;
+    const int   fd = open(path, O_RDONLY);
+
+    if (fd < 0 || fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        fprintf(stderr, "%s: can't open\n", path);
+
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+
+        return 0;
+    }
+
+    void* map = mmap(0, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (map == MAP_FAILED)
+    {
+        fprintf(stderr, "%s: can't map\n", path);
+        return 0;
+    }
+
+    // we read straight through, once
+    madvise(map, info.st_size, MADV_SEQUENTIAL);
+    *size = info.st_size;
+    return (unsigned char*)map;
+}
+
+// open ------------------------------------------------------------------------
+/*
+ * walk the chunks after "RIFF....WAVE" for "fmt " and "data".
+ */
+int wav_open(t_wav* w, const char* path)
+{
+    memset(w, 0, sizeof(t_wav));
+
+    if ((w->map = map_file(path, &w->mapSize)) == 0)
+    {
+        return 0;
+    }
+
+    const unsigned char* p   = w->map;
+    const unsigned char* end = w->map + w->mapSize;
+    const unsigned char* fmt = 0;
+    int isFloat = 0, nBits = 0;
+
+    if (w->mapSize < 12 || memcmp(p, "RIFF", 4) || memcmp(p + 8, "WAVE", 4))
+    {
+        fprintf(stderr, "%s: not a wav file\n", path);
+        wav_close(w);
+        return 0;
+    }
+
+    for (p += 12; p + 8 <= end; p += 8 + ((get_le(p + 4, 4) + 1) & ~1ul))
+    {
+        const unsigned long size = get_le(p + 4, 4);
+
+        if (memcmp(p, "fmt ", 4) == 0 && size >= 16)
+        {
+            fmt = p + 8;
+            const unsigned long tag = get_le(fmt, 2);
+
+            // WAVE_FORMAT_EXTENSIBLE keeps the real tag in its sub-format
+            isFloat      = (tag == 0xfffe && size >= 26) ? get_le(fmt + 24, 2)
+                                                         == 3 : tag == 3;
+            w->nChannels = (int)get_le(fmt + 2, 2);
+            w->sr        = (float)get_le(fmt + 4, 4);
+            nBits        = (int)get_le(fmt + 14, 2);
+        }
+        else if (memcmp(p, "data", 4) == 0 && fmt != 0)
+        {
+            w->data = (unsigned char*)p + 8;
+            w->nFrames = (long)(((size < (size_t)(end - w->data)) ?
+                                 size : (size_t)(end - w->data)));
+            break;
+        }
+    }
+
+    if      (isFloat && nBits == 32)  { w->format = wav_float32; }
+    else if (!isFloat && nBits == 16) { w->format = wav_pcm16; }
+    else if (!isFloat && nBits == 24) { w->format = wav_pcm24; }
+    else if (!isFloat && nBits == 32) { w->format = wav_pcm32; }
+    else
+    {
+        nBits = 0;
+    }
+
+    if (w->data == 0 || nBits == 0 || w->nChannels < 1)
+    {
+        fprintf(stderr, "%s: unsupported wav file (16, 24 or 32 bit integer, "
+                        "or 32 bit float only)\n", path);
+        wav_close(w);
+        return 0;
+    }
+
+    w->nFrames /= bytes_per_sample(w->format) * w->nChannels;
+    return 1;
+}
+
+int wav_open_raw(t_wav* w, const char* path, int nChannels, float sr)
+{
+    memset(w, 0, sizeof(t_wav));
+
+    if ((w->map = map_file(path, &w->mapSize)) == 0)
+    {
+        return 0;
+    }
+
+    w->data      = w->map;
+    w->nChannels = nChannels;
+    w->sr        = sr;
+    w->format    = wav_float32;
+    w->raw       = 1;
+    w->nFrames   = (long)(w->mapSize / (sizeof(float) * nChannels));
+    return 1;
+}
+
+// create ----------------------------------------------------------------------
+/*
+ * the header is a 32 bit float wav's: "RIFF", "fmt " (with an empty
+ * extension), "fact" (the number of frames), then "data".
+ */
+#define wav_header_size 58
+
+int wav_create(t_wav* w, const char* path, long nFrames, int nChannels,
+               float sr, int raw)
+{
+    const size_t dataSize = (size_t)nFrames * nChannels * sizeof(float);
+    const size_t header   = raw ? 0 : wav_header_size;
+
+    memset(w, 0, sizeof(t_wav));
+
+    if (!raw && dataSize > 0xffffffffu - wav_header_size)
+    {
+        fprintf(stderr, "%s: too long for a wav file\n", path);
+        return 0;
+    }
+
+    const int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+
+    if (fd < 0 || ftruncate(fd, (off_t)(header + dataSize)) != 0)
+    {
+        fprintf(stderr, "%s: can't create\n", path);
+
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+
+        return 0;
+    }
+
+    void* map = (header + dataSize > 0) ?
+                mmap(0, header + dataSize, PROT_READ | PROT_WRITE, MAP_SHARED,
+                     fd, 0) : MAP_FAILED;
+    close(fd);
+
+    if (map == MAP_FAILED)
+    {
+        fprintf(stderr, "%s: can't map\n", path);
+        return 0;
+    }
+
+    w->map       = (unsigned char*)map;
+    w->mapSize   = header + dataSize;
+    w->data      = w->map + header;
+    w->nFrames   = nFrames;
+    w->nChannels = nChannels;
+    w->sr        = sr;
+    w->format    = wav_float32;
+    w->raw       = raw;
+    w->writable  = 1;
+
+    if (!raw)
+    {
+        unsigned char* p = w->map;
+
+        memcpy(p, "RIFF", 4);
+        put_le(p + 4, (unsigned long)(wav_header_size - 8 + dataSize), 4);
+        memcpy(p + 8, "WAVEfmt ", 8);
+        put_le(p + 16, 18, 4);                              // fmt size
+        put_le(p + 20, 3, 2);                               // float
+        put_le(p + 22, nChannels, 2);
+        put_le(p + 24, (unsigned long)sr, 4);
+        put_le(p + 28, (unsigned long)sr * nChannels * 4, 4); // bytes/second
+        put_le(p + 32, nChannels * 4, 2);                   // bytes/frame
+        put_le(p + 34, 32, 2);                              // bits
+        put_le(p + 36, 0, 2);                               // no extension
+        memcpy(p + 38, "fact", 4);
+        put_le(p + 42, 4, 4);
+        put_le(p + 46, (unsigned long)nFrames, 4);
+        memcpy(p + 50, "data", 4);
+        put_le(p + 54, (unsigned long)dataSize, 4);
+    }
+
+    return 1;
+}
+
+void wav_close(t_wav* w)
+{
+    if (w->map != 0)
+    {
+        if (w->writable)
+        {
+            msync(w->map, w->mapSize, MS_SYNC);
+        }
+
+        munmap(w->map, w->mapSize);
+    }
+
+    memset(w, 0, sizeof(t_wav));
+}
+
+// read/write ------------------------------------------------------------------
+/*
+ * integers are scaled by a power of two, like pd's soundfiler, so they
+ * convert to exactly the same floats.
+ */
+void wav_read(const t_wav* w, long frame, int channel, int nChannels,
+              float* const* out, int nFrames)
+{
+    const int bytes  = bytes_per_sample(w->format);
+    const int stride = bytes * w->nChannels;
+
+    for (int c = 0; c < nChannels; ++c)
+    {
+        const unsigned char* p = w->data + frame * stride +
+                                 (channel + c) * bytes;
+        float* y = out[c];
+
+        for (int n = 0; n < nFrames; ++n, p += stride)
+        {
+            int32_t i;
+
+            switch (w->format)
+            {
+                case wav_pcm16:
+                    i = (int32_t)(get_le(p, 2) << 16);
+                    y[n] = (float)(i * (1. / 2147483648.));
+                    break;
+                case wav_pcm24:
+                    i = (int32_t)(get_le(p, 3) << 8);
+                    y[n] = (float)(i * (1. / 2147483648.));
+                    break;
+                case wav_pcm32:
+                    i = (int32_t)get_le(p, 4);
+                    y[n] = (float)(i * (1. / 2147483648.));
+                    break;
+                case wav_float32:
+                    memcpy(&y[n], p, sizeof(float));
+                    break;
+            }
+        }
+    }
+}
+
+void wav_write(t_wav* w, long frame, int channel, int nChannels,
+               const float* const* in, int nFrames)
+{
+    const size_t stride = sizeof(float) * w->nChannels;
+
+    for (int c = 0; c < nChannels; ++c)
+    {
+        unsigned char* p = w->data + frame * stride +
+                           (channel + c) * sizeof(float);
+
+        for (int n = 0; n < nFrames; ++n, p += stride)
+        {
+            memcpy(p, &in[c][n], sizeof(float));
+        }
+    }
+}
@@ -0,0 +1,66 @@
+//------------------------------------------------------------------------------
+//  Higher Order Filter Project
+//
+//  wav.h: memory-mapped wav (and raw float) files, for the offline tools
+//  Copyright (c) 2016 Elliot Patros. All rights reserved.
+//------------------------------------------------------------------------------
+
+#ifndef _wav_h
+#define _wav_h
+
+#include <stddef.h>
+
+/*
+ * a sound file, mapped into memory. input can be 16, 24 or 32 bit integer or
+ * 32 bit float wav, or headerless 32 bit floats ("raw"). output is always 32
+ * bit float, so nothing the filters produce is lost. integer samples become
+ * floats exactly as pd's soundfiler converts them.
+ *
+ * reading and writing different channels of the same file from different
+ * threads is safe; nothing is shared but the mapped memory.
+ */
+typedef enum wav_format
+{
+    wav_pcm16,
+    wav_pcm24,
+    wav_pcm32,
+    wav_float32
+
+} wav_format;
+
+typedef struct wav
+{
+    unsigned char* map;       // the whole file
+    size_t         mapSize;   // size of the file (bytes)
+    unsigned char* data;      // the first sample frame
+    long           nFrames;   // number of sample frames
+    int            nChannels; // number of channels
+    float          sr;        // sample rate (Hz.)
+    wav_format     format;    // sample format
+    int            raw;       // 1 if the file has no header
+    int            writable;  // 1 if the file was made by wav_create
+
+} t_wav;
+
+// map a wav file for reading. returns 0 (and prints why) if it can't
+int wav_open(t_wav* w, const char* path);
+
+// map a headerless file of 32 bit floats for reading
+int wav_open_raw(t_wav* w, const char* path, int nChannels, float sr);
+
+// make a new 32 bit float file (wav, or raw if 'raw'), and map it for writing
+int wav_create(t_wav* w, const char* path, long nFrames, int nChannels,
+               float sr, int raw);
+
+// unmap (and finish writing) a file
+void wav_close(t_wav* w);
+
+// read channels [channel, channel + nChannels) of some frames, as floats
+void wav_read(const t_wav* w, long frame, int channel, int nChannels,
+              float* const* out, int nFrames);
+
+// write channels [channel, channel + nChannels) of some frames
+void wav_write(t_wav* w, long frame, int channel, int nChannels,
+               const float* const* in, int nFrames);
+
+#endif // _wav_h defined